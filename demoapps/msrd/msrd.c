@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2013-2017, Lawrence Livermore National Security, LLC.
+ *
+ * Produced at the Lawrence Livermore National Laboratory. Written by:
+ *     Barry Rountree <rountree@llnl.gov>,
+ *     Scott Walker <walker91@llnl.gov>, and
+ *     Kathleen Shoga <shoga1@llnl.gov>.
+ *
+ * LLNL-CODE-645430
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr. For details, see https://github.com/LLNL/libmsr.git.
+ *
+ * Please also read libmsr/LICENSE for our notice and the LGPL.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License (as published by the Free
+ * Software Foundation) version 2.1 dated February 1999.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the IMPLIED WARRANTY OF MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the terms and conditions of the GNU Lesser
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <msr_core.h>
+#include <msr_sampler.h>
+#include <msr_shm.h>
+
+static volatile sig_atomic_t running = 1;
+
+static void stop(int sig)
+{
+    running = 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *usage = "\n"
+                        "NAME\n"
+                        "  msrd - node-wide libmsr sampling daemon\n"
+                        "\n"
+                        "SYNOPSIS\n"
+                        "  %s [-h] [-i interval_ms] [-n shm_name]\n"
+                        "\n"
+                        "OVERVIEW\n"
+                        "  Samples RAPL, clocks, temperatures and fixed\n"
+                        "  counters on a fixed schedule and publishes each\n"
+                        "  snapshot into a POSIX shared-memory segment.\n"
+                        "  Readers use msr_shm_attach()/msr_shm_read() and\n"
+                        "  never touch the MSR devices themselves.\n"
+                        "\n"
+                        "OPTIONS\n"
+                        "  -h\n"
+                        "      Display this help information, then exit.\n"
+                        "  -i interval_ms\n"
+                        "      Sampling interval in milliseconds, at least\n"
+                        "      1. Default is 100.\n"
+                        "  -n shm_name\n"
+                        "      Name of the shared-memory segment. Default\n"
+                        "      is " MSR_SHM_NAME ".\n"
+                        "\n";
+    struct sigaction sa;
+    struct msr_sampler *sampler;
+    struct msr_sampler_config cfg;
+    struct msr_sampler_stats stats;
+    struct pollfd pfd;
+    uint64_t ticks;
+    const char *name = MSR_SHM_NAME;
+    uint64_t interval_ns = 100000000ULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "hi:n:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'i':
+                interval_ns = strtoull(optarg, NULL, 10) * 1000000ULL;
+                break;
+            case 'n':
+                name = optarg;
+                break;
+            case 'h':
+                printf(usage, argv[0]);
+                return 0;
+            default:
+                fprintf(stderr, usage, argv[0]);
+                return -1;
+        }
+    }
+    if (interval_ns < MSR_SAMPLER_MIN_PERIOD_NS)
+    {
+        fprintf(stderr, usage, argv[0]);
+        return -1;
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = stop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    if (init_msr())
+    {
+        fprintf(stderr, "Error: unable to initialize msr.\n");
+        return -1;
+    }
+    if (msr_shm_create(name, interval_ns))
+    {
+        finalize_msr();
+        return -1;
+    }
+
+    /* The sampler ticks on absolute deadlines so the schedule does not
+     * drift. Publishing stays on this thread, which owns the batches. */
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.period_ns = interval_ns;
+    cfg.cpu = -1;
+    cfg.notify = 1;
+    if (msr_sampler_start(&sampler, &cfg))
+    {
+        msr_shm_destroy();
+        finalize_msr();
+        return -1;
+    }
+    pfd.fd = msr_sampler_eventfd(sampler);
+    pfd.events = POLLIN;
+    msr_shm_publish();
+    while (running)
+    {
+        /* SIGINT and SIGTERM interrupt the poll. */
+        if (poll(&pfd, 1, -1) > 0 && read(pfd.fd, &ticks, sizeof(ticks)) == sizeof(ticks))
+        {
+            msr_shm_publish();
+        }
+    }
+    msr_sampler_get_stats(sampler, &stats);
+    msr_sampler_stop(sampler);
+    if (stats.overruns)
+    {
+        fprintf(stderr, "Warning: %lu of %lu samples were skipped.\n", (unsigned long)stats.overruns, (unsigned long)(stats.samples + stats.overruns));
+    }
+
+    msr_shm_destroy();
+    finalize_msr();
+    return 0;
+}
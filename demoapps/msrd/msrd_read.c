@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2013-2017, Lawrence Livermore National Security, LLC.
+ *
+ * Produced at the Lawrence Livermore National Laboratory. Written by:
+ *     Barry Rountree <rountree@llnl.gov>,
+ *     Scott Walker <walker91@llnl.gov>, and
+ *     Kathleen Shoga <shoga1@llnl.gov>.
+ *
+ * LLNL-CODE-645430
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr. For details, see https://github.com/LLNL/libmsr.git.
+ *
+ * Please also read libmsr/LICENSE for our notice and the LGPL.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License (as published by the Free
+ * Software Foundation) version 2.1 dated February 1999.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the IMPLIED WARRANTY OF MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the terms and conditions of the GNU Lesser
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <msr_shm.h>
+
+int main(int argc, char **argv)
+{
+    const char *name = MSR_SHM_NAME;
+    struct msr_shm_client client;
+    const struct msr_shm_header *hdr;
+    const struct msr_shm_socket *sock;
+    const struct msr_shm_core *core;
+    const struct msr_shm_thread *thr;
+    void *snap;
+    uint64_t i;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n':
+                name = optarg;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n shm_name]\n", argv[0]);
+                return -1;
+        }
+    }
+    if (msr_shm_attach(name, &client))
+    {
+        return -1;
+    }
+    snap = malloc(client.size);
+    if (snap == NULL || msr_shm_read(&client, snap))
+    {
+        fprintf(stderr, "Error: no consistent snapshot.\n");
+        msr_shm_detach(&client);
+        free(snap);
+        return -1;
+    }
+    hdr = (const struct msr_shm_header *) snap;
+    sock = msr_shm_sockets(snap);
+    core = msr_shm_cores(snap);
+    thr = msr_shm_threads(snap);
+
+    fprintf(stdout, "publisher pid %ld, sample %lu, age %.3f ms, sources 0x%lx\n", (long)hdr->pid, hdr->nsamples, msr_shm_age_ns(snap) / 1e6, hdr->sources);
+    for (i = 0; i < hdr->nsockets; i++)
+    {
+        fprintf(stdout, "socket %lu: pkg %.2f W (%.1f J) dram %.2f W (%.1f J) temp %ld C\n", i, sock[i].pkg_watts, sock[i].pkg_joules, sock[i].dram_watts, sock[i].dram_joules, (long)sock[i].pkg_temp);
+    }
+    for (i = 0; i < hdr->ncores; i++)
+    {
+        fprintf(stdout, "core %lu: temp %ld C\n", i, (long)core[i].temp);
+    }
+    for (i = 0; i < hdr->nthreads; i++)
+    {
+        fprintf(stdout, "thread %lu: aperf %lu mperf %lu tsc %lu inst %lu ucc %lu urc %lu\n", i, thr[i].aperf, thr[i].mperf, thr[i].tsc, thr[i].inst_retired, thr[i].unhalted_core, thr[i].unhalted_ref);
+    }
+    msr_shm_detach(&client);
+    free(snap);
+    return 0;
+}
@@ -29,7 +29,39 @@
  * Temple Place, Suite 330, Boston, MA 02111-1307 USA.
  */
 
+#include <poll.h>
 #include <stdint.h>
+#include <string.h>
+
+#include <msr_sampler.h>
+#include "trace.h"
+
+/// @brief Default sample period of the measurement thread in milliseconds.
+#define POWMON_PERIOD_MS 100
+
+/// @brief Number of fields in each sample.
+#define POWMON_NCOLS 11
+
+/// @brief Sample period in use, in milliseconds.
+static unsigned long period_ms = POWMON_PERIOD_MS;
+
+/// @brief Binary trace, written instead of logfile when open.
+static struct trace_writer *tracefile = NULL;
+
+/// @brief Columns of a sample, in the order of the text log.
+static const struct trace_column trace_columns[POWMON_NCOLS] = {
+    {"time", "ms", TRACE_I64},
+    {"pkg_joules0", "J", TRACE_F64},
+    {"pkg_joules1", "J", TRACE_F64},
+    {"pkg_limwatts0", "W", TRACE_F64},
+    {"pkg_limwatts1", "W", TRACE_F64},
+    {"dram_joules0", "J", TRACE_F64},
+    {"dram_joules1", "J", TRACE_F64},
+    {"instr0", "", TRACE_U64},
+    {"instr1", "", TRACE_U64},
+    {"core0", "", TRACE_U64},
+    {"core1", "", TRACE_U64},
+};
 
 int init_data(void)
 {
@@ -66,25 +98,111 @@ void take_measurement(void)
     {
         min_watts = rapl_data[5];
     }
-    fprintf(logfile, "%ld %lf %lf %lf %lf %lf %lf %lu %lu %lu %lu\n", now_ms(), rapl_data[0], rapl_data[1], rapl_data[6], rapl_data[7], rapl_data[8], rapl_data[9], instr0, instr1, core0, core1);
+    if (tracefile != NULL)
+    {
+        union trace_value rec[POWMON_NCOLS];
+        int i;
+
+        rec[0].i = now_ms();
+        rec[1].d = rapl_data[0];
+        rec[2].d = rapl_data[1];
+        for (i = 0; i < 4; i++)
+        {
+            rec[3 + i].d = rapl_data[6 + i];
+        }
+        rec[7].u = instr0;
+        rec[8].u = instr1;
+        rec[9].u = core0;
+        rec[10].u = core1;
+        trace_append(tracefile, rec);
+    }
+    else
+    {
+        fprintf(logfile, "%ld %lf %lf %lf %lf %lf %lf %lu %lu %lu %lu\n", now_ms(), rapl_data[0], rapl_data[1], rapl_data[6], rapl_data[7], rapl_data[8], rapl_data[9], instr0, instr1, core0, core1);
+    }
     pthread_mutex_unlock(&mlock);
 }
 
+/// @brief Start a library sampler that signals its eventfd every period.
+///
+/// @param [in] ms Sample period in milliseconds.
+///
+/// @return Sampler handle, else NULL if it could not be started.
+static struct msr_sampler *start_sampler(unsigned long ms)
+{
+    struct msr_sampler *sampler;
+    struct msr_sampler_config cfg;
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.period_ns = ms * 1000000ULL;
+    cfg.cpu = -1;
+    cfg.notify = 1;
+    if (msr_sampler_start(&sampler, &cfg))
+    {
+        fprintf(stderr, "Error: could not start a %lu ms sampler.\n", ms);
+        return NULL;
+    }
+    return sampler;
+}
+
+/// @brief Wait for the next tick of the sampler.
+///
+/// @param [in] sampler Sampler handle.
+///
+/// @param [in] ms Sample period in milliseconds, bounds how long it takes to
+///        notice that running was cleared.
+///
+/// @return 1 on a tick, else 0 once running is cleared.
+static int wait_sampler(struct msr_sampler *sampler, unsigned long ms)
+{
+    struct pollfd pfd;
+    uint64_t ticks;
+
+    pfd.fd = msr_sampler_eventfd(sampler);
+    pfd.events = POLLIN;
+    while (running)
+    {
+        if (poll(&pfd, 1, (int)ms) > 0 && read(pfd.fd, &ticks, sizeof(ticks)) == sizeof(ticks))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/// @brief Stop the sampler and report samples it had to skip.
+///
+/// @param [in] sampler Sampler handle.
+static void stop_sampler(struct msr_sampler *sampler)
+{
+    struct msr_sampler_stats stats;
+
+    msr_sampler_get_stats(sampler, &stats);
+    msr_sampler_stop(sampler);
+    if (stats.overruns)
+    {
+        fprintf(stderr, "Warning: %lu of %lu samples were skipped, max jitter %lu us.\n", (unsigned long)stats.overruns, (unsigned long)(stats.samples + stats.overruns), (unsigned long)(stats.jitter_max_ns / 1000));
+    }
+}
+
 void *power_measurement(void *arg)
 {
-    struct mstimer timer;
+    struct msr_sampler *sampler;
     // According to the Intel docs, the counter wraps at most once per second.
     // 100 ms should be short enough to always get good information.
-    init_msTimer(&timer, 100);
     init_data();
     read_rapl_init();
     start = now_ms();
 
-    timer_sleep(&timer);
-    while (running)
+    sampler = start_sampler(period_ms);
+    if (sampler == NULL)
+    {
+        return arg;
+    }
+    while (wait_sampler(sampler, period_ms))
     {
         take_measurement();
-        timer_sleep(&timer);
     }
+    stop_sampler(sampler);
     return arg;
 }
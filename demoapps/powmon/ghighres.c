@@ -58,7 +58,7 @@ unsigned long now_rt_ms(void)
 }
 #endif
 
-/// @brief Get a number of millis from a monotonic clock.
+/// @brief Get a number of millis from the realtime clock.
 unsigned long now_ms(void)
 {
     struct timespec t;
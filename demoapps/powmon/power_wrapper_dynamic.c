@@ -73,18 +73,21 @@ static int running = 1;
 void *power_set_measurement(void *arg)
 {
     unsigned long poll_num = 0;
-    struct mstimer timer;
+    struct msr_sampler *sampler;
     set_rapl_power(watt_cap, watt_cap);
     double watts = watt_cap;
     // According to the Intel docs, the counter wraps a most once per second.
     // 100 ms should be short enough to always get good information.
-    init_msTimer(&timer, 1500);
     init_data();
     start = now_ms();
 
+    sampler = start_sampler(1500);
+    if (sampler == NULL)
+    {
+        return arg;
+    }
     poll_num++;
-    timer_sleep(&timer);
-    while (running)
+    while (wait_sampler(sampler, 1500))
     {
         take_measurement();
         if (poll_num%5 == 0)
@@ -101,8 +104,9 @@ void *power_set_measurement(void *arg)
             set_rapl_power(watts, watts);
         }
         poll_num++;
-        timer_sleep(&timer);
     }
+    stop_sampler(sampler);
+    return arg;
 }
 
 int main(int argc, char**argv)
@@ -79,7 +79,7 @@ int main(int argc, char **argv)
                         "NAME\n"
                         "  powmon - Package and DRAM power monitor\n"
                         "SYNOPSIS\n"
-                        "  %s [--help | -h] [-c] <executable> <args> ...\n"
+                        "  %s [--help | -h] [-c] [-b] [-z] [-p period_ms] <executable> <args> ...\n"
                         "OVERVIEW\n"
                         "  Powmon is a utility for sampling and printing the\n"
                         "  power consumption (for package and DRAM) and power\n"
@@ -89,6 +89,15 @@ int main(int argc, char **argv)
                         "      Display this help information, then exit.\n"
                         "  -c\n"
                         "      Remove stale shared memory.\n"
+                        "  -b\n"
+                        "      Write a binary trace to <host>.power.trace\n"
+                        "      instead of the text log <host>.power.dat.\n"
+                        "      Convert it to text with powmon-trace2txt.\n"
+                        "  -z\n"
+                        "      Like -b, but delta encode and bit-pack the\n"
+                        "      records in blocks of 1024 samples.\n"
+                        "  -p period_ms\n"
+                        "      Sample period in milliseconds. Default is 100.\n"
                         "\n";
     if (argc == 1 || (argc > 1 && (
                           strncmp(argv[1], "--help", strlen("--help")) == 0 ||
@@ -103,20 +112,43 @@ int main(int argc, char **argv)
         return 1;
     }
 
+    int binary = 0;
+    int compress = 0;
     int opt;
-    while ((opt = getopt(argc, argv, "c")) != -1)
+    /* Stop at the executable so its own options are left alone. */
+    while ((opt = getopt(argc, argv, "+cbzp:")) != -1)
     {
         switch(opt)
         {
             case 'c':
                 highlander_clean();
                 return 0;
+            case 'b':
+                binary = 1;
+                break;
+            case 'z':
+                binary = 1;
+                compress = 1;
+                break;
+            case 'p':
+                period_ms = strtoul(optarg, NULL, 10);
+                if (period_ms == 0)
+                {
+                    fprintf(stderr, usage, argv[0]);
+                    return -1;
+                }
+                break;
             default:
                 fprintf(stderr, "\nError: unknown paramater \"%c\"\n", opt);
                 fprintf(stderr, usage, argv[0]);
                 return -1;
         }
     }
+    if (optind >= argc)
+    {
+        fprintf(stderr, usage, argv[0]);
+        return -1;
+    }
 
     if (highlander())
     {
@@ -126,7 +158,7 @@ int main(int argc, char **argv)
         gethostname(hostname,64);
 
         char *fname;
-        int ret = asprintf(&fname, "%s.power.dat", hostname);
+        int ret = asprintf(&fname, (binary ? "%s.power.trace" : "%s.power.dat"), hostname);
         if (ret < 0)
         {
             printf("Fatal Error: Cannot allocate memory for fname.\n");
@@ -139,8 +171,19 @@ int main(int argc, char **argv)
             printf("Fatal Error: %s on %s cannot open the appropriate fd.\n", argv[0], hostname);
             return 1;
         }
-        logfile = fdopen(logfd, "w");
-        fprintf(logfile, "time pkg_joules0 pkg_joules1 pkg_limwatts0 pkg_limwatts1 dram_joules0 dram_joules1 instr0 instr1 core0 core1\n");
+        if (binary)
+        {
+            if (trace_open(&tracefile, logfd, trace_columns, POWMON_NCOLS, 2, period_ms * 1000, now_ms(), (compress ? TRACE_COMPRESSED : 0)))
+            {
+                printf("Fatal Error: %s on %s cannot write the trace header.\n", argv[0], hostname);
+                return 1;
+            }
+        }
+        else
+        {
+            logfile = fdopen(logfd, "w");
+            fprintf(logfile, "time pkg_joules0 pkg_joules1 pkg_limwatts0 pkg_limwatts1 dram_joules0 dram_joules1 instr0 instr1 core0 core1\n");
+        }
 
         /* Start power measurement thread. */
         pthread_t mthread;
@@ -152,7 +195,7 @@ int main(int argc, char **argv)
         if (app_pid == 0)
         {
             /* I'm the child. */
-            execvp(argv[1], &argv[1]);
+            execvp(argv[optind], &argv[optind]);
             printf("fork failure\n");
             return 1;
         }
@@ -164,8 +207,13 @@ int main(int argc, char **argv)
 
         /* Stop power measurement thread. */
         running = 0;
+        pthread_join(mthread, NULL);
         take_measurement();
         end = now_ms();
+        if (tracefile != NULL && trace_close(tracefile))
+        {
+            printf("Error: %s on %s could not write the whole trace.\n", argv[0], hostname);
+        }
 
         /* Output summary data. */
         ret = asprintf(&fname, "%s.power.summary", hostname);
@@ -204,7 +252,7 @@ int main(int argc, char **argv)
         if (app_pid == 0)
         {
             /* I'm the child. */
-            execvp(argv[1], &argv[1]);
+            execvp(argv[optind], &argv[optind]);
             printf("Fork failure\n");
             return 1;
         }
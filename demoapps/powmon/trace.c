@@ -0,0 +1,328 @@
+/*
+ * Copyright (c) 2013-2017, Lawrence Livermore National Security, LLC.
+ *
+ * Produced at the Lawrence Livermore National Laboratory. Written by:
+ *     Barry Rountree <rountree@llnl.gov>,
+ *     Scott Walker <walker91@llnl.gov>, and
+ *     Kathleen Shoga <shoga1@llnl.gov>.
+ *
+ * LLNL-CODE-645430
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr. For details, see https://github.com/LLNL/libmsr.git.
+ *
+ * Please also read libmsr/LICENSE for our notice and the LGPL.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License (as published by the Free
+ * Software Foundation) version 2.1 dated February 1999.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the IMPLIED WARRANTY OF MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the terms and conditions of the GNU Lesser
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <msr_codec.h>
+
+#include "trace.h"
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "Binary traces are written in host order, which must be little endian."
+#endif
+
+struct trace_writer
+{
+    /// @brief Trace file.
+    int fd;
+    /// @brief Size of one record in bytes.
+    unsigned record_size;
+    /// @brief Non-zero if records go through codec.
+    int compressed;
+    /// @brief Record encoder of a compressed trace.
+    struct msr_codec codec;
+    /// @brief Buffered blocks.
+    char *blocks[TRACE_NBLOCKS];
+    /// @brief Number of bytes used in each block.
+    size_t fill[TRACE_NBLOCKS];
+    /// @brief Block the sampler is filling.
+    unsigned head;
+    /// @brief Next block the writer thread will write.
+    unsigned tail;
+    /// @brief Number of full blocks queued for the writer thread.
+    unsigned pending;
+    /// @brief Non-zero once trace_close() has queued the last block.
+    int closing;
+    /// @brief Non-zero if a write failed.
+    int err;
+    /// @brief Non-zero if the writer thread is running, else blocks are
+    /// written synchronously by trace_handoff().
+    int threaded;
+    pthread_mutex_t lock;
+    /// @brief Signalled when a block is queued.
+    pthread_cond_t queued;
+    /// @brief Signalled when a block has been written.
+    pthread_cond_t written;
+    pthread_t thread;
+};
+
+/// @brief Write a whole buffer, retrying short writes.
+static int write_all(int fd, const char *buf, size_t len)
+{
+    ssize_t n;
+
+    while (len > 0)
+    {
+        n = write(fd, buf, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/// @brief Writer thread, writes queued blocks in order until closed.
+static void *trace_thread(void *arg)
+{
+    struct trace_writer *tw = (struct trace_writer *) arg;
+    unsigned b;
+
+    pthread_mutex_lock(&tw->lock);
+    while (1)
+    {
+        while (tw->pending == 0 && !tw->closing)
+        {
+            pthread_cond_wait(&tw->queued, &tw->lock);
+        }
+        if (tw->pending == 0)
+        {
+            break;
+        }
+        b = tw->tail;
+        pthread_mutex_unlock(&tw->lock);
+
+        if (write_all(tw->fd, tw->blocks[b], tw->fill[b]))
+        {
+            tw->err = 1;
+        }
+
+        pthread_mutex_lock(&tw->lock);
+        tw->fill[b] = 0;
+        tw->tail = (tw->tail + 1) % TRACE_NBLOCKS;
+        tw->pending--;
+        pthread_cond_signal(&tw->written);
+    }
+    pthread_mutex_unlock(&tw->lock);
+    return arg;
+}
+
+/// @brief Queue the current block and move to the next free one.
+static void trace_handoff(struct trace_writer *tw)
+{
+    if (!tw->threaded)
+    {
+        if (write_all(tw->fd, tw->blocks[tw->head], tw->fill[tw->head]))
+        {
+            tw->err = 1;
+        }
+        tw->fill[tw->head] = 0;
+        return;
+    }
+    pthread_mutex_lock(&tw->lock);
+    tw->pending++;
+    pthread_cond_signal(&tw->queued);
+    while (tw->pending == TRACE_NBLOCKS)
+    {
+        pthread_cond_wait(&tw->written, &tw->lock);
+    }
+    tw->head = (tw->head + 1) % TRACE_NBLOCKS;
+    pthread_mutex_unlock(&tw->lock);
+}
+
+/// @brief Copy bytes into the current block, handing it off first if they do
+/// not fit.
+static void trace_put(struct trace_writer *tw, const void *buf, size_t len)
+{
+    if (tw->fill[tw->head] + len > TRACE_BLOCK_SIZE)
+    {
+        trace_handoff(tw);
+    }
+    memcpy(tw->blocks[tw->head] + tw->fill[tw->head], buf, len);
+    tw->fill[tw->head] += len;
+}
+
+int trace_open(struct trace_writer **tw, int fd, const struct trace_column *cols, unsigned ncols, unsigned nsockets, uint64_t period_us, int64_t start_ms, int flags)
+{
+    struct trace_header hdr;
+    struct trace_column_desc *desc;
+    struct trace_writer *w;
+    uint8_t *types;
+    unsigned i;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, TRACE_MAGIC, sizeof(hdr.magic));
+    hdr.version = TRACE_VERSION;
+    hdr.header_size = sizeof(hdr) + ncols * sizeof(struct trace_column_desc);
+    hdr.ncols = ncols;
+    hdr.record_size = ncols * sizeof(union trace_value);
+    hdr.nsockets = nsockets;
+    hdr.flags = flags;
+    hdr.period_us = period_us;
+    hdr.start_ms = start_ms;
+    gethostname(hdr.host, sizeof(hdr.host) - 1);
+
+    desc = (struct trace_column_desc *) calloc(ncols, sizeof(struct trace_column_desc));
+    if (desc == NULL)
+    {
+        return -1;
+    }
+    for (i = 0; i < ncols; i++)
+    {
+        strncpy(desc[i].name, cols[i].name, TRACE_NAME_LEN - 1);
+        strncpy(desc[i].unit, cols[i].unit, TRACE_UNIT_LEN - 1);
+        desc[i].type = cols[i].type;
+    }
+    if (write_all(fd, (const char *) &hdr, sizeof(hdr)) || write_all(fd, (const char *) desc, ncols * sizeof(struct trace_column_desc)))
+    {
+        free(desc);
+        return -1;
+    }
+    free(desc);
+
+    w = (struct trace_writer *) calloc(1, sizeof(struct trace_writer));
+    if (w == NULL)
+    {
+        return -1;
+    }
+    w->fd = fd;
+    w->record_size = hdr.record_size;
+    if (flags & TRACE_COMPRESSED)
+    {
+        /* Doubles change in their low mantissa bits, integers by small
+         * steps. */
+        types = (uint8_t *) calloc(ncols, sizeof(uint8_t));
+        if (types == NULL)
+        {
+            free(w);
+            return -1;
+        }
+        for (i = 0; i < ncols; i++)
+        {
+            types[i] = (cols[i].type == TRACE_F64 ? MSR_CODEC_XOR : MSR_CODEC_DELTA);
+        }
+        i = msr_codec_init(&w->codec, ncols, types, MSR_CODEC_BLOCK_RECORDS, MSR_CODEC_BITPACK);
+        free(types);
+        if (i || msr_codec_max_block(&w->codec) > TRACE_BLOCK_SIZE)
+        {
+            msr_codec_free(&w->codec);
+            free(w);
+            return -1;
+        }
+        w->compressed = 1;
+    }
+    for (i = 0; i < TRACE_NBLOCKS; i++)
+    {
+        w->blocks[i] = (char *) malloc(TRACE_BLOCK_SIZE);
+        if (w->blocks[i] == NULL)
+        {
+            while (i--)
+            {
+                free(w->blocks[i]);
+            }
+            msr_codec_free(&w->codec);
+            free(w);
+            return -1;
+        }
+    }
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->queued, NULL);
+    pthread_cond_init(&w->written, NULL);
+    w->threaded = (pthread_create(&w->thread, NULL, trace_thread, w) == 0);
+    if (!w->threaded)
+    {
+        fprintf(stderr, "Warning: could not start the trace writer thread, writing synchronously.\n");
+    }
+    *tw = w;
+    return 0;
+}
+
+int trace_append(struct trace_writer *tw, const union trace_value *rec)
+{
+    const uint8_t *blk;
+    size_t len;
+
+    if (!tw->compressed)
+    {
+        trace_put(tw, rec, tw->record_size);
+    }
+    else if (msr_codec_append(&tw->codec, (const uint64_t *) rec))
+    {
+        blk = msr_codec_block(&tw->codec, &len);
+        trace_put(tw, blk, len);
+    }
+    return (tw->err ? -1 : 0);
+}
+
+int trace_close(struct trace_writer *tw)
+{
+    const uint8_t *blk;
+    size_t len;
+    int ret;
+    int i;
+
+    if (tw->compressed)
+    {
+        if (msr_codec_flush(&tw->codec))
+        {
+            blk = msr_codec_block(&tw->codec, &len);
+            trace_put(tw, blk, len);
+        }
+        msr_codec_free(&tw->codec);
+    }
+    if (tw->fill[tw->head] > 0)
+    {
+        trace_handoff(tw);
+    }
+    if (tw->threaded)
+    {
+        pthread_mutex_lock(&tw->lock);
+        tw->closing = 1;
+        pthread_cond_signal(&tw->queued);
+        pthread_mutex_unlock(&tw->lock);
+        pthread_join(tw->thread, NULL);
+    }
+
+    ret = (tw->err ? -1 : 0);
+    if (close(tw->fd))
+    {
+        ret = -1;
+    }
+    for (i = 0; i < TRACE_NBLOCKS; i++)
+    {
+        free(tw->blocks[i]);
+    }
+    pthread_mutex_destroy(&tw->lock);
+    pthread_cond_destroy(&tw->queued);
+    pthread_cond_destroy(&tw->written);
+    free(tw);
+    return ret;
+}
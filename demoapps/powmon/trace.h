@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2013-2017, Lawrence Livermore National Security, LLC.
+ *
+ * Produced at the Lawrence Livermore National Laboratory. Written by:
+ *     Barry Rountree <rountree@llnl.gov>,
+ *     Scott Walker <walker91@llnl.gov>, and
+ *     Kathleen Shoga <shoga1@llnl.gov>.
+ *
+ * LLNL-CODE-645430
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr. For details, see https://github.com/LLNL/libmsr.git.
+ *
+ * Please also read libmsr/LICENSE for our notice and the LGPL.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License (as published by the Free
+ * Software Foundation) version 2.1 dated February 1999.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the IMPLIED WARRANTY OF MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the terms and conditions of the GNU Lesser
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+/// @brief Magic bytes at the start of a binary trace.
+#define TRACE_MAGIC "PWRTRACE"
+
+/// @brief Layout version of the trace header.
+#define TRACE_VERSION 1
+
+/// @brief Size of each buffered block handed to the writer thread.
+#define TRACE_BLOCK_SIZE (1 << 20)
+
+/// @brief Number of blocks the sampler can fill ahead of the writer thread.
+#define TRACE_NBLOCKS 4
+
+/// @brief Length of column names and units in the header, including the
+/// terminating NUL.
+#define TRACE_NAME_LEN 24
+#define TRACE_UNIT_LEN 8
+
+/// @brief Enum encompassing trace options.
+enum trace_flag_e
+{
+    /// @brief Records are stored as msr_codec blocks (per-column delta or
+    /// XOR residuals, bit-packed), each starting with a full keyframe record.
+    TRACE_COMPRESSED = 1 << 0,
+};
+
+/// @brief Enum encompassing the types of a trace column.
+enum trace_type_e
+{
+    /// @brief Unsigned 64-bit integer.
+    TRACE_U64,
+    /// @brief Signed 64-bit integer.
+    TRACE_I64,
+    /// @brief IEEE 754 double.
+    TRACE_F64,
+};
+
+/// @brief One 8-byte field of a record.
+union trace_value
+{
+    uint64_t u;
+    int64_t i;
+    double d;
+};
+
+/// @brief Structure describing a column to trace_open().
+struct trace_column
+{
+    /// @brief Column name.
+    const char *name;
+    /// @brief Unit of the column, "" if none.
+    const char *unit;
+    /// @brief trace_type_e type of the column.
+    int type;
+};
+
+/// @brief Structure at the start of a trace file, followed by ncols
+/// trace_column_desc entries and then the records.
+///
+/// All fields and records are little endian. Records are ncols fields of 8
+/// bytes each, and their number follows from the file size. In a
+/// TRACE_COMPRESSED trace the records are instead a sequence of msr_codec
+/// blocks, which can be skipped without decoding to reach a given time.
+struct trace_header
+{
+    /// @brief TRACE_MAGIC, not NUL terminated.
+    char magic[8];
+    /// @brief TRACE_VERSION.
+    uint32_t version;
+    /// @brief Offset of the first record.
+    uint32_t header_size;
+    /// @brief Number of columns.
+    uint32_t ncols;
+    /// @brief Size of one record in bytes.
+    uint32_t record_size;
+    /// @brief Number of sockets sampled.
+    uint32_t nsockets;
+    /// @brief trace_flag_e options.
+    uint32_t flags;
+    /// @brief Sample period in microseconds.
+    uint64_t period_us;
+    /// @brief Time (in ms since the epoch) the trace was started.
+    int64_t start_ms;
+    /// @brief Host name, NUL terminated.
+    char host[64];
+};
+
+/// @brief Column description as stored in the trace header.
+struct trace_column_desc
+{
+    /// @brief Column name, NUL terminated.
+    char name[TRACE_NAME_LEN];
+    /// @brief Unit, NUL terminated.
+    char unit[TRACE_UNIT_LEN];
+    /// @brief trace_type_e type of the column.
+    uint32_t type;
+    /// @brief Reserved, 0.
+    uint32_t reserved;
+};
+
+struct trace_writer;
+
+/// @brief Create a trace file, write its header and start the writer thread.
+///
+/// If the thread cannot be started, full blocks are written synchronously by
+/// trace_append() instead.
+///
+/// @param [out] tw Trace writer.
+///
+/// @param [in] fd File descriptor opened for writing.
+///
+/// @param [in] cols Column descriptions.
+///
+/// @param [in] ncols Number of columns.
+///
+/// @param [in] nsockets Number of sockets sampled.
+///
+/// @param [in] period_us Sample period in microseconds.
+///
+/// @param [in] start_ms Start time in ms since the epoch.
+///
+/// @param [in] flags trace_flag_e options.
+///
+/// @return 0 if successful, else -1.
+int trace_open(struct trace_writer **tw, int fd, const struct trace_column *cols, unsigned ncols, unsigned nsockets, uint64_t period_us, int64_t start_ms, int flags);
+
+/// @brief Append one record of ncols fields.
+///
+/// The record is copied into the current block, or into the codec's block
+/// in a compressed trace. A full block is handed to
+/// the writer thread, so the caller only waits if every block is queued.
+///
+/// @param [in] tw Trace writer.
+///
+/// @param [in] rec Record to append.
+///
+/// @return 0 if successful, else -1 if the writer thread hit a write error.
+int trace_append(struct trace_writer *tw, const union trace_value *rec);
+
+/// @brief Flush the remaining records, stop the writer thread and close the
+/// file.
+///
+/// Records only reach the file when a block fills up or here. A job killed
+/// before trace_close() loses every buffered record: up to TRACE_NBLOCKS
+/// blocks of TRACE_BLOCK_SIZE bytes, plus the codec block being encoded in a
+/// compressed trace.
+///
+/// @param [in] tw Trace writer.
+///
+/// @return 0 if successful, else -1 if any write failed.
+int trace_close(struct trace_writer *tw);
+
+#endif
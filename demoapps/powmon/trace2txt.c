@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2013-2017, Lawrence Livermore National Security, LLC.
+ *
+ * Produced at the Lawrence Livermore National Laboratory. Written by:
+ *     Barry Rountree <rountree@llnl.gov>,
+ *     Scott Walker <walker91@llnl.gov>, and
+ *     Kathleen Shoga <shoga1@llnl.gov>.
+ *
+ * LLNL-CODE-645430
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr. For details, see https://github.com/LLNL/libmsr.git.
+ *
+ * Please also read libmsr/LICENSE for our notice and the LGPL.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License (as published by the Free
+ * Software Foundation) version 2.1 dated February 1999.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the IMPLIED WARRANTY OF MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the terms and conditions of the GNU Lesser
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+/// Convert a binary powmon trace back to the space-separated text format.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <msr_codec.h>
+
+#include "trace.h"
+
+/// @brief Print one record in the text log format.
+static void print_record(const union trace_value *rec, const struct trace_column_desc *desc, const unsigned ncols)
+{
+    unsigned i;
+
+    for (i = 0; i < ncols; i++)
+    {
+        if (i)
+        {
+            fputc(' ', stdout);
+        }
+        switch (desc[i].type)
+        {
+            case TRACE_I64:
+                fprintf(stdout, "%ld", rec[i].i);
+                break;
+            case TRACE_F64:
+                fprintf(stdout, "%lf", rec[i].d);
+                break;
+            default:
+                fprintf(stdout, "%lu", rec[i].u);
+                break;
+        }
+    }
+    fputc('\n', stdout);
+}
+
+/// @brief Decode and print the codec blocks of a compressed trace.
+///
+/// @return 0 if successful, else 1 if a block is malformed. A block cut short
+/// by a killed job is dropped. Records still buffered by the writer when the
+/// job was killed never reached the file (see trace_close()).
+static int print_compressed(FILE *in, const struct trace_header *hdr, const struct trace_column_desc *desc)
+{
+    struct msr_codec codec;
+    uint8_t *buf = NULL;
+    union trace_value *recs = NULL;
+    uint8_t *types;
+    size_t cap = 0;
+    size_t len;
+    unsigned nrec;
+    unsigned i;
+    int n;
+    int ret = 0;
+
+    types = (uint8_t *) calloc(hdr->ncols, sizeof(uint8_t));
+    for (i = 0; i < hdr->ncols; i++)
+    {
+        types[i] = (desc[i].type == TRACE_F64 ? MSR_CODEC_XOR : MSR_CODEC_DELTA);
+    }
+    if (msr_codec_init(&codec, hdr->ncols, types, MSR_CODEC_MAX_BLOCK_RECORDS, 0))
+    {
+        free(types);
+        return 1;
+    }
+    free(types);
+    recs = (union trace_value *) calloc((size_t)MSR_CODEC_MAX_BLOCK_RECORDS * hdr->ncols, sizeof(union trace_value));
+    while (1)
+    {
+        if (cap < MSR_CODEC_BLOCK_HDR)
+        {
+            cap = MSR_CODEC_BLOCK_HDR;
+            buf = (uint8_t *) realloc(buf, cap);
+        }
+        if (fread(buf, MSR_CODEC_BLOCK_HDR, 1, in) != 1)
+        {
+            break;
+        }
+        len = msr_codec_block_len(buf, &nrec);
+        if (len < MSR_CODEC_BLOCK_HDR)
+        {
+            ret = 1;
+            break;
+        }
+        if (len > cap)
+        {
+            cap = len;
+            buf = (uint8_t *) realloc(buf, cap);
+        }
+        if (fread(buf + MSR_CODEC_BLOCK_HDR, len - MSR_CODEC_BLOCK_HDR, 1, in) != 1)
+        {
+            break;
+        }
+        n = msr_codec_decode(&codec, buf, len, (uint64_t *) recs);
+        if (n < 0)
+        {
+            ret = 1;
+            break;
+        }
+        for (i = 0; i < (unsigned)n; i++)
+        {
+            print_record(&recs[(size_t)i * hdr->ncols], desc, hdr->ncols);
+        }
+    }
+    if (ret)
+    {
+        fprintf(stderr, "malformed block\n");
+    }
+    msr_codec_free(&codec);
+    free(recs);
+    free(buf);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    const char *usage = "usage: %s [-v] <trace file>\n"
+                        "  -v  Print the trace header and column units first.\n";
+    struct trace_header hdr;
+    struct trace_column_desc *desc;
+    union trace_value *rec;
+    FILE *in;
+    int verbose = 0;
+    int ret = 0;
+    int opt;
+    unsigned i;
+
+    while ((opt = getopt(argc, argv, "v")) != -1)
+    {
+        switch (opt)
+        {
+            case 'v':
+                verbose = 1;
+                break;
+            default:
+                fprintf(stderr, usage, argv[0]);
+                return 1;
+        }
+    }
+    if (optind >= argc)
+    {
+        fprintf(stderr, usage, argv[0]);
+        return 1;
+    }
+    in = fopen(argv[optind], "r");
+    if (in == NULL)
+    {
+        perror(argv[optind]);
+        return 1;
+    }
+    if (fread(&hdr, sizeof(hdr), 1, in) != 1 || memcmp(hdr.magic, TRACE_MAGIC, sizeof(hdr.magic)) != 0 || hdr.version != TRACE_VERSION || hdr.record_size != hdr.ncols * sizeof(union trace_value))
+    {
+        fprintf(stderr, "%s: not a version %d powmon trace\n", argv[optind], TRACE_VERSION);
+        fclose(in);
+        return 1;
+    }
+    desc = (struct trace_column_desc *) calloc(hdr.ncols, sizeof(struct trace_column_desc));
+    rec = (union trace_value *) calloc(hdr.ncols, sizeof(union trace_value));
+    if (desc == NULL || rec == NULL || fread(desc, sizeof(struct trace_column_desc), hdr.ncols, in) != hdr.ncols || fseek(in, hdr.header_size, SEEK_SET))
+    {
+        fprintf(stderr, "%s: truncated header\n", argv[optind]);
+        fclose(in);
+        return 1;
+    }
+    hdr.host[sizeof(hdr.host) - 1] = '\0';
+
+    if (verbose)
+    {
+        fprintf(stdout, "# host: %s sockets: %u period_us: %lu start_ms: %ld%s\n# units:", hdr.host, hdr.nsockets, hdr.period_us, hdr.start_ms, ((hdr.flags & TRACE_COMPRESSED) ? " compressed" : ""));
+        for (i = 0; i < hdr.ncols; i++)
+        {
+            fprintf(stdout, " %s", (desc[i].unit[0] ? desc[i].unit : "-"));
+        }
+        fprintf(stdout, "\n");
+    }
+    for (i = 0; i < hdr.ncols; i++)
+    {
+        desc[i].name[TRACE_NAME_LEN - 1] = '\0';
+        fprintf(stdout, "%s%s", (i ? " " : ""), desc[i].name);
+    }
+    fprintf(stdout, "\n");
+
+    if (hdr.flags & TRACE_COMPRESSED)
+    {
+        ret = print_compressed(in, &hdr, desc);
+    }
+    else
+    {
+        /* A trace cut short by a killed job may end in a partial record,
+         * which is dropped. Records still buffered by the writer are lost. */
+        while (fread(rec, hdr.record_size, 1, in) == 1)
+        {
+            print_record(rec, desc, hdr.ncols);
+        }
+    }
+    free(desc);
+    free(rec);
+    fclose(in);
+    return ret;
+}
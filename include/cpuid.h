@@ -136,6 +136,12 @@ bool cpuid_timestamp_counter_avail(void);
 /// @return Number of PMCs are available.
 int cpuid_num_pmc(void);
 
+/// @brief Determine the bit width of the general-purpose performance
+/// monitoring counters.
+///
+/// @return Bit width of the PMCs.
+int cpuid_width_pmc(void);
+
 /*****************************************/
 /* Performance Event Select (PerfEvtSel) */
 /* (0x186, 0x187, 0x188, 0x189)          */
@@ -197,6 +203,34 @@ bool cpuid_misc_enable_XDbitDisable(void);
 /// @return True if extended on-demand clock modulation is enabled, else false.
 bool cpuid_enable_ExtendedClockMod(void);
 
+/*******/
+/* HWP */
+/*******/
+
+/// @brief Check if hardware-controlled performance states (HWP) are supported.
+///
+/// @return True if IA32_PM_ENABLE, IA32_HWP_CAPABILITIES and
+/// IA32_HWP_REQUEST are available, else false.
+bool cpuid_hwp_avail(void);
+
+/// @brief Check if the energy/performance preference field of
+/// IA32_HWP_REQUEST is supported.
+///
+/// @return True if HWP energy/performance preference is supported, else
+/// false.
+bool cpuid_hwp_epp_avail(void);
+
+/// @brief Check if IA32_HWP_REQUEST_PKG is supported.
+///
+/// @return True if package-level HWP requests are supported, else false.
+bool cpuid_hwp_pkg_request_avail(void);
+
+/// @brief Check if IA32_ENERGY_PERF_BIAS is supported.
+///
+/// @return True if the energy/performance bias hint is supported, else
+/// false.
+bool cpuid_energy_perf_bias_avail(void);
+
 /*********************/
 /* THERMAL Functions */
 /*********************/
@@ -43,6 +43,8 @@
 #define CSRSAFE_8086_BATCH _IOWR('a', 0x05, struct csr_batch_array)
 #define CSR_FILENAME_SIZE 128
 #define CSR_MODULE "/dev/cpu/csr_safe"
+#define CSR_PCI_SYSFS "/sys/bus/pci/devices"
+#define CSR_CONFIG_SPACE_SIZE 4096
 
 /// @brief Enum encompassing type of data being read to/written from uncore
 /// registers.
@@ -56,13 +58,17 @@ enum csr_data_type_e
     CSR_IMC_PMONUNITCTRL,
     /// @brief UBox PMON global status data for integrated memory controller.
     CSR_IMC_PMONUNITSTAT,
+    /// @brief QPI/UPI link layer counter measurements.
+    CSR_QPI_CTRS,
+    /// @brief QPI/UPI link layer performance event selection.
+    CSR_QPI_EVTS,
+    /// @brief QPI/UPI link layer PMON unit control.
+    CSR_QPI_PMONUNITCTRL,
     /* Currently unused */
     //CSR_IMC_MEMCTRA,
     //CSR_IMC_MEMCTRR,
     //CSR_IMC_MEMCTRW,
     //CSR_IMC_IMCCTR,
-    //CSR_QPI_CTRS,
-    //CSR_QPI_EVTS
 };
 
 /// @brief Structure holding information for a single read/write operation to
@@ -95,6 +101,23 @@ struct csr_batch_op
     uint8_t size;
 };
 
+/// @brief Structure describing an uncore PCI device found in sysfs.
+struct csr_pci_dev
+{
+    /// @brief PCI domain (segment) of the device.
+    uint16_t domain;
+    /// @brief PCI bus of the device.
+    uint8_t bus;
+    /// @brief PCI device number.
+    uint8_t device;
+    /// @brief PCI function number.
+    uint8_t function;
+    /// @brief Socket the device belongs to.
+    uint8_t socket;
+    /// @brief PCI device ID.
+    uint16_t devid;
+};
+
 /// @brief Structure holding multiple read/write operations to various MSRs.
 struct csr_batch_array
 {
@@ -106,8 +129,13 @@ struct csr_batch_array
 
 /// @brief Open the module file descriptors exposed in the /dev filesystem.
 ///
-/// @return 0 if initialization was a success, else -1 if could not stat file
-/// descriptors or open any csr module.
+/// If csr_safe cannot be opened, uncore registers are accessed through the
+/// PCI config space files in sysfs instead. Those are opened on first use,
+/// once per device, and need the socket-relative buses to be registered with
+/// csr_register_bus().
+///
+/// @return 0 if initialization was a success, else -1 if init_csr() was
+/// already called.
 int init_csr(void);
 
 /// @brief Close the module file descriptors exposed in the /dev filesystem.
@@ -181,6 +209,83 @@ int create_csr_batch_op(off_t csr,
                         uint64_t **dest,
                         const int batchnum);
 
+/// @brief Register the PCI bus behind a socket-relative bus used in batch
+/// operations, so the sysfs backend can locate the device.
+///
+/// @param [in] socket Socket identifier used in batch operations.
+///
+/// @param [in] relbus Socket-relative bus used in batch operations.
+///
+/// @param [in] domain PCI domain of the bus.
+///
+/// @param [in] bus PCI bus number.
+///
+/// @return 0 if successful, else -1 if the socket-relative bus is already
+/// mapped to a different PCI bus.
+int csr_register_bus(uint8_t socket,
+                     uint8_t relbus,
+                     uint16_t domain,
+                     uint8_t bus);
+
+/// @brief Scan sysfs once for Intel uncore PCI devices with the given device
+/// IDs.
+///
+/// Devices are sorted by domain, bus, device and function. Each distinct
+/// domain/bus pair is assigned to the next socket, in ascending order. The
+/// sysfs root defaults to CSR_PCI_SYSFS and can be overridden with the
+/// LIBMSR_PCI_SYSFS environment variable.
+///
+/// @param [in] devids Array of PCI device IDs to match.
+///
+/// @param [in] nids Number of entries in devids.
+///
+/// @param [out] devs Newly allocated array of matching devices, NULL if none
+///              were found.
+///
+/// @return Number of matching devices, else -1 if sysfs could not be read.
+int csr_pci_discover(const uint16_t *devids,
+                     const unsigned nids,
+                     struct csr_pci_dev **devs);
+
+/// @brief Build the table of one kind of uncore unit (e.g., iMC channels or
+/// QPI links), indexed as [socket * nunits + unit].
+///
+/// Units are discovered with csr_pci_discover() and their buses registered
+/// with csr_register_bus(). Every socket gets the same number of units, the
+/// smallest found on any socket, so the table stays dense. If nothing usable
+/// is found, every socket gets the fixed layout instead.
+///
+/// @param [in] devids Array of PCI device IDs of the unit.
+///
+/// @param [in] nids Number of entries in devids.
+///
+/// @param [in] fixed Device and function of each unit of a socket in the
+///        fixed layout.
+///
+/// @param [in] nfixed Number of units per socket in the fixed layout.
+///
+/// @param [in] relbus Socket-relative bus of the unit.
+///
+/// @param [in] maxsockets Number of sockets in the system.
+///
+/// @param [out] nsockets Number of sockets in the table.
+///
+/// @param [out] nunits Number of units per socket.
+///
+/// @param [out] units Newly allocated table.
+///
+/// @return 1 if the units were discovered, else 0 if the fixed layout is
+/// used.
+int csr_unit_table(const uint16_t *devids,
+                   const unsigned nids,
+                   const struct csr_pci_dev *fixed,
+                   const unsigned nfixed,
+                   const uint8_t relbus,
+                   const uint64_t maxsockets,
+                   uint64_t *nsockets,
+                   uint64_t *nunits,
+                   struct csr_pci_dev **units);
+
 /// @brief Execute read/write batch operation on a specific set of batch
 /// uncore registers.
 ///
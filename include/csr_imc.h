@@ -32,12 +32,31 @@
 #define CSR_IMC_H_INCLUDE
 
 #include <linux/types.h>
+#include <sys/time.h>
 
+#include "csr_core.h"
 #include "master.h"
 
 /* Integrated Memory Controller (iMC) CSRs */
 
 #define NUMCTRS 8
+/// @brief Width of the iMC PMON counters in bits.
+#define IMC_CTR_WIDTH 48
+
+/// @brief Structure holding the iMC channel table of every socket.
+///
+/// The table is built once from PCI devices found in sysfs, or from the fixed
+/// IMC0_DEV/IMC1_DEV layout if discovery finds nothing or a socket has none.
+struct imc_channel_table
+{
+    /// @brief Number of sockets with iMC channels.
+    uint64_t nsockets;
+    /// @brief Number of iMC channels per socket.
+    uint64_t nchannels;
+    /// @brief Location of each channel, indexed as [socket * nchannels +
+    /// channel].
+    struct csr_pci_dev *chan;
+};
 
 /// @brief Structure containing data of per-component performance counters.
 struct pmonctrs_data
@@ -70,6 +89,11 @@ struct pmonctr_global
     uint64_t **unitstatus;
 };
 
+/// @brief Build (on first call) and return the iMC channel table.
+///
+/// @return Pointer to iMC channel table.
+struct imc_channel_table *imc_channel_storage(void);
+
 /// @brief Store the PMON counter data on the heap.
 ///
 /// @return Pointer to PMON counter data.
@@ -82,14 +106,14 @@ struct pmonctr_global *pmonctr_global_storage(void);
 
 /// @brief Initialize storage for PMON performance counter data.
 ///
-/// @return -1 if PMON counters have been initialized, else
-/// 10*NUMCTRS*num_sockets.
+/// @return -1 if PMON counters have been initialized, else 10 times the
+/// number of iMC channels.
 int init_pmon_ctrs(void);
 
 /// @brief Initialize storage for PMON global performance counter data.
 ///
-/// @return -1 if PMON global counters have been initialized, else
-/// 2*NUMCTRS*num_sockets.
+/// @return -1 if PMON global counters have been initialized, else 2 times
+/// the number of iMC channels.
 int init_pmonctr_global(void);
 
 /// @brief Configure iMC performance counters.
@@ -229,4 +253,69 @@ int print_mem_page_miss_from_ctr(const unsigned pre,
 /// @return 0 if successful, else -1 if init_pmon_ctrs() fails.
 int print_pmon_ctrs(void);
 
+/// @brief Structure holding the state and results of the iMC bandwidth
+/// sampler.
+///
+/// Per-channel entries are indexed as [socket * nchannels + channel].
+struct imc_bw_data
+{
+    /// @brief Number of iMC channels per socket.
+    uint64_t nchannels;
+    /// @brief iMC counter programmed to count CAS reads.
+    unsigned rcounter;
+    /// @brief iMC counter programmed to count CAS writes.
+    unsigned wcounter;
+    /// @brief Raw read counter values of the previous sample.
+    uint64_t *prev_rd;
+    /// @brief Raw write counter values of the previous sample.
+    uint64_t *prev_wr;
+    /// @brief Read bandwidth (in GB/s) of each channel over the last interval.
+    double *chan_read_gbs;
+    /// @brief Write bandwidth (in GB/s) of each channel over the last
+    /// interval.
+    double *chan_write_gbs;
+    /// @brief Read bandwidth (in GB/s) of each socket over the last interval.
+    double *sock_read_gbs;
+    /// @brief Write bandwidth (in GB/s) of each socket over the last interval.
+    double *sock_write_gbs;
+    /// @brief Length (in seconds) of the last interval.
+    double interval;
+    /// @brief Time of the previous sample.
+    struct timeval last;
+    /// @brief Non-zero once the first sample has been taken.
+    int have_baseline;
+};
+
+/// @brief Get the iMC bandwidth sampler state.
+///
+/// @param [out] bw Pointer to iMC bandwidth data.
+void imc_bw_storage(struct imc_bw_data **bw);
+
+/// @brief Program CAS read and write counts on every channel and take the
+/// baseline sample of the iMC bandwidth sampler.
+///
+/// @param [in] rcounter Unique counter identifier for CAS reads.
+///
+/// @param [in] wcounter Unique counter identifier for CAS writes.
+///
+/// @return 0 if successful, else -1 if a counter does not exist or
+/// programming the counters failed.
+int start_imc_bw_sampler(const unsigned rcounter,
+                         const unsigned wcounter);
+
+/// @brief Read every channel's iMC counters in a single batch and compute
+/// read/write bandwidth since the previous sample.
+///
+/// Deltas are taken modulo 2^IMC_CTR_WIDTH, so a counter wrapping between
+/// samples is handled as long as it wraps at most once.
+///
+/// @return 0 if successful, else -1 if the sampler was not started or the
+/// batch read failed.
+int sample_imc_bw(void);
+
+/// @brief Print per-channel and per-socket bandwidth of the last interval.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_imc_bw(FILE *writedest);
+
 #endif
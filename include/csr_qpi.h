@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2013-2017, Lawrence Livermore National Security, LLC.
+ *
+ * Produced at the Lawrence Livermore National Laboratory. Written by:
+ *     Barry Rountree <rountree@llnl.gov>,
+ *     Scott Walker <walker91@llnl.gov>, and
+ *     Kathleen Shoga <shoga1@llnl.gov>.
+ *
+ * LLNL-CODE-645430
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr. For details, see https://github.com/LLNL/libmsr.git.
+ *
+ * Please also read libmsr/LICENSE for our notice and the LGPL.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License (as published by the Free
+ * Software Foundation) version 2.1 dated February 1999.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the IMPLIED WARRANTY OF MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the terms and conditions of the GNU Lesser
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#ifndef CSR_QPI_H_INCLUDE
+#define CSR_QPI_H_INCLUDE
+
+#include <stdio.h>
+#include <sys/time.h>
+
+#include "csr_core.h"
+#include "master.h"
+
+/* QPI/UPI Link Layer CSRs */
+
+/// @brief Width of the link layer PMON counters in bits.
+#define QPI_CTR_WIDTH 48
+
+/// @brief Structure holding the link table of every socket.
+///
+/// The table is built once from PCI devices found in sysfs, or from the fixed
+/// QPI_LINK_DEVS layout if discovery finds nothing or a socket has none.
+struct qpi_link_table
+{
+    /// @brief Number of sockets with links.
+    uint64_t nsockets;
+    /// @brief Number of links per socket.
+    uint64_t nlinks;
+    /// @brief Location of each link, indexed as [socket * nlinks + link].
+    struct csr_pci_dev *link;
+};
+
+/// @brief Structure holding the state and results of the link utilization
+/// sampler.
+///
+/// Three counters are used on every link: transmitted data flits, transmitted
+/// non-data flits and link layer clockticks. Per-link entries are indexed as
+/// [socket * nlinks + link].
+struct qpi_data
+{
+    /// @brief Number of links per socket.
+    uint64_t nlinks;
+    /// @brief Transmitted data flit counter of each link.
+    uint64_t **data_flits;
+    /// @brief Transmitted non-data flit counter of each link.
+    uint64_t **non_data_flits;
+    /// @brief Clocktick counter of each link.
+    uint64_t **clockticks;
+    /// @brief Event select of the data flit counter of each link.
+    uint64_t **ctrcfg0;
+    /// @brief Event select of the non-data flit counter of each link.
+    uint64_t **ctrcfg1;
+    /// @brief Event select of the clocktick counter of each link.
+    uint64_t **ctrcfg2;
+    /// @brief PMON unit control of each link.
+    uint64_t **unitctrl;
+    /// @brief Raw data flit counts of the previous sample.
+    uint64_t *prev_data;
+    /// @brief Raw non-data flit counts of the previous sample.
+    uint64_t *prev_non_data;
+    /// @brief Raw clocktick counts of the previous sample.
+    uint64_t *prev_clk;
+    /// @brief Transmit bandwidth (in GB/s) of each link over the last
+    /// interval.
+    double *link_gbs;
+    /// @brief Fraction of transmit slots used on each link over the last
+    /// interval.
+    double *link_util;
+    /// @brief Transmit bandwidth (in GB/s) of each socket over the last
+    /// interval.
+    double *sock_gbs;
+    /// @brief Length (in seconds) of the last interval.
+    double interval;
+    /// @brief Time of the previous sample.
+    struct timeval last;
+    /// @brief Non-zero once the first sample has been taken.
+    int have_baseline;
+};
+
+/// @brief Build (on first call) and return the link table.
+///
+/// @return Pointer to link table.
+struct qpi_link_table *qpi_link_storage(void);
+
+/// @brief Get the link sampler state, allocating it on first call.
+///
+/// @param [out] qd Pointer to link sampler data.
+void qpi_storage(struct qpi_data **qd);
+
+/// @brief Program flit and clocktick events on every link of every socket and
+/// take the baseline sample of the link sampler.
+///
+/// The counters of all links are reset with one PMON unit control batch and
+/// programmed with one event select batch.
+///
+/// @return 0 if successful, else -1 if no links were found or programming
+/// the counters failed.
+int start_qpi_sampler(void);
+
+/// @brief Read every link's counters in a single batch and compute transmit
+/// bandwidth and utilization since the previous sample.
+///
+/// Deltas are taken modulo 2^QPI_CTR_WIDTH, so a counter wrapping between
+/// samples is handled as long as it wraps at most once.
+///
+/// @return 0 if successful, else -1 if the sampler was not started or the
+/// batch read failed.
+int sample_qpi(void);
+
+/// @brief Print per-link and per-socket bandwidth and utilization of the last
+/// interval.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_qpi(FILE *writedest);
+
+#endif
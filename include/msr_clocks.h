@@ -86,6 +86,39 @@ struct perf_data
     uint64_t **perf_ctl;
 };
 
+/// @brief Structure containing per-logical-processor data for
+/// IA32_PERF_STATUS and IA32_PERF_CTL.
+///
+/// Entries are indexed as [(socket * cores_per_socket + core) *
+/// threads_per_core + thread].
+struct perf_thread_data
+{
+    /// @brief Number of hardware threads per core.
+    uint64_t threads_per_core;
+    /// @brief Raw 64-bit value stored in IA32_PERF_STATUS.
+    uint64_t **perf_status;
+    /// @brief Raw 64-bit value stored in IA32_PERF_CTL.
+    uint64_t **perf_ctl;
+    /// @brief Staged IA32_PERF_CTL value.
+    uint64_t *request;
+    /// @brief Non-zero if the staged IA32_PERF_CTL value has not been written
+    /// yet.
+    uint8_t *dirty;
+};
+
+/// @brief Structure containing per-logical-processor data for
+/// IA32_CLOCK_MODULATION.
+///
+/// Entries are indexed as [(socket * cores_per_socket + core) *
+/// threads_per_core + thread].
+struct clock_mod_data
+{
+    /// @brief Number of hardware threads per core.
+    uint64_t threads_per_core;
+    /// @brief Raw 64-bit value stored in IA32_CLOCK_MODULATION.
+    uint64_t **raw;
+};
+
 /// @brief Allocate array for storing raw register data from IA32_APERF,
 /// IA32_MPERF, and IA32_TIME_STAMP_COUNTER.
 ///
@@ -123,6 +156,69 @@ void dump_p_state(FILE *writedest);
 void set_p_state(unsigned socket,
                  uint64_t pstate);
 
+/// @brief Allocate array for storing per-logical-processor raw register data
+/// from IA32_PERF_STATUS and IA32_PERF_CTL.
+///
+/// IA32_PERF_CTL is read once at initialization so staged writes can be
+/// compared against the value currently programmed.
+///
+/// @param [out] pd Pointer to per-thread perf-related data.
+void perf_thread_storage(struct perf_thread_data **pd);
+
+/// @brief Read IA32_PERF_STATUS on every logical processor in a single batch.
+///
+/// @return 0 if successful, else -1 if the batch read failed.
+int read_p_state_threads(void);
+
+/// @brief Stage a new p-state request for a single logical processor.
+///
+/// Nothing is written until commit_p_state() is called. Requests equal to the
+/// currently programmed value are not marked dirty.
+///
+/// @param [in] socket Unique socket/package identifier.
+///
+/// @param [in] core Unique core identifier.
+///
+/// @param [in] thread Unique thread identifier.
+///
+/// @param [in] pstate Desired raw IA32_PERF_CTL value.
+///
+/// @return 0 if successful, else -1 if the coordinates are invalid.
+int set_p_state_thread(unsigned socket,
+                       unsigned core,
+                       unsigned thread,
+                       uint64_t pstate);
+
+/// @brief Stage a new p-state request for every logical processor of a core.
+///
+/// Nothing is written until commit_p_state() is called.
+///
+/// @param [in] socket Unique socket/package identifier.
+///
+/// @param [in] core Unique core identifier.
+///
+/// @param [in] pstate Desired raw IA32_PERF_CTL value.
+///
+/// @return 0 if successful, else -1 if the coordinates are invalid.
+int set_p_state_core(unsigned socket,
+                     unsigned core,
+                     uint64_t pstate);
+
+/// @brief Write all staged p-state requests that differ from the programmed
+/// value in a single sparse batch.
+///
+/// IA32_PERF_CTL is read again first and its IDA/Turbo DISENGAGE bit (32) is
+/// kept, so a commit does not undo enable_turbo() or disable_turbo().
+///
+/// @return 0 if successful or nothing changed, else -1 if the batch write
+/// failed.
+int commit_p_state(void);
+
+/// @brief Print current p-state of every logical processor.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_p_state_threads(FILE *writedest);
+
 /// @brief Print detailed clocks data.
 ///
 /// @param [in] writedest File stream where output will be written to.
@@ -162,6 +258,325 @@ int set_clock_mod(int socket,
                   int core,
                   struct clock_mod *s);
 
+/// @brief Allocate array for storing per-logical-processor raw register data
+/// from IA32_CLOCK_MODULATION.
+///
+/// @param [out] cm Pointer to clock modulation data.
+void clock_mod_storage(struct clock_mod_data **cm);
+
+/// @brief Get contents of IA32_CLOCK_MODULATION for every core in a single
+/// batch read.
+///
+/// The value reported for a core is taken from its first hardware thread.
+///
+/// @param [out] s Array of num_cores() entries, indexed as
+///        [socket * cores_per_socket + core].
+///
+/// @return 0 if successful, else -1 if the batch read failed.
+int get_clock_mod_all(struct clock_mod *s);
+
+/// @brief Change value of IA32_CLOCK_MODULATION on every core using one batch
+/// read and one masked batch write.
+///
+/// Only the duty cycle and enable bits are modified, all other bits keep their
+/// current value. Every hardware thread of a core gets the same setting.
+///
+/// @param [in] s Array of num_cores() entries, indexed as
+///        [socket * cores_per_socket + core].
+///
+/// @return 0 if successful, else -1 if any entry is invalid or a batch
+/// operation failed.
+int set_clock_mod_all(const struct clock_mod *s);
+
+/********************/
+/* Uncore Frequency */
+/********************/
+
+/// @brief Structure containing per-socket data for MSR_UNCORE_PERF_STATUS
+/// and MSR_UNCORE_RATIO_LIMIT.
+struct uncore_freq_data
+{
+    /// @brief Raw 64-bit value stored in MSR_UNCORE_PERF_STATUS.
+    uint64_t **perf_status;
+    /// @brief Raw 64-bit value stored (or staged) in MSR_UNCORE_RATIO_LIMIT.
+    uint64_t **ratio_limit;
+    /// @brief Last MSR_UNCORE_RATIO_LIMIT value known to be programmed.
+    uint64_t *shadow;
+    /// @brief Non-zero if the staged MSR_UNCORE_RATIO_LIMIT value differs
+    /// from the shadow copy.
+    uint8_t *dirty;
+};
+
+/// @brief Allocate array for storing per-socket raw register data from
+/// MSR_UNCORE_PERF_STATUS and MSR_UNCORE_RATIO_LIMIT.
+///
+/// MSR_UNCORE_RATIO_LIMIT is read once at initialization to seed the shadow
+/// copy, after which limits are only written when they change.
+///
+/// @param [out] uf Pointer to uncore frequency data.
+void uncore_freq_storage(struct uncore_freq_data **uf);
+
+/// @brief Read the current uncore ratio of every socket in a single batch.
+///
+/// @param [out] ratio Array of num_sockets() entries, filled with the
+///        uncore ratio (multiples of 100 MHz).
+///
+/// @return 0 if successful, else -1 if the platform has no uncore frequency
+/// MSRs or the batch read failed.
+int get_uncore_ratio(uint64_t *ratio);
+
+/// @brief Get the uncore min/max ratio limits of a socket from the shadow
+/// copy, without touching the MSR.
+///
+/// @param [in] socket Unique socket/package identifier.
+///
+/// @param [out] min_ratio Minimum uncore ratio (multiples of 100 MHz).
+///
+/// @param [out] max_ratio Maximum uncore ratio (multiples of 100 MHz).
+///
+/// @return 0 if successful, else -1 if the platform has no uncore frequency
+/// MSRs or the socket is invalid.
+int get_uncore_ratio_limit(unsigned socket,
+                           uint64_t *min_ratio,
+                           uint64_t *max_ratio);
+
+/// @brief Change the uncore min/max ratio limits of a socket.
+///
+/// The new limits are compared against the shadow copy and
+/// MSR_UNCORE_RATIO_LIMIT is only written if they differ. Reserved bits keep
+/// the value read at initialization.
+///
+/// @param [in] socket Unique socket/package identifier.
+///
+/// @param [in] min_ratio Minimum uncore ratio (multiples of 100 MHz).
+///
+/// @param [in] max_ratio Maximum uncore ratio (multiples of 100 MHz).
+///
+/// @return 0 if successful or nothing changed, else -1 if the platform has
+/// no uncore frequency MSRs, an argument is invalid, or the write failed.
+int set_uncore_ratio_limit(unsigned socket,
+                           uint64_t min_ratio,
+                           uint64_t max_ratio);
+
+/// @brief Re-read MSR_UNCORE_RATIO_LIMIT on every socket and resynchronize
+/// the shadow copy, e.g. after another tool changed the limits.
+///
+/// @return 0 if successful, else -1 if the platform has no uncore frequency
+/// MSRs or the batch read failed.
+int refresh_uncore_ratio_limit(void);
+
+/// @brief Print current uncore frequency and ratio limits of every socket.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_uncore_freq(FILE *writedest);
+
+/**************************************/
+/* Hardware-Controlled P-States (HWP) */
+/**************************************/
+
+/// @brief Structure containing decoded fields of IA32_HWP_REQUEST or
+/// IA32_HWP_REQUEST_PKG.
+///
+/// When passed to one of the set functions, a negative field keeps the value
+/// currently programmed.
+struct hwp_request
+{
+    /// @brief Raw 64-bit value stored in the request register.
+    uint64_t raw;
+    /// @brief Minimum performance hint (bits [7:0]).
+    int min_perf;
+    /// @brief Maximum performance hint (bits [15:8]).
+    int max_perf;
+    /// @brief Desired performance hint, 0 lets hardware choose (bits
+    /// [23:16]).
+    int desired_perf;
+    /// @brief Energy/performance preference, 0 favors performance and 255
+    /// favors energy (bits [31:24]).
+    int epp;
+    /// @brief Non-zero if the thread follows IA32_HWP_REQUEST_PKG instead of
+    /// its own request (bit 42, ignored for package requests).
+    int pkg_control;
+};
+
+/// @brief Structure containing decoded fields of IA32_HWP_CAPABILITIES.
+struct hwp_capabilities
+{
+    /// @brief Raw 64-bit value stored in IA32_HWP_CAPABILITIES.
+    uint64_t raw;
+    /// @brief Highest performance level (bits [7:0]).
+    int highest_perf;
+    /// @brief Guaranteed performance level (bits [15:8]).
+    int guaranteed_perf;
+    /// @brief Most efficient performance level (bits [23:16]).
+    int most_efficient_perf;
+    /// @brief Lowest performance level (bits [31:24]).
+    int lowest_perf;
+};
+
+/// @brief Structure containing per-logical-processor data for
+/// IA32_HWP_CAPABILITIES, IA32_HWP_REQUEST and IA32_ENERGY_PERF_BIAS, and
+/// per-socket data for IA32_HWP_REQUEST_PKG.
+///
+/// Per-thread entries are indexed as [(socket * cores_per_socket + core) *
+/// threads_per_core + thread].
+struct hwp_data
+{
+    /// @brief Number of hardware threads per core.
+    uint64_t threads_per_core;
+    /// @brief Raw 64-bit value stored in IA32_HWP_CAPABILITIES.
+    uint64_t **capabilities;
+    /// @brief Raw 64-bit value stored (or staged) in IA32_HWP_REQUEST.
+    uint64_t **request;
+    /// @brief Raw 64-bit value stored (or staged) in IA32_HWP_REQUEST_PKG.
+    uint64_t **pkg_request;
+    /// @brief Raw 64-bit value stored (or staged) in IA32_ENERGY_PERF_BIAS.
+    uint64_t **epb;
+    /// @brief Non-zero if the staged IA32_HWP_REQUEST value has not been
+    /// written yet.
+    uint8_t *request_dirty;
+    /// @brief Non-zero if the staged IA32_HWP_REQUEST_PKG value has not been
+    /// written yet.
+    uint8_t *pkg_request_dirty;
+    /// @brief Non-zero if the staged IA32_ENERGY_PERF_BIAS value has not been
+    /// written yet.
+    uint8_t *epb_dirty;
+};
+
+/// @brief Allocate arrays for storing raw register data from the HWP and
+/// energy/performance bias registers.
+///
+/// All registers are read once at initialization so staged writes can be
+/// compared against the value currently programmed. HWP must already be
+/// enabled in IA32_PM_ENABLE (e.g., by the kernel's intel_pstate driver),
+/// otherwise the HWP registers are left alone and the HWP functions return
+/// -1.
+///
+/// @param [out] hd Pointer to HWP data.
+void hwp_storage(struct hwp_data **hd);
+
+/// @brief Re-read IA32_HWP_REQUEST, IA32_HWP_REQUEST_PKG and
+/// IA32_ENERGY_PERF_BIAS in one batch each, discarding any staged requests.
+///
+/// @return 0 if successful, else -1 if HWP is not available or a batch read
+/// failed.
+int read_hwp_request(void);
+
+/// @brief Get the HWP capabilities of a single logical processor.
+///
+/// @param [in] socket Unique socket/package identifier.
+///
+/// @param [in] core Unique core identifier.
+///
+/// @param [in] thread Unique thread identifier.
+///
+/// @param [out] c Data for HWP capabilities.
+///
+/// @return 0 if successful, else -1 if HWP is not available or the
+/// coordinates are invalid.
+int get_hwp_capabilities(unsigned socket,
+                         unsigned core,
+                         unsigned thread,
+                         struct hwp_capabilities *c);
+
+/// @brief Get the HWP request of a single logical processor, as of the last
+/// read or staged change.
+///
+/// @param [in] socket Unique socket/package identifier.
+///
+/// @param [in] core Unique core identifier.
+///
+/// @param [in] thread Unique thread identifier.
+///
+/// @param [out] r Data for HWP request.
+///
+/// @return 0 if successful, else -1 if HWP is not available or the
+/// coordinates are invalid.
+int get_hwp_request(unsigned socket,
+                    unsigned core,
+                    unsigned thread,
+                    struct hwp_request *r);
+
+/// @brief Stage a new HWP request for a single logical processor.
+///
+/// Nothing is written until commit_hwp_request() is called. Requests equal to
+/// the currently programmed value are not marked dirty.
+///
+/// @param [in] socket Unique socket/package identifier.
+///
+/// @param [in] core Unique core identifier.
+///
+/// @param [in] thread Unique thread identifier.
+///
+/// @param [in] r Data for HWP request, negative fields are left unchanged.
+///
+/// @return 0 if successful, else -1 if HWP is not available or an argument
+/// is invalid.
+int set_hwp_request_thread(unsigned socket,
+                           unsigned core,
+                           unsigned thread,
+                           const struct hwp_request *r);
+
+/// @brief Stage a new energy/performance preference for every logical
+/// processor of a core, leaving the other request fields unchanged.
+///
+/// Nothing is written until commit_hwp_request() is called.
+///
+/// @param [in] socket Unique socket/package identifier.
+///
+/// @param [in] core Unique core identifier.
+///
+/// @param [in] epp Energy/performance preference (0-255).
+///
+/// @return 0 if successful, else -1 if HWP EPP is not available or an
+/// argument is invalid.
+int set_hwp_epp_core(unsigned socket,
+                     unsigned core,
+                     int epp);
+
+/// @brief Stage a new package-level HWP request, used by every logical
+/// processor of the socket whose pkg_control bit is set.
+///
+/// Nothing is written until commit_hwp_request() is called.
+///
+/// @param [in] socket Unique socket/package identifier.
+///
+/// @param [in] r Data for HWP request, negative fields are left unchanged.
+///
+/// @return 0 if successful, else -1 if package-level requests are not
+/// available or an argument is invalid.
+int set_hwp_request_pkg(unsigned socket,
+                        const struct hwp_request *r);
+
+/// @brief Stage a new energy/performance bias hint for every logical
+/// processor of a core.
+///
+/// Nothing is written until commit_hwp_request() is called.
+///
+/// @param [in] socket Unique socket/package identifier.
+///
+/// @param [in] core Unique core identifier.
+///
+/// @param [in] bias Energy/performance bias, 0 favors performance and 15
+/// favors energy.
+///
+/// @return 0 if successful, else -1 if the bias hint is not available or an
+/// argument is invalid.
+int set_energy_perf_bias_core(unsigned socket,
+                              unsigned core,
+                              int bias);
+
+/// @brief Write all staged HWP requests and energy/performance bias hints
+/// that differ from the programmed value, one sparse batch per register.
+///
+/// @return 0 if successful or nothing changed, else -1 if a batch write
+/// failed.
+int commit_hwp_request(void);
+
+/// @brief Print HWP capabilities and requests of every logical processor.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_hwp(FILE *writedest);
+
 #ifdef __cplusplus
 }
 #endif
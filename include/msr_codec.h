@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2013-2017, Lawrence Livermore National Security, LLC.
+ *
+ * Produced at the Lawrence Livermore National Laboratory. Written by:
+ *     Barry Rountree <rountree@llnl.gov>,
+ *     Scott Walker <walker91@llnl.gov>, and
+ *     Kathleen Shoga <shoga1@llnl.gov>.
+ *
+ * LLNL-CODE-645430
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr. For details, see https://github.com/LLNL/libmsr.git.
+ *
+ * Please also read libmsr/LICENSE for our notice and the LGPL.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License (as published by the Free
+ * Software Foundation) version 2.1 dated February 1999.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the IMPLIED WARRANTY OF MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the terms and conditions of the GNU Lesser
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#ifndef MSR_CODEC_H_INCLUDE
+#define MSR_CODEC_H_INCLUDE
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Default number of records per block. Every block starts with a
+/// keyframe, so this is also the random access granularity.
+#define MSR_CODEC_BLOCK_RECORDS 1024
+
+/// @brief Largest number of records per block.
+#define MSR_CODEC_MAX_BLOCK_RECORDS 65535
+
+/// @brief Size of the header at the start of every encoded block.
+#define MSR_CODEC_BLOCK_HDR 8
+
+/// @brief Enum encompassing how a column is predicted from the previous
+/// record.
+enum msr_codec_col_e
+{
+    /// @brief Integer difference, zigzag encoded. Suits counters, energy
+    /// bits and timestamps, including ones that wrap.
+    MSR_CODEC_DELTA,
+    /// @brief Bitwise XOR. Suits doubles, whose high bits (sign, exponent and
+    /// leading mantissa) rarely change between samples.
+    MSR_CODEC_XOR,
+};
+
+/// @brief Enum encompassing block encoding options.
+enum msr_codec_flag_e
+{
+    /// @brief Bit-pack each column of a block at the width of its largest
+    /// residual instead of writing one varint per value.
+    MSR_CODEC_BITPACK = 1 << 0,
+};
+
+/// @brief Structure holding the state of an encoder or decoder.
+///
+/// An encoded stream is a sequence of self-contained blocks. A block header
+/// holds the block length (32 bits), the record count (16 bits) and the
+/// flags (8 bits), followed by the first record in full and the residuals of
+/// the rest. All fields are little endian.
+struct msr_codec
+{
+    /// @brief Number of 64-bit columns per record.
+    unsigned ncols;
+    /// @brief msr_codec_col_e prediction of each column.
+    uint8_t *types;
+    /// @brief Records per block.
+    unsigned block_records;
+    /// @brief msr_codec_flag_e options used when encoding.
+    int flags;
+    /// @brief Records buffered for the current block, [record][column].
+    uint64_t *pending;
+    /// @brief Number of buffered records.
+    unsigned npending;
+    /// @brief Encoded block.
+    uint8_t *out;
+    /// @brief Length of the encoded block, 0 if none is ready.
+    size_t outlen;
+    /// @brief Residual scratch space of one column, used by the encoder.
+    uint64_t *resid;
+};
+
+/// @brief Set up an encoder or decoder.
+///
+/// @param [out] c Codec state.
+///
+/// @param [in] ncols Number of columns per record.
+///
+/// @param [in] types msr_codec_col_e prediction of each column.
+///
+/// @param [in] block_records Records per block, 0 for
+///        MSR_CODEC_BLOCK_RECORDS.
+///
+/// @param [in] flags msr_codec_flag_e encoding options.
+///
+/// @return 0 if successful, else -1 if the parameters are out of range.
+int msr_codec_init(struct msr_codec *c,
+                   const unsigned ncols,
+                   const uint8_t *types,
+                   const unsigned block_records,
+                   const int flags);
+
+/// @brief Release the memory of a codec.
+///
+/// @param [in] c Codec state.
+void msr_codec_free(struct msr_codec *c);
+
+/// @brief Add a record to the current block.
+///
+/// @param [in] c Codec state.
+///
+/// @param [in] rec Record of ncols values. Doubles are passed as their bit
+///        patterns.
+///
+/// @return 1 if the block is full and has been encoded (see
+/// msr_codec_block()), else 0.
+int msr_codec_append(struct msr_codec *c,
+                     const uint64_t *rec);
+
+/// @brief Encode the buffered records as a final, possibly short, block.
+///
+/// @param [in] c Codec state.
+///
+/// @return 1 if a block has been encoded, else 0 if nothing was buffered.
+int msr_codec_flush(struct msr_codec *c);
+
+/// @brief Get the block encoded by the last msr_codec_append() or
+/// msr_codec_flush() that returned 1.
+///
+/// @param [in] c Codec state.
+///
+/// @param [out] len Length of the block in bytes.
+///
+/// @return Pointer to the block, valid until the next append or flush.
+const uint8_t *msr_codec_block(const struct msr_codec *c,
+                               size_t *len);
+
+/// @brief Get the upper bound of an encoded block's size.
+///
+/// @param [in] c Codec state.
+///
+/// @return Size in bytes.
+size_t msr_codec_max_block(const struct msr_codec *c);
+
+/// @brief Get the length of an encoded block from its header, so a reader
+/// can skip to later blocks without decoding.
+///
+/// @param [in] buf Start of a block, at least MSR_CODEC_BLOCK_HDR bytes.
+///
+/// @param [out] nrecords Number of records in the block (may be NULL).
+///
+/// @return Block length in bytes.
+size_t msr_codec_block_len(const uint8_t *buf,
+                           unsigned *nrecords);
+
+/// @brief Decode one block.
+///
+/// @param [in] c Codec state with the encoder's columns and types.
+///
+/// @param [in] buf Encoded block.
+///
+/// @param [in] len Number of bytes available at buf.
+///
+/// @param [out] recs Buffer of block_records * ncols values receiving the
+///        records, [record][column].
+///
+/// @return Number of records decoded, else -1 if the block is malformed.
+int msr_codec_decode(const struct msr_codec *c,
+                     const uint8_t *buf,
+                     const size_t len,
+                     uint64_t *recs);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
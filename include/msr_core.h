@@ -32,6 +32,7 @@
 #define MSR_CORE_H_INCLUDE
 
 #include <linux/types.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <sys/types.h>
 
@@ -42,7 +43,17 @@ extern "C" {
 #define NUM_DEVS (sockets * coresPerSocket * threadsPerCore)
 #define X86_IOC_MSR_BATCH _IOWR('c', 0xA2, struct msr_batch_array)
 #define MSR_BATCH_DIR "/dev/cpu/msr_batch"
+/// @brief Default directory of the MSR device files, overridden by
+/// LIBMSR_DEV_DIR.
+#define MSR_DEV_DIR "/dev/cpu"
 #define FILENAME_SIZE 1024
+/// @brief Default topology cache file, %u is replaced by the effective user ID.
+#define TOPO_CACHE_PATH "/tmp/libmsr-topo-%u.cache"
+/// @brief Format version of the topology cache file.
+#define TOPO_CACHE_VERSION 2
+#define BOOT_ID_FILE "/proc/sys/kernel/random/boot_id"
+/// @brief List of online CPUs, part of the topology cache key.
+#define CPU_ONLINE_FILE "/sys/devices/system/cpu/online"
 //#define USE_NO_BATCH 1
 
 /// @brief Enum encompassing type of data being read to/written from MSRs.
@@ -91,6 +102,49 @@ enum libmsr_data_type_e
     UNCORE_EVTSEL,
     /// @brief Uncore general-performance counter measurements.
     UNCORE_COUNT,
+    /// @brief Per-box CBo uncore unit control (freeze and reset).
+    CBO_BOX_CTL,
+    /// @brief Per-box CBo uncore event select and filter configuration.
+    CBO_EVTSEL,
+    /// @brief Per-box CBo uncore counter measurements.
+    CBO_COUNT,
+    /// @brief Instantaneous operating frequency of each logical processor.
+    PERF_THREAD_DATA,
+    /// @brief Software desired operating frequency of each logical processor.
+    PERF_THREAD_CTL,
+    /// @brief On-demand clock modulation of each logical processor.
+    CLOCK_MOD,
+    /// @brief Core and package thermal status sampled by the thermal event
+    /// watcher.
+    THERM_WATCH,
+    /// @brief Core and package thermal status used for temperature-only
+    /// sampling.
+    THERM_TEMP,
+    /// @brief Core and package C-state residencies with the matching TSC
+    /// values.
+    CRES_INTERVAL,
+    /// @brief Current uncore ratio of each socket.
+    UNCORE_FREQ_STATUS,
+    /// @brief Uncore min/max ratio limits of each socket.
+    UNCORE_FREQ_LIMIT,
+    /// @brief HWP capabilities of each logical processor.
+    HWP_CAPABILITIES,
+    /// @brief HWP min/max/desired/EPP request of each logical processor.
+    HWP_REQUEST,
+    /// @brief Package-level HWP request of each socket.
+    HWP_REQUEST_PKG,
+    /// @brief Energy/performance bias hint of each logical processor.
+    ENERGY_PERF_BIAS,
+    /// @brief Frequency limit reasons of each socket.
+    PERF_LIMIT,
+    /// @brief Turbo disengage control (IA32_PERF_CTL) of each logical
+    /// processor.
+    TURBO_CTL,
+    /// @brief Turbo ratio limits of each socket.
+    TURBO_RATIO,
+    /// @brief Scratch batch holding the changed subset of another batch for
+    /// write_batch_sparse().
+    SPARSE_WRITE,
     /// @brief User-defined batch MSR data.
     USR_BATCH0,
     /// @brief User-defined batch MSR data.
@@ -126,6 +180,15 @@ enum libmsr_batch_op_type_e
     BATCH_READ,
 };
 
+/// @brief Enum encompassing the ways per-CPU MSR device files are opened.
+enum libmsr_open_mode_e
+{
+    /// @brief Open every device file in init_msr().
+    MSR_OPEN_EAGER,
+    /// @brief Open a device file the first time its CPU is accessed.
+    MSR_OPEN_LAZY,
+};
+
 struct topo
 {
     struct hwthread *thread_map;
@@ -217,6 +280,9 @@ int free_batch(int batchnum);
 
 /// @brief Create new batch operation.
 ///
+/// An operation on a CPU outside the CPU subset still gets storage for dest,
+/// but is never submitted.
+///
 /// @param [in] msr Address of MSR for which operation will take place.
 ///
 /// @param [in] cpu CPU where batch operation will take place.
@@ -310,13 +376,101 @@ int stat_module(char *filename,
 
 /// @brief Open the MSR module file descriptors exposed in the /dev filesystem.
 ///
+/// In MSR_OPEN_LAZY mode only the module type is probed here, and each
+/// /dev/cpu/N device is opened on its first pread/pwrite access. Tools that
+/// only use the msr_batch driver then never open per-CPU files. The lazy
+/// mode is selected with set_msr_open_mode() or by setting LIBMSR_LAZY_OPEN
+/// in the environment.
+///
+/// Device files are looked up under MSR_DEV_DIR, or under the directory
+/// named by LIBMSR_DEV_DIR. Pointing it at a tree of regular files (N/msr or
+/// N/msr_safe per CPU) runs libmsr against a file-backed fake, which uses the
+/// compatibility batch path since there is no msr_batch device.
+///
+/// The topology is cached in TOPO_CACHE_PATH (or the file named by
+/// LIBMSR_TOPO_CACHE, an empty value disables the cache) and reused until
+/// the next reboot.
+///
 /// @return 0 if initialization was a success, else -1 if could not stat file
 /// descriptors or open any msr module.
 int init_msr(void);
 
+/// @brief Restrict MSR access to a subset of logical processors.
+///
+/// CPUs outside the subset are not opened by init_msr(), batch operations on
+/// them are not added to the batch (their values stay zero), and socket/core
+/// batches are loaded on a selected CPU when the socket or core has one. Setting LIBMSR_CPU_AFFINITY in the environment makes
+/// init_msr() use the affinity mask of the calling process.
+///
+/// @param [in] mask Array of num_devs() flags indexed by OS CPU number,
+///        non-zero selects the CPU. NULL selects the CPUs in the affinity
+///        mask of the calling process.
+///
+/// @return 0 if successful, else -1 if init_msr() was already called, the
+/// affinity mask could not be read or no CPU is selected.
+int set_cpu_subset(const uint8_t *mask);
+
+/// @brief Check if a logical processor is in the CPU subset.
+///
+/// @param [in] dev_idx Unique logical processor identifier.
+///
+/// @return 1 if the CPU is selected or no subset is set, else 0.
+int cpu_in_subset(const uint64_t dev_idx);
+
+/// @brief Check if a logical processor, given by its coordinates, is in the
+/// CPU subset.
+///
+/// @param [in] socket Unique socket/package identifier.
+///
+/// @param [in] core Unique core identifier.
+///
+/// @param [in] thread Unique thread identifier.
+///
+/// @return 1 if the CPU is selected or no subset is set, else 0.
+int coord_in_subset(const unsigned socket,
+                    const unsigned core,
+                    const unsigned thread);
+
+/// @brief Retrieve the logical processors in the CPU subset.
+///
+/// @param [out] devs Unique logical processor identifiers in ascending
+///        order, every CPU when no subset is set.
+///
+/// @return Number of entries in devs.
+uint64_t cpu_subset_list(const uint64_t **devs);
+
+/// @brief Check if a socket has at least one CPU in the CPU subset.
+///
+/// @param [in] socket Unique socket/package identifier.
+///
+/// @return 1 if the socket is selected or no subset is set, else 0.
+int socket_in_subset(const uint64_t socket);
+
+/// @brief Restrict MSR access to a single thread.
+///
+/// While an owner is set, single MSR reads and writes and batch operations
+/// issued from any other thread fail with LIBMSR_ERROR_INVAL instead of
+/// racing the owner on shared batches and scratch space. msr_sched_start()
+/// makes its sampler thread the owner until msr_sched_stop().
+///
+/// @param [in] owner Thread allowed to access MSRs, or NULL to allow every
+///        thread again.
+void set_msr_owner(const pthread_t *owner);
+
+/// @brief Select how init_msr() opens the per-CPU MSR device files.
+///
+/// @param [in] mode libmsr_open_mode_e mode, must be set before init_msr().
+///
+/// @return 0 if successful, else -1 if init_msr() was already called or the
+/// mode is invalid.
+int set_msr_open_mode(const int mode);
+
 /// @brief Close the MSR module file descriptors exposed in the /dev
 /// filesystem.
 ///
+/// This also releases all library memory, libmsr must not be used
+/// afterwards.
+///
 /// @return 0 if finalization was a success, else -1 if could not close file
 /// descriptors.
 int finalize_msr(void);
@@ -375,6 +529,42 @@ int read_msr_by_coord(unsigned socket,
                       off_t msr,
                       uint64_t *val);
 
+/// @brief Write a new value to a package-scope MSR of a socket.
+///
+/// The write goes to the same logical processor load_socket_batch() uses,
+/// the first CPU of the socket in the CPU subset.
+///
+/// @param [in] socket Unique socket/package identifier.
+///
+/// @param [in] msr Address of register to write.
+///
+/// @param [in] val Value to write to MSR.
+///
+/// @return 0 if write_msr_by_idx() was a success, else -1 if the file
+/// descriptor was NULL or if the number of bytes written was not the size of
+/// uint64_t.
+int write_msr_by_socket(unsigned socket,
+                        off_t msr,
+                        uint64_t val);
+
+/// @brief Read current value of a package-scope MSR of a socket.
+///
+/// The read goes to the same logical processor load_socket_batch() uses,
+/// the first CPU of the socket in the CPU subset.
+///
+/// @param [in] socket Unique socket/package identifier.
+///
+/// @param [in] msr Address of register to read.
+///
+/// @param [out] val Value read from MSR.
+///
+/// @return 0 if read_msr_by_idx() was a success, else -1 if the file
+/// descriptor was NULL or if the number of bytes read was not the size of
+/// uint64_t.
+int read_msr_by_socket(unsigned socket,
+                       off_t msr,
+                       uint64_t *val);
+
 /// @brief Perform batch read of multiple MSR based on the coordinates of a
 /// core or thread.
 ///
@@ -405,11 +595,41 @@ int read_msr_by_coord_batch(unsigned socket,
 /// @param [in] batchnum libmsr_data_type_e data type of batch operation.
 int read_batch(const int batchnum);
 
+/// @brief Do batch read operation on several batches at once.
+///
+/// With the msr_batch driver, the operations of every batch are submitted in
+/// a single ioctl and the results copied back into each batch. Otherwise each
+/// batch is read in turn.
+///
+/// @param [in] batchnums libmsr_data_type_e data types of the batches.
+///
+/// @param [in] nbatches Number of entries in batchnums.
+///
+/// @return 0 if successful, else -1 if the ioctl failed.
+int read_batches(const int *batchnums, const int nbatches);
+
 /// @brief Do batch write operation.
 ///
 /// @param [in] batchnum libmsr_data_type_e data type of batch operation.
 int write_batch(const int batchnum);
 
+/// @brief Do batch write operation on a subset of a batch.
+///
+/// Only the operations whose entry in dirty is non-zero are copied into a
+/// scratch batch and submitted, so the write costs as many MSR accesses as
+/// there are changed entries.
+///
+/// @param [in] batchnum libmsr_data_type_e data type of batch operation.
+///
+/// @param [in] dirty Array with one entry per operation in the batch, in the
+///        order the operations were loaded. Entries of operations on CPUs
+///        outside the CPU subset are ignored.
+///
+/// @return 0 if successful or nothing was dirty, else -1 if the batch is
+/// uninitialized or the write failed.
+int write_batch_sparse(const int batchnum,
+                       const uint8_t *dirty);
+
 /// @brief Load batch operations for a socket.
 ///
 /// @param [in] msr Address of register to load.
@@ -123,6 +123,26 @@ struct pmc
     uint64_t **pmc7;
 };
 
+/// @brief Structure containing the general-purpose performance counters and
+/// their event select registers for every logical processor.
+///
+/// Pointers into the batch are laid out contiguously as [counter][thread],
+/// i.e., counter i of logical processor t is at index i * num_threads + t. The
+/// named fields of struct perfevtsel and struct pmc point into these arrays.
+struct pmc_bank
+{
+    /// @brief Number of general-purpose counters per logical processor.
+    int num_counters;
+    /// @brief Number of logical processors.
+    uint64_t num_threads;
+    /// @brief Bit width of the general-purpose counters.
+    int width;
+    /// @brief Raw 64-bit values stored in IA32_PERFEVTSEL[0-n].
+    uint64_t **evtsel;
+    /// @brief Raw 64-bit values stored in IA32_PMC[0-n].
+    uint64_t **value;
+};
+
 /// @brief Structure containing data of uncore performance event select
 /// counters.
 struct unc_perfevtsel
@@ -151,6 +171,46 @@ struct unc_counters
     uint64_t **c3;
 };
 
+/// @brief Number of general-purpose counters in each CBo box.
+#define CBO_NUM_CTRS 4
+
+/// @brief Structure containing data of the per-box CBo (caching agent) uncore
+/// performance monitoring MSRs.
+///
+/// Each array holds one pointer per (box, socket) pair, indexed as
+/// [box * sockets + socket]. The event select and counter arrays add the
+/// counter number as the outermost index, i.e.,
+/// [(ctr * nboxes + box) * sockets + socket].
+struct cbo_counters
+{
+    /// @brief Number of CBo boxes monitored on each socket.
+    int nboxes;
+    /// @brief Raw 64-bit value stored in MSR_Cx_PMON_BOX_CTL.
+    uint64_t **box_ctl;
+    /// @brief Raw 64-bit value stored in MSR_Cx_BOX_FILTER.
+    uint64_t **filter;
+    /// @brief Raw 64-bit value stored in MSR_Cx_PMON_EVNTSEL[0-3].
+    uint64_t **evtsel;
+    /// @brief Raw 64-bit value stored in MSR_Cx_PMON_CTR[0-3].
+    uint64_t **ctr;
+};
+
+/// @brief Structure containing socket-level last-level cache statistics
+/// aggregated across all CBo boxes.
+struct cbo_llc_stats
+{
+    /// @brief LLC lookups since the previous sample.
+    uint64_t lookups;
+    /// @brief LLC misses since the previous sample.
+    uint64_t misses;
+    /// @brief LLC lookups per second since the previous sample.
+    double lookup_rate;
+    /// @brief LLC misses per second since the previous sample.
+    double miss_rate;
+    /// @brief Fraction of lookups that missed the LLC.
+    double miss_ratio;
+};
+
 /// @brief Print available general-purpose performance counters.
 void print_available_counters(void);
 
@@ -168,6 +228,51 @@ void perfevtsel_storage(struct perfevtsel **e);
 /// @param [out] p Data for general-purpose performance counters.
 void pmc_storage(struct pmc **p);
 
+/// @brief Store the general-purpose performance counter bank on the heap.
+///
+/// @param [out] bank Data for the general-purpose performance counter bank.
+void pmc_bank_storage(struct pmc_bank **bank);
+
+/// @brief Read the general-purpose performance counters on all logical
+/// processors and copy a subset of them into a dense buffer.
+///
+/// @param [in] ctrmask Bitmask of counters to copy (bit i selects PMCi).
+///
+/// @param [out] out Buffer of num_counters * num_threads entries in
+///        [counter][thread] layout. Rows not selected by ctrmask are left
+///        untouched.
+///
+/// @return 0 if successful, else -1 if no counters are available or the batch
+/// read failed.
+int read_pmc_bank(uint64_t ctrmask, uint64_t *out);
+
+/// @brief Compute wraparound-safe counter deltas between two dense buffers
+/// produced by read_pmc_bank().
+///
+/// @param [in] prev Earlier sample in [counter][thread] layout.
+///
+/// @param [in] curr Later sample in [counter][thread] layout.
+///
+/// @param [out] delta Per-counter, per-thread difference in [counter][thread]
+///        layout (may alias curr).
+///
+/// @param [in] ctrmask Bitmask of counters to compute (bit i selects PMCi).
+void delta_pmc_bank(const uint64_t *prev,
+                    const uint64_t *curr,
+                    uint64_t *delta,
+                    uint64_t ctrmask);
+
+/// @brief Sum each selected counter across all logical processors.
+///
+/// @param [in] data Dense buffer in [counter][thread] layout.
+///
+/// @param [in] ctrmask Bitmask of counters to reduce (bit i selects PMCi).
+///
+/// @param [out] sums Per-counter totals, indexed by counter number.
+void reduce_pmc_bank(const uint64_t *data,
+                     uint64_t ctrmask,
+                     uint64_t *sums);
+
 /// @brief Set a performance event select counter on a single logical processor.
 ///
 /// @param [in] cmask Count multiple event occurrences per cycle.
@@ -316,6 +421,115 @@ void dump_unc_counter_data_label(FILE *writedest);
 /// @param [in] writedest File stream where output will be written to.
 void dump_unc_counter_data(FILE *writedest);
 
+/*************************************/
+/* Uncore CBo Performance Monitoring */
+/*************************************/
+
+/// @brief Store the per-box CBo uncore performance monitoring data on the
+/// heap.
+///
+/// The number of boxes monitored per socket is the smaller of NUM_CBO_BOXES
+/// and the number of cores per socket, since each core has its own CBo.
+///
+/// @param [out] cbo Pointer to data for CBo uncore performance counters.
+void cbo_counters_storage(struct cbo_counters **cbo);
+
+/// @brief Set a CBo event select counter to the same event on every box of
+/// every socket.
+///
+/// Values are staged in the batch; nothing is written until program_cbo() is
+/// called.
+///
+/// @param [in] flags Toggle additional options, such as edge detection,
+///        invert, and thread ID filter enable (bits 18-23 of the event select).
+///
+/// @param [in] thresh Threshold used for counter comparison.
+///
+/// @param [in] umask Condition to be detected by the event logic unit.
+///
+/// @param [in] eventsel Unique event logic unit identifier.
+///
+/// @param [in] ctrnum Counter number within each box (0-3).
+///
+/// @return 0 if successful, else -1 if ctrnum is invalid.
+int set_all_cbo_ctrl(uint64_t flags,
+                     uint64_t thresh,
+                     uint64_t umask,
+                     uint64_t eventsel,
+                     int ctrnum);
+
+/// @brief Set the CBo filter register to the same value on every box of every
+/// socket.
+///
+/// Values are staged in the batch; nothing is written until program_cbo() is
+/// called.
+///
+/// @param [in] filter Raw value for MSR_Cx_BOX_FILTER.
+void set_all_cbo_filter(uint64_t filter);
+
+/// @brief Write the staged event select and filter values for all CBo boxes
+/// on all sockets in a single batch.
+///
+/// @return 0 if successful, else -1 if the batch write failed.
+int program_cbo(void);
+
+/// @brief Freeze all CBo counters on all sockets in a single batch.
+///
+/// @return 0 if successful, else -1 if the batch write failed.
+int freeze_cbo(void);
+
+/// @brief Unfreeze all CBo counters on all sockets in a single batch.
+///
+/// @return 0 if successful, else -1 if the batch write failed.
+int unfreeze_cbo(void);
+
+/// @brief Reset all CBo counters on all sockets in a single batch, leaving
+/// the boxes unfrozen.
+///
+/// @return 0 if successful, else -1 if the batch write failed.
+int reset_cbo(void);
+
+/// @brief Read all CBo counters on all sockets in a single batch.
+///
+/// @return 0 if successful, else -1 if the batch read failed.
+int read_cbo_counters(void);
+
+/// @brief Sum the most recently read value of a CBo counter across all boxes
+/// on each socket.
+///
+/// @param [in] ctrnum Counter number within each box (0-3).
+///
+/// @param [out] totals Per-socket sums, must hold num_sockets() entries.
+///
+/// @return 0 if successful, else -1 if ctrnum is invalid.
+int sum_cbo_counters(int ctrnum, uint64_t *totals);
+
+/// @brief Program counter 0 of every CBo box to count LLC lookups and counter
+/// 1 to count LLC misses, then reset and start counting.
+///
+/// @return 0 if successful, else -1 if the platform does not define LLC
+/// events or a batch operation failed.
+int enable_cbo_llc(void);
+
+/// @brief Read the CBo counters and compute per-socket LLC lookup and miss
+/// rates since the previous call (or since enable_cbo_llc()).
+///
+/// @param [out] stats Per-socket LLC statistics, must hold num_sockets()
+///        entries.
+///
+/// @return 0 if successful, else -1 if the batch read failed.
+int get_cbo_llc_stats(struct cbo_llc_stats *stats);
+
+/// @brief Print the label for the CBo uncore counter data print out.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_cbo_counter_data_label(FILE *writedest);
+
+/// @brief Print per-socket CBo uncore counter totals.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_cbo_counter_data(FILE *writedest);
+
 /*****************************************/
 /* Fixed Counters Performance Monitoring */
 /*****************************************/
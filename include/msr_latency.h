@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2013-2017, Lawrence Livermore National Security, LLC.
+ *
+ * Produced at the Lawrence Livermore National Laboratory. Written by:
+ *     Barry Rountree <rountree@llnl.gov>,
+ *     Scott Walker <walker91@llnl.gov>, and
+ *     Kathleen Shoga <shoga1@llnl.gov>.
+ *
+ * LLNL-CODE-645430
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr. For details, see https://github.com/LLNL/libmsr.git.
+ *
+ * Please also read libmsr/LICENSE for our notice and the LGPL.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License (as published by the Free
+ * Software Foundation) version 2.1 dated February 1999.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the IMPLIED WARRANTY OF MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the terms and conditions of the GNU Lesser
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#ifndef MSR_LATENCY_H_INCLUDE
+#define MSR_LATENCY_H_INCLUDE
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Number of log2 latency buckets. Bucket i counts operations taking
+/// [2^i, 2^(i+1)) nanoseconds, the last bucket also counts anything slower.
+#define LAT_NUM_BUCKETS 32
+
+/// @brief Number of per-batch slots kept for each operation type. Batch ids
+/// at or above this share the last slot.
+#define LAT_MAX_BATCHES 64
+
+/// @brief Enum encompassing the timed operation types.
+enum libmsr_lat_op_e
+{
+    /// @brief Batch submitted through the msr_batch ioctl.
+    LAT_MSR_BATCH,
+    /// @brief Batch run through the pread/pwrite compatibility path.
+    LAT_MSR_COMPAT_BATCH,
+    /// @brief Several batches merged into one msr_batch ioctl by
+    /// read_batches(), each batch charged its share of the ioctl by op count.
+    LAT_MSR_MERGED_BATCH,
+    /// @brief Single MSR read through the per-CPU device.
+    LAT_MSR_READ,
+    /// @brief Single MSR write through the per-CPU device.
+    LAT_MSR_WRITE,
+    /// @brief CSR batch, through csr_safe or sysfs config space.
+    LAT_CSR_BATCH,
+    /// @brief Number of operation types.
+    LAT_NUM_OP_TYPES,
+};
+
+/// @brief Structure holding call counts and the latency histogram of one
+/// operation type and batch id.
+struct libmsr_lat_stats
+{
+    /// @brief Number of timed calls.
+    uint64_t calls;
+    /// @brief Number of MSR or CSR operations issued by those calls.
+    uint64_t ops;
+    /// @brief Number of failed operations.
+    uint64_t errors;
+    /// @brief Sum of call latencies in nanoseconds.
+    uint64_t total_ns;
+    /// @brief Slowest call in nanoseconds.
+    uint64_t max_ns;
+    /// @brief Log2 latency histogram of calls.
+    uint64_t buckets[LAT_NUM_BUCKETS];
+};
+
+/// @brief Get a monotonic timestamp to pass to lat_record().
+///
+/// @return Current CLOCK_MONOTONIC time in nanoseconds.
+uint64_t lat_now(void);
+
+/// @brief Record one timed call in the calling thread's statistics.
+///
+/// Each thread updates its own block without locking. Blocks are merged when
+/// statistics are queried.
+///
+/// @param [in] type libmsr_lat_op_e type of operation.
+///
+/// @param [in] batchnum Batch id of the call, 0 for single operations.
+///
+/// @param [in] start Timestamp taken with lat_now() before the call.
+///
+/// @param [in] ops Number of operations issued by the call.
+///
+/// @param [in] errors Number of those operations that failed.
+void lat_record(const int type, const int batchnum, const uint64_t start, const unsigned ops, const unsigned errors);
+
+/// @brief Record one call whose duration is already known, e.g. a share of
+/// a submission covering several batches.
+///
+/// @param [in] type libmsr_lat_op_e type of operation.
+///
+/// @param [in] batchnum Batch id of the call, 0 for single operations.
+///
+/// @param [in] ns Duration of the call in nanoseconds.
+///
+/// @param [in] ops Number of operations issued by the call.
+///
+/// @param [in] errors Number of those operations that failed.
+void lat_record_ns(const int type, const int batchnum, const uint64_t ns, const unsigned ops, const unsigned errors);
+
+/// @brief Get statistics of one operation type merged over all threads.
+///
+/// @param [in] type libmsr_lat_op_e type of operation.
+///
+/// @param [in] batchnum Batch id, or -1 to merge every batch id.
+///
+/// @param [out] stats Merged statistics.
+///
+/// @return 0 if successful, else -1 if type is out of range.
+int get_lat_stats(const int type, const int batchnum, struct libmsr_lat_stats *stats);
+
+/// @brief Estimate a latency percentile from a histogram.
+///
+/// @param [in] stats Statistics to read.
+///
+/// @param [in] pct Percentile between 0 and 100.
+///
+/// @return Upper bound (in nanoseconds) of the bucket holding the percentile,
+/// else 0 if no calls were recorded.
+uint64_t lat_percentile(const struct libmsr_lat_stats *stats, const double pct);
+
+/// @brief Clear the statistics of every thread.
+void reset_lat_stats(void);
+
+/// @brief Get a printable name of an operation type.
+///
+/// @param [in] type libmsr_lat_op_e type of operation.
+///
+/// @return Name of the operation type.
+const char *lat_op_name(const int type);
+
+/// @brief Print merged statistics of every operation type and batch id that
+/// has recorded calls.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_lat_stats(FILE *writedest);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -202,6 +202,33 @@ struct core_cres
     uint64_t **core_c7;
 };
 
+/// @brief Number of core-level C-states tracked by the interval API (C3, C6,
+/// C7).
+#define CRES_NUM_CORE_STATES 3
+
+/// @brief Number of package-level C-states tracked by the interval API (C2,
+/// C3, C6, C7).
+#define CRES_NUM_PKG_STATES 4
+
+/// @brief Structure holding C-state residency fractions over the most recent
+/// sampling interval.
+///
+/// Each fraction is the residency delta divided by the TSC delta over the same
+/// interval, so 1.0 means the whole interval was spent in that state.
+struct cres_interval
+{
+    /// @brief Elapsed TSC ticks per core, [core].
+    uint64_t *core_tsc;
+    /// @brief Core residency fractions, [core * CRES_NUM_CORE_STATES + state]
+    /// for C3, C6, and C7.
+    double *core;
+    /// @brief Elapsed TSC ticks per package, [socket].
+    uint64_t *pkg_tsc;
+    /// @brief Package residency fractions, [socket * CRES_NUM_PKG_STATES +
+    /// state] for C2, C3, C6, and C7.
+    double *pkg;
+};
+
 /*************************/
 /* Misc Enable Functions */
 /*************************/
@@ -264,6 +291,31 @@ void dump_core_cres_label(FILE *writedest);
 /// @param [in] writedest File stream where output will be written to.
 void dump_core_cres(FILE *writedest);
 
+/// @brief Initialize storage for C-state residency fractions.
+///
+/// Core and package residency counters and the TSC of each core and package
+/// are loaded into a single batch.
+///
+/// @param [out] ci Pointer to C-state residency interval data.
+void cres_interval_storage(struct cres_interval **ci);
+
+/// @brief Read all C-state residency counters and the TSC in a single batch
+/// and compute the residency fraction of each state since the previous call.
+///
+/// The first call records a baseline and reports all fractions as 0. Deltas
+/// use unsigned arithmetic, so a counter wrap between samples is handled.
+///
+/// @param [out] ci Pointer to C-state residency interval data (may be NULL).
+///
+/// @return 0 if successful, else -1 if the batch read failed.
+int read_cres_interval(struct cres_interval **ci);
+
+/// @brief Print core and package C-state residency fractions since the
+/// previous call.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_cres_interval(FILE *writedest);
+
 #ifdef __cplusplus
 }
 #endif
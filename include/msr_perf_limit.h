@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2013-2017, Lawrence Livermore National Security, LLC.
+ *
+ * Produced at the Lawrence Livermore National Laboratory. Written by:
+ *     Barry Rountree <rountree@llnl.gov>,
+ *     Scott Walker <walker91@llnl.gov>, and
+ *     Kathleen Shoga <shoga1@llnl.gov>.
+ *
+ * LLNL-CODE-645430
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr. For details, see https://github.com/LLNL/libmsr.git.
+ *
+ * Please also read libmsr/LICENSE for our notice and the LGPL.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License (as published by the Free
+ * Software Foundation) version 2.1 dated February 1999.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the IMPLIED WARRANTY OF MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the terms and conditions of the GNU Lesser
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#ifndef MSR_PERF_LIMIT_H_INCLUDE
+#define MSR_PERF_LIMIT_H_INCLUDE
+
+#include <stdint.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+#include "master.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Number of status bits in MSR_CORE_PERF_LIMIT_REASONS, the matching
+/// log bits start at PERF_LIMIT_LOG_SHIFT.
+#define PERF_LIMIT_NUM_REASONS 16
+/// @brief Offset of the log bits relative to their status bits.
+#define PERF_LIMIT_LOG_SHIFT 16
+/// @brief Mask covering every log bit in MSR_CORE_PERF_LIMIT_REASONS.
+#define PERF_LIMIT_LOG_MASK (0xFFFFUL << PERF_LIMIT_LOG_SHIFT)
+
+/// @brief Enum encompassing the status bits of MSR_CORE_PERF_LIMIT_REASONS.
+///
+/// Not every bit is implemented on every platform, unimplemented bits read
+/// as zero.
+enum perf_limit_reason_e
+{
+    /// @brief Frequency reduced below OS request due to PROCHOT# assertion.
+    PERF_LIMIT_PROCHOT = 0,
+    /// @brief Frequency reduced due to a thermal event.
+    PERF_LIMIT_THERMAL = 1,
+    /// @brief Frequency reduced due to residency state regulation.
+    PERF_LIMIT_RESIDENCY = 4,
+    /// @brief Frequency reduced due to running average thermal limit.
+    PERF_LIMIT_RATL = 5,
+    /// @brief Frequency reduced due to a voltage regulator thermal alert.
+    PERF_LIMIT_VR_THERM_ALERT = 6,
+    /// @brief Frequency reduced due to voltage regulator thermal design
+    /// current limit.
+    PERF_LIMIT_VR_TDC = 7,
+    /// @brief Frequency reduced due to electrical design point or other
+    /// current limit.
+    PERF_LIMIT_OTHER = 8,
+    /// @brief Frequency reduced due to package-level power limit PL1.
+    PERF_LIMIT_PKG_PL1 = 10,
+    /// @brief Frequency reduced due to package-level power limit PL2.
+    PERF_LIMIT_PKG_PL2 = 11,
+    /// @brief Frequency reduced due to the multi-core turbo limit (number of
+    /// active cores).
+    PERF_LIMIT_MAX_TURBO = 12,
+    /// @brief Frequency reduced due to turbo transition attenuation.
+    PERF_LIMIT_TURBO_ATTEN = 13,
+};
+
+/// @brief Structure containing per-socket data for
+/// MSR_CORE_PERF_LIMIT_REASONS and the time-in-reason histogram.
+struct perf_limit_data
+{
+    /// @brief Raw 64-bit value stored in MSR_CORE_PERF_LIMIT_REASONS.
+    uint64_t **raw;
+    /// @brief Status bits (bits [15:0]) of the last sample.
+    uint64_t *active;
+    /// @brief Log bits (bits [31:16]) of the last sample, shifted down to
+    /// line up with the status bits.
+    uint64_t *log;
+    /// @brief Seconds each reason was active, indexed as
+    /// [socket * PERF_LIMIT_NUM_REASONS + reason].
+    double *time_in_reason;
+    /// @brief Seconds any reason was active, per socket.
+    double *time_limited;
+    /// @brief Seconds covered by the histogram.
+    double elapsed;
+    /// @brief Time of the last sample.
+    struct timeval last;
+    /// @brief Non-zero once the first sample has been taken.
+    int have_baseline;
+    /// @brief Non-zero if the socket has log bits to be cleared.
+    uint8_t *dirty;
+};
+
+/// @brief Allocate arrays for storing per-socket raw register data from
+/// MSR_CORE_PERF_LIMIT_REASONS and the time-in-reason histogram.
+///
+/// @param [out] pl Pointer to perf limit reasons data.
+void perf_limit_storage(struct perf_limit_data **pl);
+
+/// @brief Read MSR_CORE_PERF_LIMIT_REASONS on every socket in a single batch
+/// and accumulate the time-in-reason histogram.
+///
+/// The time since the previous sample is charged to every reason active in
+/// this sample, so the sampling interval bounds the histogram resolution.
+///
+/// @return 0 if successful, else -1 if the platform has no perf limit reasons
+/// MSR or the batch read failed.
+int sample_perf_limit(void);
+
+/// @brief Clear the log bits of MSR_CORE_PERF_LIMIT_REASONS in a single
+/// write batch, only touching sockets that had log bits set in the last
+/// sample.
+///
+/// Only the log bits seen in the last sample are cleared, reasons latched
+/// after it stay set.
+///
+/// @return 0 if successful or nothing to clear, else -1 if the platform has
+/// no perf limit reasons MSR or the batch write failed.
+int clear_perf_limit_log(void);
+
+/// @brief Zero the time-in-reason histogram, the next sample starts a new
+/// interval.
+void reset_perf_limit_hist(void);
+
+/// @brief Get a short name for a perf limit reason.
+///
+/// @param [in] reason Status bit of MSR_CORE_PERF_LIMIT_REASONS.
+///
+/// @return Name of the reason, or "reserved" for unimplemented bits.
+const char *perf_limit_reason_name(int reason);
+
+/// @brief Print active and logged reasons plus the time-in-reason histogram
+/// of every socket.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_perf_limit(FILE *writedest);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -432,6 +432,21 @@ int delta_rapl_data(void);
 /// @return 0 if successful, else -1 if rapl_storage() fails.
 int read_rapl_data(void);
 
+/// @brief First half of read_rapl_data(), for callers that read the RAPL_DATA
+/// batch themselves, e.g. merged with other batches by read_batches().
+///
+/// Keeps the previous readings and takes the timestamp of the new ones. Read
+/// RAPL_DATA, then call end_rapl_data().
+///
+/// @return 0 if successful, else -1 if rapl_storage() fails.
+int begin_rapl_data(void);
+
+/// @brief Second half of read_rapl_data(), translating a freshly read
+/// RAPL_DATA batch into joules.
+///
+/// @return 0 if successful, else -1 if rapl_storage() fails.
+int end_rapl_data(void);
+
 /// @brief Get units for RAPL power data.
 ///
 /// @param [out] ru Data for RAPL power units.
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2013-2017, Lawrence Livermore National Security, LLC.
+ *
+ * Produced at the Lawrence Livermore National Laboratory. Written by:
+ *     Barry Rountree <rountree@llnl.gov>,
+ *     Scott Walker <walker91@llnl.gov>, and
+ *     Kathleen Shoga <shoga1@llnl.gov>.
+ *
+ * LLNL-CODE-645430
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr. For details, see https://github.com/LLNL/libmsr.git.
+ *
+ * Please also read libmsr/LICENSE for our notice and the LGPL.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License (as published by the Free
+ * Software Foundation) version 2.1 dated February 1999.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the IMPLIED WARRANTY OF MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the terms and conditions of the GNU Lesser
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#ifndef MSR_SAMPLER_H_INCLUDE
+#define MSR_SAMPLER_H_INCLUDE
+
+#include <pthread.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Shortest supported sampling period in nanoseconds (1 ms).
+#define MSR_SAMPLER_MIN_PERIOD_NS 1000000ULL
+
+/// @brief Callback run by the sampler thread on every tick.
+///
+/// @param [in] arg User argument from the configuration.
+///
+/// @param [in] now_ns CLOCK_MONOTONIC time of the wakeup in nanoseconds.
+///
+/// @param [in] missed Number of ticks skipped since the previous call
+///        because the callback or the scheduler ran late.
+typedef void (*msr_sampler_fn)(void *arg, uint64_t now_ns, uint64_t missed);
+
+/// @brief Structure holding the configuration of a sampler.
+struct msr_sampler_config
+{
+    /// @brief Sampling period in nanoseconds, at least
+    /// MSR_SAMPLER_MIN_PERIOD_NS.
+    uint64_t period_ns;
+    /// @brief CPU to pin the sampler thread to, or -1 to leave it unpinned.
+    int cpu;
+    /// @brief SCHED_FIFO priority of the sampler thread, or 0 to inherit the
+    /// caller's policy.
+    int rt_priority;
+    /// @brief Function called on every tick (may be NULL).
+    msr_sampler_fn callback;
+    /// @brief Argument passed to callback.
+    void *arg;
+    /// @brief Non-zero to create an eventfd that is signalled after every
+    /// tick, see msr_sampler_eventfd().
+    int notify;
+};
+
+/// @brief Structure holding the timing statistics of a sampler.
+struct msr_sampler_stats
+{
+    /// @brief Number of ticks handled.
+    uint64_t samples;
+    /// @brief Number of ticks skipped because a previous tick ran late.
+    uint64_t overruns;
+    /// @brief Wakeup delay (in ns) after the deadline of the last tick.
+    uint64_t jitter_last_ns;
+    /// @brief Largest wakeup delay in nanoseconds.
+    uint64_t jitter_max_ns;
+    /// @brief Sum of the wakeup delays, divide by samples for the mean.
+    uint64_t jitter_sum_ns;
+};
+
+struct msr_sampler;
+
+/// @brief Start a sampler thread driven by a CLOCK_MONOTONIC timerfd.
+///
+/// Deadlines are absolute multiples of the period from the start time, so
+/// the cadence does not drift with callback run time. Ticks that are missed
+/// entirely are counted as overruns rather than run late.
+///
+/// @param [out] s Sampler handle.
+///
+/// @param [in] cfg Configuration, copied by the call.
+///
+/// @return 0 if successful, else -1 if the period is too short, or the
+/// timer, CPU pin or real-time priority could not be set up.
+int msr_sampler_start(struct msr_sampler **s,
+                      const struct msr_sampler_config *cfg);
+
+/// @brief Get the eventfd signalled after every tick.
+///
+/// A read() returns the number of ticks since the previous read.
+///
+/// @param [in] s Sampler handle.
+///
+/// @return File descriptor, else -1 if the sampler was started without
+/// notify.
+int msr_sampler_eventfd(const struct msr_sampler *s);
+
+/// @brief Get the sampler thread, e.g. to hand it MSR access with
+/// set_msr_owner().
+///
+/// @param [in] s Sampler handle.
+///
+/// @return Thread running the callback.
+pthread_t msr_sampler_thread(const struct msr_sampler *s);
+
+/// @brief Get the timing statistics of a sampler.
+///
+/// @param [in] s Sampler handle.
+///
+/// @param [out] stats Statistics so far.
+void msr_sampler_get_stats(const struct msr_sampler *s,
+                           struct msr_sampler_stats *stats);
+
+/// @brief Stop the sampler thread and release its resources.
+///
+/// @param [in] s Sampler handle.
+void msr_sampler_stop(struct msr_sampler *s);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
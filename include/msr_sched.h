@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2013-2017, Lawrence Livermore National Security, LLC.
+ *
+ * Produced at the Lawrence Livermore National Laboratory. Written by:
+ *     Barry Rountree <rountree@llnl.gov>,
+ *     Scott Walker <walker91@llnl.gov>, and
+ *     Kathleen Shoga <shoga1@llnl.gov>.
+ *
+ * LLNL-CODE-645430
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr. For details, see https://github.com/LLNL/libmsr.git.
+ *
+ * Please also read libmsr/LICENSE for our notice and the LGPL.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License (as published by the Free
+ * Software Foundation) version 2.1 dated February 1999.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the IMPLIED WARRANTY OF MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the terms and conditions of the GNU Lesser
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#ifndef MSR_SCHED_H_INCLUDE
+#define MSR_SCHED_H_INCLUDE
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Maximum number of sources registered with the scheduler.
+#define MSR_SCHED_MAX_SOURCES 32
+
+/// @brief Source flag, the batch is a csr_data_type_e batch read with
+/// do_csr_batch_op() instead of a libmsr_data_type_e batch.
+#define MSR_SCHED_CSR 0x1
+
+/// @brief Hook run by the scheduler around the read of a source.
+///
+/// @param [in] arg User argument given when the source was added.
+typedef void (*msr_sched_fn)(void *arg);
+
+/// @brief Structure holding the counters of the scheduler.
+struct msr_sched_stats
+{
+    /// @brief Number of ticks that read at least one source.
+    uint64_t ticks;
+    /// @brief Number of MSR submissions (one per tick with a due MSR source).
+    uint64_t submissions;
+    /// @brief Number of batch reads the submissions stand for.
+    uint64_t batch_reads;
+    /// @brief Number of CSR batch submissions.
+    uint64_t csr_reads;
+};
+
+/// @brief Register a batch to be read at a given period.
+///
+/// The batch must already be loaded, e.g. by the matching *_storage() or
+/// init call. On every tick, all due MSR sources are read with a single
+/// read_batches() call: every due source's prepare hook runs first, then
+/// the merged read, then every due source's decode hook.
+///
+/// @param [in] batchnum libmsr_data_type_e (or csr_data_type_e with
+///        MSR_SCHED_CSR) batch to read.
+///
+/// @param [in] flags 0 or MSR_SCHED_CSR.
+///
+/// @param [in] period_ns Read period in nanoseconds, or 0 to read the batch
+///        only once on the first tick (static registers).
+///
+/// @param [in] prepare Hook run before the read (may be NULL).
+///
+/// @param [in] decode Hook run after the read (may be NULL).
+///
+/// @param [in] arg Argument passed to both hooks.
+///
+/// @return Source index if successful, else -1 if the table is full or the
+/// scheduler is running.
+int msr_sched_add(const int batchnum,
+                  const int flags,
+                  const uint64_t period_ns,
+                  msr_sched_fn prepare,
+                  msr_sched_fn decode,
+                  void *arg);
+
+/// @brief Register RAPL_DATA, keeping the rapl_data of rapl_storage() up to
+/// date like poll_rapl_data() does.
+///
+/// @param [in] period_ns Read period in nanoseconds.
+///
+/// @param [in] decode Hook run after the energy and power are computed (may
+///        be NULL).
+///
+/// @param [in] arg Argument passed to decode.
+///
+/// @return Source index if successful, else -1.
+int msr_sched_add_rapl(const uint64_t period_ns,
+                       msr_sched_fn decode,
+                       void *arg);
+
+/// @brief Read every source that is due at a given time.
+///
+/// Called by the scheduler thread, or directly by a caller running its own
+/// loop. The first call reads every source.
+///
+/// @param [in] now_ns CLOCK_MONOTONIC time in nanoseconds.
+///
+/// @return Number of sources read, else -1 if a read failed.
+int msr_sched_tick(const uint64_t now_ns);
+
+/// @brief Start a sampler thread ticking the scheduler.
+///
+/// The tick period is the greatest common divisor of the source periods (at
+/// least MSR_SAMPLER_MIN_PERIOD_NS). A first tick runs on the calling thread,
+/// so static sources are read before this returns.
+///
+/// The sampler thread then owns MSR access (see set_msr_owner()) until
+/// msr_sched_stop(): batches, scratch space and the decode hooks' data are
+/// not locked, so MSR reads and writes from any other thread fail while the
+/// scheduler runs. Decode hooks run on the sampler thread and may use
+/// libmsr. CSR batches are not checked and must not be used by other threads
+/// either.
+///
+/// @param [in] cpu CPU to pin the thread to, or -1.
+///
+/// @param [in] rt_priority SCHED_FIFO priority of the thread, or 0.
+///
+/// @return 0 if successful, else -1 if no source has a period, the
+/// scheduler is already running, or the sampler could not be started.
+int msr_sched_start(const int cpu, const int rt_priority);
+
+/// @brief Stop the scheduler thread and give MSR access back to every thread.
+void msr_sched_stop(void);
+
+/// @brief Remove every source and reset the counters, stopping the
+/// scheduler thread first if it is running.
+void msr_sched_clear(void);
+
+/// @brief Get the counters of the scheduler.
+///
+/// @param [out] stats Counters so far.
+void msr_sched_get_stats(struct msr_sched_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
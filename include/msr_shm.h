@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2013-2017, Lawrence Livermore National Security, LLC.
+ *
+ * Produced at the Lawrence Livermore National Laboratory. Written by:
+ *     Barry Rountree <rountree@llnl.gov>,
+ *     Scott Walker <walker91@llnl.gov>, and
+ *     Kathleen Shoga <shoga1@llnl.gov>.
+ *
+ * LLNL-CODE-645430
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr. For details, see https://github.com/LLNL/libmsr.git.
+ *
+ * Please also read libmsr/LICENSE for our notice and the LGPL.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License (as published by the Free
+ * Software Foundation) version 2.1 dated February 1999.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the IMPLIED WARRANTY OF MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the terms and conditions of the GNU Lesser
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#ifndef MSR_SHM_H_INCLUDE
+#define MSR_SHM_H_INCLUDE
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief Default name of the shared-memory segment.
+#define MSR_SHM_NAME "/libmsr-sample"
+
+/// @brief Magic number at the start of a published segment ("MSRS").
+#define MSR_SHM_MAGIC 0x5352534d
+
+/// @brief Layout version of the segment, bumped on incompatible changes.
+#define MSR_SHM_VERSION 1
+
+/// @brief Number of consistent-copy attempts before msr_shm_read() gives up.
+#define MSR_SHM_MAX_RETRIES 1000
+
+/// @brief Enum encompassing the data sources published in a segment.
+enum msr_shm_source_e
+{
+    /// @brief Package and DRAM energy and power of each socket.
+    MSR_SHM_RAPL = 1 << 0,
+    /// @brief APERF, MPERF and TSC of each logical processor.
+    MSR_SHM_CLOCKS = 1 << 1,
+    /// @brief Core and package temperatures.
+    MSR_SHM_THERM = 1 << 2,
+    /// @brief Fixed-function performance counters of each logical processor.
+    MSR_SHM_COUNTERS = 1 << 3,
+};
+
+/// @brief Structure at the start of the shared-memory segment.
+///
+/// Per-socket, per-core and per-thread records follow at the given offsets
+/// from the start of the segment. The snapshot is guarded by a seqlock: seq
+/// is odd while the publisher updates it.
+struct msr_shm_header
+{
+    /// @brief MSR_SHM_MAGIC.
+    uint32_t magic;
+    /// @brief MSR_SHM_VERSION.
+    uint32_t version;
+    /// @brief Size of the segment in bytes.
+    uint64_t size;
+    /// @brief Number of sockets.
+    uint64_t nsockets;
+    /// @brief Number of physical cores.
+    uint64_t ncores;
+    /// @brief Number of logical processors.
+    uint64_t nthreads;
+    /// @brief Bitmask of msr_shm_source_e sources being published.
+    uint64_t sources;
+    /// @brief Sampling interval of the publisher in nanoseconds.
+    uint64_t interval_ns;
+    /// @brief Process ID of the publisher, 0 once it has shut down.
+    int64_t pid;
+    /// @brief Seqlock sequence number.
+    uint64_t seq;
+    /// @brief Number of snapshots published.
+    uint64_t nsamples;
+    /// @brief CLOCK_MONOTONIC time of the snapshot in nanoseconds.
+    uint64_t sample_ns;
+    /// @brief Length (in seconds) of the interval the power values cover.
+    double elapsed;
+    /// @brief Offset of the per-socket records.
+    uint64_t socket_off;
+    /// @brief Offset of the per-core records.
+    uint64_t core_off;
+    /// @brief Offset of the per-thread records.
+    uint64_t thread_off;
+};
+
+/// @brief Structure holding the published data of one socket.
+struct msr_shm_socket
+{
+    /// @brief Package energy (in joules) consumed since the publisher started.
+    double pkg_joules;
+    /// @brief Package power (in watts) over the last interval.
+    double pkg_watts;
+    /// @brief DRAM energy (in joules) consumed since the publisher started.
+    double dram_joules;
+    /// @brief DRAM power (in watts) over the last interval.
+    double dram_watts;
+    /// @brief Package temperature in degree Celsius.
+    int64_t pkg_temp;
+};
+
+/// @brief Structure holding the published data of one physical core.
+struct msr_shm_core
+{
+    /// @brief Core temperature in degree Celsius, or THERM_TEMP_INVALID.
+    int64_t temp;
+};
+
+/// @brief Structure holding the published data of one logical processor.
+struct msr_shm_thread
+{
+    /// @brief Raw value of IA32_APERF.
+    uint64_t aperf;
+    /// @brief Raw value of IA32_MPERF.
+    uint64_t mperf;
+    /// @brief Raw value of IA32_TIME_STAMP_COUNTER.
+    uint64_t tsc;
+    /// @brief Raw value of IA32_FIXED_CTR0 (instructions retired).
+    uint64_t inst_retired;
+    /// @brief Raw value of IA32_FIXED_CTR1 (unhalted core cycles).
+    uint64_t unhalted_core;
+    /// @brief Raw value of IA32_FIXED_CTR2 (unhalted reference cycles).
+    uint64_t unhalted_ref;
+};
+
+/// @brief Structure holding a reader's mapping of a segment.
+struct msr_shm_client
+{
+    /// @brief Read-only mapping of the segment.
+    const void *base;
+    /// @brief Size of the mapping in bytes.
+    uint64_t size;
+};
+
+/*************/
+/* Publisher */
+/*************/
+
+/// @brief Create the shared-memory segment and set up sampling of every
+/// available source.
+///
+/// init_msr() must have been called. Sources that cannot be initialized are
+/// left out of the header's sources mask.
+///
+/// @param [in] name Segment name, or NULL for MSR_SHM_NAME.
+///
+/// @param [in] interval_ns Sampling interval advertised to readers.
+///
+/// @return 0 if successful, else -1 if the segment could not be created.
+int msr_shm_create(const char *name,
+                   const uint64_t interval_ns);
+
+/// @brief Sample every source and publish the snapshot.
+///
+/// All MSRs are read before the seqlock is taken, so readers only retry if
+/// they overlap the final copy into the segment.
+///
+/// @return 0 if successful, else -1 if no segment was created.
+int msr_shm_publish(void);
+
+/// @brief Mark the segment as shut down, unmap it and remove its name.
+void msr_shm_destroy(void);
+
+/**********/
+/* Reader */
+/**********/
+
+/// @brief Map a published segment read-only.
+///
+/// @param [in] name Segment name, or NULL for MSR_SHM_NAME.
+///
+/// @param [out] client Mapping of the segment.
+///
+/// @return 0 if successful, else -1 if the segment does not exist or has an
+/// unexpected layout.
+int msr_shm_attach(const char *name,
+                   struct msr_shm_client *client);
+
+/// @brief Copy a consistent snapshot out of the segment.
+///
+/// The copy takes no locks and makes no system calls. It is retried while
+/// the publisher is updating the segment.
+///
+/// @param [in] client Mapping from msr_shm_attach().
+///
+/// @param [out] snap Buffer of client->size bytes receiving the header and
+///        records.
+///
+/// @return 0 if successful, else -1 if no consistent copy was obtained in
+/// MSR_SHM_MAX_RETRIES attempts.
+int msr_shm_read(const struct msr_shm_client *client,
+                 void *snap);
+
+/// @brief Unmap a segment.
+///
+/// @param [in] client Mapping from msr_shm_attach().
+void msr_shm_detach(struct msr_shm_client *client);
+
+/// @brief Get the per-socket records of a snapshot.
+///
+/// @param [in] snap Snapshot from msr_shm_read().
+///
+/// @return Array of nsockets records.
+const struct msr_shm_socket *msr_shm_sockets(const void *snap);
+
+/// @brief Get the per-core records of a snapshot.
+///
+/// @param [in] snap Snapshot from msr_shm_read().
+///
+/// @return Array of ncores records.
+const struct msr_shm_core *msr_shm_cores(const void *snap);
+
+/// @brief Get the per-thread records of a snapshot.
+///
+/// @param [in] snap Snapshot from msr_shm_read().
+///
+/// @return Array of nthreads records.
+const struct msr_shm_thread *msr_shm_threads(const void *snap);
+
+/// @brief Get the age of a snapshot.
+///
+/// Readers use this to detect a publisher that stopped or restarted, in
+/// which case they detach and attach again.
+///
+/// @param [in] snap Snapshot from msr_shm_read().
+///
+/// @return Nanoseconds since the snapshot was taken.
+uint64_t msr_shm_age_ns(const void *snap);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
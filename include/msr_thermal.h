@@ -31,6 +31,7 @@
 #ifndef MSR_THERMAL_H_INCLUDE
 #define MSR_THERMAL_H_INCLUDE
 
+#include <stdint.h>
 #include <stdio.h>
 
 #include "master.h"
@@ -577,6 +578,106 @@ void dump_therm_temp_reading(FILE *writedest);
 /// @param [in] writedest File stream where output will be written to.
 void dump_therm_data_verbose(FILE *writedest);
 
+/**********************/
+/* Temperature Stream */
+/**********************/
+
+/// @brief Value stored for a core whose digital readout is not valid.
+#define THERM_TEMP_INVALID -273
+
+/// @brief Read IA32_THERM_STATUS on every core and IA32_PACKAGE_THERM_STATUS
+/// on every socket in a single batch and convert the readouts to absolute
+/// temperatures.
+///
+/// MSR_TEMPERATURE_TARGET is read once on the first call and cached.
+///
+/// @param [out] core_temp Array of num_cores() entries receiving the core
+///        temperatures in degree Celsius, or THERM_TEMP_INVALID.
+///
+/// @param [out] pkg_temp Array of num_sockets() entries receiving the package
+///        temperatures in degree Celsius (may be NULL).
+///
+/// @return 0 if successful, else -1 if the batch read failed.
+int read_core_temps(int *core_temp,
+                    int *pkg_temp);
+
+/// @brief Compute per-socket maximum, mean, and hottest core from a dense
+/// array of core temperatures produced by read_core_temps().
+///
+/// Entries equal to THERM_TEMP_INVALID are ignored.
+///
+/// @param [in] core_temp Array of num_cores() core temperatures.
+///
+/// @param [out] max Per-socket maximum temperature (may be NULL).
+///
+/// @param [out] mean Per-socket mean temperature (may be NULL).
+///
+/// @param [out] hotspot Per-socket index of the hottest core within the
+///        socket, or -1 if no readout was valid (may be NULL).
+void reduce_core_temps(const int *core_temp,
+                       int *max,
+                       double *mean,
+                       int *hotspot);
+
+/*************************/
+/* Thermal Event Watcher */
+/*************************/
+
+/// @brief Sticky log bits of IA32_THERM_STATUS and IA32_PACKAGE_THERM_STATUS
+/// (status, PROCHOT/FORCEPR, critical temperature, thresholds #1 and #2, and
+/// power notification logs).
+#define THERM_LOG_MASK 0xAAAUL
+
+/// @brief Maximum number of undrained events held by the watcher.
+#define THERM_EVENT_QUEUE_SIZE 1024
+
+/// @brief Structure describing a single sticky thermal log bit that was set
+/// between two samples.
+struct therm_event
+{
+    /// @brief Time the change was observed, in microseconds since the epoch.
+    uint64_t timestamp;
+    /// @brief Core index (or socket index if pkg is set).
+    uint16_t index;
+    /// @brief 1 if the event came from IA32_PACKAGE_THERM_STATUS, else 0.
+    uint8_t pkg;
+    /// @brief Bit position of the log bit that was set.
+    uint8_t bit;
+};
+
+/// @brief Sample IA32_THERM_STATUS on every core and IA32_PACKAGE_THERM_STATUS
+/// on every socket in a single batch, and queue an event for every log bit
+/// that was set since the previous sample.
+///
+/// The first call only records a baseline, so log bits already set at that
+/// point are not reported.
+///
+/// @return Number of new events queued, else -1 if the batch read failed.
+int therm_watch_poll(void);
+
+/// @brief Remove queued events in the order they were observed.
+///
+/// @param [out] events Array receiving up to max events.
+///
+/// @param [in] max Capacity of the events array.
+///
+/// @return Number of events copied.
+int therm_watch_drain(struct therm_event *events,
+                      int max);
+
+/// @brief Retrieve the number of events discarded because the queue was full.
+///
+/// @return Number of dropped events since initialization.
+uint64_t therm_watch_dropped(void);
+
+/// @brief Clear the log bits of every core and socket whose most recent sample
+/// had a log bit set, in a single batch write that only touches those
+/// registers.
+///
+/// @return 0 if successful or nothing was tripped, else -1 if the batch write
+/// failed.
+int therm_watch_clear(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -76,9 +76,31 @@ struct turbo_limit_data
     double max_8c;
 };
 
+/// @brief Structure holding the cached turbo ratio table of every socket.
+///
+/// The turbo ratio limit registers are read once, the table then holds the
+/// max turbo frequency for every possible active-core count.
+struct turbo_bin_table
+{
+    /// @brief Number of buckets per socket (i.e., cores per socket).
+    uint64_t nbuckets;
+    /// @brief Raw 64-bit value stored in MSR_TURBO_RATIO_LIMIT.
+    uint64_t **ratio_limit;
+    /// @brief Raw 64-bit value stored in MSR_TURBO_RATIO_LIMIT1 (platform
+    /// dependent).
+    uint64_t **ratio_limit1;
+    /// @brief Raw 64-bit value stored in MSR_TURBO_RATIO_LIMIT2 (platforms
+    /// with more than 16 cores per socket, e.g., Haswell-E and Broadwell-E).
+    uint64_t **ratio_limit2;
+    /// @brief Max turbo frequency (in MHz), indexed as
+    /// [socket * nbuckets + active_cores - 1].
+    double *max_mhz;
+};
+
 /// @brief Allocate array for storing raw register data from IA32_PERF_CTL.
 ///
-/// There are plans to use a struct to make the indirection less crazy.
+/// The array is loaded into a batch covering every logical processor so turbo
+/// can be toggled with one batch read and one batch write.
 ///
 /// @param [in] val Pointer to array of raw IA32_PERF_CTL data, length equal to
 ///        the total number of logical processors.
@@ -89,16 +111,22 @@ void turbo_storage(uint64_t ***val);
 /// Enable Intel Dynamic Acceleration (IDA) and Intel Turbo Boost Technology by
 /// setting bit 32 of IA32_PERF_CTL to 0. This bit is not shared across logical
 /// processors in a package, so it must be modified to the same value across
-/// all logical processors in the same package.
-void enable_turbo(void);
+/// all logical processors in the same package. All other bits keep their
+/// current value.
+///
+/// @return 0 if successful, else -1 if a batch operation failed.
+int enable_turbo(void);
 
 /// @brief Disable turbo by modifying IA32_PERF_CTL on each logical processor.
 ///
 /// Disable Intel Dynamic Acceleration (IDA) and Intel Turbo Boost Technology by
 /// setting bit 32 of IA32_PERF_CTL to 1. This bit is not shared across logical
 /// processors in a package, so it must be modified to the same value across
-/// all logical processors in the same package.
-void disable_turbo(void);
+/// all logical processors in the same package. All other bits keep their
+/// current value.
+///
+/// @return 0 if successful, else -1 if a batch operation failed.
+int disable_turbo(void);
 
 /// @brief Print turbo data for each logical processor.
 ///
@@ -156,6 +184,50 @@ int get_turbo_ratio_limit(const unsigned socket,
                           struct turbo_limit_data *info,
                           struct turbo_limit_data *info2);
 
+/// @brief Build (on first call) and return the cached turbo ratio table of
+/// every socket.
+///
+/// @param [out] tb Pointer to turbo bin table.
+///
+/// @return 0 if successful, else -1 if the turbo ratio limit registers are
+/// not supported or the batch read failed.
+int turbo_bin_storage(struct turbo_bin_table **tb);
+
+/// @brief Predict the max turbo frequency of a socket for a given number of
+/// active cores.
+///
+/// @param [in] socket Unique socket/package identifier.
+///
+/// @param [in] active_cores Number of cores in C0, values of 0 are treated as
+///        1 and values above cores per socket are clamped.
+///
+/// @return Expected max frequency in MHz, else -1.0 if the turbo ratio table
+/// is not available.
+double predict_turbo_freq(const unsigned socket,
+                          unsigned active_cores);
+
+/// @brief Count the active cores of a socket from per-core C0 residency.
+///
+/// C0 residency of a core over an interval is the IA32_MPERF delta divided by
+/// the IA32_TIME_STAMP_COUNTER delta.
+///
+/// @param [in] socket Unique socket/package identifier.
+///
+/// @param [in] c0 Array of num_cores() C0 residency fractions, indexed as
+///        [socket * cores_per_socket + core].
+///
+/// @param [in] threshold Minimum C0 fraction for a core to count as active.
+///
+/// @return Number of active cores on the socket.
+unsigned turbo_active_cores(const unsigned socket,
+                            const double *c0,
+                            double threshold);
+
+/// @brief Print the cached turbo ratio table of every socket.
+///
+/// @param [in] writedest File stream where output will be written to.
+void dump_turbo_bins(FILE *writedest);
+
 #ifdef __cplusplus
 }
 #endif
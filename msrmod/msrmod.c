@@ -36,6 +36,7 @@
 
 #include <msr_rapl.h>
 #include <msr_counters.h>
+#include <msr_latency.h>
 
 short ISVERBOSE;
 
@@ -255,6 +256,7 @@ int main(int argc, char **argv)
                         "      [-r msr_hex] [-w msr_hex] [-s set_type]\n"
                         "      [-c socket_id] [-t thread_id] [-d value_hex]\n"
                         "      [-a power1] [-b time1] [-e power2] [-f time2]\n"
+                        "      [-L]\n"
                         "\n"
                         "OVERVIEW\n"
                         "  MSRMOD is designed for quick access to common\n"
@@ -307,6 +309,10 @@ int main(int argc, char **argv)
                         "      Power limit 2 for RAPL package domain.\n"
                         "  -f time2_sec\n"
                         "      Time window 2 for RAPL package domain.\n"
+                        "  -L\n"
+                        "      Print call counts and latency histograms of\n"
+                        "      the MSR and CSR operations performed by this\n"
+                        "      run before exiting.\n"
                         "\n";
 
     if (argc == 1 || (argc > 1 && (
@@ -333,9 +339,10 @@ int main(int argc, char **argv)
     int power_lim2 = 0;
     int time_lim1 = 0;
     int time_lim2 = 0;
+    int islatency = 0;
     int opt;
 
-    while ((opt = getopt(argc, argv, "vip:l:r:w:s:c:t:d:a:b:e:f:")) != -1)
+    while ((opt = getopt(argc, argv, "vip:l:r:w:s:c:t:d:a:b:e:f:L")) != -1)
     {
         switch (opt)
         {
@@ -401,6 +408,10 @@ int main(int argc, char **argv)
                 /* Time (in seconds) for RAPL limit 2. */
                 time_lim2 = atof(optarg);
                 break;
+            case 'L':
+                /* Dump operation latencies at exit. */
+                islatency = 1;
+                break;
             default:
                 fprintf(stderr, "\nError: unknown parameter \"%c\"\n", optopt);
                 fprintf(stderr, usage, argv[0]);
@@ -446,5 +457,10 @@ int main(int argc, char **argv)
     {
         set_functions(set_msr_type, socket, power_lim1, time_lim1, power_lim2, time_lim2);
     }
+    if (islatency)
+    {
+        fprintf(stdout, "\n=== Operation Latency ===\n");
+        dump_lat_stats(stdout);
+    }
     return 0;
 }
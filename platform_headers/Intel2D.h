@@ -169,6 +169,17 @@
 #define MSR_C7_PMON_CTR2     0xDF8
 #define MSR_C7_PMON_CTR3     0xDF9
 
+// Per-box CBo MSRs are laid out at a fixed stride from the C0 registers.
+#define NUM_CBO_BOXES         8
+#define CBO_MSR_STRIDE        0x20
+#define CBO_CTR_WIDTH         44
+#define CBO_BOX_CTL_FRZ       0x10100
+#define CBO_LLC_LOOKUP_EVENT  0x34  // LLC_LOOKUP.ANY
+#define CBO_LLC_LOOKUP_UMASK  0x11
+#define CBO_LLC_MISS_EVENT    0x35  // TOR_INSERTS.MISS
+#define CBO_LLC_MISS_UMASK    0x0A
+#define CBO_FILTER_STATE_ALL  (0x1FUL << 18)
+
 /********/
 /* MISC */
 /********/
@@ -220,6 +231,10 @@
 #define IMC_CH1_FUNC     1
 #define IMC_CH2_FUNC     4
 #define IMC_CH3_FUNC     5
+// PCI device IDs of the iMC channels, matched by uncore discovery.
+#define IMC_PCI_DEVICE_IDS {0x3CB0, 0x3CB1, 0x3CB4, 0x3CB5}
+// Bus (relative to the socket) passed to csr_safe for iMC channels.
+#define IMC_CSR_BUS      1
 
 #define CSR_PMONCTRCFG0  0xD8
 #define CSR_PMONCTRCFG1  0xDC
@@ -289,3 +304,36 @@
 #define UMASK_PRE_RD  0x4
 #define UMASK_PRE_WR  0x8
 #define UMASK_PRE_BYP 0x16
+
+/***********/
+/* CSR QPI */
+/***********/
+// PCI device IDs of the QPI link layer PMON units, matched by uncore discovery.
+#define QPI_PCI_DEVICE_IDS {0x3C41, 0x3C42}
+// Fixed device/function layout used when discovery finds nothing.
+#define QPI_LINK_DEVS {8, 9}
+#define QPI_LINK_FUNC 2
+// Bus (relative to the socket) passed to csr_safe for QPI links.
+#define QPI_CSR_BUS   1
+
+#define QPI_PMONCTRCFG0  0xD8
+#define QPI_PMONCTRCFG1  0xDC
+#define QPI_PMONCTRCFG2  0xE0
+
+#define QPI_PMONCTR0     0xA0
+#define QPI_PMONCTR1     0xA8
+#define QPI_PMONCTR2     0xB0
+
+#define QPI_PMONUNITCTRL 0xF4
+
+#define QPI_EVT_CLOCKTICKS  0x14
+#define QPI_EVT_TXL_FLITS   0x00
+// Extended event select (bit 21) needed by QPI_EVT_TXL_FLITS.
+#define QPI_EVT_TXL_FLITS_EXT 1
+#define QPI_UMASK_FLITS_DATA     0x02
+#define QPI_UMASK_FLITS_NON_DATA 0x04
+
+// Payload bytes carried by one data flit.
+#define QPI_BYTES_PER_DATA_FLIT 8.0
+// Flits the link can transmit per QPI_EVT_CLOCKTICKS cycle.
+#define QPI_FLITS_PER_CLOCK     2.0
@@ -259,6 +259,17 @@
 #define MSR_C14_PMON_CTR3     0xED9
 #define MSR_C14_BOX_FILTER1   0xEDA
 
+// Per-box CBo MSRs are laid out at a fixed stride from the C0 registers.
+#define NUM_CBO_BOXES         15
+#define CBO_MSR_STRIDE        0x20
+#define CBO_CTR_WIDTH         44
+#define CBO_BOX_CTL_FRZ       0x10100
+#define CBO_LLC_LOOKUP_EVENT  0x34  // LLC_LOOKUP.ANY
+#define CBO_LLC_LOOKUP_UMASK  0x11
+#define CBO_LLC_MISS_EVENT    0x35  // TOR_INSERTS.MISS
+#define CBO_LLC_MISS_UMASK    0x0A
+#define CBO_FILTER_STATE_ALL  (0x3FUL << 17)
+
 /********/
 /* MISC */
 /********/
@@ -313,6 +324,10 @@
 #define IMC_CH1_FUNC     5
 #define IMC_CH2_FUNC     0
 #define IMC_CH3_FUNC     1
+// PCI device IDs of the iMC channels, matched by uncore discovery.
+#define IMC_PCI_DEVICE_IDS {0x0EB4, 0x0EB5, 0x0EB0, 0x0EB1, 0x0EF4, 0x0EF5, 0x0EF0, 0x0EF1}
+// Bus (relative to the socket) passed to csr_safe for iMC channels.
+#define IMC_CSR_BUS      1
 
 #define CSR_PMONCTRCFG0  0xD8
 #define CSR_PMONCTRCFG1  0xDC
@@ -400,3 +415,36 @@
 #define UMASK_PRE_RD           0x4
 #define UMASK_PRE_WR           0x8
 #define UMASK_PRE_BYP          0x16
+
+/***********/
+/* CSR QPI */
+/***********/
+// PCI device IDs of the QPI link layer PMON units, matched by uncore discovery.
+#define QPI_PCI_DEVICE_IDS {0x0E32, 0x0E33, 0x0E3A}
+// Fixed device/function layout used when discovery finds nothing.
+#define QPI_LINK_DEVS {8, 9, 10}
+#define QPI_LINK_FUNC 2
+// Bus (relative to the socket) passed to csr_safe for QPI links.
+#define QPI_CSR_BUS   1
+
+#define QPI_PMONCTRCFG0  0xD8
+#define QPI_PMONCTRCFG1  0xDC
+#define QPI_PMONCTRCFG2  0xE0
+
+#define QPI_PMONCTR0     0xA0
+#define QPI_PMONCTR1     0xA8
+#define QPI_PMONCTR2     0xB0
+
+#define QPI_PMONUNITCTRL 0xF4
+
+#define QPI_EVT_CLOCKTICKS  0x14
+#define QPI_EVT_TXL_FLITS   0x00
+// Extended event select (bit 21) needed by QPI_EVT_TXL_FLITS.
+#define QPI_EVT_TXL_FLITS_EXT 1
+#define QPI_UMASK_FLITS_DATA     0x02
+#define QPI_UMASK_FLITS_NON_DATA 0x04
+
+// Payload bytes carried by one data flit.
+#define QPI_BYTES_PER_DATA_FLIT 8.0
+// Flits the link can transmit per QPI_EVT_CLOCKTICKS cycle.
+#define QPI_FLITS_PER_CLOCK     2.0
@@ -40,6 +40,9 @@
 #define IA32_CLOCK_MODULATION   0x19A
 #define IA32_PERF_STATUS        0x198
 #define IA32_PERF_CTL           0x199
+#define MSR_UNCORE_RATIO_LIMIT  0x620
+#define MSR_UNCORE_PERF_STATUS  0x621
+#define HAS_UNCORE_FREQ         1
 
 /************/
 /* COUNTERS */
@@ -313,6 +316,17 @@
 #define MSR_C17_PMON_CTR2     0xF1A
 #define MSR_C17_PMON_CTR3     0xF1B
 
+// Per-box CBo MSRs are laid out at a fixed stride from the C0 registers.
+#define NUM_CBO_BOXES         18
+#define CBO_MSR_STRIDE        0x10
+#define CBO_CTR_WIDTH         48
+#define CBO_BOX_CTL_FRZ       0x100
+#define CBO_LLC_LOOKUP_EVENT  0x34  // LLC_LOOKUP.ANY
+#define CBO_LLC_LOOKUP_UMASK  0x11
+#define CBO_LLC_MISS_EVENT    0x35  // TOR_INSERTS.MISS
+#define CBO_LLC_MISS_UMASK    0x0A
+#define CBO_FILTER_STATE_ALL  (0x7FUL << 17)
+
 /********/
 /* MISC */
 /********/
@@ -325,6 +339,11 @@
 #define MSR_CORE_C6_RESIDENCY 0x3FD
 #define MSR_CORE_C7_RESIDENCY 0x3FE
 
+/**********************/
+/* PERF LIMIT REASONS */
+/**********************/
+#define MSR_CORE_PERF_LIMIT_REASONS 0x690
+
 /********/
 /* RAPL */
 /********/
@@ -357,6 +376,8 @@
 #define MSR_TURBO_ACTIVATION_RATIO 0x64C
 #define MSR_TURBO_RATIO_LIMIT      0x1AD
 #define MSR_TURBO_RATIO_LIMIT1     0x1AE
+#define MSR_TURBO_RATIO_LIMIT2     0x1AF
+// MSR_TURBO_RATIO_LIMIT2 holds the ratios for 17 and 18 active cores.
 
 /***********/
 /* CSR iMC */
@@ -369,6 +390,10 @@
 #define IMC_CH1_FUNC     1
 #define IMC_CH2_FUNC     0
 #define IMC_CH3_FUNC     1
+// PCI device IDs of the iMC channels, matched by uncore discovery.
+#define IMC_PCI_DEVICE_IDS {0x2FB4, 0x2FB5, 0x2FB0, 0x2FB1, 0x2FD4, 0x2FD5, 0x2FD0, 0x2FD1}
+// Bus (relative to the socket) passed to csr_safe for iMC channels.
+#define IMC_CSR_BUS      1
 
 #define CSR_PMONCTRCFG0  0xD8
 #define CSR_PMONCTRCFG1  0xDC
@@ -456,3 +481,36 @@
 #define UMASK_PRE_RD         0x4
 #define UMASK_PRE_WR         0x8
 #define UMASK_PRE_BYP        0x16
+
+/***********/
+/* CSR QPI */
+/***********/
+// PCI device IDs of the QPI link layer PMON units, matched by uncore discovery.
+#define QPI_PCI_DEVICE_IDS {0x2F32, 0x2F33, 0x2F3A}
+// Fixed device/function layout used when discovery finds nothing.
+#define QPI_LINK_DEVS {8, 9, 10}
+#define QPI_LINK_FUNC 2
+// Bus (relative to the socket) passed to csr_safe for QPI links.
+#define QPI_CSR_BUS   1
+
+#define QPI_PMONCTRCFG0  0xD8
+#define QPI_PMONCTRCFG1  0xDC
+#define QPI_PMONCTRCFG2  0xE0
+
+#define QPI_PMONCTR0     0xA0
+#define QPI_PMONCTR1     0xA8
+#define QPI_PMONCTR2     0xB0
+
+#define QPI_PMONUNITCTRL 0xF4
+
+#define QPI_EVT_CLOCKTICKS  0x14
+#define QPI_EVT_TXL_FLITS   0x00
+// Extended event select (bit 21) needed by QPI_EVT_TXL_FLITS.
+#define QPI_EVT_TXL_FLITS_EXT 1
+#define QPI_UMASK_FLITS_DATA     0x02
+#define QPI_UMASK_FLITS_NON_DATA 0x04
+
+// Payload bytes carried by one data flit.
+#define QPI_BYTES_PER_DATA_FLIT 8.0
+// Flits the link can transmit per QPI_EVT_CLOCKTICKS cycle.
+#define QPI_FLITS_PER_CLOCK     2.0
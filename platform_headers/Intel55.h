@@ -40,6 +40,15 @@
 #define IA32_CLOCK_MODULATION   0x19A
 #define IA32_PERF_STATUS        0x198
 #define IA32_PERF_CTL           0x199
+#define MSR_UNCORE_RATIO_LIMIT  0x620
+#define MSR_UNCORE_PERF_STATUS  0x621
+#define HAS_UNCORE_FREQ         1
+#define IA32_ENERGY_PERF_BIAS   0x1B0
+#define IA32_PM_ENABLE          0x770
+#define IA32_HWP_CAPABILITIES   0x771
+#define IA32_HWP_REQUEST_PKG    0x772
+#define IA32_HWP_REQUEST        0x774
+#define HAS_HWP                 1
 
 /************/
 /* COUNTERS */
@@ -313,6 +322,17 @@
 #define MSR_C17_PMON_CTR2     0xF1A
 #define MSR_C17_PMON_CTR3     0xF1B
 
+// Per-box CBo MSRs are laid out at a fixed stride from the C0 registers.
+#define NUM_CBO_BOXES         28  // Up to 28 CHAs on Skylake/Cascade Lake server
+#define CBO_MSR_STRIDE        0x10
+#define CBO_CTR_WIDTH         48
+#define CBO_BOX_CTL_FRZ       0x100
+#define CBO_LLC_LOOKUP_EVENT  0x34  // LLC_LOOKUP.ANY
+#define CBO_LLC_LOOKUP_UMASK  0x11
+#define CBO_LLC_MISS_EVENT    0x35  // TOR_INSERTS.MISS
+#define CBO_LLC_MISS_UMASK    0x21
+#define CBO_FILTER_STATE_ALL  (0x3FFUL << 17)
+
 /********/
 /* MISC */
 /********/
@@ -325,6 +345,11 @@
 #define MSR_CORE_C6_RESIDENCY 0x3FD
 #define MSR_CORE_C7_RESIDENCY 0x3FE
 
+/**********************/
+/* PERF LIMIT REASONS */
+/**********************/
+#define MSR_CORE_PERF_LIMIT_REASONS 0x64F
+
 /********/
 /* RAPL */
 /********/
@@ -357,6 +382,8 @@
 #define MSR_TURBO_ACTIVATION_RATIO 0x64C
 #define MSR_TURBO_RATIO_LIMIT      0x1AD
 #define MSR_TURBO_RATIO_LIMIT1     0x1AE
+// MSR_TURBO_RATIO_LIMIT1 holds the active-core count of each ratio group.
+#define HAS_TURBO_RATIO_GROUPS     1
 
 /***********/
 /* CSR iMC */
@@ -369,6 +396,10 @@
 #define IMC_CH1_FUNC     1
 #define IMC_CH2_FUNC     0
 #define IMC_CH3_FUNC     1
+// PCI device IDs of the iMC channels, matched by uncore discovery.
+#define IMC_PCI_DEVICE_IDS {0x2042, 0x2046, 0x204A}
+// Bus (relative to the socket) passed to csr_safe for iMC channels.
+#define IMC_CSR_BUS      2
 
 #define CSR_PMONCTRCFG0  0xD8
 #define CSR_PMONCTRCFG1  0xDC
@@ -456,3 +487,37 @@
 #define UMASK_PRE_RD         0x4
 #define UMASK_PRE_WR         0x8
 #define UMASK_PRE_BYP        0x16
+
+/***********/
+/* CSR UPI */
+/***********/
+// UPI links keep the QPI_ names so csr_qpi.c builds on every platform.
+// PCI device IDs of the UPI link layer PMON units, matched by uncore discovery.
+#define QPI_PCI_DEVICE_IDS {0x2058}
+// Fixed device/function layout used when discovery finds nothing.
+#define QPI_LINK_DEVS {14, 15, 16}
+#define QPI_LINK_FUNC 0
+// Bus (relative to the socket) passed to csr_safe for QPI links.
+#define QPI_CSR_BUS   3
+
+#define QPI_PMONCTRCFG0  0x350
+#define QPI_PMONCTRCFG1  0x358
+#define QPI_PMONCTRCFG2  0x360
+
+#define QPI_PMONCTR0     0x318
+#define QPI_PMONCTR1     0x320
+#define QPI_PMONCTR2     0x328
+
+#define QPI_PMONUNITCTRL 0x378
+
+#define QPI_EVT_CLOCKTICKS  0x01
+#define QPI_EVT_TXL_FLITS   0x02
+// Extended event select (bit 21) needed by QPI_EVT_TXL_FLITS.
+#define QPI_EVT_TXL_FLITS_EXT 0
+#define QPI_UMASK_FLITS_DATA     0x0F
+#define QPI_UMASK_FLITS_NON_DATA 0x97
+
+// Payload bytes carried by one data flit.
+#define QPI_BYTES_PER_DATA_FLIT (64.0 / 9.0)
+// Flits the link can transmit per QPI_EVT_CLOCKTICKS cycle.
+#define QPI_FLITS_PER_CLOCK     3.0
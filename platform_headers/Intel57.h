@@ -292,6 +292,12 @@
 #define MSR_C17_PMON_CTR2     0xED6
 #define MSR_C17_PMON_CTR3     0xED7
 
+// Per-box CBo MSRs are laid out at a fixed stride from the C0 registers.
+#define NUM_CBO_BOXES         38  // One CHA per tile, up to 38 on Knights Landing
+#define CBO_MSR_STRIDE        0x0C
+#define CBO_CTR_WIDTH         48
+#define CBO_BOX_CTL_FRZ       0x100
+
 /********/
 /* RAPL */
 /********/
@@ -28,8 +28,10 @@
  * Temple Place, Suite 330, Boston, MA 02111-1307 USA.
  */
 
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
@@ -42,16 +44,125 @@
 #include "cpuid.h"
 #include "libmsr_debug.h"
 #include "libmsr_error.h"
+#include "msr_latency.h"
+
+/// @brief Enum encompassing the ways uncore registers can be accessed.
+enum csr_backend_e
+{
+    /// @brief Batched ioctl through the csr_safe module.
+    CSR_BACKEND_CSRSAFE,
+    /// @brief pread/pwrite on /sys/bus/pci/devices/<BDF>/config.
+    CSR_BACKEND_SYSFS,
+};
+
+/// @brief Structure mapping a csr_safe socket-relative bus to a PCI bus.
+struct csr_bus_map
+{
+    /// @brief Socket identifier used in batch operations.
+    uint8_t socket;
+    /// @brief Socket-relative bus used in batch operations.
+    uint8_t relbus;
+    /// @brief PCI domain of the bus.
+    uint16_t domain;
+    /// @brief PCI bus number.
+    uint8_t bus;
+};
+
+/// @brief Structure holding an open PCI config space file.
+struct csr_sysfs_dev
+{
+    /// @brief PCI domain of the device.
+    uint16_t domain;
+    /// @brief PCI bus of the device.
+    uint8_t bus;
+    /// @brief PCI device number.
+    uint8_t device;
+    /// @brief PCI function number.
+    uint8_t function;
+    /// @brief File descriptor of the config file, -1 if it could not be
+    /// opened.
+    int fd;
+};
+
+/// @brief Structure holding one grouped pread covering a range of a device's
+/// config space.
+struct csr_sysfs_group
+{
+    /// @brief File descriptor of the config file.
+    int fd;
+    /// @brief First byte covered by the group.
+    uint16_t lo;
+    /// @brief One past the last byte covered by the group.
+    uint16_t hi;
+    /// @brief Offset of the group's range in the plan's read buffer.
+    unsigned base;
+};
+
+/// @brief Structure holding the grouped pread plan of a batch.
+struct csr_sysfs_plan
+{
+    /// @brief Number of operations the plan was built for.
+    uint32_t numops;
+    /// @brief Number of groups.
+    unsigned ngroups;
+    /// @brief Grouped preads, one per device read by the batch.
+    struct csr_sysfs_group *groups;
+    /// @brief Group of each read operation, -1 for writes and unusable
+    /// operations.
+    int *opgroup;
+    /// @brief File descriptor of each operation, -1 if the device is
+    /// unavailable, -2 if the register lies outside config space.
+    int *opfd;
+    /// @brief Buffer the groups are read into.
+    uint8_t *buf;
+};
 
 /// @brief Retrieve file descriptor for uncore register.
 ///
 /// @return Unique file descriptor, else NULL.
 static int *csr_fd(void)
 {
-    static int csrsafe = 0;
+    static int csrsafe = -1;
     return &csrsafe;
 }
 
+/// @brief Retrieve the uncore register access backend in use.
+///
+/// @return Pointer to csr_backend_e value.
+static int *csr_backend(void)
+{
+    static int backend = CSR_BACKEND_CSRSAFE;
+    return &backend;
+}
+
+/// @brief Retrieve the socket-relative to PCI bus mappings.
+///
+/// @param [out] nmaps Number of mappings.
+///
+/// @return Pointer to mapping array, grown as needed by csr_register_bus().
+static struct csr_bus_map **csr_bus_maps(unsigned **nmaps)
+{
+    static struct csr_bus_map *maps = NULL;
+    static unsigned count = 0;
+
+    *nmaps = &count;
+    return &maps;
+}
+
+/// @brief Retrieve the PCI config space files opened by the sysfs backend.
+///
+/// @param [out] ndevs Number of opened devices.
+///
+/// @return Pointer to device array.
+static struct csr_sysfs_dev **csr_sysfs_devs(unsigned **ndevs)
+{
+    static struct csr_sysfs_dev *devs = NULL;
+    static unsigned count = 0;
+
+    *ndevs = &count;
+    return &devs;
+}
+
 int init_csr(void)
 {
     int *fileDescriptor = csr_fd();
@@ -67,11 +178,17 @@ int init_csr(void)
         {
             fprintf(stderr, "Warning: <libmsr> Could not stat %s: init_csr(): %s: %s:%s::%d\n", CSR_MODULE, strerror(errno), getenv("HOSTNAME"), __FILE__, __LINE__);
         }
-        if (!(statbuf.st_mode & S_IRUSR) || !(statbuf.st_mode & S_IWUSR))
+        else if (!(statbuf.st_mode & S_IRUSR) || !(statbuf.st_mode & S_IWUSR))
         {
             fprintf(stderr, "Warning: <libmsr> Incorrect permissions on csr_safe: init_csr(): %s:%s::%d\n", getenv("HOSTNAME"), __FILE__, __LINE__);
         }
         *fileDescriptor = open(filename, O_RDWR);
+        if (*fileDescriptor < 0)
+        {
+            fprintf(stderr, "Warning: <libmsr> Using PCI config space in sysfs instead of csr_safe: init_csr(): %s:%s::%d\n", getenv("HOSTNAME"), __FILE__, __LINE__);
+            *fileDescriptor = -1;
+            *csr_backend() = CSR_BACKEND_SYSFS;
+        }
     }
     else
     {
@@ -84,9 +201,24 @@ int init_csr(void)
 int finalize_csr(void)
 {
     int *fileDescriptor = csr_fd();
+    struct csr_sysfs_dev **devs;
+    unsigned *ndevs;
+    unsigned i;
     int err = 0;
 
-    if (fileDescriptor)
+    if (*csr_backend() == CSR_BACKEND_SYSFS)
+    {
+        devs = csr_sysfs_devs(&ndevs);
+        for (i = 0; i < *ndevs; i++)
+        {
+            if ((*devs)[i].fd >= 0)
+            {
+                err |= close((*devs)[i].fd);
+            }
+        }
+        *ndevs = 0;
+    }
+    else if (*fileDescriptor >= 0)
     {
         err = close(*fileDescriptor);
     }
@@ -97,11 +229,289 @@ int finalize_csr(void)
     }
     else
     {
-        *fileDescriptor = 0;
+        *fileDescriptor = -1;
+    }
+    return 0;
+}
+
+int csr_register_bus(uint8_t socket, uint8_t relbus, uint16_t domain, uint8_t bus)
+{
+    struct csr_bus_map **maps;
+    unsigned *nmaps;
+    unsigned i;
+
+    maps = csr_bus_maps(&nmaps);
+    for (i = 0; i < *nmaps; i++)
+    {
+        if ((*maps)[i].socket == socket && (*maps)[i].relbus == relbus)
+        {
+            if ((*maps)[i].domain != domain || (*maps)[i].bus != bus)
+            {
+                libmsr_error_handler("csr_register_bus(): Conflicting PCI bus for socket", LIBMSR_ERROR_CSR_INIT, getenv("HOSTNAME"), __FILE__, __LINE__);
+                return -1;
+            }
+            return 0;
+        }
+    }
+    if (*nmaps == 0)
+    {
+        *maps = (struct csr_bus_map *) libmsr_calloc(1, sizeof(struct csr_bus_map));
+    }
+    else
+    {
+        *maps = (struct csr_bus_map *) libmsr_realloc(*maps, (*nmaps + 1) * sizeof(struct csr_bus_map));
     }
+    (*maps)[*nmaps].socket = socket;
+    (*maps)[*nmaps].relbus = relbus;
+    (*maps)[*nmaps].domain = domain;
+    (*maps)[*nmaps].bus = bus;
+    (*nmaps)++;
     return 0;
 }
 
+/// @brief Get the config space file of the device targeted by a batch
+/// operation, opening it on first use.
+///
+/// @param [in] op Batch operation.
+///
+/// @return File descriptor, else -1 if the bus is not mapped or the file
+/// could not be opened.
+static int csr_sysfs_fd(const struct csr_batch_op *op)
+{
+    const char *root = getenv("LIBMSR_PCI_SYSFS");
+    char path[PATH_MAX];
+    struct csr_bus_map **maps;
+    struct csr_sysfs_dev **devs;
+    unsigned *nmaps, *ndevs;
+    unsigned i;
+    uint16_t domain = 0;
+    uint8_t bus = 0;
+
+    maps = csr_bus_maps(&nmaps);
+    for (i = 0; i < *nmaps; i++)
+    {
+        if ((*maps)[i].socket == op->socket && (*maps)[i].relbus == op->bus)
+        {
+            domain = (*maps)[i].domain;
+            bus = (*maps)[i].bus;
+            break;
+        }
+    }
+    if (i == *nmaps)
+    {
+        return -1;
+    }
+    devs = csr_sysfs_devs(&ndevs);
+    for (i = 0; i < *ndevs; i++)
+    {
+        if ((*devs)[i].domain == domain && (*devs)[i].bus == bus && (*devs)[i].device == op->device && (*devs)[i].function == op->function)
+        {
+            return (*devs)[i].fd;
+        }
+    }
+    if (*ndevs == 0)
+    {
+        *devs = (struct csr_sysfs_dev *) libmsr_calloc(1, sizeof(struct csr_sysfs_dev));
+    }
+    else
+    {
+        *devs = (struct csr_sysfs_dev *) libmsr_realloc(*devs, (*ndevs + 1) * sizeof(struct csr_sysfs_dev));
+    }
+    snprintf(path, PATH_MAX, "%s/%04x:%02x:%02x.%x/config", (root ? root : CSR_PCI_SYSFS), domain, bus, op->device, op->function);
+    (*devs)[*ndevs].domain = domain;
+    (*devs)[*ndevs].bus = bus;
+    (*devs)[*ndevs].device = op->device;
+    (*devs)[*ndevs].function = op->function;
+    (*devs)[*ndevs].fd = open(path, O_RDWR);
+    if ((*devs)[*ndevs].fd < 0)
+    {
+        fprintf(stderr, "Warning: <libmsr> Could not open %s: %s: %s:%s::%d\n", path, strerror(errno), getenv("HOSTNAME"), __FILE__, __LINE__);
+    }
+    return (*devs)[(*ndevs)++].fd;
+}
+
+/// @brief Build (or reuse) the grouped pread plan of a batch.
+///
+/// Every device read by the batch gets one group covering all of its read
+/// registers, so a read batch costs one pread per device. Writes are not
+/// grouped. Registers that do not fit in config space are rejected here.
+///
+/// @param [in] batchnum csr_data_type_e data type of batch operation.
+///
+/// @param [in] batch Batch operations.
+///
+/// @return Pointer to the plan of this batch.
+static struct csr_sysfs_plan *csr_sysfs_plan(const int batchnum, struct csr_batch_array *batch)
+{
+    static struct csr_sysfs_plan *plans = NULL;
+    static int nplans = 0;
+    struct csr_sysfs_plan *plan;
+    struct csr_batch_op *op;
+    unsigned i, g;
+    unsigned total = 0;
+    int fd;
+
+    if (batchnum >= nplans)
+    {
+        if (plans == NULL)
+        {
+            plans = (struct csr_sysfs_plan *) libmsr_calloc(batchnum + 1, sizeof(struct csr_sysfs_plan));
+        }
+        else
+        {
+            plans = (struct csr_sysfs_plan *) libmsr_realloc(plans, (batchnum + 1) * sizeof(struct csr_sysfs_plan));
+            memset(&plans[nplans], 0, (batchnum + 1 - nplans) * sizeof(struct csr_sysfs_plan));
+        }
+        nplans = batchnum + 1;
+    }
+    plan = &plans[batchnum];
+    if (plan->opgroup != NULL && plan->numops == batch->numops)
+    {
+        return plan;
+    }
+    if (plan->opgroup != NULL)
+    {
+        libmsr_free(plan->opgroup);
+        libmsr_free(plan->opfd);
+        libmsr_free(plan->groups);
+        if (plan->buf != NULL)
+        {
+            libmsr_free(plan->buf);
+        }
+    }
+    plan->numops = batch->numops;
+    plan->ngroups = 0;
+    plan->buf = NULL;
+    plan->opgroup = (int *) libmsr_calloc(batch->numops, sizeof(int));
+    plan->opfd = (int *) libmsr_calloc(batch->numops, sizeof(int));
+    plan->groups = (struct csr_sysfs_group *) libmsr_calloc(batch->numops, sizeof(struct csr_sysfs_group));
+    for (i = 0; i < batch->numops; i++)
+    {
+        op = &batch->ops[i];
+        plan->opgroup[i] = -1;
+        if (op->size == 0 || op->size > sizeof(uint64_t) || op->offset + op->size > CSR_CONFIG_SPACE_SIZE)
+        {
+            plan->opfd[i] = -2;
+            continue;
+        }
+        fd = csr_sysfs_fd(op);
+        plan->opfd[i] = fd;
+        if (fd < 0 || !op->isread)
+        {
+            continue;
+        }
+        for (g = 0; g < plan->ngroups; g++)
+        {
+            if (plan->groups[g].fd == fd)
+            {
+                break;
+            }
+        }
+        if (g == plan->ngroups)
+        {
+            plan->groups[g].fd = fd;
+            plan->groups[g].lo = op->offset;
+            plan->groups[g].hi = op->offset + op->size;
+            plan->ngroups++;
+        }
+        if (op->offset < plan->groups[g].lo)
+        {
+            plan->groups[g].lo = op->offset;
+        }
+        if (op->offset + op->size > plan->groups[g].hi)
+        {
+            plan->groups[g].hi = op->offset + op->size;
+        }
+        plan->opgroup[i] = g;
+    }
+    for (g = 0; g < plan->ngroups; g++)
+    {
+        plan->groups[g].base = total;
+        total += plan->groups[g].hi - plan->groups[g].lo;
+    }
+    if (total)
+    {
+        plan->buf = (uint8_t *) libmsr_calloc(total, sizeof(uint8_t));
+    }
+    return plan;
+}
+
+/// @brief Execute a batch through PCI config space files in sysfs.
+///
+/// Reads are grouped into one pread per device, writes are issued one
+/// pwrite per operation of op->size bytes.
+///
+/// @param [in] batchnum csr_data_type_e data type of batch operation.
+///
+/// @param [in] batch Batch operations.
+///
+/// @return 0 if successful, else -1 if any operation failed.
+static int do_csr_sysfs_batch_op(const int batchnum, struct csr_batch_array *batch)
+{
+    struct csr_sysfs_plan *plan = csr_sysfs_plan(batchnum, batch);
+    struct csr_sysfs_group *grp;
+    struct csr_batch_op *op;
+    uint64_t val;
+    unsigned i, g;
+    ssize_t got;
+    int ret = 0;
+
+    for (i = 0; i < batch->numops; i++)
+    {
+        batch->ops[i].err = 0;
+    }
+    for (g = 0; g < plan->ngroups; g++)
+    {
+        grp = &plan->groups[g];
+        got = pread(grp->fd, &plan->buf[grp->base], grp->hi - grp->lo, grp->lo);
+        if (got == grp->hi - grp->lo)
+        {
+            continue;
+        }
+        /* Fail this call's reads of the group, the plan stays intact. */
+        for (i = 0; i < batch->numops; i++)
+        {
+            if (plan->opgroup[i] == (int) g)
+            {
+                batch->ops[i].err = -EIO;
+            }
+        }
+    }
+    for (i = 0; i < batch->numops; i++)
+    {
+        op = &batch->ops[i];
+        if (plan->opfd[i] < 0)
+        {
+            op->err = (plan->opfd[i] == -2) ? -EINVAL : -ENODEV;
+            ret = -1;
+            continue;
+        }
+        if (op->isread)
+        {
+            if (op->err)
+            {
+                ret = -1;
+                continue;
+            }
+            grp = &plan->groups[plan->opgroup[i]];
+            val = 0;
+            /* Config space is little endian, like the host. */
+            memcpy(&val, &plan->buf[grp->base + op->offset - grp->lo], op->size);
+            op->csrdata = val;
+        }
+        else if (pwrite(plan->opfd[i], &op->csrdata, op->size, op->offset) != op->size)
+        {
+            op->err = -errno;
+            ret = -1;
+        }
+    }
+    if (ret)
+    {
+        libmsr_error_handler("do_csr_sysfs_batch_op(): PCI config space access failed", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+    }
+    return ret;
+}
+
 // CSRs have their own batch functions so that they can be used independently
 // of the rest of libmsr
 int csr_batch_storage(struct csr_batch_array **batchsel, const int batchnum, unsigned **opssize)
@@ -237,14 +647,12 @@ int create_csr_batch_op(off_t csr, uint8_t bus, uint8_t device, uint8_t function
 
 int do_csr_batch_op(const int batchnum)
 {
-    static int batchfd = 0;
     struct csr_batch_array *batch = NULL;
+    uint64_t start;
+    unsigned nerr = 0;
+    unsigned j;
     int res;
 
-    if (!batchfd)
-    {
-        batchfd = *csr_fd();
-    }
     if (csr_batch_storage(&batch, batchnum, NULL))
     {
         return -1;
@@ -258,7 +666,20 @@ int do_csr_batch_op(const int batchnum)
         return -1;
     }
 
-    res = ioctl(batchfd, CSRSAFE_8086_BATCH, batch);
+    start = lat_now();
+    if (*csr_backend() == CSR_BACKEND_SYSFS)
+    {
+        res = do_csr_sysfs_batch_op(batchnum, batch);
+        for (j = 0; j < batch->numops; j++)
+        {
+            nerr += (batch->ops[j].err != 0);
+        }
+        lat_record(LAT_CSR_BATCH, batchnum, start, batch->numops, nerr);
+        return res;
+    }
+
+    res = ioctl(*csr_fd(), CSRSAFE_8086_BATCH, batch);
+    lat_record(LAT_CSR_BATCH, batchnum, start, batch->numops, (res < 0));
     if (res < 0)
     {
         libmsr_error_handler("do_csr_batch_op(): IOctl failed, does /dev/cpu/csr_batch exist?", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
@@ -281,3 +702,203 @@ int do_csr_batch_op(const int batchnum)
     /// @todo Debug stuff here.
     return 0;
 }
+
+/// @brief Read a hexadecimal value from a sysfs attribute file.
+///
+/// @param [in] path Path of the attribute file.
+///
+/// @param [out] val Value read from the file.
+///
+/// @return 0 if successful, else -1 if the file could not be read.
+static int read_sysfs_hex(const char *path, unsigned *val)
+{
+    FILE *fp;
+    int rc;
+
+    fp = fopen(path, "r");
+    if (fp == NULL)
+    {
+        return -1;
+    }
+    rc = fscanf(fp, "%x", val);
+    fclose(fp);
+    return (rc == 1) ? 0 : -1;
+}
+
+/// @brief Order PCI devices by domain, bus, device and function.
+static int compare_pci_dev(const void *a, const void *b)
+{
+    const struct csr_pci_dev *x = (const struct csr_pci_dev *) a;
+    const struct csr_pci_dev *y = (const struct csr_pci_dev *) b;
+
+    if (x->domain != y->domain)
+    {
+        return x->domain - y->domain;
+    }
+    if (x->bus != y->bus)
+    {
+        return x->bus - y->bus;
+    }
+    if (x->device != y->device)
+    {
+        return x->device - y->device;
+    }
+    return x->function - y->function;
+}
+
+int csr_pci_discover(const uint16_t *devids, const unsigned nids, struct csr_pci_dev **devs)
+{
+    const char *root = getenv("LIBMSR_PCI_SYSFS");
+    char path[PATH_MAX];
+    struct dirent *entry;
+    DIR *dir;
+    unsigned domain, bus, device, function, vendor, devid;
+    unsigned i;
+    int count = 0;
+    int cap = 0;
+    int socket = -1;
+
+    *devs = NULL;
+    if (root == NULL)
+    {
+        root = CSR_PCI_SYSFS;
+    }
+    dir = opendir(root);
+    if (dir == NULL)
+    {
+        libmsr_error_handler("csr_pci_discover(): Unable to open PCI sysfs directory", LIBMSR_ERROR_CSR_INIT, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    while ((entry = readdir(dir)) != NULL)
+    {
+        if (sscanf(entry->d_name, "%x:%x:%x.%x", &domain, &bus, &device, &function) != 4)
+        {
+            continue;
+        }
+        snprintf(path, PATH_MAX, "%s/%s/vendor", root, entry->d_name);
+        if (read_sysfs_hex(path, &vendor) || vendor != 0x8086)
+        {
+            continue;
+        }
+        snprintf(path, PATH_MAX, "%s/%s/device", root, entry->d_name);
+        if (read_sysfs_hex(path, &devid))
+        {
+            continue;
+        }
+        for (i = 0; i < nids; i++)
+        {
+            if (devids[i] == devid)
+            {
+                break;
+            }
+        }
+        if (i == nids)
+        {
+            continue;
+        }
+        if (cap == 0)
+        {
+            cap = 16;
+            *devs = (struct csr_pci_dev *) libmsr_calloc(cap, sizeof(struct csr_pci_dev));
+        }
+        else if (count == cap)
+        {
+            cap *= 2;
+            *devs = (struct csr_pci_dev *) libmsr_realloc(*devs, cap * sizeof(struct csr_pci_dev));
+        }
+        (*devs)[count].domain = domain;
+        (*devs)[count].bus = bus;
+        (*devs)[count].device = device;
+        (*devs)[count].function = function;
+        (*devs)[count].devid = devid;
+        count++;
+    }
+    closedir(dir);
+    if (count == 0)
+    {
+        return 0;
+    }
+    qsort(*devs, count, sizeof(struct csr_pci_dev), compare_pci_dev);
+    for (i = 0; i < (unsigned) count; i++)
+    {
+        if (i == 0 || (*devs)[i].domain != (*devs)[i - 1].domain || (*devs)[i].bus != (*devs)[i - 1].bus)
+        {
+            socket++;
+        }
+        (*devs)[i].socket = socket;
+    }
+#ifdef CSRDEBUG
+    fprintf(stderr, "CSRPCI: found %d devices on %d sockets\n", count, socket + 1);
+#endif
+    return count;
+}
+
+int csr_unit_table(const uint16_t *devids, const unsigned nids, const struct csr_pci_dev *fixed, const unsigned nfixed, const uint8_t relbus, const uint64_t maxsockets, uint64_t *nsockets, uint64_t *nunits, struct csr_pci_dev **units)
+{
+    struct csr_pci_dev *devs = NULL;
+    uint64_t *per_socket;
+    uint64_t s, i, k;
+    int ndevs;
+
+    *nunits = 0;
+    ndevs = csr_pci_discover(devids, nids, &devs);
+    if (ndevs > 0)
+    {
+        *nsockets = devs[ndevs - 1].socket + 1;
+        if (*nsockets > maxsockets)
+        {
+            *nsockets = maxsockets;
+        }
+        per_socket = (uint64_t *) libmsr_calloc(*nsockets, sizeof(uint64_t));
+        for (i = 0; i < (uint64_t) ndevs; i++)
+        {
+            if (devs[i].socket < *nsockets)
+            {
+                per_socket[devs[i].socket]++;
+            }
+        }
+        /* Keep the [socket * nunits + unit] layout dense. */
+        *nunits = per_socket[0];
+        for (s = 1; s < *nsockets; s++)
+        {
+            if (per_socket[s] < *nunits)
+            {
+                *nunits = per_socket[s];
+            }
+        }
+        if (*nunits)
+        {
+            *units = (struct csr_pci_dev *) libmsr_calloc(*nsockets * *nunits, sizeof(struct csr_pci_dev));
+            memset(per_socket, 0, *nsockets * sizeof(uint64_t));
+            for (i = 0; i < (uint64_t) ndevs; i++)
+            {
+                s = devs[i].socket;
+                if (s < *nsockets && per_socket[s] < *nunits)
+                {
+                    (*units)[s * *nunits + per_socket[s]++] = devs[i];
+                    csr_register_bus(s, relbus, devs[i].domain, devs[i].bus);
+                }
+            }
+        }
+        libmsr_free(per_socket);
+        libmsr_free(devs);
+    }
+    if (*nunits)
+    {
+        return 1;
+    }
+    /* No sysfs, no matching devices or a socket without any. */
+    *nsockets = maxsockets;
+    *nunits = nfixed;
+    *units = (struct csr_pci_dev *) libmsr_calloc(*nsockets * *nunits, sizeof(struct csr_pci_dev));
+    for (s = 0; s < *nsockets; s++)
+    {
+        for (k = 0; k < *nunits; k++)
+        {
+            (*units)[s * *nunits + k] = fixed[k];
+            (*units)[s * *nunits + k].bus = relbus;
+            (*units)[s * *nunits + k].socket = s;
+        }
+    }
+    return 0;
+}
@@ -34,6 +34,7 @@
 #include <string.h>
 #include <sys/ioctl.h>
 #include <sys/stat.h>
+#include <sys/time.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -45,8 +46,48 @@
 #include "libmsr_debug.h"
 #include "libmsr_error.h"
 
+struct imc_channel_table *imc_channel_storage(void)
+{
+    static struct imc_channel_table t;
+    static int init = 0;
+
+    if (!init)
+    {
+        const uint16_t ids[] = IMC_PCI_DEVICE_IDS;
+        const uint8_t funcnums[4] = {IMC_CH0_FUNC, IMC_CH1_FUNC, IMC_CH2_FUNC, IMC_CH3_FUNC};
+        const uint8_t devnums[2] = {IMC0_DEV, IMC1_DEV};
+        struct csr_pci_dev fixed[NUMCTRS];
+        int k;
+
+        memset(fixed, 0, sizeof(fixed));
+        for (k = 0; k < NUMCTRS; k++)
+        {
+            fixed[k].device = devnums[k / 4];
+            fixed[k].function = funcnums[k % 4];
+        }
+        csr_unit_table(ids, sizeof(ids) / sizeof(ids[0]), fixed, NUMCTRS, IMC_CSR_BUS, num_sockets(), &t.nsockets, &t.nchannels, &t.chan);
+#ifdef CSRDEBUG
+        fprintf(stderr, "CSRDEBUG: %lu iMC channels on each of %lu sockets\n", t.nchannels, t.nsockets);
+#endif
+        init = 1;
+    }
+    return &t;
+}
+
+/// @brief Get the total number of iMC channels across all sockets.
+///
+/// @return Number of entries in the iMC channel table.
+static int imc_num_channels(void)
+{
+    struct imc_channel_table *imct = imc_channel_storage();
+
+    return (int)(imct->nsockets * imct->nchannels);
+}
+
 /// @brief Load batch operations for the integrated memory controller (iMC).
 ///
+/// One operation is created for every channel in the iMC channel table.
+///
 /// @param [in] offt Address of uncore register to load.
 ///
 /// @param [in] loc Pointer to csr batch storage array.
@@ -60,31 +101,14 @@
 /// @return Number of csr batch operations created.
 static int load_imc_batch_for_each(const size_t offt, uint64_t **loc, const int isread, const size_t size, const unsigned batchno)
 {
+    struct imc_channel_table *imct = imc_channel_storage();
     int idx = 0;
 
     if (loc)
     {
-        create_csr_batch_op(offt, 1, IMC0_DEV, IMC_CH0_FUNC, 0, isread, size, &loc[idx], batchno);
-        create_csr_batch_op(offt, 1, IMC0_DEV, IMC_CH1_FUNC, 0, isread, size, &loc[++idx], batchno);
-        create_csr_batch_op(offt, 1, IMC0_DEV, IMC_CH2_FUNC, 0, isread, size, &loc[++idx], batchno);
-        create_csr_batch_op(offt, 1, IMC0_DEV, IMC_CH3_FUNC, 0, isread, size, &loc[++idx], batchno);
-
-        create_csr_batch_op(offt, 1, IMC1_DEV, IMC_CH0_FUNC, 0, isread, size, &loc[++idx], batchno);
-        create_csr_batch_op(offt, 1, IMC1_DEV, IMC_CH1_FUNC, 0, isread, size, &loc[++idx], batchno);
-        create_csr_batch_op(offt, 1, IMC1_DEV, IMC_CH2_FUNC, 0, isread, size, &loc[++idx], batchno);
-        create_csr_batch_op(offt, 1, IMC1_DEV, IMC_CH3_FUNC, 0, isread, size, &loc[++idx], batchno);
-
-        if (num_sockets() > 1)
+        for (idx = 0; idx < imc_num_channels(); idx++)
         {
-            create_csr_batch_op(offt, 1, IMC0_DEV, IMC_CH0_FUNC, 1, isread, size, &loc[++idx], batchno);
-            create_csr_batch_op(offt, 1, IMC0_DEV, IMC_CH1_FUNC, 1, isread, size, &loc[++idx], batchno);
-            create_csr_batch_op(offt, 1, IMC0_DEV, IMC_CH2_FUNC, 1, isread, size, &loc[++idx], batchno);
-            create_csr_batch_op(offt, 1, IMC0_DEV, IMC_CH3_FUNC, 1, isread, size, &loc[++idx], batchno);
-
-            create_csr_batch_op(offt, 1, IMC1_DEV, IMC_CH0_FUNC, 1, isread, size, &loc[++idx], batchno);
-            create_csr_batch_op(offt, 1, IMC1_DEV, IMC_CH1_FUNC, 1, isread, size, &loc[++idx], batchno);
-            create_csr_batch_op(offt, 1, IMC1_DEV, IMC_CH2_FUNC, 1, isread, size, &loc[++idx], batchno);
-            create_csr_batch_op(offt, 1, IMC1_DEV, IMC_CH3_FUNC, 1, isread, size, &loc[++idx], batchno);
+            create_csr_batch_op(offt, IMC_CSR_BUS, imct->chan[idx].device, imct->chan[idx].function, imct->chan[idx].socket, isread, size, &loc[idx], batchno);
         }
     }
     else
@@ -101,7 +125,7 @@ struct pmonctrs_data *pmon_ctr_storage(void)
 
     if (!init)
     {
-        int allocated = NUMCTRS * num_sockets();
+        int allocated = imc_num_channels();
         pcd.ctr0 = (uint64_t **) libmsr_calloc(allocated, sizeof(uint64_t *));
         pcd.ctr1 = (uint64_t **) libmsr_calloc(allocated, sizeof(uint64_t *));
         pcd.ctr2 = (uint64_t **) libmsr_calloc(allocated, sizeof(uint64_t *));
@@ -125,7 +149,7 @@ struct pmonctr_global *pmonctr_global_storage(void)
 
     if (!init)
     {
-        int allocated = NUMCTRS * num_sockets();
+        int allocated = imc_num_channels();
         pgd.unitctrl = (uint64_t **) libmsr_calloc(allocated, sizeof(uint64_t *));
         pgd.unitstatus = (uint64_t **) libmsr_calloc(allocated, sizeof(uint64_t *));
         init = 1;
@@ -143,7 +167,7 @@ int init_pmon_ctrs(void)
     if (!init)
     {
         init = 1;
-        allocated = NUMCTRS * num_sockets();
+        allocated = imc_num_channels();
         pmonctrs = pmon_ctr_storage();
 
         allocate_csr_batch(CSR_IMC_CTRS, allocated * 4);
@@ -173,7 +197,7 @@ int init_pmonctr_global(void)
     if (!init)
     {
         init = 1;
-        allocated = NUMCTRS * num_sockets();
+        allocated = imc_num_channels();
         pgd = pmonctr_global_storage();
         allocate_csr_batch(CSR_IMC_PMONUNITCTRL, allocated);
         allocate_csr_batch(CSR_IMC_PMONUNITSTAT, allocated);
@@ -202,7 +226,7 @@ static int set_pmon_config(const uint32_t setting, uint64_t **cfg)
         libmsr_error_handler("set_pmon_config(): iMC PMON config is not initialized", LIBMSR_ERROR_CSR_INIT, getenv("HOSTNAME"), __FILE__, __LINE__);
         return -1;
     }
-    for (i = 0; i < NUMCTRS * num_sockets(); i++)
+    for (i = 0; i < imc_num_channels(); i++)
     {
         *cfg[i] = setting;
     }
@@ -256,7 +280,7 @@ int set_pmon_unit_ctrl(uint32_t ovf_en, uint16_t freeze_en, uint16_t freeze, uin
     uint32_t setting = 0x0 | (ovf_en << 17) | (freeze_en << 16) | (freeze << 8) | (reset << 1) | reset_cfg;
     int i;
 
-    for (i = 0; i < NUMCTRS * num_sockets(); i++)
+    for (i = 0; i < imc_num_channels(); i++)
     {
         *pgd->unitctrl[i] = setting;
     }
@@ -347,43 +371,21 @@ int mem_page_miss_on_ctr(const unsigned pre_count, const unsigned cas_count)
 
 int read_imc_counter_batch(const unsigned counter)
 {
-    int res = 0;
-
-    switch (counter)
+    /* Every counter lives in the same CSR_IMC_CTRS batch. */
+    if (counter > 4)
     {
-        case 0:
-            res = do_csr_batch_op(CSR_IMC_CTRS);
-            break;
-        case 1:
-            res = do_csr_batch_op(CSR_IMC_CTRS);
-            break;
-        case 2:
-            res = do_csr_batch_op(CSR_IMC_CTRS);
-            break;
-        case 3:
-            res = do_csr_batch_op(CSR_IMC_CTRS);
-            break;
-        case 4:
-            res = do_csr_batch_op(CSR_IMC_CTRS);
-            break;
-        default:
-            libmsr_error_handler("read_imc_counter_batch(): iMC PMON counter does not exist", LIBMSR_ERROR_CSR_COUNTERS, getenv("HOSTNAME"), __FILE__, __LINE__);
-            return -1;
-            break;
+        libmsr_error_handler("read_imc_counter_batch(): iMC PMON counter does not exist", LIBMSR_ERROR_CSR_COUNTERS, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
     }
-    return res;
+    return do_csr_batch_op(CSR_IMC_CTRS);
 }
 
 int print_mem_bw_from_ctr(const unsigned counter, FILE *writedest)
 {
     struct pmonctrs_data *pcd = pmon_ctr_storage();
     uint64_t **ctr = NULL;
-    uint8_t devctr = 0;
-    uint8_t func = 0;
-    uint8_t sockctr = 0;
     int i;
-    const uint8_t funcnums[4] = {IMC_CH0_FUNC, IMC_CH1_FUNC, IMC_CH2_FUNC, IMC_CH3_FUNC};
-    const uint8_t devnums[2] = {IMC0_DEV, IMC1_DEV};
+    struct imc_channel_table *imct = imc_channel_storage();
 
     read_imc_counter_batch(counter);
     switch (counter)
@@ -406,21 +408,10 @@ int print_mem_bw_from_ctr(const unsigned counter, FILE *writedest)
     }
 
     fprintf(writedest, "Memory Bandwidth\n");
-    for (i = 0; i < NUMCTRS * num_sockets(); i++)
+    for (i = 0; i < imc_num_channels(); i++)
     {
-        if (i > 0 && i%4 == 0)
-        {
-            devctr++;
-        }
-        devctr %= 2;
-        func %= 4;
-        if (i > 0 && i%8 == 0)
-        {
-            sockctr++;
-        }
-        fprintf(writedest, "dev %d func %d sock %d: ", devnums[devctr], funcnums[func], sockctr);
+        fprintf(writedest, "dev %d func %d sock %d: ", imct->chan[i].device, imct->chan[i].function, imct->chan[i].socket);
         fprintf(writedest, "%lu bytes\n", *ctr[i] * 64LU);
-        func++;
     }
     return 0;
 }
@@ -430,11 +421,7 @@ int print_mem_pct_rw_from_ctr(const unsigned rcounter, const unsigned wcounter,
     struct pmonctrs_data *pcd = pmon_ctr_storage();
     uint64_t **rctr = NULL;
     uint64_t **wctr = NULL;
-    const uint8_t funcnums[4] = {IMC_CH0_FUNC, IMC_CH1_FUNC, IMC_CH2_FUNC, IMC_CH3_FUNC};
-    const uint8_t devnums[2] = {IMC0_DEV, IMC1_DEV};
-    uint8_t devctr = 0;
-    uint8_t func = 0;
-    uint8_t sockctr = 0;
+    struct imc_channel_table *imct = imc_channel_storage();
     int i;
 
     read_imc_counter_batch(rcounter);
@@ -477,19 +464,9 @@ int print_mem_pct_rw_from_ctr(const unsigned rcounter, const unsigned wcounter,
     }
 
     fprintf(writedest, "Percent %s Requests\n", (type ? "read\0" : "write\0"));
-    for (i = 0; i < NUMCTRS * num_sockets(); i++)
+    for (i = 0; i < imc_num_channels(); i++)
     {
-        if (i > 0 && i%4 == 0)
-        {
-            devctr++;
-        }
-        devctr %= 2;
-        func %= 4;
-        if (i > 0 && i%8 == 0)
-        {
-            sockctr++;
-        }
-        fprintf(writedest, "dev %d func %d sock %d: ", devnums[devctr], funcnums[func], sockctr);
+        fprintf(writedest, "dev %d func %d sock %d: ", imct->chan[i].device, imct->chan[i].function, imct->chan[i].socket);
         if (type)
         {
             fprintf(writedest, "%lf\n", (double)*rctr[i] / ((*rctr[i] + *wctr[i]) ? (*rctr[i] + *wctr[i]) : 1));
@@ -498,7 +475,6 @@ int print_mem_pct_rw_from_ctr(const unsigned rcounter, const unsigned wcounter,
         {
             fprintf(writedest, "%lf\n", (double)*wctr[i] / ((*rctr[i] + *wctr[i]) ? (*rctr[i] + *wctr[i]) : 1));
         }
-        func++;
     }
     return 0;
 }
@@ -509,11 +485,7 @@ int print_mem_page_empty_from_ctr(const unsigned act, const unsigned pre, const
     uint64_t **actr = NULL;
     uint64_t **pctr = NULL;
     uint64_t **cctr = NULL;
-    const uint8_t funcnums[4] = {IMC_CH0_FUNC, IMC_CH1_FUNC, IMC_CH2_FUNC, IMC_CH3_FUNC};
-    const uint8_t devnums[2] = {IMC0_DEV, IMC1_DEV};
-    uint8_t devctr = 0;
-    uint8_t func = 0;
-    uint8_t sockctr = 0;
+    struct imc_channel_table *imct = imc_channel_storage();
     int i;
 
     read_imc_counter_batch(act);
@@ -575,21 +547,10 @@ int print_mem_page_empty_from_ctr(const unsigned act, const unsigned pre, const
     }
 
     fprintf(writedest, "Percent Requests Caused Page Empty\n");
-    for (i = 0; i < NUMCTRS * num_sockets(); i++)
+    for (i = 0; i < imc_num_channels(); i++)
     {
-        if (i > 0 && i%4 == 0)
-        {
-            devctr++;
-        }
-        devctr %= 2;
-        func %= 4;
-        if (i > 0 && i%8 == 0)
-        {
-            sockctr++;
-        }
-        fprintf(writedest, "dev %d func %d sock %d: ", devnums[devctr], funcnums[func], sockctr);
+        fprintf(writedest, "dev %d func %d sock %d: ", imct->chan[i].device, imct->chan[i].function, imct->chan[i].socket);
         fprintf(writedest, "%lf\n", (double)(*actr[i] - *pctr[i]) / (*cctr[i] ? *cctr[i] : 1));
-        func++;
     }
     return 0;
 }
@@ -599,11 +560,7 @@ int print_mem_page_miss_from_ctr(const unsigned pre, const unsigned cas, FILE *w
     struct pmonctrs_data *pcd = pmon_ctr_storage();
     uint64_t **pctr = NULL;
     uint64_t **cctr = NULL;
-    const uint8_t funcnums[4] = {IMC_CH0_FUNC, IMC_CH1_FUNC, IMC_CH2_FUNC, IMC_CH3_FUNC};
-    const uint8_t devnums[2] = {IMC0_DEV, IMC1_DEV};
-    uint8_t devctr = 0;
-    uint8_t func = 0;
-    uint8_t sockctr = 0;
+    struct imc_channel_table *imct = imc_channel_storage();
     int i;
 
     read_imc_counter_batch(pre);
@@ -646,21 +603,10 @@ int print_mem_page_miss_from_ctr(const unsigned pre, const unsigned cas, FILE *w
     }
 
     fprintf(writedest, "Percent Requests Caused Page Miss\n");
-    for (i = 0; i < NUMCTRS * num_sockets(); i++)
+    for (i = 0; i < imc_num_channels(); i++)
     {
-        if (i > 0 && i%4 == 0)
-        {
-            devctr++;
-        }
-        devctr %= 2;
-        func %= 4;
-        if (i > 0 && i%8 == 0)
-        {
-            sockctr++;
-        }
-        fprintf(writedest, "dev %d func %d sock %d: ", devnums[devctr], funcnums[func], sockctr);
+        fprintf(writedest, "dev %d func %d sock %d: ", imct->chan[i].device, imct->chan[i].function, imct->chan[i].socket);
         fprintf(writedest, "%lf\n", (double)*pctr[i] / (*cctr[i] ? *cctr[i] : 1));
-        func++;
     }
     return 0;
 }
@@ -668,11 +614,7 @@ int print_mem_page_miss_from_ctr(const unsigned pre, const unsigned cas, FILE *w
 int print_pmon_ctrs(void)
 {
     struct pmonctrs_data *pcd = pmon_ctr_storage();
-    const uint8_t funcnums[4] = {IMC_CH0_FUNC, IMC_CH1_FUNC, IMC_CH2_FUNC, IMC_CH3_FUNC};
-    const uint8_t devnums[2] = {IMC0_DEV, IMC1_DEV};
-    uint8_t devctr = 0;
-    uint8_t func = 0;
-    uint8_t sockctr = 0;
+    struct imc_channel_table *imct = imc_channel_storage();
     int i;
 
     if (init_pmon_ctrs() > 0)
@@ -682,25 +624,148 @@ int print_pmon_ctrs(void)
     }
     do_csr_batch_op(CSR_IMC_CTRS);
 
-    for (i = 0; i < num_sockets() * NUMCTRS; i++)
+    for (i = 0; i < imc_num_channels(); i++)
     {
-        if (i > 0 && i%4 == 0)
-        {
-            devctr++;
-        }
-        devctr %= 2;
-        func %= 4;
-        if (i > 0 && i%8 == 0)
-        {
-            sockctr++;
-        }
-        fprintf(stdout, "dev %d func %d sock %d\n", devnums[devctr], funcnums[func], sockctr);
+        fprintf(stdout, "dev %d func %d sock %d\n", imct->chan[i].device, imct->chan[i].function, imct->chan[i].socket);
         fprintf(stdout, "CTR0 %lx\n", *pcd->ctr0[i]);
         fprintf(stdout, "CTR1 %lx\n", *pcd->ctr1[i]);
         fprintf(stdout, "CTR2 %lx\n", *pcd->ctr2[i]);
         fprintf(stdout, "CTR3 %lx\n", *pcd->ctr3[i]);
         fprintf(stdout, "CTR4 %lx\n", *pcd->ctr4[i]);
-        func++;
     }
     return 0;
 }
+
+/// @brief Get the raw counter array of an iMC counter loaded in the
+/// CSR_IMC_CTRS batch.
+///
+/// @param [in] counter Unique counter identifier.
+///
+/// @return Pointer to counter array, else NULL if counter is not loaded.
+static uint64_t **imc_ctr_array(const unsigned counter)
+{
+    struct pmonctrs_data *pcd = pmon_ctr_storage();
+
+    switch (counter)
+    {
+        case 0:
+            return pcd->ctr0;
+        case 1:
+            return pcd->ctr1;
+        case 2:
+            return pcd->ctr2;
+        case 3:
+            return pcd->ctr3;
+        default:
+            return NULL;
+    }
+}
+
+void imc_bw_storage(struct imc_bw_data **bw)
+{
+    static struct imc_bw_data d;
+    static int init = 0;
+    uint64_t sockets;
+
+    if (!init)
+    {
+        sockets = imc_channel_storage()->nsockets;
+        d.nchannels = imc_channel_storage()->nchannels;
+        d.prev_rd = (uint64_t *) libmsr_calloc(sockets * d.nchannels, sizeof(uint64_t));
+        d.prev_wr = (uint64_t *) libmsr_calloc(sockets * d.nchannels, sizeof(uint64_t));
+        d.chan_read_gbs = (double *) libmsr_calloc(sockets * d.nchannels, sizeof(double));
+        d.chan_write_gbs = (double *) libmsr_calloc(sockets * d.nchannels, sizeof(double));
+        d.sock_read_gbs = (double *) libmsr_calloc(sockets, sizeof(double));
+        d.sock_write_gbs = (double *) libmsr_calloc(sockets, sizeof(double));
+        init = 1;
+    }
+    if (bw != NULL)
+    {
+        *bw = &d;
+    }
+}
+
+int start_imc_bw_sampler(const unsigned rcounter, const unsigned wcounter)
+{
+    struct imc_bw_data *bw = NULL;
+
+    if (imc_ctr_array(rcounter) == NULL || imc_ctr_array(wcounter) == NULL || rcounter == wcounter)
+    {
+        libmsr_error_handler("start_imc_bw_sampler(): Invalid iMC PMON counter pair", LIBMSR_ERROR_CSR_COUNTERS, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    init_pmon_ctrs();
+    imc_bw_storage(&bw);
+    if (mem_bw_on_ctr(rcounter, 0) || mem_bw_on_ctr(wcounter, 1))
+    {
+        return -1;
+    }
+    bw->rcounter = rcounter;
+    bw->wcounter = wcounter;
+    bw->have_baseline = 0;
+    return sample_imc_bw();
+}
+
+int sample_imc_bw(void)
+{
+    static const uint64_t mask = (1UL << IMC_CTR_WIDTH) - 1;
+    struct imc_bw_data *bw = NULL;
+    struct timeval now;
+    uint64_t **rctr, **wctr;
+    uint64_t sockets, s, c, i;
+    double scale;
+
+    imc_bw_storage(&bw);
+    rctr = imc_ctr_array(bw->rcounter);
+    wctr = imc_ctr_array(bw->wcounter);
+    if (rctr == NULL || wctr == NULL || bw->rcounter == bw->wcounter || rctr[0] == NULL)
+    {
+        libmsr_error_handler("sample_imc_bw(): iMC bandwidth sampler has not been started", LIBMSR_ERROR_CSR_INIT, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    if (do_csr_batch_op(CSR_IMC_CTRS))
+    {
+        return -1;
+    }
+    gettimeofday(&now, NULL);
+    sockets = imc_channel_storage()->nsockets;
+    bw->interval = (now.tv_sec - bw->last.tv_sec) + (now.tv_usec - bw->last.tv_usec) / 1000000.0;
+    /* Each CAS transfers one 64-byte cache line. */
+    scale = (bw->have_baseline && bw->interval > 0.0) ? 64.0 / (bw->interval * 1000000000.0) : 0.0;
+    for (s = 0; s < sockets; s++)
+    {
+        bw->sock_read_gbs[s] = 0.0;
+        bw->sock_write_gbs[s] = 0.0;
+        for (c = 0; c < bw->nchannels; c++)
+        {
+            i = s * bw->nchannels + c;
+            bw->chan_read_gbs[i] = ((*rctr[i] - bw->prev_rd[i]) & mask) * scale;
+            bw->chan_write_gbs[i] = ((*wctr[i] - bw->prev_wr[i]) & mask) * scale;
+            bw->sock_read_gbs[s] += bw->chan_read_gbs[i];
+            bw->sock_write_gbs[s] += bw->chan_write_gbs[i];
+            bw->prev_rd[i] = *rctr[i];
+            bw->prev_wr[i] = *wctr[i];
+        }
+    }
+    bw->last = now;
+    bw->have_baseline = 1;
+    return 0;
+}
+
+void dump_imc_bw(FILE *writedest)
+{
+    struct imc_bw_data *bw = NULL;
+    uint64_t sockets = imc_channel_storage()->nsockets;
+    uint64_t s, c;
+
+    imc_bw_storage(&bw);
+    fprintf(writedest, "Memory Bandwidth over %.3f sec\n", bw->interval);
+    for (s = 0; s < sockets; s++)
+    {
+        for (c = 0; c < bw->nchannels; c++)
+        {
+            fprintf(writedest, "sock %lu chan %lu: read %.3f GB/s write %.3f GB/s\n", s, c, bw->chan_read_gbs[s * bw->nchannels + c], bw->chan_write_gbs[s * bw->nchannels + c]);
+        }
+        fprintf(writedest, "sock %lu total: read %.3f GB/s write %.3f GB/s\n", s, bw->sock_read_gbs[s], bw->sock_write_gbs[s]);
+    }
+}
@@ -0,0 +1,277 @@
+/*
+ * Copyright (c) 2013-2017, Lawrence Livermore National Security, LLC.
+ *
+ * Produced at the Lawrence Livermore National Laboratory. Written by:
+ *     Barry Rountree <rountree@llnl.gov>,
+ *     Scott Walker <walker91@llnl.gov>, and
+ *     Kathleen Shoga <shoga1@llnl.gov>.
+ *
+ * LLNL-CODE-645430
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr. For details, see https://github.com/LLNL/libmsr.git.
+ *
+ * Please also read libmsr/LICENSE for our notice and the LGPL.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License (as published by the Free
+ * Software Foundation) version 2.1 dated February 1999.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the IMPLIED WARRANTY OF MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the terms and conditions of the GNU Lesser
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "csr_core.h"
+#include "csr_qpi.h"
+#include "memhdlr.h"
+#include "msr_core.h"
+#include "libmsr_error.h"
+
+struct qpi_link_table *qpi_link_storage(void)
+{
+    static struct qpi_link_table t;
+    static int init = 0;
+
+    if (!init)
+    {
+        const uint16_t ids[] = QPI_PCI_DEVICE_IDS;
+        const uint8_t devnums[] = QPI_LINK_DEVS;
+        struct csr_pci_dev fixed[sizeof(devnums) / sizeof(devnums[0])];
+        unsigned k;
+
+        memset(fixed, 0, sizeof(fixed));
+        for (k = 0; k < sizeof(devnums) / sizeof(devnums[0]); k++)
+        {
+            fixed[k].device = devnums[k];
+            fixed[k].function = QPI_LINK_FUNC;
+        }
+        csr_unit_table(ids, sizeof(ids) / sizeof(ids[0]), fixed, sizeof(devnums) / sizeof(devnums[0]), QPI_CSR_BUS, num_sockets(), &t.nsockets, &t.nlinks, &t.link);
+#ifdef CSRDEBUG
+        fprintf(stderr, "CSRDEBUG: %lu links on each of %lu sockets\n", t.nlinks, t.nsockets);
+#endif
+        init = 1;
+    }
+    return &t;
+}
+
+/// @brief Get the total number of links across all sockets.
+///
+/// @return Number of entries in the link table.
+static int qpi_num_links(void)
+{
+    struct qpi_link_table *qt = qpi_link_storage();
+
+    return (int)(qt->nsockets * qt->nlinks);
+}
+
+/// @brief Load one batch operation for every link in the link table.
+///
+/// @param [in] offt Address of uncore register to load.
+///
+/// @param [in] loc Pointer to csr batch storage array.
+///
+/// @param [in] isread Indicates read or write to uncore register.
+///
+/// @param [in] size Size (in bytes) of the uncore register.
+///
+/// @param [in] batchno csr_data_type_e data type of batch operation.
+///
+/// @return Number of csr batch operations created.
+static int load_qpi_batch_for_each(const size_t offt, uint64_t **loc, const int isread, const size_t size, const unsigned batchno)
+{
+    struct qpi_link_table *qt = qpi_link_storage();
+    int idx;
+
+    for (idx = 0; idx < qpi_num_links(); idx++)
+    {
+        create_csr_batch_op(offt, QPI_CSR_BUS, qt->link[idx].device, qt->link[idx].function, qt->link[idx].socket, isread, size, &loc[idx], batchno);
+    }
+    return idx;
+}
+
+void qpi_storage(struct qpi_data **qd)
+{
+    static struct qpi_data d;
+    static int init = 0;
+    int links;
+
+    if (!init)
+    {
+        links = qpi_num_links();
+        d.nlinks = qpi_link_storage()->nlinks;
+        d.data_flits = (uint64_t **) libmsr_calloc(links, sizeof(uint64_t *));
+        d.non_data_flits = (uint64_t **) libmsr_calloc(links, sizeof(uint64_t *));
+        d.clockticks = (uint64_t **) libmsr_calloc(links, sizeof(uint64_t *));
+        d.ctrcfg0 = (uint64_t **) libmsr_calloc(links, sizeof(uint64_t *));
+        d.ctrcfg1 = (uint64_t **) libmsr_calloc(links, sizeof(uint64_t *));
+        d.ctrcfg2 = (uint64_t **) libmsr_calloc(links, sizeof(uint64_t *));
+        d.unitctrl = (uint64_t **) libmsr_calloc(links, sizeof(uint64_t *));
+        d.prev_data = (uint64_t *) libmsr_calloc(links, sizeof(uint64_t));
+        d.prev_non_data = (uint64_t *) libmsr_calloc(links, sizeof(uint64_t));
+        d.prev_clk = (uint64_t *) libmsr_calloc(links, sizeof(uint64_t));
+        d.link_gbs = (double *) libmsr_calloc(links, sizeof(double));
+        d.link_util = (double *) libmsr_calloc(links, sizeof(double));
+        d.sock_gbs = (double *) libmsr_calloc(num_sockets(), sizeof(double));
+        init = 1;
+    }
+    if (qd != NULL)
+    {
+        *qd = &d;
+    }
+}
+
+/// @brief Create the unit control, event select and counter batches of every
+/// link.
+///
+/// @return 0 if successful, else -1 if no links were found.
+static int init_qpi_batches(void)
+{
+    static int init = 0;
+    struct qpi_data *qd = NULL;
+    int links = qpi_num_links();
+
+    if (links == 0)
+    {
+        libmsr_error_handler("init_qpi_batches(): No QPI/UPI links found", LIBMSR_ERROR_PLATFORM_NOT_SUPPORTED, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    if (!init)
+    {
+        qpi_storage(&qd);
+        allocate_csr_batch(CSR_QPI_PMONUNITCTRL, links);
+        allocate_csr_batch(CSR_QPI_EVTS, links * 3);
+        allocate_csr_batch(CSR_QPI_CTRS, links * 3);
+
+        load_qpi_batch_for_each(QPI_PMONUNITCTRL, qd->unitctrl, 0, 4, CSR_QPI_PMONUNITCTRL);
+
+        load_qpi_batch_for_each(QPI_PMONCTRCFG0, qd->ctrcfg0, 0, 4, CSR_QPI_EVTS);
+        load_qpi_batch_for_each(QPI_PMONCTRCFG1, qd->ctrcfg1, 0, 4, CSR_QPI_EVTS);
+        load_qpi_batch_for_each(QPI_PMONCTRCFG2, qd->ctrcfg2, 0, 4, CSR_QPI_EVTS);
+
+        load_qpi_batch_for_each(QPI_PMONCTR0, qd->data_flits, 1, 8, CSR_QPI_CTRS);
+        load_qpi_batch_for_each(QPI_PMONCTR1, qd->non_data_flits, 1, 8, CSR_QPI_CTRS);
+        load_qpi_batch_for_each(QPI_PMONCTR2, qd->clockticks, 1, 8, CSR_QPI_CTRS);
+        init = 1;
+    }
+    return 0;
+}
+
+/// @brief Encode a link layer PMON event select.
+///
+/// @param [in] event Select event to be counted.
+///
+/// @param [in] umask Select subevents to be counted within the selected event.
+///
+/// @param [in] ext Extended event select bit.
+///
+/// @return Raw event select value with the counter enabled.
+static uint32_t qpi_event_select(const uint8_t event, const uint8_t umask, const uint8_t ext)
+{
+    return (0x1 << 22) | ((ext & 0x1) << 21) | (umask << 8) | event;
+}
+
+int start_qpi_sampler(void)
+{
+    struct qpi_data *qd = NULL;
+    int i;
+
+    if (init_qpi_batches())
+    {
+        return -1;
+    }
+    qpi_storage(&qd);
+    for (i = 0; i < qpi_num_links(); i++)
+    {
+        /* Reset the control and counter registers of the unit. */
+        *qd->unitctrl[i] = 0x3;
+        *qd->ctrcfg0[i] = qpi_event_select(QPI_EVT_TXL_FLITS, QPI_UMASK_FLITS_DATA, QPI_EVT_TXL_FLITS_EXT);
+        *qd->ctrcfg1[i] = qpi_event_select(QPI_EVT_TXL_FLITS, QPI_UMASK_FLITS_NON_DATA, QPI_EVT_TXL_FLITS_EXT);
+        *qd->ctrcfg2[i] = qpi_event_select(QPI_EVT_CLOCKTICKS, 0x0, 0x0);
+    }
+    if (do_csr_batch_op(CSR_QPI_PMONUNITCTRL) || do_csr_batch_op(CSR_QPI_EVTS))
+    {
+        return -1;
+    }
+    qd->have_baseline = 0;
+    return sample_qpi();
+}
+
+int sample_qpi(void)
+{
+    static const uint64_t mask = (1UL << QPI_CTR_WIDTH) - 1;
+    struct qpi_data *qd = NULL;
+    struct timeval now;
+    uint64_t sockets, s, l, i;
+    uint64_t data, non_data, clk;
+
+    qpi_storage(&qd);
+    if (qd->data_flits[0] == NULL)
+    {
+        libmsr_error_handler("sample_qpi(): QPI/UPI link sampler has not been started", LIBMSR_ERROR_CSR_INIT, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    if (do_csr_batch_op(CSR_QPI_CTRS))
+    {
+        return -1;
+    }
+    gettimeofday(&now, NULL);
+    sockets = qpi_link_storage()->nsockets;
+    qd->interval = (now.tv_sec - qd->last.tv_sec) + (now.tv_usec - qd->last.tv_usec) / 1000000.0;
+    for (s = 0; s < sockets; s++)
+    {
+        qd->sock_gbs[s] = 0.0;
+        for (l = 0; l < qd->nlinks; l++)
+        {
+            i = s * qd->nlinks + l;
+            data = (*qd->data_flits[i] - qd->prev_data[i]) & mask;
+            non_data = (*qd->non_data_flits[i] - qd->prev_non_data[i]) & mask;
+            clk = (*qd->clockticks[i] - qd->prev_clk[i]) & mask;
+            if (qd->have_baseline && qd->interval > 0.0)
+            {
+                qd->link_gbs[i] = data * QPI_BYTES_PER_DATA_FLIT / (qd->interval * 1000000000.0);
+                qd->link_util[i] = clk ? (data + non_data) / (QPI_FLITS_PER_CLOCK * clk) : 0.0;
+            }
+            else
+            {
+                qd->link_gbs[i] = 0.0;
+                qd->link_util[i] = 0.0;
+            }
+            qd->sock_gbs[s] += qd->link_gbs[i];
+            qd->prev_data[i] = *qd->data_flits[i];
+            qd->prev_non_data[i] = *qd->non_data_flits[i];
+            qd->prev_clk[i] = *qd->clockticks[i];
+        }
+    }
+    qd->last = now;
+    qd->have_baseline = 1;
+    return 0;
+}
+
+void dump_qpi(FILE *writedest)
+{
+    struct qpi_link_table *qt = qpi_link_storage();
+    struct qpi_data *qd = NULL;
+    uint64_t s, l;
+
+    qpi_storage(&qd);
+    fprintf(writedest, "Link Transmit Bandwidth over %.3f sec\n", qd->interval);
+    for (s = 0; s < qt->nsockets; s++)
+    {
+        for (l = 0; l < qd->nlinks; l++)
+        {
+            fprintf(writedest, "sock %lu link %lu: %.3f GB/s util %.1f%%\n", s, l, qd->link_gbs[s * qd->nlinks + l], 100.0 * qd->link_util[s * qd->nlinks + l]);
+        }
+        fprintf(writedest, "sock %lu total: %.3f GB/s\n", s, qd->sock_gbs[s]);
+    }
+}
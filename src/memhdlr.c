@@ -117,6 +117,10 @@ int memory_handler(void *address, void *oldaddr, int type)
             {
                 free(arrays);
             }
+            /* Start over so allocations after finalize are tracked again. */
+            arrays = NULL;
+            last = 0;
+            size = 16;
             return 0;
         case LIBMSR_REALLOC:
 #ifdef MEMHDLR_DEBUG
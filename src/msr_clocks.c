@@ -31,12 +31,15 @@
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "msr_core.h"
 #include "msr_clocks.h"
 #include "memhdlr.h"
 #include "cpuid.h"
 #include "libmsr_debug.h"
+#include "libmsr_error.h"
 
 void clocks_storage(struct clocks_data **cd)
 {
@@ -85,33 +88,34 @@ void perf_storage(struct perf_data **pd)
 
 void dump_clocks_data_terse_label(FILE *writedest)
 {
+    const uint64_t *devs;
+    uint64_t ndevs = cpu_subset_list(&devs);
+    uint64_t i;
     int thread_idx;
-    static uint64_t totalThreads = 0;
 
-    if (!totalThreads)
-    {
-        totalThreads = num_devs();
-    }
-    for (thread_idx = 0; thread_idx < totalThreads; thread_idx++)
+    for (i = 0; i < ndevs; i++)
     {
+        thread_idx = devs[i];
         fprintf(writedest, "aperf%02d mperf%02d tsc%02d ", thread_idx, thread_idx, thread_idx);
     }
 }
 
 void dump_clocks_data_terse(FILE *writedest)
 {
-    static uint64_t totalThreads = 0;
-    static struct clocks_data *cd;
+    static struct clocks_data *cd = NULL;
+    const uint64_t *devs;
+    uint64_t ndevs = cpu_subset_list(&devs);
+    uint64_t i;
     int thread_idx;
 
-    if (!totalThreads)
+    if (cd == NULL)
     {
-        totalThreads = num_devs();
         clocks_storage(&cd);
     }
     read_batch(CLOCKS_DATA);
-    for (thread_idx = 0; thread_idx < totalThreads; thread_idx++)
+    for (i = 0; i < ndevs; i++)
     {
+        thread_idx = devs[i];
         fprintf(writedest, "%20lu %20lu %20lu ", *cd->aperf[thread_idx], *cd->mperf[thread_idx], *cd->tsc[thread_idx]);
     }
 }
@@ -145,17 +149,22 @@ void set_p_state(unsigned socket, uint64_t pstate)
 {
     static uint64_t procs = 0;
     static struct perf_data *cd;
+    static uint8_t *dirty = NULL;
 
     if (!procs)
     {
         procs = num_sockets();
         perf_storage(&cd);
+        dirty = (uint8_t *) libmsr_calloc(procs, sizeof(uint8_t));
     }
     *cd->perf_ctl[socket] = pstate;
 #ifdef LIBMSR_DEBUG
     printf("PERF_CTL raw decimal %" PRIu64 "\n", *cd->perf_ctl[socket]);
 #endif
-    write_batch(PERF_CTL);
+    /* Only the requested socket is written. */
+    dirty[socket] = 1;
+    write_batch_sparse(PERF_CTL, dirty);
+    dirty[socket] = 0;
 
 #ifdef LIBMSR_DEBUG
     read_batch(PERF_CTL);
@@ -163,23 +172,180 @@ void set_p_state(unsigned socket, uint64_t pstate)
 #endif
 }
 
+void perf_thread_storage(struct perf_thread_data **pd)
+{
+    static struct perf_thread_data d;
+    static int init = 0;
+    uint64_t coresPerSocket, threadsPerCore, sockets;
+    unsigned s, c, t;
+    uint64_t idx = 0;
+
+    if (!init)
+    {
+        core_config(&coresPerSocket, &threadsPerCore, &sockets, NULL);
+        d.threads_per_core = threadsPerCore;
+        d.perf_status = (uint64_t **) libmsr_calloc(num_devs(), sizeof(uint64_t *));
+        d.perf_ctl = (uint64_t **) libmsr_calloc(num_devs(), sizeof(uint64_t *));
+        d.request = (uint64_t *) libmsr_calloc(num_devs(), sizeof(uint64_t));
+        d.dirty = (uint8_t *) libmsr_calloc(num_devs(), sizeof(uint8_t));
+        allocate_batch(PERF_THREAD_DATA, num_devs());
+        allocate_batch(PERF_THREAD_CTL, num_devs());
+        /* Ops are loaded in index order so dirty[] lines up with the batch. */
+        for (s = 0; s < sockets; s++)
+        {
+            for (c = 0; c < coresPerSocket; c++)
+            {
+                for (t = 0; t < threadsPerCore; t++, idx++)
+                {
+                    read_msr_by_coord_batch(s, c, t, IA32_PERF_STATUS, &d.perf_status[idx], PERF_THREAD_DATA);
+                    read_msr_by_coord_batch(s, c, t, IA32_PERF_CTL, &d.perf_ctl[idx], PERF_THREAD_CTL);
+                }
+            }
+        }
+        read_batch(PERF_THREAD_CTL);
+        init = 1;
+    }
+    if (pd != NULL)
+    {
+        *pd = &d;
+    }
+}
+
+int read_p_state_threads(void)
+{
+    perf_thread_storage(NULL);
+    return read_batch(PERF_THREAD_DATA);
+}
+
+int set_p_state_thread(unsigned socket, unsigned core, unsigned thread, uint64_t pstate)
+{
+    static struct perf_thread_data *pd = NULL;
+    static uint64_t coresPerSocket = 0;
+    uint64_t idx;
+
+    if (pd == NULL)
+    {
+        coresPerSocket = cores_per_socket();
+        perf_thread_storage(&pd);
+    }
+    if (socket >= num_sockets() || core >= coresPerSocket || thread >= pd->threads_per_core)
+    {
+        libmsr_error_handler("set_p_state_thread(): Invalid socket, core, or thread", LIBMSR_ERROR_ARRAY_BOUNDS, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    idx = (socket * coresPerSocket + core) * pd->threads_per_core + thread;
+    pd->request[idx] = pstate;
+    /* Bit 32 belongs to enable_turbo()/disable_turbo(). */
+    pd->dirty[idx] = ((*pd->perf_ctl[idx] ^ pstate) & ~(((uint64_t)1) << 32)) != 0;
+    return 0;
+}
+
+int set_p_state_core(unsigned socket, unsigned core, uint64_t pstate)
+{
+    static struct perf_thread_data *pd = NULL;
+    unsigned t;
+
+    if (pd == NULL)
+    {
+        perf_thread_storage(&pd);
+    }
+    for (t = 0; t < pd->threads_per_core; t++)
+    {
+        if (set_p_state_thread(socket, core, t, pstate))
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int commit_p_state(void)
+{
+    static struct perf_thread_data *pd = NULL;
+    uint64_t idx;
+    int pending = 0;
+    int ret;
+
+    if (pd == NULL)
+    {
+        perf_thread_storage(&pd);
+    }
+    for (idx = 0; idx < num_devs(); idx++)
+    {
+        pending |= pd->dirty[idx];
+    }
+    if (!pending)
+    {
+        return 0;
+    }
+    /* IA32_PERF_CTL is shared with the TURBO_CTL batch, keep its bit 32. */
+    if (read_batch(PERF_THREAD_CTL))
+    {
+        return -1;
+    }
+    for (idx = 0; idx < num_devs(); idx++)
+    {
+        if (pd->dirty[idx])
+        {
+            *pd->perf_ctl[idx] = (pd->request[idx] & ~(((uint64_t)1) << 32)) | (*pd->perf_ctl[idx] & (((uint64_t)1) << 32));
+        }
+    }
+    ret = write_batch_sparse(PERF_THREAD_CTL, pd->dirty);
+    if (ret == 0)
+    {
+        memset(pd->dirty, 0, num_devs() * sizeof(uint8_t));
+    }
+    return ret;
+}
+
+void dump_p_state_threads(FILE *writedest)
+{
+    static struct perf_thread_data *pd = NULL;
+    static uint64_t coresPerSocket = 0;
+    uint64_t idx;
+    unsigned s, c, t;
+
+    if (pd == NULL)
+    {
+        coresPerSocket = cores_per_socket();
+        perf_thread_storage(&pd);
+    }
+    read_batch(PERF_THREAD_DATA);
+    for (s = 0, idx = 0; s < num_sockets(); s++)
+    {
+        for (c = 0; c < coresPerSocket; c++)
+        {
+            for (t = 0; t < pd->threads_per_core; t++, idx++)
+            {
+                if (!coord_in_subset(s, c, t))
+                {
+                    continue;
+                }
+                fprintf(writedest, "Socket %u, Core %2u, Thread %u: current p-state = %lu MHz (requested %lu MHz)\n", s, c, t, MASK_VAL(*pd->perf_status[idx], 15, 8) * 100, MASK_VAL(*pd->perf_ctl[idx], 15, 8) * 100);
+            }
+        }
+    }
+}
+
 void dump_clocks_data_readable(FILE *writedest)
 {
-    static uint64_t totalThreads = 0;
-    static struct clocks_data *cd;
+    static struct clocks_data *cd = NULL;
+    const uint64_t *devs;
+    uint64_t ndevs = cpu_subset_list(&devs);
+    uint64_t i;
     int thread_idx;
 
-    if (!totalThreads)
+    if (cd == NULL)
     {
-        totalThreads = num_devs();
         clocks_storage(&cd);
     }
 #ifdef LIBMSR_DEBUG
-    fprintf(stderr, "DEBUG: (clocks_readable) totalThreads is %lu\n", totalThreads);
+    fprintf(stderr, "DEBUG: (clocks_readable) totalThreads is %lu\n", ndevs);
 #endif
     read_batch(CLOCKS_DATA);
-    for (thread_idx = 0; thread_idx < totalThreads; thread_idx++)
+    for (i = 0; i < ndevs; i++)
     {
+        thread_idx = devs[i];
         fprintf(writedest, "aperf%02d:%20lu mperf%02d:%20lu tsc%02d:%20lu\n", thread_idx, *cd->aperf[thread_idx], thread_idx, *cd->mperf[thread_idx], thread_idx, *cd->tsc[thread_idx]);
     }
 }
@@ -250,9 +416,765 @@ int set_clock_mod(int socket, int core, struct clock_mod *s)
         return -1;
     }
 
-    msrVal = (msrVal & (~(3<<1))) | (s->duty_cycle << 1);
+    msrVal = (msrVal & (~(7<<1))) | (s->duty_cycle << 1);
     msrVal = (msrVal & (~(1<<4))) | (s->duty_cycle_enable << 4);
 
     write_msr_by_coord(socket, core, 0, IA32_CLOCK_MODULATION, msrVal);
     return 0;
 }
+
+void clock_mod_storage(struct clock_mod_data **cm)
+{
+    static struct clock_mod_data d;
+    static int init = 0;
+    uint64_t coresPerSocket, threadsPerCore, sockets;
+    unsigned s, c, t;
+    uint64_t idx = 0;
+
+    if (!init)
+    {
+        core_config(&coresPerSocket, &threadsPerCore, &sockets, NULL);
+        d.threads_per_core = threadsPerCore;
+        d.raw = (uint64_t **) libmsr_calloc(num_devs(), sizeof(uint64_t *));
+        allocate_batch(CLOCK_MOD, num_devs());
+        for (s = 0; s < sockets; s++)
+        {
+            for (c = 0; c < coresPerSocket; c++)
+            {
+                for (t = 0; t < threadsPerCore; t++, idx++)
+                {
+                    read_msr_by_coord_batch(s, c, t, IA32_CLOCK_MODULATION, &d.raw[idx], CLOCK_MOD);
+                }
+            }
+        }
+        init = 1;
+    }
+    if (cm != NULL)
+    {
+        *cm = &d;
+    }
+}
+
+int get_clock_mod_all(struct clock_mod *s)
+{
+    static struct clock_mod_data *cm = NULL;
+    static uint64_t cores = 0;
+    uint64_t i;
+
+    if (cm == NULL)
+    {
+        cores = num_cores();
+        clock_mod_storage(&cm);
+    }
+    if (read_batch(CLOCK_MOD))
+    {
+        return -1;
+    }
+    for (i = 0; i < cores; i++)
+    {
+        s[i].raw = *cm->raw[i * cm->threads_per_core];
+        s[i].duty_cycle = MASK_VAL(s[i].raw, 3, 1);
+        s[i].duty_cycle_enable = MASK_VAL(s[i].raw, 4, 4);
+    }
+    return 0;
+}
+
+int set_clock_mod_all(const struct clock_mod *s)
+{
+    static struct clock_mod_data *cm = NULL;
+    static uint64_t cores = 0;
+    uint64_t i, t;
+    uint64_t *raw;
+
+    if (cm == NULL)
+    {
+        cores = num_cores();
+        clock_mod_storage(&cm);
+    }
+    for (i = 0; i < cores; i++)
+    {
+        if (!(s[i].duty_cycle > 0 && s[i].duty_cycle < 8))
+        {
+            return -1;
+        }
+        if (!(s[i].duty_cycle_enable == 0 || s[i].duty_cycle_enable == 1))
+        {
+            return -1;
+        }
+    }
+    if (read_batch(CLOCK_MOD))
+    {
+        return -1;
+    }
+    for (i = 0; i < cores; i++)
+    {
+        for (t = 0; t < cm->threads_per_core; t++)
+        {
+            raw = cm->raw[i * cm->threads_per_core + t];
+            *raw = (*raw & ~((7UL << 1) | (1UL << 4))) | ((uint64_t)s[i].duty_cycle << 1) | ((uint64_t)s[i].duty_cycle_enable << 4);
+        }
+    }
+    return write_batch(CLOCK_MOD);
+}
+
+void uncore_freq_storage(struct uncore_freq_data **uf)
+{
+    static struct uncore_freq_data d;
+    static int init = 0;
+    uint64_t sockets;
+    unsigned s;
+
+    if (!init)
+    {
+        sockets = num_sockets();
+        d.perf_status = (uint64_t **) libmsr_calloc(sockets, sizeof(uint64_t *));
+        d.ratio_limit = (uint64_t **) libmsr_calloc(sockets, sizeof(uint64_t *));
+        d.shadow = (uint64_t *) libmsr_calloc(sockets, sizeof(uint64_t));
+        d.dirty = (uint8_t *) libmsr_calloc(sockets, sizeof(uint8_t));
+#ifdef HAS_UNCORE_FREQ
+        allocate_batch(UNCORE_FREQ_STATUS, sockets);
+        allocate_batch(UNCORE_FREQ_LIMIT, sockets);
+        load_socket_batch(MSR_UNCORE_PERF_STATUS, d.perf_status, UNCORE_FREQ_STATUS);
+        load_socket_batch(MSR_UNCORE_RATIO_LIMIT, d.ratio_limit, UNCORE_FREQ_LIMIT);
+        read_batch(UNCORE_FREQ_LIMIT);
+        for (s = 0; s < sockets; s++)
+        {
+            d.shadow[s] = *d.ratio_limit[s];
+        }
+#else
+        (void) s;
+#endif
+        init = 1;
+    }
+    if (uf != NULL)
+    {
+        *uf = &d;
+    }
+}
+
+int get_uncore_ratio(uint64_t *ratio)
+{
+#ifdef HAS_UNCORE_FREQ
+    static struct uncore_freq_data *uf = NULL;
+    static uint64_t sockets = 0;
+    unsigned s;
+
+    if (uf == NULL)
+    {
+        sockets = num_sockets();
+        uncore_freq_storage(&uf);
+    }
+    if (read_batch(UNCORE_FREQ_STATUS))
+    {
+        return -1;
+    }
+    for (s = 0; s < sockets; s++)
+    {
+        ratio[s] = MASK_VAL(*uf->perf_status[s], 6, 0);
+    }
+    return 0;
+#else
+    (void) ratio;
+    libmsr_error_handler("get_uncore_ratio(): Uncore frequency MSRs not available on this platform", LIBMSR_ERROR_PLATFORM_NOT_SUPPORTED, getenv("HOSTNAME"), __FILE__, __LINE__);
+    return -1;
+#endif
+}
+
+int get_uncore_ratio_limit(unsigned socket, uint64_t *min_ratio, uint64_t *max_ratio)
+{
+#ifdef HAS_UNCORE_FREQ
+    static struct uncore_freq_data *uf = NULL;
+
+    if (uf == NULL)
+    {
+        uncore_freq_storage(&uf);
+    }
+    if (socket >= num_sockets())
+    {
+        libmsr_error_handler("get_uncore_ratio_limit(): Invalid socket", LIBMSR_ERROR_ARRAY_BOUNDS, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    *min_ratio = MASK_VAL(uf->shadow[socket], 14, 8);
+    *max_ratio = MASK_VAL(uf->shadow[socket], 6, 0);
+    return 0;
+#else
+    (void) socket;
+    (void) min_ratio;
+    (void) max_ratio;
+    libmsr_error_handler("get_uncore_ratio_limit(): Uncore frequency MSRs not available on this platform", LIBMSR_ERROR_PLATFORM_NOT_SUPPORTED, getenv("HOSTNAME"), __FILE__, __LINE__);
+    return -1;
+#endif
+}
+
+int set_uncore_ratio_limit(unsigned socket, uint64_t min_ratio, uint64_t max_ratio)
+{
+#ifdef HAS_UNCORE_FREQ
+    static struct uncore_freq_data *uf = NULL;
+    uint64_t staged;
+    int ret;
+
+    if (uf == NULL)
+    {
+        uncore_freq_storage(&uf);
+    }
+    if (socket >= num_sockets())
+    {
+        libmsr_error_handler("set_uncore_ratio_limit(): Invalid socket", LIBMSR_ERROR_ARRAY_BOUNDS, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    if (min_ratio > 0x7F || max_ratio > 0x7F || min_ratio > max_ratio)
+    {
+        libmsr_error_handler("set_uncore_ratio_limit(): Invalid min/max uncore ratio", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    staged = (uf->shadow[socket] & ~((0x7FUL << 8) | 0x7FUL)) | (min_ratio << 8) | max_ratio;
+    if (staged == uf->shadow[socket])
+    {
+        return 0;
+    }
+    *uf->ratio_limit[socket] = staged;
+    uf->dirty[socket] = 1;
+    ret = write_batch_sparse(UNCORE_FREQ_LIMIT, uf->dirty);
+    uf->dirty[socket] = 0;
+    if (ret == 0)
+    {
+        uf->shadow[socket] = staged;
+    }
+    else
+    {
+        *uf->ratio_limit[socket] = uf->shadow[socket];
+    }
+    return ret;
+#else
+    (void) socket;
+    (void) min_ratio;
+    (void) max_ratio;
+    libmsr_error_handler("set_uncore_ratio_limit(): Uncore frequency MSRs not available on this platform", LIBMSR_ERROR_PLATFORM_NOT_SUPPORTED, getenv("HOSTNAME"), __FILE__, __LINE__);
+    return -1;
+#endif
+}
+
+int refresh_uncore_ratio_limit(void)
+{
+#ifdef HAS_UNCORE_FREQ
+    static struct uncore_freq_data *uf = NULL;
+    static uint64_t sockets = 0;
+    unsigned s;
+
+    if (uf == NULL)
+    {
+        sockets = num_sockets();
+        uncore_freq_storage(&uf);
+    }
+    if (read_batch(UNCORE_FREQ_LIMIT))
+    {
+        return -1;
+    }
+    for (s = 0; s < sockets; s++)
+    {
+        uf->shadow[s] = *uf->ratio_limit[s];
+    }
+    return 0;
+#else
+    libmsr_error_handler("refresh_uncore_ratio_limit(): Uncore frequency MSRs not available on this platform", LIBMSR_ERROR_PLATFORM_NOT_SUPPORTED, getenv("HOSTNAME"), __FILE__, __LINE__);
+    return -1;
+#endif
+}
+
+void dump_uncore_freq(FILE *writedest)
+{
+    uint64_t *ratio;
+    uint64_t min_ratio, max_ratio;
+    unsigned s;
+
+    ratio = (uint64_t *) libmsr_calloc(num_sockets(), sizeof(uint64_t));
+    if (get_uncore_ratio(ratio) == 0)
+    {
+        for (s = 0; s < num_sockets(); s++)
+        {
+            get_uncore_ratio_limit(s, &min_ratio, &max_ratio);
+            fprintf(writedest, "Socket %u: uncore frequency = %lu MHz (limits %lu - %lu MHz)\n", s, ratio[s] * 100, min_ratio * 100, max_ratio * 100);
+        }
+    }
+    libmsr_free(ratio);
+}
+
+#ifdef HAS_HWP
+/* The HWP MSRs fault until HWP is enabled in IA32_PM_ENABLE, which cannot be
+ * undone without a reset, so it is checked once. The register is read on the
+ * first CPU of the subset, a failed read is not cached. Returns non-zero if
+ * HWP is supported and enabled. */
+static int hwp_enabled(void)
+{
+    static int enabled = -1;
+    const uint64_t *devs;
+    uint64_t val = 0;
+
+    if (enabled < 0)
+    {
+        if (!cpuid_hwp_avail())
+        {
+            enabled = 0;
+        }
+        else if (cpu_subset_list(&devs) > 0 && read_msr_by_idx(devs[0], IA32_PM_ENABLE, &val) == 0)
+        {
+            enabled = ((val & 1) != 0);
+        }
+        else
+        {
+            return 0;
+        }
+    }
+    return enabled;
+}
+
+/* Merge the non-negative fields of r into raw, returns -1 if a field is out of
+ * range. */
+static int hwp_merge_request(uint64_t *raw, const struct hwp_request *r, int pkg)
+{
+    const int field[4] = {r->min_perf, r->max_perf, r->desired_perf, r->epp};
+    uint64_t val = *raw;
+    int i;
+
+    for (i = 0; i < 4; i++)
+    {
+        if (field[i] > 0xFF)
+        {
+            return -1;
+        }
+        if (field[i] >= 0)
+        {
+            val = (val & ~(0xFFUL << (i * 8))) | ((uint64_t)field[i] << (i * 8));
+        }
+    }
+    if (!pkg && r->pkg_control >= 0)
+    {
+        val = (val & ~(1UL << 42)) | ((uint64_t)(r->pkg_control ? 1 : 0) << 42);
+    }
+    *raw = val;
+    return 0;
+}
+#endif
+
+void hwp_storage(struct hwp_data **hd)
+{
+    static struct hwp_data d;
+    static int init = 0;
+    uint64_t coresPerSocket, threadsPerCore, sockets;
+    unsigned s, c, t;
+    uint64_t idx = 0;
+
+    if (!init)
+    {
+        core_config(&coresPerSocket, &threadsPerCore, &sockets, NULL);
+        d.threads_per_core = threadsPerCore;
+        d.capabilities = (uint64_t **) libmsr_calloc(num_devs(), sizeof(uint64_t *));
+        d.request = (uint64_t **) libmsr_calloc(num_devs(), sizeof(uint64_t *));
+        d.epb = (uint64_t **) libmsr_calloc(num_devs(), sizeof(uint64_t *));
+        d.pkg_request = (uint64_t **) libmsr_calloc(sockets, sizeof(uint64_t *));
+        d.request_dirty = (uint8_t *) libmsr_calloc(num_devs(), sizeof(uint8_t));
+        d.epb_dirty = (uint8_t *) libmsr_calloc(num_devs(), sizeof(uint8_t));
+        d.pkg_request_dirty = (uint8_t *) libmsr_calloc(sockets, sizeof(uint8_t));
+#ifdef HAS_HWP
+        if (cpuid_hwp_avail() && !hwp_enabled())
+        {
+            libmsr_error_handler("hwp_storage(): HWP is supported but not enabled in IA32_PM_ENABLE", LIBMSR_ERROR_PLATFORM_ENV, getenv("HOSTNAME"), __FILE__, __LINE__);
+        }
+        if (hwp_enabled())
+        {
+            allocate_batch(HWP_CAPABILITIES, num_devs());
+            allocate_batch(HWP_REQUEST, num_devs());
+            /* Ops are loaded in index order so the dirty arrays line up with
+             * the batches. */
+            for (s = 0; s < sockets; s++)
+            {
+                for (c = 0; c < coresPerSocket; c++)
+                {
+                    for (t = 0; t < threadsPerCore; t++, idx++)
+                    {
+                        read_msr_by_coord_batch(s, c, t, IA32_HWP_CAPABILITIES, &d.capabilities[idx], HWP_CAPABILITIES);
+                        read_msr_by_coord_batch(s, c, t, IA32_HWP_REQUEST, &d.request[idx], HWP_REQUEST);
+                    }
+                }
+            }
+            read_batch(HWP_CAPABILITIES);
+            read_batch(HWP_REQUEST);
+        }
+        if (hwp_enabled() && cpuid_hwp_pkg_request_avail())
+        {
+            allocate_batch(HWP_REQUEST_PKG, sockets);
+            load_socket_batch(IA32_HWP_REQUEST_PKG, d.pkg_request, HWP_REQUEST_PKG);
+            read_batch(HWP_REQUEST_PKG);
+        }
+        if (cpuid_energy_perf_bias_avail())
+        {
+            allocate_batch(ENERGY_PERF_BIAS, num_devs());
+            for (s = 0, idx = 0; s < sockets; s++)
+            {
+                for (c = 0; c < coresPerSocket; c++)
+                {
+                    for (t = 0; t < threadsPerCore; t++, idx++)
+                    {
+                        read_msr_by_coord_batch(s, c, t, IA32_ENERGY_PERF_BIAS, &d.epb[idx], ENERGY_PERF_BIAS);
+                    }
+                }
+            }
+            read_batch(ENERGY_PERF_BIAS);
+        }
+#else
+        (void) s;
+        (void) c;
+        (void) t;
+        (void) idx;
+#endif
+        init = 1;
+    }
+    if (hd != NULL)
+    {
+        *hd = &d;
+    }
+}
+
+int read_hwp_request(void)
+{
+#ifdef HAS_HWP
+    static struct hwp_data *hd = NULL;
+
+    if (hd == NULL)
+    {
+        hwp_storage(&hd);
+    }
+    if (!hwp_enabled())
+    {
+        libmsr_error_handler("read_hwp_request(): HWP not available or not enabled on this platform", LIBMSR_ERROR_PLATFORM_NOT_SUPPORTED, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    if (read_batch(HWP_REQUEST))
+    {
+        return -1;
+    }
+    memset(hd->request_dirty, 0, num_devs() * sizeof(uint8_t));
+    if (cpuid_hwp_pkg_request_avail())
+    {
+        if (read_batch(HWP_REQUEST_PKG))
+        {
+            return -1;
+        }
+        memset(hd->pkg_request_dirty, 0, num_sockets() * sizeof(uint8_t));
+    }
+    if (cpuid_energy_perf_bias_avail())
+    {
+        if (read_batch(ENERGY_PERF_BIAS))
+        {
+            return -1;
+        }
+        memset(hd->epb_dirty, 0, num_devs() * sizeof(uint8_t));
+    }
+    return 0;
+#else
+    libmsr_error_handler("read_hwp_request(): HWP not available on this platform", LIBMSR_ERROR_PLATFORM_NOT_SUPPORTED, getenv("HOSTNAME"), __FILE__, __LINE__);
+    return -1;
+#endif
+}
+
+/* Translate coordinates into a per-thread HWP index, returns -1 if HWP is not
+ * available or the coordinates are invalid. */
+static int64_t hwp_thread_index(const char *caller, unsigned socket, unsigned core, unsigned thread)
+{
+    static uint64_t coresPerSocket = 0;
+    static uint64_t threadsPerCore = 0;
+    static uint64_t sockets = 0;
+    char msg[128];
+
+    if (sockets == 0)
+    {
+        core_config(&coresPerSocket, &threadsPerCore, &sockets, NULL);
+    }
+#ifdef HAS_HWP
+    if (!hwp_enabled())
+#endif
+    {
+        snprintf(msg, sizeof(msg), "%s(): HWP not available or not enabled on this platform", caller);
+        libmsr_error_handler(msg, LIBMSR_ERROR_PLATFORM_NOT_SUPPORTED, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    if (socket >= sockets || core >= coresPerSocket || thread >= threadsPerCore)
+    {
+        snprintf(msg, sizeof(msg), "%s(): Invalid socket, core, or thread", caller);
+        libmsr_error_handler(msg, LIBMSR_ERROR_ARRAY_BOUNDS, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    return (int64_t)((socket * coresPerSocket + core) * threadsPerCore + thread);
+}
+
+int get_hwp_capabilities(unsigned socket, unsigned core, unsigned thread, struct hwp_capabilities *c)
+{
+    static struct hwp_data *hd = NULL;
+    int64_t idx;
+
+    if (hd == NULL)
+    {
+        hwp_storage(&hd);
+    }
+    idx = hwp_thread_index("get_hwp_capabilities", socket, core, thread);
+    if (idx < 0)
+    {
+        return -1;
+    }
+    c->raw = *hd->capabilities[idx];
+    c->highest_perf = MASK_VAL(c->raw, 7, 0);
+    c->guaranteed_perf = MASK_VAL(c->raw, 15, 8);
+    c->most_efficient_perf = MASK_VAL(c->raw, 23, 16);
+    c->lowest_perf = MASK_VAL(c->raw, 31, 24);
+    return 0;
+}
+
+int get_hwp_request(unsigned socket, unsigned core, unsigned thread, struct hwp_request *r)
+{
+    static struct hwp_data *hd = NULL;
+    int64_t idx;
+
+    if (hd == NULL)
+    {
+        hwp_storage(&hd);
+    }
+    idx = hwp_thread_index("get_hwp_request", socket, core, thread);
+    if (idx < 0)
+    {
+        return -1;
+    }
+    r->raw = *hd->request[idx];
+    r->min_perf = MASK_VAL(r->raw, 7, 0);
+    r->max_perf = MASK_VAL(r->raw, 15, 8);
+    r->desired_perf = MASK_VAL(r->raw, 23, 16);
+    r->epp = MASK_VAL(r->raw, 31, 24);
+    r->pkg_control = MASK_VAL(r->raw, 42, 42);
+    return 0;
+}
+
+int set_hwp_request_thread(unsigned socket, unsigned core, unsigned thread, const struct hwp_request *r)
+{
+#ifdef HAS_HWP
+    static struct hwp_data *hd = NULL;
+    uint64_t val;
+    int64_t idx;
+
+    if (hd == NULL)
+    {
+        hwp_storage(&hd);
+    }
+    idx = hwp_thread_index("set_hwp_request_thread", socket, core, thread);
+    if (idx < 0)
+    {
+        return -1;
+    }
+    if (r->epp >= 0 && !cpuid_hwp_epp_avail())
+    {
+        libmsr_error_handler("set_hwp_request_thread(): HWP energy/performance preference not available on this platform", LIBMSR_ERROR_PLATFORM_NOT_SUPPORTED, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    val = *hd->request[idx];
+    if (hwp_merge_request(&val, r, 0))
+    {
+        libmsr_error_handler("set_hwp_request_thread(): Invalid HWP request field", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    if (*hd->request[idx] != val)
+    {
+        *hd->request[idx] = val;
+        hd->request_dirty[idx] = 1;
+    }
+    return 0;
+#else
+    (void) r;
+    return hwp_thread_index("set_hwp_request_thread", socket, core, thread) < 0 ? -1 : 0;
+#endif
+}
+
+int set_hwp_epp_core(unsigned socket, unsigned core, int epp)
+{
+    static struct hwp_data *hd = NULL;
+    struct hwp_request r = {0, -1, -1, -1, epp, -1};
+    unsigned t;
+
+    if (hd == NULL)
+    {
+        hwp_storage(&hd);
+    }
+    if (epp < 0)
+    {
+        libmsr_error_handler("set_hwp_epp_core(): Invalid energy/performance preference", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    for (t = 0; t < hd->threads_per_core; t++)
+    {
+        if (set_hwp_request_thread(socket, core, t, &r))
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int set_hwp_request_pkg(unsigned socket, const struct hwp_request *r)
+{
+#ifdef HAS_HWP
+    static struct hwp_data *hd = NULL;
+    uint64_t val;
+
+    if (hd == NULL)
+    {
+        hwp_storage(&hd);
+    }
+    if (!hwp_enabled() || !cpuid_hwp_pkg_request_avail())
+    {
+        libmsr_error_handler("set_hwp_request_pkg(): Package-level HWP request not available on this platform", LIBMSR_ERROR_PLATFORM_NOT_SUPPORTED, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    if (socket >= num_sockets())
+    {
+        libmsr_error_handler("set_hwp_request_pkg(): Invalid socket", LIBMSR_ERROR_ARRAY_BOUNDS, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    val = *hd->pkg_request[socket];
+    if (hwp_merge_request(&val, r, 1))
+    {
+        libmsr_error_handler("set_hwp_request_pkg(): Invalid HWP request field", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    if (*hd->pkg_request[socket] != val)
+    {
+        *hd->pkg_request[socket] = val;
+        hd->pkg_request_dirty[socket] = 1;
+    }
+    return 0;
+#else
+    (void) socket;
+    (void) r;
+    libmsr_error_handler("set_hwp_request_pkg(): Package-level HWP request not available on this platform", LIBMSR_ERROR_PLATFORM_NOT_SUPPORTED, getenv("HOSTNAME"), __FILE__, __LINE__);
+    return -1;
+#endif
+}
+
+int set_energy_perf_bias_core(unsigned socket, unsigned core, int bias)
+{
+#ifdef HAS_HWP
+    static struct hwp_data *hd = NULL;
+    static uint64_t coresPerSocket = 0;
+    uint64_t idx, val;
+    unsigned t;
+
+    if (hd == NULL)
+    {
+        coresPerSocket = cores_per_socket();
+        hwp_storage(&hd);
+    }
+    if (!cpuid_energy_perf_bias_avail())
+    {
+        libmsr_error_handler("set_energy_perf_bias_core(): Energy/performance bias not available on this platform", LIBMSR_ERROR_PLATFORM_NOT_SUPPORTED, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    if (socket >= num_sockets() || core >= coresPerSocket)
+    {
+        libmsr_error_handler("set_energy_perf_bias_core(): Invalid socket or core", LIBMSR_ERROR_ARRAY_BOUNDS, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    if (bias < 0 || bias > 15)
+    {
+        libmsr_error_handler("set_energy_perf_bias_core(): Invalid energy/performance bias", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    for (t = 0; t < hd->threads_per_core; t++)
+    {
+        idx = (socket * coresPerSocket + core) * hd->threads_per_core + t;
+        val = (*hd->epb[idx] & ~0xFUL) | (uint64_t)bias;
+        if (*hd->epb[idx] != val)
+        {
+            *hd->epb[idx] = val;
+            hd->epb_dirty[idx] = 1;
+        }
+    }
+    return 0;
+#else
+    (void) socket;
+    (void) core;
+    (void) bias;
+    libmsr_error_handler("set_energy_perf_bias_core(): Energy/performance bias not available on this platform", LIBMSR_ERROR_PLATFORM_NOT_SUPPORTED, getenv("HOSTNAME"), __FILE__, __LINE__);
+    return -1;
+#endif
+}
+
+int commit_hwp_request(void)
+{
+#ifdef HAS_HWP
+    static struct hwp_data *hd = NULL;
+
+    if (hd == NULL)
+    {
+        hwp_storage(&hd);
+    }
+    if (hwp_enabled() && cpuid_hwp_pkg_request_avail())
+    {
+        /* Package requests go first so threads switching to package control
+         * pick up the new values. */
+        if (write_batch_sparse(HWP_REQUEST_PKG, hd->pkg_request_dirty))
+        {
+            return -1;
+        }
+        memset(hd->pkg_request_dirty, 0, num_sockets() * sizeof(uint8_t));
+    }
+    if (hwp_enabled())
+    {
+        if (write_batch_sparse(HWP_REQUEST, hd->request_dirty))
+        {
+            return -1;
+        }
+        memset(hd->request_dirty, 0, num_devs() * sizeof(uint8_t));
+    }
+    if (cpuid_energy_perf_bias_avail())
+    {
+        if (write_batch_sparse(ENERGY_PERF_BIAS, hd->epb_dirty))
+        {
+            return -1;
+        }
+        memset(hd->epb_dirty, 0, num_devs() * sizeof(uint8_t));
+    }
+    return 0;
+#else
+    libmsr_error_handler("commit_hwp_request(): HWP not available on this platform", LIBMSR_ERROR_PLATFORM_NOT_SUPPORTED, getenv("HOSTNAME"), __FILE__, __LINE__);
+    return -1;
+#endif
+}
+
+void dump_hwp(FILE *writedest)
+{
+    static uint64_t coresPerSocket = 0;
+    static uint64_t threadsPerCore = 0;
+    static uint64_t sockets = 0;
+    struct hwp_capabilities c;
+    struct hwp_request r;
+    unsigned s, co, t;
+
+    if (sockets == 0)
+    {
+        core_config(&coresPerSocket, &threadsPerCore, &sockets, NULL);
+    }
+    for (s = 0; s < sockets; s++)
+    {
+        for (co = 0; co < coresPerSocket; co++)
+        {
+            for (t = 0; t < threadsPerCore; t++)
+            {
+                if (!coord_in_subset(s, co, t))
+                {
+                    continue;
+                }
+                if (get_hwp_capabilities(s, co, t, &c) || get_hwp_request(s, co, t, &r))
+                {
+                    return;
+                }
+                fprintf(writedest, "Socket %u, Core %2u, Thread %u: caps %d/%d/%d/%d, request min %d max %d desired %d epp %d%s\n", s, co, t, c.lowest_perf, c.most_efficient_perf, c.guaranteed_perf, c.highest_perf, r.min_perf, r.max_perf, r.desired_perf, r.epp, r.pkg_control ? " (pkg)" : "");
+            }
+        }
+    }
+}
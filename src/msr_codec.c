@@ -0,0 +1,361 @@
+/*
+ * Copyright (c) 2013-2017, Lawrence Livermore National Security, LLC.
+ *
+ * Produced at the Lawrence Livermore National Laboratory. Written by:
+ *     Barry Rountree <rountree@llnl.gov>,
+ *     Scott Walker <walker91@llnl.gov>, and
+ *     Kathleen Shoga <shoga1@llnl.gov>.
+ *
+ * LLNL-CODE-645430
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr. For details, see https://github.com/LLNL/libmsr.git.
+ *
+ * Please also read libmsr/LICENSE for our notice and the LGPL.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License (as published by the Free
+ * Software Foundation) version 2.1 dated February 1999.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the IMPLIED WARRANTY OF MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the terms and conditions of the GNU Lesser
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "msr_codec.h"
+#include "libmsr_error.h"
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "msr_codec writes keyframes in host order, which must be little endian."
+#endif
+
+/// @brief Largest encoded size of one varint.
+#define VARINT_MAX 10
+
+static uint64_t zigzag(const uint64_t d)
+{
+    return (d << 1) ^ (uint64_t)((int64_t)d >> 63);
+}
+
+static uint64_t unzigzag(const uint64_t z)
+{
+    return (z >> 1) ^ (0 - (z & 1));
+}
+
+/// @brief Predict a value from the previous record.
+///
+/// @return Residual to store.
+static uint64_t residual(const uint8_t type, const uint64_t prev, const uint64_t cur)
+{
+    return (type == MSR_CODEC_XOR ? cur ^ prev : zigzag(cur - prev));
+}
+
+/// @brief Undo residual().
+///
+/// @return Reconstructed value.
+static uint64_t reconstruct(const uint8_t type, const uint64_t prev, const uint64_t r)
+{
+    return (type == MSR_CODEC_XOR ? prev ^ r : prev + unzigzag(r));
+}
+
+static uint8_t *put_varint(uint8_t *p, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        *p++ = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+/// @brief Read a varint.
+///
+/// @return Pointer past the varint, else NULL if it runs past end.
+static const uint8_t *get_varint(const uint8_t *p, const uint8_t *end, uint64_t *v)
+{
+    uint64_t x = 0;
+    int shift;
+
+    for (shift = 0; shift < 64 && p < end; shift += 7)
+    {
+        x |= (uint64_t)(*p & 0x7f) << shift;
+        if (!(*p++ & 0x80))
+        {
+            *v = x;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+/// @brief Pack n values at width bits each, least significant bit first.
+///
+/// @return Pointer past the packed bytes.
+static uint8_t *put_bits(uint8_t *p, const uint64_t *v, const unsigned n, const unsigned width)
+{
+    unsigned __int128 acc = 0;
+    unsigned nbits = 0;
+    unsigned i;
+
+    for (i = 0; i < n; i++)
+    {
+        acc |= (unsigned __int128)v[i] << nbits;
+        nbits += width;
+        while (nbits >= 8)
+        {
+            *p++ = (uint8_t)acc;
+            acc >>= 8;
+            nbits -= 8;
+        }
+    }
+    if (nbits)
+    {
+        *p++ = (uint8_t)acc;
+    }
+    return p;
+}
+
+/// @brief Unpack n values of width bits each into every stride-th element
+/// of v.
+///
+/// @return Pointer past the packed bytes, else NULL if they run past end.
+static const uint8_t *get_bits(const uint8_t *p, const uint8_t *end, uint64_t *v, const unsigned stride, const unsigned n, const unsigned width)
+{
+    unsigned __int128 acc = 0;
+    uint64_t mask = (width >= 64 ? ~0ULL : (1ULL << width) - 1);
+    unsigned nbits = 0;
+    unsigned i;
+
+    if ((size_t)(end - p) < ((size_t)n * width + 7) / 8)
+    {
+        return NULL;
+    }
+    for (i = 0; i < n; i++)
+    {
+        while (nbits < width)
+        {
+            acc |= (unsigned __int128)*p++ << nbits;
+            nbits += 8;
+        }
+        v[(size_t)i * stride] = (uint64_t)acc & mask;
+        acc >>= width;
+        nbits -= width;
+    }
+    return p;
+}
+
+int msr_codec_init(struct msr_codec *c, const unsigned ncols, const uint8_t *types, const unsigned block_records, const int flags)
+{
+    unsigned i;
+
+    memset(c, 0, sizeof(struct msr_codec));
+    if (ncols == 0 || block_records > MSR_CODEC_MAX_BLOCK_RECORDS)
+    {
+        libmsr_error_handler("msr_codec_init(): Column or block record count out of range", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    c->ncols = ncols;
+    c->block_records = (block_records ? block_records : MSR_CODEC_BLOCK_RECORDS);
+    c->flags = flags;
+    /* Plain calloc() rather than the libmsr memory handler, which is not
+     * thread safe and is torn down by finalize_msr(). */
+    c->types = (uint8_t *) calloc(ncols, sizeof(uint8_t));
+    if (c->types == NULL)
+    {
+        libmsr_error_handler("msr_codec_init(): Could not allocate codec buffers", LIBMSR_ERROR_MEMORY_ALLOCATION, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    for (i = 0; i < ncols; i++)
+    {
+        c->types[i] = (types != NULL ? types[i] : MSR_CODEC_DELTA);
+    }
+    c->pending = (uint64_t *) calloc((size_t)c->block_records * ncols, sizeof(uint64_t));
+    c->resid = (uint64_t *) calloc(c->block_records, sizeof(uint64_t));
+    c->out = (uint8_t *) calloc(msr_codec_max_block(c), sizeof(uint8_t));
+    if (c->pending == NULL || c->resid == NULL || c->out == NULL)
+    {
+        libmsr_error_handler("msr_codec_init(): Could not allocate codec buffers", LIBMSR_ERROR_MEMORY_ALLOCATION, getenv("HOSTNAME"), __FILE__, __LINE__);
+        msr_codec_free(c);
+        return -1;
+    }
+    return 0;
+}
+
+void msr_codec_free(struct msr_codec *c)
+{
+    if (c->types != NULL)
+    {
+        free(c->types);
+        free(c->pending);
+        free(c->resid);
+        free(c->out);
+    }
+    memset(c, 0, sizeof(struct msr_codec));
+}
+
+size_t msr_codec_max_block(const struct msr_codec *c)
+{
+    /* Keyframe, then a width byte per column plus a varint or 64 packed
+     * bits per residual. */
+    return MSR_CODEC_BLOCK_HDR + (size_t)c->ncols * (sizeof(uint64_t) + 1) + (size_t)c->block_records * c->ncols * VARINT_MAX;
+}
+
+/// @brief Encode the buffered records into c->out.
+static void encode_block(struct msr_codec *c)
+{
+    const unsigned n = c->npending;
+    const unsigned ncols = c->ncols;
+    uint8_t *p = c->out + MSR_CODEC_BLOCK_HDR;
+    uint64_t maxr;
+    uint32_t len;
+    uint16_t nrec = (uint16_t)n;
+    unsigned r, col, width;
+
+    memcpy(p, c->pending, ncols * sizeof(uint64_t));
+    p += ncols * sizeof(uint64_t);
+    if (c->flags & MSR_CODEC_BITPACK)
+    {
+        /* Column major, each column at its own width. */
+        for (col = 0; col < ncols; col++)
+        {
+            maxr = 0;
+            for (r = 1; r < n; r++)
+            {
+                c->resid[r - 1] = residual(c->types[col], c->pending[(r - 1) * ncols + col], c->pending[r * ncols + col]);
+                maxr |= c->resid[r - 1];
+            }
+            width = (maxr ? 64 - __builtin_clzll(maxr) : 0);
+            *p++ = (uint8_t)width;
+            p = put_bits(p, c->resid, n - 1, width);
+        }
+    }
+    else
+    {
+        /* Row major, so a partial block decodes record by record. */
+        for (r = 1; r < n; r++)
+        {
+            for (col = 0; col < ncols; col++)
+            {
+                p = put_varint(p, residual(c->types[col], c->pending[(r - 1) * ncols + col], c->pending[r * ncols + col]));
+            }
+        }
+    }
+    len = (uint32_t)(p - c->out);
+    memcpy(c->out, &len, sizeof(len));
+    memcpy(c->out + 4, &nrec, sizeof(nrec));
+    c->out[6] = (uint8_t)c->flags;
+    c->out[7] = 0;
+    c->outlen = len;
+    c->npending = 0;
+}
+
+int msr_codec_append(struct msr_codec *c, const uint64_t *rec)
+{
+    memcpy(&c->pending[(size_t)c->npending * c->ncols], rec, c->ncols * sizeof(uint64_t));
+    c->npending++;
+    if (c->npending < c->block_records)
+    {
+        return 0;
+    }
+    encode_block(c);
+    return 1;
+}
+
+int msr_codec_flush(struct msr_codec *c)
+{
+    if (c->npending == 0)
+    {
+        return 0;
+    }
+    encode_block(c);
+    return 1;
+}
+
+const uint8_t *msr_codec_block(const struct msr_codec *c, size_t *len)
+{
+    *len = c->outlen;
+    return c->out;
+}
+
+size_t msr_codec_block_len(const uint8_t *buf, unsigned *nrecords)
+{
+    uint32_t len;
+    uint16_t nrec;
+
+    memcpy(&len, buf, sizeof(len));
+    memcpy(&nrec, buf + 4, sizeof(nrec));
+    if (nrecords != NULL)
+    {
+        *nrecords = nrec;
+    }
+    return len;
+}
+
+int msr_codec_decode(const struct msr_codec *c, const uint8_t *buf, const size_t len, uint64_t *recs)
+{
+    const unsigned ncols = c->ncols;
+    const uint8_t *p = buf + MSR_CODEC_BLOCK_HDR;
+    const uint8_t *end;
+    uint64_t v;
+    unsigned n, r, col, width;
+
+    if (len < MSR_CODEC_BLOCK_HDR || msr_codec_block_len(buf, &n) > len || n == 0 || n > c->block_records)
+    {
+        return -1;
+    }
+    end = buf + msr_codec_block_len(buf, NULL);
+    if (end < p || (size_t)(end - p) < ncols * sizeof(uint64_t))
+    {
+        return -1;
+    }
+    memcpy(recs, p, ncols * sizeof(uint64_t));
+    p += ncols * sizeof(uint64_t);
+    if (buf[6] & MSR_CODEC_BITPACK)
+    {
+        for (col = 0; col < ncols; col++)
+        {
+            if (p >= end || (width = *p++) > 64)
+            {
+                return -1;
+            }
+            /* Unpack the residuals in place, then replace each with its
+             * value. */
+            p = get_bits(p, end, &recs[ncols + col], ncols, n - 1, width);
+            if (p == NULL)
+            {
+                return -1;
+            }
+            for (r = 1; r < n; r++)
+            {
+                recs[r * ncols + col] = reconstruct(c->types[col], recs[(r - 1) * ncols + col], recs[r * ncols + col]);
+            }
+        }
+    }
+    else
+    {
+        for (r = 1; r < n; r++)
+        {
+            for (col = 0; col < ncols; col++)
+            {
+                p = get_varint(p, end, &v);
+                if (p == NULL)
+                {
+                    return -1;
+                }
+                recs[r * ncols + col] = reconstruct(c->types[col], recs[(r - 1) * ncols + col], v);
+            }
+        }
+    }
+    return (int)n;
+}
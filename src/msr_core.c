@@ -30,12 +30,16 @@
 
 // Necessary for pread & pwrite.
 #define _XOPEN_SOURCE 500
+// Necessary for sched_getaffinity.
+#define _GNU_SOURCE
 
 #include <errno.h>
 #include <fcntl.h>
 #include <hwloc.h>
+#include <pthread.h>
 #include <linux/ioctl.h>
 #include <linux/types.h>
+#include <sched.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -48,12 +52,182 @@
 #include "msr_core.h"
 #include "memhdlr.h"
 #include "msr_counters.h"
+#include "msr_latency.h"
 #include "cpuid.h"
 #include "libmsr_error.h"
 #include "libmsr_debug.h"
 
 static struct topo g_topo_list;
 
+/// @brief Structure holding the state of the MSR core layer.
+struct msr_core_state
+{
+    /// @brief Number of sockets.
+    uint64_t sockets;
+    /// @brief Number of cores per socket.
+    uint64_t cores_per_socket;
+    /// @brief Number of threads per core.
+    uint64_t threads_per_core;
+    /// @brief Number of logical processors.
+    uint64_t ndevs;
+    /// @brief libmsr_open_mode_e mode used by init_msr().
+    int open_mode;
+    /// @brief MSR module in use, 0 is msr_safe, 1 is msr.
+    int kerneltype;
+    /// @brief Non-zero once init_msr() succeeded.
+    int init;
+    /// @brief File descriptor of each logical processor, -1 if not open.
+    int *fds;
+    /// @brief File descriptor of the msr_batch driver, 0 if not probed yet
+    /// and -1 if unavailable.
+    int batchfd;
+    /// @brief Batches, indexed by libmsr_data_type_e.
+    struct msr_batch_array *batches;
+    /// @brief Capacity of each batch.
+    unsigned *batch_sizes;
+    /// @brief Number of entries in batches, batch_sizes, batch_slots and
+    /// batch_parked.
+    unsigned nbatches;
+    /// @brief Load order index of each submitted operation of a batch, so
+    /// sparse write masks line up when unselected CPUs are left out.
+    unsigned **batch_slots;
+    /// @brief Number of operations on unselected CPUs in each batch. They are
+    /// kept at the end of the operation array and never submitted.
+    unsigned *batch_parked;
+    /// @brief Selected CPUs, NULL when every CPU is selected.
+    uint8_t *cpu_subset;
+    /// @brief Sockets with a selected CPU, NULL when every CPU is selected.
+    uint8_t *socket_subset;
+    /// @brief Logical processor used for socket-scope accesses of each
+    /// socket, NULL until first use.
+    int *socket_devs;
+    /// @brief Selected CPUs in ascending order, NULL until first use.
+    uint64_t *subset_list;
+    /// @brief Number of entries in subset_list.
+    uint64_t subset_count;
+    /// @brief Scratch operations used to submit several batches merged by
+    /// read_batches().
+    struct msr_batch_op *merged_ops;
+    /// @brief Capacity of merged_ops.
+    unsigned merged_capacity;
+};
+
+static struct msr_core_state g_core;
+
+/// @brief Only thread allowed to access MSRs, valid when g_owned is set.
+static pthread_t g_owner;
+
+/// @brief Non-zero while access is restricted to g_owner.
+static int g_owned = 0;
+
+/// @brief Allocate zeroed memory owned by the MSR core state.
+///
+/// The state lives outside the memory handler, which is not thread safe, so
+/// sampler threads can grow scratch batches.
+///
+/// @param [in] num Number of elements.
+///
+/// @param [in] size Size of each element.
+///
+/// @return Pointer to the memory, exits if it could not be allocated.
+static void *core_calloc(size_t num, size_t size)
+{
+    void *result = calloc(num, size);
+
+    if (result == NULL)
+    {
+        libmsr_error_handler("core_calloc(): calloc failed.", LIBMSR_ERROR_MEMORY_ALLOCATION, getenv("HOSTNAME"), __FILE__, __LINE__);
+        exit(-1);
+    }
+    return result;
+}
+
+/// @brief Resize memory owned by the MSR core state.
+///
+/// @param [in] addr Memory from core_calloc().
+///
+/// @param [in] size New size in bytes.
+///
+/// @return Pointer to the memory, exits if it could not be allocated.
+static void *core_realloc(void *addr, size_t size)
+{
+    void *result = realloc(addr, size);
+
+    if (result == NULL)
+    {
+        libmsr_error_handler("core_realloc(): realloc failed.", LIBMSR_ERROR_MEMORY_ALLOCATION, getenv("HOSTNAME"), __FILE__, __LINE__);
+        exit(-1);
+    }
+    return result;
+}
+
+/// @brief Release the memory of the MSR core state.
+///
+/// @param [in] cs MSR core state.
+static void core_release(struct msr_core_state *cs)
+{
+    unsigned i;
+
+    for (i = 0; i < cs->nbatches; i++)
+    {
+        free(cs->batches[i].ops);
+        free(cs->batch_slots[i]);
+    }
+    free(cs->batches);
+    free(cs->batch_sizes);
+    free(cs->batch_slots);
+    free(cs->batch_parked);
+    free(cs->cpu_subset);
+    free(cs->socket_subset);
+    free(cs->socket_devs);
+    free(cs->subset_list);
+    free(cs->merged_ops);
+    free(cs->fds);
+}
+
+/// @brief Fill the topology counts of the MSR core state and allocate its
+/// file descriptor table.
+///
+/// @param [out] cs MSR core state.
+static void core_setup(struct msr_core_state *cs)
+{
+    uint64_t i;
+
+    core_config(&cs->cores_per_socket, &cs->threads_per_core, &cs->sockets, NULL);
+    cs->ndevs = cs->sockets * cs->cores_per_socket * cs->threads_per_core;
+    cs->fds = (int *) core_calloc(cs->ndevs, sizeof(int));
+    for (i = 0; i < cs->ndevs; i++)
+    {
+        cs->fds[i] = -1;
+    }
+}
+
+/// @brief Retrieve the MSR core state, setting it up on first use.
+///
+/// @return Pointer to the MSR core state.
+static struct msr_core_state *core_state(void)
+{
+    if (g_core.fds == NULL)
+    {
+        core_setup(&g_core);
+    }
+    return &g_core;
+}
+
+/// @brief Header of the topology cache file, followed by one struct hwthread
+/// per logical processor.
+struct topo_cache_hdr
+{
+    char magic[8];
+    uint32_t version;
+    char boot_id[40];
+    uint32_t nsockets;
+    uint32_t ncores;
+    uint32_t nthreads;
+    uint32_t discontinuous;
+    uint64_t cpu_key;
+};
+
 /// @brief Retrieve unique index of a logical processor.
 ///
 /// For a dual socket system, maps cores on socket 1 to a continuous index
@@ -70,18 +244,17 @@ static struct topo g_topo_list;
 /// @return Number of logical processors, else -1.
 static uint64_t devidx(int socket, int core, int thread)
 {
-    uint64_t num_sockets, num_cores_per_socket, num_threads_per_core;
+    struct msr_core_state *cs = core_state();
 
-    core_config(&num_cores_per_socket, &num_threads_per_core, &num_sockets, NULL);
     if (!g_topo_list.discontinuous_mapping)
     {
         // continuous mapping
-        return (thread * num_sockets * num_cores_per_socket) + (socket * num_cores_per_socket) + core;
+        return (thread * cs->sockets * cs->cores_per_socket) + (socket * cs->cores_per_socket) + core;
     }
     else
     {
         // discontinuous mapping
-        return (thread * num_sockets * num_cores_per_socket) + (core * num_sockets) + socket;
+        return (thread * cs->sockets * cs->cores_per_socket) + (core * cs->sockets) + socket;
     }
     return -1;
 }
@@ -93,23 +266,294 @@ static uint64_t devidx(int socket, int core, int thread)
 /// @return Unique file descriptor, else NULL.
 static int *core_fd(const int dev_idx)
 {
+    struct msr_core_state *cs = core_state();
+
+    if (dev_idx >= 0 && dev_idx < cs->ndevs)
+    {
+        return &(cs->fds[dev_idx]);
+    }
+    libmsr_error_handler("core_fd(): Array reference out of bounds", LIBMSR_ERROR_ARRAY_BOUNDS, getenv("HOSTNAME"), __FILE__, __LINE__);
+    return NULL;
+}
+
+/// @brief Get the directory holding the MSR device files.
+///
+/// @return Value of LIBMSR_DEV_DIR if set, else MSR_DEV_DIR.
+static const char *msr_dev_dir(void)
+{
+    const char *env = getenv("LIBMSR_DEV_DIR");
+
+    return ((env != NULL && *env) ? env : MSR_DEV_DIR);
+}
+
+/// @brief Check that the calling thread may access MSRs.
+///
+/// @param [in] caller Name of the calling function, for the error message.
+///
+/// @return 0 if allowed, else -1 if another thread owns the MSR core layer.
+static int owner_check(const char *caller)
+{
+    char msg[128];
+
+    if (__atomic_load_n(&g_owned, __ATOMIC_ACQUIRE) && !pthread_equal(g_owner, pthread_self()))
+    {
+        snprintf(msg, sizeof(msg), "%s: MSR access is owned by another thread (see set_msr_owner())", caller);
+        libmsr_error_handler(msg, LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    return 0;
+}
+
+/// @brief Retrieve file descriptor per logical processor, opening the device
+/// file first in MSR_OPEN_LAZY mode.
+///
+/// @param [in] dev_idx Unique logical processor identifier.
+///
+/// @return Unique file descriptor, else NULL if out of bounds or the device
+/// file could not be opened.
+static int *dev_fd(const int dev_idx)
+{
+    char filename[FILENAME_SIZE];
+    int *fileDescriptor = core_fd(dev_idx);
+
+    if (owner_check("dev_fd()"))
+    {
+        return NULL;
+    }
+    if (!cpu_in_subset(dev_idx))
+    {
+        libmsr_error_handler("dev_fd(): CPU is not in the CPU subset", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return NULL;
+    }
+    if (fileDescriptor != NULL && *fileDescriptor < 0 && core_state()->open_mode == MSR_OPEN_LAZY)
+    {
+        snprintf(filename, FILENAME_SIZE, (core_state()->kerneltype ? "%s/%d/msr" : "%s/%d/msr_safe"), msr_dev_dir(), dev_idx);
+        *fileDescriptor = open(filename, O_RDWR);
+        if (*fileDescriptor < 0)
+        {
+            libmsr_error_handler("dev_fd(): Could not open file", LIBMSR_ERROR_MSR_OPEN, getenv("HOSTNAME"), __FILE__, __LINE__);
+            return NULL;
+        }
+    }
+    return fileDescriptor;
+}
+
+/// @brief Get the topology cache file name.
+///
+/// @param [out] path Buffer of FILENAME_SIZE bytes.
+///
+/// @return 0 if successful, else -1 if the cache is disabled.
+static int topo_cache_path(char *path)
+{
+    const char *env = getenv("LIBMSR_TOPO_CACHE");
+
+    if (env != NULL)
+    {
+        if (env[0] == '\0')
+        {
+            return -1;
+        }
+        snprintf(path, FILENAME_SIZE, "%s", env);
+        return 0;
+    }
+    snprintf(path, FILENAME_SIZE, TOPO_CACHE_PATH, (unsigned) geteuid());
+    return 0;
+}
+
+/// @brief Read the boot ID of the running kernel.
+///
+/// @param [out] boot_id Buffer of 40 bytes, NUL padded.
+///
+/// @return 0 if successful, else -1.
+static int read_boot_id(char *boot_id)
+{
+    ssize_t len;
+    int fd;
+
+    memset(boot_id, 0, 40);
+    fd = open(BOOT_ID_FILE, O_RDONLY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    len = read(fd, boot_id, 39);
+    close(fd);
+    if (len <= 0)
+    {
+        return -1;
+    }
+    boot_id[strcspn(boot_id, "\n")] = '\0';
+    return 0;
+}
+
+/// @brief Hash the CPUs the topology was discovered on.
+///
+/// hwloc only reports the online CPUs the process is allowed to run on, so
+/// the online list and the affinity mask are both part of the cache key.
+///
+/// @param [out] key FNV-1a hash of the online CPU list and affinity mask.
+///
+/// @return 0 if successful, else -1.
+static int read_cpu_key(uint64_t *key)
+{
+    char online[FILENAME_SIZE];
+    cpu_set_t affinity;
+    const unsigned char *p;
+    ssize_t len;
+    size_t i;
+    int fd;
+
+    if (sched_getaffinity(0, sizeof(affinity), &affinity))
+    {
+        return -1;
+    }
+    fd = open(CPU_ONLINE_FILE, O_RDONLY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    len = read(fd, online, sizeof(online));
+    close(fd);
+    if (len <= 0)
+    {
+        return -1;
+    }
+    *key = 0xcbf29ce484222325ULL;
+    for (i = 0; i < (size_t) len; i++)
+    {
+        *key = (*key ^ (unsigned char) online[i]) * 0x100000001b3ULL;
+    }
+    p = (const unsigned char *) &affinity;
+    for (i = 0; i < sizeof(affinity); i++)
+    {
+        *key = (*key ^ p[i]) * 0x100000001b3ULL;
+    }
+    return 0;
+}
+
+/// @brief Load the topology from the cache file.
+///
+/// The cache is only used if it is owned by the effective user, matches
+/// TOPO_CACHE_VERSION, was written since the last reboot and was built from
+/// the same online CPUs and affinity mask.
+///
+/// @param [out] nsockets Number of sockets.
+///
+/// @param [out] ncores Number of cores.
+///
+/// @param [out] nthreads Number of logical processors.
+///
+/// @return 0 if the cache was loaded into g_topo_list, else -1.
+static int topo_cache_load(int *nsockets, int *ncores, int *nthreads)
+{
+    char path[FILENAME_SIZE];
+    char boot_id[40];
+    struct topo_cache_hdr hdr;
+    struct hwthread *map;
+    struct stat statbuf;
+    uint64_t cpu_key;
+    size_t mapsize;
+    int fd;
+
+    if (topo_cache_path(path) || read_boot_id(boot_id) || read_cpu_key(&cpu_key))
+    {
+        return -1;
+    }
+    fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    if (fstat(fd, &statbuf) || statbuf.st_uid != geteuid() ||
+        read(fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+        memcmp(hdr.magic, "LIBMSRT", 8) || hdr.version != TOPO_CACHE_VERSION ||
+        memcmp(hdr.boot_id, boot_id, sizeof(boot_id)) || hdr.cpu_key != cpu_key ||
+        hdr.nsockets == 0 || hdr.ncores == 0 || hdr.nthreads == 0 ||
+        statbuf.st_size != sizeof(hdr) + (off_t) hdr.nthreads * sizeof(struct hwthread))
+    {
+        close(fd);
+        return -1;
+    }
+    mapsize = hdr.nthreads * sizeof(struct hwthread);
+    map = (struct hwthread *) malloc(mapsize);
+    if (read(fd, map, mapsize) != (ssize_t) mapsize)
+    {
+        free(map);
+        close(fd);
+        return -1;
+    }
+    close(fd);
+    g_topo_list.thread_map = map;
+    g_topo_list.discontinuous_mapping = hdr.discontinuous;
+    *nsockets = hdr.nsockets;
+    *ncores = hdr.ncores;
+    *nthreads = hdr.nthreads;
+#ifdef TOPOLOGY_DEBUG
+    printf("loaded topology cache %s\n", path);
+#endif
+    return 0;
+}
+
+/// @brief Write the topology in g_topo_list to the cache file.
+///
+/// The file is written under a temporary name and renamed, so concurrent
+/// readers never see a partial cache. Failures are silently ignored.
+///
+/// @param [in] nsockets Number of sockets.
+///
+/// @param [in] ncores Number of cores.
+///
+/// @param [in] nthreads Number of logical processors.
+static void topo_cache_store(int nsockets, int ncores, int nthreads)
+{
+    char path[FILENAME_SIZE];
+    char tmppath[FILENAME_SIZE + 16];
+    struct topo_cache_hdr hdr;
+    size_t mapsize = nthreads * sizeof(struct hwthread);
+    int fd;
+    int ok;
+
+    memset(&hdr, 0, sizeof(hdr));
+    if (topo_cache_path(path) || read_boot_id(hdr.boot_id) || read_cpu_key(&hdr.cpu_key))
+    {
+        return;
+    }
+    memcpy(hdr.magic, "LIBMSRT", 8);
+    hdr.version = TOPO_CACHE_VERSION;
+    hdr.nsockets = nsockets;
+    hdr.ncores = ncores;
+    hdr.nthreads = nthreads;
+    hdr.discontinuous = g_topo_list.discontinuous_mapping;
+
+    snprintf(tmppath, sizeof(tmppath), "%s.%d", path, (int) getpid());
+    fd = open(tmppath, O_WRONLY | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if (fd < 0)
+    {
+        return;
+    }
+    ok = (write(fd, &hdr, sizeof(hdr)) == sizeof(hdr) && write(fd, g_topo_list.thread_map, mapsize) == (ssize_t) mapsize);
+    close(fd);
+    if (!ok || rename(tmppath, path))
+    {
+        unlink(tmppath);
+    }
+}
+
+/// @brief Retrieve the hwloc topology, loading it on first call.
+///
+/// @return Pointer to loaded hwloc topology.
+static hwloc_topology_t *hwloc_storage(void)
+{
+    static hwloc_topology_t topology;
     static int init = 0;
-    static int *file_descriptors = NULL;
-    static uint64_t devices = 0;
 
     if (!init)
     {
+        hwloc_topology_init(&topology);
+        hwloc_topology_load(topology);
         init = 1;
-        uint64_t numDevs = num_devs();;
-        devices = numDevs;
-        file_descriptors = (int *) libmsr_malloc(devices * sizeof(int));
-    }
-    if (dev_idx < devices)
-    {
-        return &(file_descriptors[dev_idx]);
     }
-    libmsr_error_handler("core_fd(): Array reference out of bounds", LIBMSR_ERROR_ARRAY_BOUNDS, getenv("HOSTNAME"), __FILE__, __LINE__);
-    return NULL;
+    return &topology;
 }
 
 /// @brief Allocate space for batch arrays.
@@ -120,58 +564,82 @@ static int *core_fd(const int dev_idx)
 ///
 /// @param [out] opssize Size of specific set of batch operations.
 ///
-/// @return 0 if successful, else NULL pointer as a result of libmsr_calloc(),
-/// libmsr_malloc(), or libmsr_realloc().
+/// @return 0 if successful.
 static int batch_storage(struct msr_batch_array **batchsel, const int batchnum, unsigned **opssize)
 {
-    static struct msr_batch_array *batch = NULL;
-    static unsigned arrsize = 1;
-    static unsigned *size = NULL;
+    struct msr_core_state *cs = core_state();
     int i;
 
-    if (batch == NULL)
+    if (cs->batches == NULL)
     {
 #ifdef BATCH_DEBUG
         fprintf(stderr, "BATCH: initializing batch ops\n");
 #endif
-        arrsize = (batchnum + 1 > arrsize ? batchnum + 1 : arrsize);
-        size = (unsigned *) libmsr_calloc(arrsize, sizeof(unsigned));
-        batch = (struct msr_batch_array *) libmsr_calloc(arrsize, sizeof(struct msr_batch_array));
-        for (i = 0; i < arrsize; i++)
+        cs->nbatches = (batchnum + 1 > 1 ? batchnum + 1 : 1);
+        cs->batch_sizes = (unsigned *) core_calloc(cs->nbatches, sizeof(unsigned));
+        cs->batches = (struct msr_batch_array *) core_calloc(cs->nbatches, sizeof(struct msr_batch_array));
+        cs->batch_slots = (unsigned **) core_calloc(cs->nbatches, sizeof(unsigned *));
+        cs->batch_parked = (unsigned *) core_calloc(cs->nbatches, sizeof(unsigned));
+        for (i = 0; i < cs->nbatches; i++)
         {
-            size[i] = 0;
-            batch[i].ops = NULL;
-            batch[i].numops = 0;
+            cs->batch_sizes[i] = 0;
+            cs->batches[i].ops = NULL;
+            cs->batches[i].numops = 0;
         }
     }
-    if (batchnum + 1 > arrsize)
+    if (batchnum + 1 > cs->nbatches)
     {
 #ifdef BATCH_DEBUG
         fprintf(stderr, "BATCH: reallocating array of batches for batch %d\n", batchnum);
 #endif
-        unsigned oldsize = arrsize;
-        arrsize = batchnum + 1;
-        batch = (struct msr_batch_array *) libmsr_realloc(batch, arrsize * sizeof(struct msr_batch_array));
-        size = (unsigned *) libmsr_realloc(size, arrsize * sizeof(unsigned));
-        for (; oldsize < arrsize; oldsize++)
+        unsigned oldsize = cs->nbatches;
+        cs->nbatches = batchnum + 1;
+        cs->batches = (struct msr_batch_array *) core_realloc(cs->batches, cs->nbatches * sizeof(struct msr_batch_array));
+        cs->batch_sizes = (unsigned *) core_realloc(cs->batch_sizes, cs->nbatches * sizeof(unsigned));
+        cs->batch_slots = (unsigned **) core_realloc(cs->batch_slots, cs->nbatches * sizeof(unsigned *));
+        cs->batch_parked = (unsigned *) core_realloc(cs->batch_parked, cs->nbatches * sizeof(unsigned));
+        for (; oldsize < cs->nbatches; oldsize++)
         {
-            batch[oldsize].ops = NULL;
-            batch[oldsize].numops = 0;
-            size[oldsize] = 0;
+            cs->batches[oldsize].ops = NULL;
+            cs->batches[oldsize].numops = 0;
+            cs->batch_sizes[oldsize] = 0;
+            cs->batch_slots[oldsize] = NULL;
+            cs->batch_parked[oldsize] = 0;
         }
     }
     if (batchsel == NULL)
     {
         libmsr_error_handler("batch_storage(): Loading uninitialized batch", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
     }
-    *batchsel = &batch[batchnum];
+    *batchsel = &cs->batches[batchnum];
     if (opssize != NULL)
     {
-        *opssize = &size[batchnum];
+        *opssize = &cs->batch_sizes[batchnum];
     }
     return 0;
 }
 
+/// @brief Open the msr_batch driver on first use.
+///
+/// @param [in] cs MSR core state owning the file descriptor.
+///
+/// @return File descriptor, else -1 if the driver is unavailable.
+static int batch_fd(struct msr_core_state *cs)
+{
+    char filename[FILENAME_SIZE];
+
+    if (cs->batchfd == 0)
+    {
+        snprintf(filename, FILENAME_SIZE, "%s/msr_batch", msr_dev_dir());
+        if ((cs->batchfd = open(filename, O_RDWR)) < 0)
+        {
+            perror(filename);
+            cs->batchfd = -1;
+        }
+    }
+    return cs->batchfd;
+}
+
 /// @brief Default to pread/pwrite if msr_batch driver does not exist.
 ///
 /// @param [in] batchnum libmsr_data_type_e data type of batch operation.
@@ -181,25 +649,34 @@ static int batch_storage(struct msr_batch_array **batchsel, const int batchnum,
 /// @return 0 if successful, else -1 if batch_storage() fails.
 static int compatibility_batch(int batchnum, int type)
 {
+    static int warned = 0;
     struct msr_batch_array *batch = NULL;
+    uint64_t start;
+    unsigned nerr = 0;
     int i;
 
-    fprintf(stderr, "Warning: <libmsr> No /dev/cpu/msr_batch, using compatibility batch: compatibility_batch(): %s: %s:%s::%d\n", strerror(errno), getenv("HOSTNAME"), __FILE__, __LINE__);
+    if (!warned)
+    {
+        fprintf(stderr, "Warning: <libmsr> No /dev/cpu/msr_batch, using compatibility batch: compatibility_batch(): %s: %s:%s::%d\n", strerror(errno), getenv("HOSTNAME"), __FILE__, __LINE__);
+        warned = 1;
+    }
     if (batch_storage(&batch, batchnum, NULL))
     {
         return -1;
     }
+    start = lat_now();
     for (i = 0; i < batch->numops; i++)
     {
         if (type == BATCH_READ)
         {
-            read_msr_by_idx(batch->ops[i].cpu, batch->ops[i].msr, (uint64_t *) &batch->ops[i].msrdata);
+            nerr += (read_msr_by_idx(batch->ops[i].cpu, batch->ops[i].msr, (uint64_t *) &batch->ops[i].msrdata) != 0);
         }
         else
         {
-            write_msr_by_idx(batch->ops[i].cpu, batch->ops[i].msr, (uint64_t)batch->ops[i].msrdata);
+            nerr += (write_msr_by_idx(batch->ops[i].cpu, batch->ops[i].msr, (uint64_t)batch->ops[i].msrdata) != 0);
         }
     }
+    lat_record(LAT_MSR_COMPAT_BATCH, batchnum, start, batch->numops, nerr);
     return 0;
 }
 
@@ -214,23 +691,21 @@ static int compatibility_batch(int batchnum, int type)
 /// allocation is for 0 or less operations.
 static int do_batch_op(int batchnum, int type)
 {
-    static int batchfd = 0;
+    struct msr_core_state *cs = core_state();
     struct msr_batch_array *batch = NULL;
+    uint64_t start;
+    unsigned nerr = 0;
     int res = 0;
     int i, j;
 
-    if (batchfd == 0)
+    if (owner_check("do_batch_op()"))
     {
-        if ((batchfd = open(MSR_BATCH_DIR, O_RDWR)) < 0)
-        {
-            perror(MSR_BATCH_DIR);
-            batchfd = -1;
-        }
+        return -1;
     }
 #ifdef USE_NO_BATCH
     return compatibility_batch(batchnum, type);
 #endif
-    if (batchfd < 0)
+    if (batch_fd(cs) < 0)
     {
         return compatibility_batch(batchnum, type);
     }
@@ -241,6 +716,11 @@ static int do_batch_op(int batchnum, int type)
 #ifdef BATCH_DEBUG
     fprintf(stderr, "BATCH %d: %s MSRs, numops %u\n", batchnum, (type == BATCH_READ ? "reading" : "writing"), batch->numops);
 #endif
+    if (batch->numops == 0 && cs->batch_parked[batchnum] > 0)
+    {
+        /* Every operation targets a CPU outside the subset. */
+        return 0;
+    }
     if (batch->numops <= 0)
     {
         libmsr_error_handler("do_batch_op(): Using empty batch", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
@@ -256,7 +736,8 @@ static int do_batch_op(int batchnum, int type)
             batch->ops[j].isrdmsr = readflag;
         }
     }
-    res = ioctl(batchfd, X86_IOC_MSR_BATCH, batch);
+    start = lat_now();
+    res = ioctl(cs->batchfd, X86_IOC_MSR_BATCH, batch);
     if (res < 0)
     {
         libmsr_error_handler("do_batch_op(): IOctl failed, does /dev/cpu/msr_batch exist?", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
@@ -264,10 +745,16 @@ static int do_batch_op(int batchnum, int type)
         {
             if (batch->ops[i].err)
             {
+                nerr++;
                 fprintf(stderr, "Operation failed on CPU %d, MSR 0x%x, ERR (%s)\n", batch->ops[i].cpu, batch->ops[i].msr, strerror(batch->ops[i].err));
             }
         }
+        if (nerr == 0)
+        {
+            nerr = 1;
+        }
     }
+    lat_record(LAT_MSR_BATCH, batchnum, start, batch->numops, nerr);
 #ifdef BATCH_DEBUG
     int k;
     for (k = 0; k < batch->numops; k++)
@@ -290,14 +777,17 @@ int find_cpu_top(void)
     hwloc_obj_t pu_obj, core_obj, socket_obj;
     unsigned int core_depth, socket_depth;
 
-    hwloc_topology_init(&topology);
-    hwloc_topology_load(topology);
+    /* core_config() fills the thread map when the topology cache is valid. */
+    core_config(&cores_per_socket, &threads_per_core, &nsockets, NULL);
+    if (g_topo_list.thread_map != NULL)
+    {
+        return 1;
+    }
 
+    topology = *hwloc_storage();
     core_depth = hwloc_get_type_depth(topology, HWLOC_OBJ_CORE);
     socket_depth = hwloc_get_type_depth(topology, HWLOC_OBJ_SOCKET);
 
-    core_config(&cores_per_socket, &threads_per_core, &nsockets, NULL);
-
     nthreads = cores_per_socket * threads_per_core * nsockets;
     g_topo_list.thread_map = (struct hwthread*) malloc(nthreads * sizeof(struct hwthread));
 
@@ -329,63 +819,31 @@ int find_cpu_top(void)
 #ifdef TOPOLOGY_DEBUG
     printf("discontinuous mapping = %d\n", g_topo_list.discontinuous_mapping);
 #endif
+    topo_cache_store(nsockets, cores_per_socket * nsockets, nthreads);
 
     return 1;
 }
 
 uint64_t num_cores(void)
 {
-    static uint64_t coresPerSocket = 0;
-    static uint64_t sockets = 0;
-    static int init = 0;
+    struct msr_core_state *cs = core_state();
 
-    if (!init)
-    {
-        core_config(&coresPerSocket, NULL, &sockets, NULL);
-        init = 1;
-    }
-    return coresPerSocket * sockets;
+    return cs->cores_per_socket * cs->sockets;
 }
 
 uint64_t num_sockets(void)
 {
-    static uint64_t sockets = 0;
-    static int init = 0;
-
-    if (!init)
-    {
-        core_config(NULL, NULL, &sockets, NULL);
-        init = 1;
-    }
-    return sockets;
+    return core_state()->sockets;
 }
 
 uint64_t num_devs(void)
 {
-    static uint64_t coresPerSocket = 0;
-    static uint64_t threadsPerCore = 0;
-    static uint64_t sockets = 0;
-    static int init = 0;
-
-    if (!init)
-    {
-        core_config(&coresPerSocket, &threadsPerCore, &sockets, NULL);
-        init = 1;
-    }
-    return coresPerSocket * threadsPerCore * sockets;
+    return core_state()->ndevs;
 }
 
 uint64_t cores_per_socket(void)
 {
-    static uint64_t coresPerSocket = 0;
-    static int init = 0;
-
-    if (!init)
-    {
-        core_config(&coresPerSocket, NULL, NULL, NULL);
-        init = 1;
-    }
-    return coresPerSocket;
+    return core_state()->cores_per_socket;
 }
 
 int allocate_batch(int batchnum, size_t bsize)
@@ -412,7 +870,9 @@ int allocate_batch(int batchnum, size_t bsize)
 #ifdef MEMHDLR_DEBUG
     fprintf(stderr, "MEMHDLR: size of batch %d is %d\n", batchnum, *size);
 #endif
-    batch->ops = (struct msr_batch_op *) libmsr_calloc(*size, sizeof(struct msr_batch_op));
+    batch->ops = (struct msr_batch_op *) core_calloc(*size, sizeof(struct msr_batch_op));
+    core_state()->batch_slots[batchnum] = (unsigned *) core_calloc(*size, sizeof(unsigned));
+    core_state()->batch_parked[batchnum] = 0;
     for (i = batch->numops; i < *size; i++)
     {
         batch->ops[i].err = 0;
@@ -423,24 +883,28 @@ int allocate_batch(int batchnum, size_t bsize)
 int free_batch(int batchnum)
 {
     struct msr_batch_array *batch = NULL;
-    static unsigned *size = NULL;
+    unsigned *size = NULL;
 
-    if (batch == NULL)
+    if (batch_storage(&batch, batchnum, &size))
     {
-        if (batch_storage(&batch, batchnum, &size))
-        {
-            return -1;
-        }
+        return -1;
     }
-    size[batchnum] = 0;
-    libmsr_free(batch[batchnum].ops);
+    *size = 0;
+    free(batch->ops);
+    batch->ops = NULL;
+    batch->numops = 0;
+    free(core_state()->batch_slots[batchnum]);
+    core_state()->batch_slots[batchnum] = NULL;
+    core_state()->batch_parked[batchnum] = 0;
     return 0;
 }
 
 int create_batch_op(off_t msr, uint64_t cpu, uint64_t **dest, const int batchnum)
 {
     struct msr_batch_array *batch = NULL;
+    struct msr_batch_op *op;
     unsigned *size = NULL;
+    unsigned *parked;
 
 #ifdef BATCH_DEBUG
     fprintf(stderr, "BATCH: creating new batch operation\n");
@@ -453,20 +917,33 @@ int create_batch_op(off_t msr, uint64_t cpu, uint64_t **dest, const int batchnum
 #ifdef BATCH_DEBUG
     fprintf(stderr, "BATCH: batch %d is at %p\n", batchnum, batch);
 #endif
-    if (batch->numops > *size)
+    parked = &core_state()->batch_parked[batchnum];
+    if (batch->numops + *parked >= *size)
     {
         libmsr_error_handler("create_batch_op(): Batch is full, you likely used the wrong size", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
         return -1;
     }
 
-    batch->numops++;
-    batch->ops[batch->numops-1].msr = msr;
-    batch->ops[batch->numops-1].cpu = (__u16) cpu;
-    batch->ops[batch->numops-1].isrdmsr = (__u8) 1;
-    batch->ops[batch->numops-1].err = 0;
-    *dest = (uint64_t *) &batch->ops[batch->numops - 1].msrdata;
+    if (!cpu_in_subset(cpu))
+    {
+        /* Fill unselected CPUs from the end of the array, so the caller gets
+         * private storage but the operation is never submitted. */
+        (*parked)++;
+        op = &batch->ops[*size - *parked];
+    }
+    else
+    {
+        core_state()->batch_slots[batchnum][batch->numops] = batch->numops + *parked;
+        op = &batch->ops[batch->numops];
+        batch->numops++;
+    }
+    op->msr = msr;
+    op->cpu = (__u16) cpu;
+    op->isrdmsr = (__u8) 1;
+    op->err = 0;
+    *dest = (uint64_t *) &op->msrdata;
 #ifdef BATCH_DEBUG
-    fprintf(stderr, "BATCH: destination of msr %lx on core %lx (at %p) is %p\n", msr, cpu, dest, &batch->ops[batch->numops - 1].msrdata);
+    fprintf(stderr, "BATCH: destination of msr %lx on core %lx (at %p) is %p\n", msr, cpu, dest, &op->msrdata);
     fprintf(stderr, "\tbatch numops is %d\n", batch->numops);
 #endif
     return 0;
@@ -486,12 +963,13 @@ void core_config(uint64_t *coresPerSocket, uint64_t *threadsPerCore, uint64_t *s
 #ifdef LIBMSR_DEBUG
         fprintf(stderr, "DEBUG: detecting core configuration\n");
 #endif
-        hwloc_topology_init(&topology);
-        hwloc_topology_load(topology);
-
-        nsockets = hwloc_get_nbobjs_by_type(topology, HWLOC_OBJ_SOCKET);
-        ncores = hwloc_get_nbobjs_by_type(topology, HWLOC_OBJ_CORE);
-        nthreads = hwloc_get_nbobjs_by_type(topology, HWLOC_OBJ_PU);
+        if (topo_cache_load(&nsockets, &ncores, &nthreads))
+        {
+            topology = *hwloc_storage();
+            nsockets = hwloc_get_nbobjs_by_type(topology, HWLOC_OBJ_SOCKET);
+            ncores = hwloc_get_nbobjs_by_type(topology, HWLOC_OBJ_CORE);
+            nthreads = hwloc_get_nbobjs_by_type(topology, HWLOC_OBJ_PU);
+        }
 
         if ((nthreads/ncores) > 1)
         {
@@ -522,13 +1000,7 @@ void core_config(uint64_t *coresPerSocket, uint64_t *threadsPerCore, uint64_t *s
 
 int sockets_assert(const unsigned *socket, const int location, const char *file)
 {
-    static uint64_t sockets = 0;
-
-    if (!sockets)
-    {
-        sockets = num_sockets();
-    }
-    if (*socket > sockets)
+    if (*socket > core_state()->sockets)
     {
         libmsr_error_handler("sockets_assert(): Requested invalid socket", LIBMSR_ERROR_PLATFORM_ENV, getenv("HOSTNAME"), __FILE__, location);
         return -1;
@@ -538,13 +1010,7 @@ int sockets_assert(const unsigned *socket, const int location, const char *file)
 
 int threads_assert(const unsigned *thread, const int location, const char *file)
 {
-    static uint64_t threadsPerCore = 0;
-
-    if (threadsPerCore < 1)
-    {
-        core_config(NULL, &threadsPerCore, NULL, NULL);
-    }
-    if (*thread > threadsPerCore)
+    if (*thread > core_state()->threads_per_core)
     {
         libmsr_error_handler("threads_assert(): Requested invalid thread", LIBMSR_ERROR_PLATFORM_ENV, getenv("HOSTNAME"), __FILE__, location);
         return -1;
@@ -554,12 +1020,7 @@ int threads_assert(const unsigned *thread, const int location, const char *file)
 
 int cores_assert(const unsigned *core, const int location, const char *file)
 {
-    static uint64_t coresPerSocket = 0;
-    if (coresPerSocket < 1)
-    {
-        core_config(&coresPerSocket, NULL, NULL, NULL);
-    }
-    if (*core > coresPerSocket)
+    if (*core > core_state()->cores_per_socket)
     {
         libmsr_error_handler("cores_assert(): Requested invalid core", LIBMSR_ERROR_PLATFORM_ENV, getenv("HOSTNAME"), __FILE__, location);
         return -1;
@@ -618,13 +1079,126 @@ int stat_module(char *filename, int *kerneltype, int *dev_idx)
     return 0;
 }
 
+int set_cpu_subset(const uint8_t *mask)
+{
+    uint64_t ndevs = num_devs();
+    uint64_t i;
+    cpu_set_t affinity;
+    uint8_t *cpus;
+    int selected = 0;
+
+    if (core_state()->init)
+    {
+        libmsr_error_handler("set_cpu_subset(): CPU subset must be set before init_msr()", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    if (mask == NULL && sched_getaffinity(0, sizeof(affinity), &affinity))
+    {
+        libmsr_error_handler("set_cpu_subset(): Could not read affinity mask", LIBMSR_ERROR_PLATFORM_ENV, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    find_cpu_top();
+    cpus = (uint8_t *) core_calloc(ndevs, sizeof(uint8_t));
+    for (i = 0; i < ndevs; i++)
+    {
+        cpus[i] = (mask != NULL ? mask[i] != 0 : (i < CPU_SETSIZE && CPU_ISSET(i, &affinity)));
+        selected += cpus[i];
+    }
+    if (!selected)
+    {
+        libmsr_error_handler("set_cpu_subset(): No CPU selected", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        free(cpus);
+        return -1;
+    }
+    if (core_state()->cpu_subset == NULL)
+    {
+        core_state()->socket_subset = (uint8_t *) core_calloc(num_sockets(), sizeof(uint8_t));
+    }
+    else
+    {
+        free(core_state()->cpu_subset);
+        memset(core_state()->socket_subset, 0, num_sockets() * sizeof(uint8_t));
+    }
+    core_state()->cpu_subset = cpus;
+    free(core_state()->socket_devs);
+    core_state()->socket_devs = NULL;
+    free(core_state()->subset_list);
+    core_state()->subset_list = NULL;
+    for (i = 0; i < ndevs; i++)
+    {
+        if (core_state()->cpu_subset[i])
+        {
+            core_state()->socket_subset[g_topo_list.thread_map[i].socket_id] = 1;
+        }
+    }
+    return 0;
+}
+
+int cpu_in_subset(const uint64_t dev_idx)
+{
+    return (core_state()->cpu_subset == NULL || (dev_idx < num_devs() && core_state()->cpu_subset[dev_idx]));
+}
+
+int coord_in_subset(const unsigned socket, const unsigned core, const unsigned thread)
+{
+    return (core_state()->cpu_subset == NULL || cpu_in_subset(devidx(socket, core, thread)));
+}
+
+uint64_t cpu_subset_list(const uint64_t **devs)
+{
+    struct msr_core_state *cs = core_state();
+    uint64_t dev_idx;
+
+    if (cs->subset_list == NULL)
+    {
+        cs->subset_list = (uint64_t *) core_calloc(cs->ndevs, sizeof(uint64_t));
+        cs->subset_count = 0;
+        for (dev_idx = 0; dev_idx < cs->ndevs; dev_idx++)
+        {
+            if (cpu_in_subset(dev_idx))
+            {
+                cs->subset_list[cs->subset_count++] = dev_idx;
+            }
+        }
+    }
+    *devs = cs->subset_list;
+    return cs->subset_count;
+}
+
+int socket_in_subset(const uint64_t socket)
+{
+    return (core_state()->socket_subset == NULL || (socket < num_sockets() && core_state()->socket_subset[socket]));
+}
+
+void set_msr_owner(const pthread_t *owner)
+{
+    if (owner == NULL)
+    {
+        __atomic_store_n(&g_owned, 0, __ATOMIC_RELEASE);
+        return;
+    }
+    g_owner = *owner;
+    __atomic_store_n(&g_owned, 1, __ATOMIC_RELEASE);
+}
+
+int set_msr_open_mode(const int mode)
+{
+    if (core_state()->init || (mode != MSR_OPEN_EAGER && mode != MSR_OPEN_LAZY))
+    {
+        libmsr_error_handler("set_msr_open_mode(): Open mode must be valid and set before init_msr()", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    core_state()->open_mode = mode;
+    return 0;
+}
+
 int init_msr(void)
 {
     int dev_idx;
     int ret;
     int *fileDescriptor = NULL;
     char filename[FILENAME_SIZE];
-    static int init = 0;
+    struct stat statbuf;
     int kerneltype = 3; // 0 is msr_safe, 1 is msr
 
     ret = find_cpu_top();
@@ -637,23 +1211,53 @@ int init_msr(void)
 #ifdef LIBMSR_DEBUG
     fprintf(stderr, "%s Initializing %lu device(s).\n", getenv("HOSTNAME"), (numDevs));
 #endif
-    if (init)
+    if (core_state()->init)
     {
         return 0;
     }
-    snprintf(filename, FILENAME_SIZE, "/dev/cpu/msr_whitelist");
+    if (getenv("LIBMSR_LAZY_OPEN") != NULL)
+    {
+        core_state()->open_mode = MSR_OPEN_LAZY;
+    }
+    if (getenv("LIBMSR_CPU_AFFINITY") != NULL && core_state()->cpu_subset == NULL && set_cpu_subset(NULL))
+    {
+        return -1;
+    }
+    snprintf(filename, FILENAME_SIZE, "%s/msr_whitelist", msr_dev_dir());
     stat_module(filename, &kerneltype, 0);
+    if (core_state()->open_mode == MSR_OPEN_LAZY)
+    {
+        /* Probe the module type on CPU 0, dev_fd() opens the rest on use. */
+        snprintf(filename, FILENAME_SIZE, "%s/0/msr_safe", msr_dev_dir());
+        if (kerneltype || stat(filename, &statbuf))
+        {
+            snprintf(filename, FILENAME_SIZE, "%s/0/msr", msr_dev_dir());
+            if (stat(filename, &statbuf))
+            {
+                libmsr_error_handler("init_msr(): Could not find any valid MSR module", LIBMSR_ERROR_MSR_MODULE, getenv("HOSTNAME"), __FILE__, __LINE__);
+                return -1;
+            }
+            kerneltype = 1;
+        }
+        core_state()->kerneltype = kerneltype;
+        for (dev_idx = 0; dev_idx < numDevs; dev_idx++)
+        {
+            *core_fd(dev_idx) = -1;
+        }
+        core_state()->init = 1;
+        return 0;
+    }
     /* Open the file descriptor for each device's msr interface. */
     for (dev_idx = 0; dev_idx < numDevs; dev_idx++)
     {
         /* Use the msr_safe module, or default to the msr module. */
         if (kerneltype)
         {
-            snprintf(filename, FILENAME_SIZE, "/dev/cpu/%d/msr", dev_idx);
+            snprintf(filename, FILENAME_SIZE, "%s/%d/msr", msr_dev_dir(), dev_idx);
         }
         else
         {
-            snprintf(filename, FILENAME_SIZE, "/dev/cpu/%d/msr_safe", dev_idx);
+            snprintf(filename, FILENAME_SIZE, "%s/%d/msr_safe", msr_dev_dir(), dev_idx);
         }
         if (stat_module(filename, &kerneltype, &dev_idx) < 0)
         {
@@ -663,8 +1267,13 @@ int init_msr(void)
         {
             continue;
         }
-        /* Open the msr module, else return the appropriate error message. */
         fileDescriptor = core_fd(dev_idx);
+        if (!cpu_in_subset(dev_idx))
+        {
+            *fileDescriptor = -1;
+            continue;
+        }
+        /* Open the msr module, else return the appropriate error message. */
         *fileDescriptor = open(filename, O_RDWR);
         if (*fileDescriptor == -1)
         {
@@ -679,12 +1288,14 @@ int init_msr(void)
             dev_idx = -1;
         }
     }
-    init = 1;
+    core_state()->kerneltype = kerneltype;
+    core_state()->init = 1;
     return 0;
 }
 
 int finalize_msr(void)
 {
+    struct msr_core_state *cs;
     int dev_idx;
     int rc;
     int *fileDescriptor = NULL;
@@ -698,7 +1309,8 @@ int finalize_msr(void)
     for (dev_idx = 0; dev_idx < numDevs; dev_idx++)
     {
         fileDescriptor = core_fd(dev_idx);
-        if (fileDescriptor != NULL)
+        /* Devices never touched in MSR_OPEN_LAZY mode were not opened. */
+        if (fileDescriptor != NULL && *fileDescriptor >= 0)
         {
             rc = close(*fileDescriptor);
             if (rc != 0)
@@ -708,26 +1320,64 @@ int finalize_msr(void)
             }
             else
             {
-                *fileDescriptor = 0;
+                *fileDescriptor = -1;
             }
         }
     }
+    cs = core_state();
+    if (cs->batchfd > 0)
+    {
+        close(cs->batchfd);
+    }
+    cs->batchfd = 0;
+    cs->init = 0;
     memhdlr_finalize();
+    core_release(cs);
+    memset(cs, 0, sizeof(*cs));
     return 0;
 }
 
-int write_msr_by_coord(unsigned socket, unsigned core, unsigned thread, off_t msr, uint64_t val)
+/// @brief Retrieve the logical processor used for socket-scope accesses.
+///
+/// This is the first CPU of the socket in the CPU subset, or the first CPU of
+/// the socket if none of its CPUs is selected.
+///
+/// @param [in] socket Unique socket/package identifier.
+///
+/// @return Unique logical processor index, else -1 if the socket has no CPU.
+static int socket_dev(const uint64_t socket)
 {
-    static uint64_t coresPerSocket = 0;
-    static uint64_t threadsPerCore = 0;
+    struct msr_core_state *cs = core_state();
+    uint64_t s;
+    int dev_idx;
 
+    if (cs->socket_devs == NULL)
+    {
+        find_cpu_top();
+        cs->socket_devs = (int *) core_calloc(cs->sockets, sizeof(int));
+        for (s = 0; s < cs->sockets; s++)
+        {
+            cs->socket_devs[s] = -1;
+            for (dev_idx = 0; dev_idx < cs->ndevs; dev_idx++)
+            {
+                /* Prefer a CPU in the subset so other jobs' CPUs are not
+                 * interrupted. */
+                if (g_topo_list.thread_map[dev_idx].socket_id == s && (cpu_in_subset(dev_idx) || !socket_in_subset(s)))
+                {
+                    cs->socket_devs[s] = dev_idx;
+                    break;
+                }
+            }
+        }
+    }
+    return (socket < cs->sockets ? cs->socket_devs[socket] : -1);
+}
+
+int write_msr_by_coord(unsigned socket, unsigned core, unsigned thread, off_t msr, uint64_t val)
+{
     sockets_assert(&socket, __LINE__, __FILE__);
     cores_assert(&core, __LINE__, __FILE__);
     threads_assert(&thread, __LINE__, __FILE__);
-    if (coresPerSocket == 0 || threadsPerCore == 0)
-    {
-        core_config(&coresPerSocket, &threadsPerCore, NULL, NULL);
-    }
 #ifdef LIBMSR_DEBUG
     fprintf(stderr, "%s %s %s::%d (write_msr_by_coord) socket=%d core=%d thread=%d msr=%lu (0x%lx) val=%lu devidx=%lu\n", getenv("HOSTNAME"), LIBMSR_DEBUG_TAG, __FILE__, __LINE__, socket, core, thread, msr, msr, val, devidx(socket, core, thread));
     return write_msr_by_idx_and_verify(devidx(socket, core, thread), msr, val);
@@ -737,9 +1387,6 @@ int write_msr_by_coord(unsigned socket, unsigned core, unsigned thread, off_t ms
 
 int read_msr_by_coord(unsigned socket, unsigned core, unsigned thread, off_t msr, uint64_t *val)
 {
-    static uint64_t coresPerSocket = 0;
-    static uint64_t threadsPerCore = 0;
-
 #ifdef LIBMSR_DEBUG
     fprintf(stderr, "%s %s %s::%d (read_msr_by_coord) socket=%d core=%d thread=%d msr=%lu (0x%lx)\n", getenv("HOSTNAME"), LIBMSR_DEBUG_TAG, __FILE__, __LINE__, socket, core, thread, msr, msr);
 #endif
@@ -750,28 +1397,40 @@ int read_msr_by_coord(unsigned socket, unsigned core, unsigned thread, off_t msr
     {
         libmsr_error_handler("read_msr_by_coord(): Received NULL pointer", LIBMSR_ERROR_MSR_READ, getenv("HOSTNAME"), __FILE__, __LINE__);
     }
-    if (coresPerSocket == 0 || threadsPerCore == 0)
+    return read_msr_by_idx(devidx(socket, core, thread), msr, val);
+}
+
+int write_msr_by_socket(unsigned socket, off_t msr, uint64_t val)
+{
+    sockets_assert(&socket, __LINE__, __FILE__);
+#ifdef LIBMSR_DEBUG
+    fprintf(stderr, "%s %s %s::%d (write_msr_by_socket) socket=%d msr=%lu (0x%lx) val=%lu devidx=%d\n", getenv("HOSTNAME"), LIBMSR_DEBUG_TAG, __FILE__, __LINE__, socket, msr, msr, val, socket_dev(socket));
+    return write_msr_by_idx_and_verify(socket_dev(socket), msr, val);
+#endif
+    return write_msr_by_idx(socket_dev(socket), msr, val);
+}
+
+int read_msr_by_socket(unsigned socket, off_t msr, uint64_t *val)
+{
+#ifdef LIBMSR_DEBUG
+    fprintf(stderr, "%s %s %s::%d (read_msr_by_socket) socket=%d msr=%lu (0x%lx)\n", getenv("HOSTNAME"), LIBMSR_DEBUG_TAG, __FILE__, __LINE__, socket, msr, msr);
+#endif
+    sockets_assert(&socket, __LINE__, __FILE__);
+    if (val == NULL)
     {
-        core_config(&coresPerSocket, &threadsPerCore, NULL, NULL);
+        libmsr_error_handler("read_msr_by_socket(): Received NULL pointer", LIBMSR_ERROR_MSR_READ, getenv("HOSTNAME"), __FILE__, __LINE__);
     }
-    return read_msr_by_idx(devidx(socket, core, thread), msr, val);
+    return read_msr_by_idx(socket_dev(socket), msr, val);
 }
 
 int read_msr_by_coord_batch(unsigned socket, unsigned core, unsigned thread, off_t msr, uint64_t **val, int batchnum)
 {
-    static uint64_t coresPerSocket = 0;
-    static uint64_t threadsPerCore = 0;
-
 #ifdef BATCH_DEBUG
     fprintf(stderr, "%s %s %s::%d (read_msr_by_coord_batch) socket=%d core=%d thread=%d msr=%lu (0x%lx)\n", getenv("HOSTNAME"), LIBMSR_DEBUG_TAG, __FILE__, __LINE__, socket, core, thread, msr, msr);
 #endif
     sockets_assert(&socket, __LINE__, __FILE__);
     cores_assert(&core, __LINE__, __FILE__);
     threads_assert(&thread, __LINE__, __FILE__);
-    if (coresPerSocket == 0 || threadsPerCore == 0)
-    {
-        core_config(&coresPerSocket, &threadsPerCore, NULL, NULL);
-    }
 #ifdef BATCH_DEBUG
     fprintf(stderr, "DEBUG: passed operation on msr 0x%lx (socket %u, core %u, thread %u) to BATCH OPS with destination %p\n", msr, socket, core, thread, val);
 #endif
@@ -784,17 +1443,166 @@ int read_batch(const int batchnum)
     return do_batch_op(batchnum, BATCH_READ);
 }
 
+int read_batches(const int *batchnums, const int nbatches)
+{
+    struct msr_core_state *cs = core_state();
+    struct msr_batch_array *batch = NULL;
+    struct msr_batch_array merged;
+    uint64_t start, ns;
+    unsigned total = 0;
+    unsigned nops, berr;
+    unsigned i;
+    int b, res;
+
+    if (owner_check("read_batches()"))
+    {
+        return -1;
+    }
+    if (nbatches < 1)
+    {
+        return 0;
+    }
+#ifndef USE_NO_BATCH
+    if (batch_fd(cs) >= 0)
+    {
+        for (b = 0; b < nbatches; b++)
+        {
+            if (batch_storage(&batch, batchnums[b], NULL))
+            {
+                return -1;
+            }
+            total += batch->numops;
+        }
+        if (cs->merged_capacity < total)
+        {
+            if (cs->merged_ops != NULL)
+            {
+                free(cs->merged_ops);
+            }
+            cs->merged_ops = (struct msr_batch_op *) core_calloc(total, sizeof(struct msr_batch_op));
+            cs->merged_capacity = total;
+        }
+        merged.ops = cs->merged_ops;
+        merged.numops = 0;
+        for (b = 0; b < nbatches; b++)
+        {
+            batch_storage(&batch, batchnums[b], NULL);
+            for (i = 0; i < batch->numops; i++)
+            {
+                merged.ops[merged.numops] = batch->ops[i];
+                merged.ops[merged.numops].isrdmsr = 1;
+                merged.ops[merged.numops].err = 0;
+                merged.numops++;
+            }
+        }
+        if (merged.numops == 0)
+        {
+            return 0;
+        }
+#ifdef BATCH_DEBUG
+        fprintf(stderr, "BATCH: merged read of %d batches, numops %u\n", nbatches, merged.numops);
+#endif
+        start = lat_now();
+        res = ioctl(cs->batchfd, X86_IOC_MSR_BATCH, &merged);
+        ns = lat_now() - start;
+        if (res < 0)
+        {
+            libmsr_error_handler("read_batches(): IOctl failed, does /dev/cpu/msr_batch exist?", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        }
+        /* Results come back in submission order. Each batch is charged the
+         * share of the ioctl its operations took. */
+        total = merged.numops;
+        merged.numops = 0;
+        for (b = 0; b < nbatches; b++)
+        {
+            batch_storage(&batch, batchnums[b], NULL);
+            nops = batch->numops;
+            berr = 0;
+            for (i = 0; i < nops; i++)
+            {
+                batch->ops[i].msrdata = merged.ops[merged.numops].msrdata;
+                batch->ops[i].err = merged.ops[merged.numops].err;
+                berr += (batch->ops[i].err != 0);
+                merged.numops++;
+            }
+            if (nops > 0)
+            {
+                lat_record_ns(LAT_MSR_MERGED_BATCH, batchnums[b], ns * nops / total, nops, (res < 0 && berr == 0 ? 1 : berr));
+            }
+        }
+        return (res < 0 ? -1 : 0);
+    }
+#endif
+    for (b = 0; b < nbatches; b++)
+    {
+        if (compatibility_batch(batchnums[b], BATCH_READ))
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
 int write_batch(const int batchnum)
 {
     return do_batch_op(batchnum, BATCH_WRITE);
 }
 
+int write_batch_sparse(const int batchnum, const uint8_t *dirty)
+{
+    struct msr_batch_array *batch = NULL;
+    struct msr_batch_array *sparse = NULL;
+    unsigned *size = NULL;
+    unsigned *slots;
+    int i;
+
+    /* Looking up a batch may grow the batch array and move the other
+     * pointer, so the higher batch number is fetched first. */
+    if (batchnum > SPARSE_WRITE ? (batch_storage(&batch, batchnum, NULL) || batch_storage(&sparse, SPARSE_WRITE, &size)) : (batch_storage(&sparse, SPARSE_WRITE, &size) || batch_storage(&batch, batchnum, NULL)))
+    {
+        return -1;
+    }
+    if (batch->ops == NULL)
+    {
+        libmsr_error_handler("write_batch_sparse(): Using uninitialized batch", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    slots = core_state()->batch_slots[batchnum];
+    if (*size < batch->numops)
+    {
+        if (sparse->ops != NULL)
+        {
+            free(sparse->ops);
+        }
+        sparse->ops = (struct msr_batch_op *) core_calloc(batch->numops, sizeof(struct msr_batch_op));
+        *size = batch->numops;
+    }
+    sparse->numops = 0;
+    for (i = 0; i < batch->numops; i++)
+    {
+        if (dirty[slots[i]])
+        {
+            sparse->ops[sparse->numops] = batch->ops[i];
+            sparse->ops[sparse->numops].isrdmsr = 0;
+            sparse->ops[sparse->numops].err = 0;
+            sparse->numops++;
+        }
+    }
+#ifdef BATCH_DEBUG
+    fprintf(stderr, "BATCH %d: sparse write of %u of %u ops\n", batchnum, sparse->numops, batch->numops);
+#endif
+    if (sparse->numops == 0)
+    {
+        return 0;
+    }
+    return do_batch_op(SPARSE_WRITE, BATCH_WRITE);
+}
+
 int load_socket_batch(off_t msr, uint64_t **val, int batchnum)
 {
     int dev_idx, val_idx;
-    static uint64_t coresPerSocket = 0;
-    static uint64_t threadsPerCore = 0;
-    static uint64_t sockets = 0;
+    struct msr_core_state *cs = core_state();
+    uint64_t sockets = cs->sockets;
 
     if (val == NULL)
     {
@@ -802,26 +1610,43 @@ int load_socket_batch(off_t msr, uint64_t **val, int batchnum)
         return -1;
     }
 
-    if (coresPerSocket == 0 || threadsPerCore == 0)
-    {
-        core_config(&coresPerSocket, &threadsPerCore, &sockets, NULL);
-    }
 #ifdef LIBMSR_DEBUG
     fprintf(stderr, "%s %s %s::%d (read_all_sockets) msr=%lu (0x%lx)\n", getenv("HOSTNAME"), LIBMSR_DEBUG_TAG, __FILE__, __LINE__, msr, msr);
-    fprintf(stderr, "sockets %lu, cores %lu, threads %lu\n", sockets, coresPerSocket, threadsPerCore);
+    fprintf(stderr, "sockets %lu, cores %lu, threads %lu\n", sockets, cs->cores_per_socket, cs->threads_per_core);
 #endif
     for (val_idx = 0; val_idx < sockets; val_idx++)
     {
-        for (dev_idx = 0; dev_idx < NUM_DEVS; dev_idx++)
+        dev_idx = socket_dev(val_idx);
+        if (dev_idx < 0)
         {
-            if (g_topo_list.thread_map[dev_idx].socket_id == val_idx)
-            {
+            continue;
+        }
 #ifdef TOPOLOGY_DEBUG
-                printf("Creating socket batch on CPU %d at index %d\n", dev_idx, val_idx);
+        printf("Creating socket batch on CPU %d at index %d\n", dev_idx, val_idx);
 #endif
-                create_batch_op(msr, dev_idx, &val[val_idx], batchnum);
-                break;
-            }
+        create_batch_op(msr, dev_idx, &val[val_idx], batchnum);
+    }
+    return 0;
+}
+
+/// @brief Check if a core has at least one thread in the CPU subset.
+///
+/// @param [in] core_id Core identifier as stored in the thread map.
+///
+/// @return 1 if the core is selected or no subset is set, else 0.
+static int core_in_subset(const int core_id)
+{
+    uint64_t dev_idx;
+
+    if (core_state()->cpu_subset == NULL)
+    {
+        return 1;
+    }
+    for (dev_idx = 0; dev_idx < num_devs(); dev_idx++)
+    {
+        if (g_topo_list.thread_map[dev_idx].core_id == core_id && core_state()->cpu_subset[dev_idx])
+        {
+            return 1;
         }
     }
     return 0;
@@ -830,10 +1655,11 @@ int load_socket_batch(off_t msr, uint64_t **val, int batchnum)
 int load_core_batch(off_t msr, uint64_t **val, int batchnum)
 {
     int dev_idx, val_idx;
-    static uint64_t coresPerSocket = 0;
-    static uint64_t threadsPerCore = 0;
-    static uint64_t sockets = 0;
-    static uint64_t coretotal = 0;
+    struct msr_core_state *cs = core_state();
+    uint64_t coresPerSocket = cs->cores_per_socket;
+    uint64_t threadsPerCore = cs->threads_per_core;
+    uint64_t sockets = cs->sockets;
+    uint64_t coretotal = sockets * coresPerSocket;
 
     if (val == NULL)
     {
@@ -841,11 +1667,6 @@ int load_core_batch(off_t msr, uint64_t **val, int batchnum)
         return -1;
     }
 
-    if (coresPerSocket == 0 || threadsPerCore == 0)
-    {
-        core_config(&coresPerSocket, &threadsPerCore, &sockets, NULL);
-        coretotal = sockets * coresPerSocket;
-    }
 #ifdef LIBMSR_DEBUG
     fprintf(stderr, "%s %s %s::%d (read_all_cores) msr=%lu (0x%lx)\n", getenv("HOSTNAME"), LIBMSR_DEBUG_TAG, __FILE__, __LINE__, msr, msr);
 #endif
@@ -853,7 +1674,7 @@ int load_core_batch(off_t msr, uint64_t **val, int batchnum)
     {
         for (dev_idx = 0; dev_idx < NUM_DEVS; dev_idx++)
         {
-            if (g_topo_list.thread_map[dev_idx].core_id == val_idx)
+            if (g_topo_list.thread_map[dev_idx].core_id == val_idx && (cpu_in_subset(dev_idx) || !core_in_subset(val_idx)))
             {
 #ifdef TOPOLOGY_DEBUG
                 printf("Creating core batch on CPU %d at index %d\n", dev_idx, val_idx);
@@ -869,19 +1690,16 @@ int load_core_batch(off_t msr, uint64_t **val, int batchnum)
 int load_thread_batch(off_t msr, uint64_t **val, int batchnum)
 {
     int dev_idx, val_idx;
-    static uint64_t coresPerSocket = 0;
-    static uint64_t threadsPerCore = 0;
-    static uint64_t sockets = 0;
+    struct msr_core_state *cs = core_state();
+    uint64_t coresPerSocket = cs->cores_per_socket;
+    uint64_t threadsPerCore = cs->threads_per_core;
+    uint64_t sockets = cs->sockets;
 
     if (val == NULL)
     {
         libmsr_error_handler("load_thread_batch(): Given uninitialized array", LIBMSR_ERROR_MSR_BATCH, getenv("HOSTNAME"), __FILE__, __LINE__);
         return -1;
     }
-    if (coresPerSocket == 0 || threadsPerCore == 0)
-    {
-        core_config(&coresPerSocket, &threadsPerCore, &sockets, NULL);
-    }
 #ifdef LIBMSR_DEBUG
     fprintf(stderr, "%s %s %s::%d (read_all_threads) msr=%lu (0x%lx)\n", getenv("HOSTNAME"), LIBMSR_DEBUG_TAG, __FILE__, __LINE__, msr, msr);
 #endif
@@ -899,8 +1717,9 @@ int read_msr_by_idx(int dev_idx, off_t msr, uint64_t *val)
 {
     int rc;
     int *fileDescriptor = NULL;
+    uint64_t start;
 
-    fileDescriptor = core_fd(dev_idx);
+    fileDescriptor = dev_fd(dev_idx);
     if (fileDescriptor == NULL)
     {
         return -1;
@@ -908,7 +1727,9 @@ int read_msr_by_idx(int dev_idx, off_t msr, uint64_t *val)
 #ifdef LIBMSR_DEBUG
     fprintf(stderr, "%s %s %s::%d (read_msr_by_idx) msr=%lu (0x%lx)\n", getenv("HOSTNAME"), LIBMSR_DEBUG_TAG, __FILE__, __LINE__, msr, msr);
 #endif
+    start = lat_now();
     rc = pread(*fileDescriptor, (void*)val, (size_t)sizeof(uint64_t), msr);
+    lat_record(LAT_MSR_READ, 0, start, 1, (rc != sizeof(uint64_t)));
     if (rc != sizeof(uint64_t))
     {
         libmsr_error_handler("read_msr_by_idx(): Pread failed", LIBMSR_ERROR_MSR_READ, getenv("HOSTNAME"), __FILE__, __LINE__);
@@ -921,8 +1742,9 @@ int write_msr_by_idx(int dev_idx, off_t msr, uint64_t val)
 {
     int rc;
     int *fileDescriptor = NULL;
+    uint64_t start;
 
-    fileDescriptor = core_fd(dev_idx);
+    fileDescriptor = dev_fd(dev_idx);
     if (fileDescriptor == NULL)
     {
         return -1;
@@ -930,7 +1752,9 @@ int write_msr_by_idx(int dev_idx, off_t msr, uint64_t val)
 #ifdef LIBMSR_DEBUG
     fprintf(stderr, "%s %s %s::%d (write_msr_by_idx) msr=%lu (0x%lx)\n", getenv("HOSTNAME"), LIBMSR_DEBUG_TAG, __FILE__, __LINE__, msr, msr);
 #endif
+    start = lat_now();
     rc = pwrite(*fileDescriptor, &val, (size_t)sizeof(uint64_t), msr);
+    lat_record(LAT_MSR_WRITE, 0, start, 1, (rc != sizeof(uint64_t)));
     if (rc != sizeof(uint64_t))
     {
         libmsr_error_handler("write_msr_by_idx(): Pwrite failed", LIBMSR_ERROR_MSR_WRITE, getenv("HOSTNAME"), __FILE__, __LINE__);
@@ -944,8 +1768,9 @@ int write_msr_by_idx_and_verify(int dev_idx, off_t msr, uint64_t val)
     int rc;
     uint64_t test = 0;
     int *fileDescriptor = NULL;
+    uint64_t start;
 
-    fileDescriptor = core_fd(dev_idx);
+    fileDescriptor = dev_fd(dev_idx);
     if (fileDescriptor == NULL)
     {
         return -1;
@@ -953,7 +1778,9 @@ int write_msr_by_idx_and_verify(int dev_idx, off_t msr, uint64_t val)
 #ifdef LIBMSR_DEBUG
     fprintf(stderr, "%s %s %s::%d (write_msr_by_idx) msr=%lu (0x%lx)\n", getenv("HOSTNAME"), LIBMSR_DEBUG_TAG, __FILE__, __LINE__, msr, msr);
 #endif
+    start = lat_now();
     rc = pwrite(*fileDescriptor, &val, (size_t)sizeof(uint64_t), msr);
+    lat_record(LAT_MSR_WRITE, 0, start, 1, (rc != sizeof(uint64_t)));
     if (rc != sizeof(uint64_t))
     {
         libmsr_error_handler("write_msr_by_idx_and_verify(): Pwrite failed", LIBMSR_ERROR_MSR_WRITE, getenv("HOSTNAME"), __FILE__, __LINE__);
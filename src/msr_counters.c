@@ -31,13 +31,16 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
-#include <sys/time.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 #include "msr_core.h"
 #include "memhdlr.h"
 #include "msr_counters.h"
 #include "cpuid.h"
 #include "libmsr_debug.h"
+#include "libmsr_error.h"
 
 void print_available_counters(void)
 {
@@ -45,37 +48,10 @@ void print_available_counters(void)
     fprintf(stdout, "IA32_PERF_GLOBAL_OVF_CTRL, 390h\nIA32_FIXED_CTR0, 309h\nIA32_FIXED_CTR1, 30Ah\n");
     fprintf(stdout, "IA32_FIXED_CTR2, 30Bh\n");
     int avail = cpuid_num_pmc();
-    if (avail > 0)
-    {
-        fprintf(stdout, "IA32_PMC0, C1h\nIA32_PERFEVTSEL0, 186h\n");
-    }
-    if (avail > 1)
-    {
-        fprintf(stdout, "IA32_PMC1, C2h\nIA32_PERFEVTSEL1, 187h\n");
-    }
-    if (avail > 2)
-    {
-        fprintf(stdout, "IA32_PMC2, C3h\nIA32_PERFEVTSEL2, 188h\n");
-    }
-    if (avail > 3)
-    {
-        fprintf(stdout, "IA32_PMC3, C4h\nIA32_PERFEVTSEL3, 189h\n");
-    }
-    if (avail > 4)
-    {
-        fprintf(stdout, "IA32_PMC4, C5h\nIA32_PERFEVTSEL4, 18Ah\n");
-    }
-    if (avail > 5)
-    {
-        fprintf(stdout, "IA32_PMC5, C6h\nIA32_PERFEVTSEL5, 18Bh\n");
-    }
-    if (avail > 6)
-    {
-        fprintf(stdout, "IA32_PMC6, C7h\nIA32_PERFEVTSEL6, 18Ch\n");
-    }
-    if (avail > 7)
+    int i;
+    for (i = 0; i < avail; i++)
     {
-        fprintf(stdout, "IA32_PMC7, C8h\nIA32_PERFEVTSEL7, 18Dh\n");
+        fprintf(stdout, "IA32_PMC%d, %Xh\nIA32_PERFEVTSEL%d, %Xh\n", i, IA32_PMC0 + i, i, IA32_PERFEVTSEL0 + i);
     }
 }
 
@@ -83,116 +59,35 @@ void print_available_counters(void)
 /* Programmable Performance Counters  */
 /**************************************/
 
-/// @brief Initialize storage for performance event select counter data.
+/// @brief Initialize storage for the general-purpose performance counter bank.
 ///
-/// @param [out] evt Data for performance event select counters.
+/// Event select and counter pointers are laid out contiguously as
+/// [counter][thread], so counter i of logical processor t is at index
+/// i * num_threads + t.
 ///
-/// @return 0 if successful, else -1 if number of general-purpose performance
-/// counters is less than 1.
-static int init_perfevtsel(struct perfevtsel *evt)
-{
-    uint64_t numDevs = num_devs();
-    int avail = cpuid_num_pmc();
-
-    if (avail < 1)
-    {
-        return -1;
-    }
-    switch (avail)
-    {
-        case 8:
-            evt->perf_evtsel7 = (uint64_t **) libmsr_calloc(numDevs, sizeof(uint64_t *));
-        case 7:
-            evt->perf_evtsel6 = (uint64_t **) libmsr_calloc(numDevs, sizeof(uint64_t *));
-        case 6:
-            evt->perf_evtsel5 = (uint64_t **) libmsr_calloc(numDevs, sizeof(uint64_t *));
-        case 5:
-            evt->perf_evtsel4 = (uint64_t **) libmsr_calloc(numDevs, sizeof(uint64_t *));
-        case 4:
-            evt->perf_evtsel3 = (uint64_t **) libmsr_calloc(numDevs, sizeof(uint64_t *));
-        case 3:
-            evt->perf_evtsel2 = (uint64_t **) libmsr_calloc(numDevs, sizeof(uint64_t *));
-        case 2:
-            evt->perf_evtsel1 = (uint64_t **) libmsr_calloc(numDevs, sizeof(uint64_t *));
-        case 1:
-            evt->perf_evtsel0 = (uint64_t **) libmsr_calloc(numDevs, sizeof(uint64_t *));
-    }
-    allocate_batch(COUNTERS_CTRL, avail * numDevs);
-    switch (avail)
-    {
-        case 8:
-            load_thread_batch(IA32_PERFEVTSEL7, evt->perf_evtsel7, COUNTERS_CTRL);
-        case 7:
-            load_thread_batch(IA32_PERFEVTSEL6, evt->perf_evtsel6, COUNTERS_CTRL);
-        case 6:
-            load_thread_batch(IA32_PERFEVTSEL5, evt->perf_evtsel5, COUNTERS_CTRL);
-        case 5:
-            load_thread_batch(IA32_PERFEVTSEL4, evt->perf_evtsel4, COUNTERS_CTRL);
-        case 4:
-            load_thread_batch(IA32_PERFEVTSEL3, evt->perf_evtsel3, COUNTERS_CTRL);
-        case 3:
-            load_thread_batch(IA32_PERFEVTSEL2, evt->perf_evtsel2, COUNTERS_CTRL);
-        case 2:
-            load_thread_batch(IA32_PERFEVTSEL1, evt->perf_evtsel1, COUNTERS_CTRL);
-        case 1:
-            load_thread_batch(IA32_PERFEVTSEL0, evt->perf_evtsel0, COUNTERS_CTRL);
-    }
-    return 0;
-}
-
-/// @brief Initialize storage for general-purpose performance counter data.
-///
-/// @param [out] p Data for general-purpose performance counters.
+/// @param [out] bank Data for general-purpose performance counter bank.
 ///
 /// @return 0 if successful, else -1 if number of general-purpose performance
 /// counters is less than 1.
-static int init_pmc(struct pmc *p)
+static int init_pmc_bank(struct pmc_bank *bank)
 {
-    uint64_t numDevs = num_devs();
-    int avail = cpuid_num_pmc();
+    int i;
 
-    if (avail < 1)
+    bank->num_counters = cpuid_num_pmc();
+    bank->num_threads = num_devs();
+    bank->width = cpuid_width_pmc();
+    if (bank->num_counters < 1)
     {
         return -1;
     }
-    switch (avail)
+    bank->evtsel = (uint64_t **) libmsr_calloc(bank->num_counters * bank->num_threads, sizeof(uint64_t *));
+    bank->value = (uint64_t **) libmsr_calloc(bank->num_counters * bank->num_threads, sizeof(uint64_t *));
+    allocate_batch(COUNTERS_CTRL, bank->num_counters * bank->num_threads);
+    allocate_batch(COUNTERS_DATA, bank->num_counters * bank->num_threads);
+    for (i = 0; i < bank->num_counters; i++)
     {
-        case 8:
-            p->pmc7 = (uint64_t **) libmsr_calloc(numDevs, sizeof(uint64_t *));
-        case 7:
-            p->pmc6 = (uint64_t **) libmsr_calloc(numDevs, sizeof(uint64_t *));
-        case 6:
-            p->pmc5 = (uint64_t **) libmsr_calloc(numDevs, sizeof(uint64_t *));
-        case 5:
-            p->pmc4 = (uint64_t **) libmsr_calloc(numDevs, sizeof(uint64_t *));
-        case 4:
-            p->pmc3 = (uint64_t **) libmsr_calloc(numDevs, sizeof(uint64_t *));
-        case 3:
-            p->pmc2 = (uint64_t **) libmsr_calloc(numDevs, sizeof(uint64_t *));
-        case 2:
-            p->pmc1 = (uint64_t **) libmsr_calloc(numDevs, sizeof(uint64_t *));
-        case 1:
-            p->pmc0 = (uint64_t **) libmsr_calloc(numDevs, sizeof(uint64_t *));
-    }
-    allocate_batch(COUNTERS_DATA, avail * numDevs);
-    switch (avail)
-    {
-        case 8:
-            load_thread_batch(IA32_PMC7, p->pmc7, COUNTERS_DATA);
-        case 7:
-            load_thread_batch(IA32_PMC6, p->pmc6, COUNTERS_DATA);
-        case 6:
-            load_thread_batch(IA32_PMC5, p->pmc5, COUNTERS_DATA);
-        case 5:
-            load_thread_batch(IA32_PMC4, p->pmc4, COUNTERS_DATA);
-        case 4:
-            load_thread_batch(IA32_PMC3, p->pmc3, COUNTERS_DATA);
-        case 3:
-            load_thread_batch(IA32_PMC2, p->pmc2, COUNTERS_DATA);
-        case 2:
-            load_thread_batch(IA32_PMC1, p->pmc1, COUNTERS_DATA);
-        case 1:
-            load_thread_batch(IA32_PMC0, p->pmc0, COUNTERS_DATA);
+        load_thread_batch(IA32_PERFEVTSEL0 + i, &bank->evtsel[i * bank->num_threads], COUNTERS_CTRL);
+        load_thread_batch(IA32_PMC0 + i, &bank->value[i * bank->num_threads], COUNTERS_DATA);
     }
     return 0;
 }
@@ -208,14 +103,39 @@ static void test_pmc_ctrl(void)
 }
 #endif
 
+void pmc_bank_storage(struct pmc_bank **bank)
+{
+    static struct pmc_bank bank_data;
+    static int init = 0;
+
+    if (!init)
+    {
+        init_pmc_bank(&bank_data);
+        init = 1;
+    }
+    if (bank != NULL)
+    {
+        *bank = &bank_data;
+    }
+}
+
 void perfevtsel_storage(struct perfevtsel **e)
 {
     static struct perfevtsel evt;
     static int init = 0;
+    struct pmc_bank *bank = NULL;
+    uint64_t ***named[] = {&evt.perf_evtsel0, &evt.perf_evtsel1, &evt.perf_evtsel2, &evt.perf_evtsel3,
+                           &evt.perf_evtsel4, &evt.perf_evtsel5, &evt.perf_evtsel6, &evt.perf_evtsel7};
+    int i;
 
     if (!init)
     {
-        init_perfevtsel(&evt);
+        /* The named fields are views into the counter bank. */
+        pmc_bank_storage(&bank);
+        for (i = 0; i < bank->num_counters && i < 8; i++)
+        {
+            *named[i] = &bank->evtsel[i * bank->num_threads];
+        }
         init = 1;
     }
     if (e != NULL)
@@ -228,10 +148,19 @@ void pmc_storage(struct pmc **p)
 {
     static struct pmc counters;
     static int init = 0;
+    struct pmc_bank *bank = NULL;
+    uint64_t ***named[] = {&counters.pmc0, &counters.pmc1, &counters.pmc2, &counters.pmc3,
+                           &counters.pmc4, &counters.pmc5, &counters.pmc6, &counters.pmc7};
+    int i;
 
     if (!init)
     {
-        init_pmc(&counters);
+        /* The named fields are views into the counter bank. */
+        pmc_bank_storage(&bank);
+        for (i = 0; i < bank->num_counters && i < 8; i++)
+        {
+            *named[i] = &bank->value[i * bank->num_threads];
+        }
         init = 1;
     }
     if (p != NULL)
@@ -240,6 +169,88 @@ void pmc_storage(struct pmc **p)
     }
 }
 
+int read_pmc_bank(uint64_t ctrmask, uint64_t *out)
+{
+    static struct pmc_bank *bank = NULL;
+    uint64_t t;
+    int i;
+
+    if (bank == NULL)
+    {
+        pmc_bank_storage(&bank);
+    }
+    if (bank->num_counters < 1 || read_batch(COUNTERS_DATA))
+    {
+        return -1;
+    }
+    for (i = 0; i < bank->num_counters; i++)
+    {
+        if (!(ctrmask & (1UL << i)))
+        {
+            continue;
+        }
+        for (t = 0; t < bank->num_threads; t++)
+        {
+            out[i * bank->num_threads + t] = *bank->value[i * bank->num_threads + t];
+        }
+    }
+    return 0;
+}
+
+void delta_pmc_bank(const uint64_t *prev, const uint64_t *curr, uint64_t *delta, uint64_t ctrmask)
+{
+    static struct pmc_bank *bank = NULL;
+    uint64_t mask;
+    uint64_t t, n;
+    int i;
+
+    if (bank == NULL)
+    {
+        pmc_bank_storage(&bank);
+    }
+    n = bank->num_threads;
+    mask = (bank->width >= 64 ? ~0UL : (1UL << bank->width) - 1);
+    for (i = 0; i < bank->num_counters; i++)
+    {
+        if (!(ctrmask & (1UL << i)))
+        {
+            continue;
+        }
+        /* Masked subtraction handles a single counter wraparound. */
+        for (t = i * n; t < (i + 1) * n; t++)
+        {
+            delta[t] = (curr[t] - prev[t]) & mask;
+        }
+    }
+}
+
+void reduce_pmc_bank(const uint64_t *data, uint64_t ctrmask, uint64_t *sums)
+{
+    static struct pmc_bank *bank = NULL;
+    uint64_t sum;
+    uint64_t t, n;
+    int i;
+
+    if (bank == NULL)
+    {
+        pmc_bank_storage(&bank);
+    }
+    n = bank->num_threads;
+    for (i = 0; i < bank->num_counters; i++)
+    {
+        if (!(ctrmask & (1UL << i)))
+        {
+            continue;
+        }
+        sum = 0;
+        for (t = i * n; t < (i + 1) * n; t++)
+        {
+            sum += data[t];
+        }
+        sums[i] = sum;
+    }
+}
+
 /* IA32_PEREVTSELx MSRs
  * cmask [31:24]
  * flags [23:16]
@@ -248,38 +259,17 @@ void pmc_storage(struct pmc **p)
  */
 void set_pmc_ctrl_flags(uint64_t cmask, uint64_t flags, uint64_t umask, uint64_t eventsel, int pmcnum, unsigned thread)
 {
-    static struct perfevtsel *evt = NULL;
-    if (evt == NULL)
+    static struct pmc_bank *bank = NULL;
+    if (bank == NULL)
     {
-        perfevtsel_storage(&evt);
+        pmc_bank_storage(&bank);
     }
-    switch(pmcnum)
+    /* pmcnum is 1-based, i.e., 1 selects IA32_PERFEVTSEL0. */
+    if (pmcnum < 1 || pmcnum > bank->num_counters || thread >= bank->num_threads)
     {
-        case 8:
-            *evt->perf_evtsel7[thread] = 0UL | (cmask << 24) | (flags << 16) | (umask << 8) | eventsel;
-            break;
-        case 7:
-            *evt->perf_evtsel6[thread] = 0UL | (cmask << 24) | (flags << 16) | (umask << 8) | eventsel;
-            break;
-        case 6:
-            *evt->perf_evtsel5[thread] = 0UL | (cmask << 24) | (flags << 16) | (umask << 8) | eventsel;
-            break;
-        case 5:
-            *evt->perf_evtsel4[thread] = 0UL | (cmask << 24) | (flags << 16) | (umask << 8) | eventsel;
-            break;
-        case 4:
-            *evt->perf_evtsel3[thread] = 0UL | (cmask << 24) | (flags << 16) | (umask << 8) | eventsel;
-            break;
-        case 3:
-            *evt->perf_evtsel2[thread] = 0UL | (cmask << 24) | (flags << 16) | (umask << 8) | eventsel;
-            break;
-        case 2:
-            *evt->perf_evtsel1[thread] = 0UL | (cmask << 24) | (flags << 16) | (umask << 8) | eventsel;
-            break;
-        case 1:
-            *evt->perf_evtsel0[thread] = 0UL | (cmask << 24) | (flags << 16) | (umask << 8) | eventsel;
-            break;
+        return;
     }
+    *bank->evtsel[(pmcnum - 1) * bank->num_threads + thread] = 0UL | (cmask << 24) | (flags << 16) | (umask << 8) | eventsel;
 }
 
 void set_all_pmc_ctrl(uint64_t cmask, uint64_t flags, uint64_t umask, uint64_t eventsel, int pmcnum)
@@ -295,16 +285,14 @@ void set_all_pmc_ctrl(uint64_t cmask, uint64_t flags, uint64_t umask, uint64_t e
 
 int enable_pmc(void)
 {
-    static struct perfevtsel *evt = NULL;
-    static int avail = 0;
-    if (evt == NULL)
+    static struct pmc_bank *bank = NULL;
+    if (bank == NULL)
     {
-        avail = cpuid_num_pmc();
-        if (avail == 0)
-        {
-            return -1;
-        }
-        perfevtsel_storage(&evt);
+        pmc_bank_storage(&bank);
+    }
+    if (bank->num_counters < 1)
+    {
+        return -1;
     }
     //test_pmc_ctrl();
     write_batch(COUNTERS_CTRL);
@@ -314,77 +302,36 @@ int enable_pmc(void)
 
 void clear_all_pmc(void)
 {
-    static struct pmc *p = NULL;
-    static uint64_t numDevs = 0;
-    static int avail = 0;
-    int i;
+    static struct pmc_bank *bank = NULL;
+    uint64_t i;
 
-    if (p == NULL)
+    if (bank == NULL)
     {
-        avail = cpuid_num_pmc();
-        numDevs = num_devs();
-        pmc_storage(&p);
+        pmc_bank_storage(&bank);
     }
-    for (i = 0; i < numDevs; i++)
+    for (i = 0; i < bank->num_counters * bank->num_threads; i++)
     {
-        switch (avail)
-        {
-            case 8:
-                *p->pmc7[i] = 0;
-            case 7:
-                *p->pmc6[i] = 0;
-            case 6:
-                *p->pmc5[i] = 0;
-            case 5:
-                *p->pmc4[i] = 0;
-            case 4:
-                *p->pmc3[i] = 0;
-            case 3:
-                *p->pmc2[i] = 0;
-            case 2:
-                *p->pmc1[i] = 0;
-            case 1:
-                *p->pmc0[i] = 0;
-        }
+        *bank->value[i] = 0;
     }
     write_batch(COUNTERS_DATA);
 }
 
 int clear_pmc(int idx)
 {
-    static struct pmc *p = NULL;
-    static int avail = 0;
+    static struct pmc_bank *bank = NULL;
+    int i;
 
-    if (p == NULL)
+    if (bank == NULL)
     {
-        avail = cpuid_num_pmc();
-        pmc_storage(&p);
+        pmc_bank_storage(&bank);
     }
-    if (idx < avail)
+    if (idx < 0 || idx >= bank->num_threads)
     {
-        switch (idx)
-        {
-            case 8:
-                *p->pmc7[idx] = 0;
-            case 7:
-                *p->pmc6[idx] = 0;
-            case 6:
-                *p->pmc5[idx] = 0;
-            case 5:
-                *p->pmc4[idx] = 0;
-            case 4:
-                *p->pmc3[idx] = 0;
-            case 3:
-                *p->pmc2[idx] = 0;
-            case 2:
-                *p->pmc1[idx] = 0;
-            case 1:
-                *p->pmc0[idx] = 0;
-        }
+        return -1;
     }
-    else
+    for (i = 0; i < bank->num_counters; i++)
     {
-        return -1;
+        *bank->value[i * bank->num_threads + idx] = 0;
     }
     //write_batch(COUNTERS_DATA);
     return 0;
@@ -392,40 +339,22 @@ int clear_pmc(int idx)
 
 void dump_pmc_data_readable(FILE *writedest)
 {
-    static struct pmc *p = NULL;
-    static uint64_t numDevs = 0;
-    static int avail = 0;
+    static struct pmc_bank *bank = NULL;
+    uint64_t t;
     int i;
 
-    if (p == NULL)
+    if (bank == NULL)
     {
-        avail = cpuid_num_pmc();
-        numDevs = num_devs();
-        pmc_storage(&p);
+        pmc_bank_storage(&bank);
     }
     read_batch(COUNTERS_DATA);
     fprintf(writedest, "PMC Counters:\n");
-    for (i = 0; i < numDevs; i++)
+    for (t = 0; t < bank->num_threads; t++)
     {
-        fprintf(writedest, "Thread %d\n", i);
-        switch (avail)
+        fprintf(writedest, "Thread %lu\n", t);
+        for (i = bank->num_counters - 1; i >= 0; i--)
         {
-            case 8:
-                fprintf(writedest, "\tpmc7: %lu\n", *p->pmc7[i]);
-            case 7:
-                fprintf(writedest, "\tpmc6: %lu\n", *p->pmc6[i]);
-            case 6:
-                fprintf(writedest, "\tpmc5: %lu\n", *p->pmc5[i]);
-            case 5:
-                fprintf(writedest, "\tpmc4: %lu\n", *p->pmc4[i]);
-            case 4:
-                fprintf(writedest, "\tpmc3: %lu\n", *p->pmc3[i]);
-            case 3:
-                fprintf(writedest, "\tpmc2: %lu\n", *p->pmc2[i]);
-            case 2:
-                fprintf(writedest, "\tpmc1: %lu\n", *p->pmc1[i]);
-            case 1:
-                fprintf(writedest, "\tpmc0: %lu\n", *p->pmc0[i]);
+            fprintf(writedest, "\tpmc%d: %lu\n", i, *bank->value[i * bank->num_threads + t]);
         }
     }
 }
@@ -625,6 +554,304 @@ void dump_unc_counter_data(FILE *writedest)
     }
 }
 
+/*************************************/
+/* Uncore CBo Performance Monitoring */
+/*************************************/
+
+/// @brief Freeze bit in MSR_Cx_PMON_BOX_CTL.
+#define CBO_BOX_CTL_FRZ_BIT  0x100
+/// @brief Reset counters bit in MSR_Cx_PMON_BOX_CTL.
+#define CBO_BOX_CTL_RST_CTRS 0x2
+/// @brief Local counter enable bit in MSR_Cx_PMON_EVNTSEL[0-3].
+#define CBO_EVTSEL_EN        (1UL << 22)
+
+/// @brief Initialize storage for per-box CBo uncore performance monitoring
+/// data.
+///
+/// Box control, event select plus filter, and counters each get their own
+/// batch so that freezing, programming, and reading all boxes on all sockets
+/// is a single batch operation.
+///
+/// @param [out] cbo Data for CBo uncore performance counters.
+static void init_cbo_counters(struct cbo_counters *cbo)
+{
+    int sockets = num_sockets();
+    uint64_t cores = cores_per_socket();
+    int box, ctr;
+    off_t base;
+
+    cbo->nboxes = (cores < NUM_CBO_BOXES ? (int)cores : NUM_CBO_BOXES);
+    cbo->box_ctl = (uint64_t **) libmsr_calloc(cbo->nboxes * sockets, sizeof(uint64_t *));
+    cbo->filter = (uint64_t **) libmsr_calloc(cbo->nboxes * sockets, sizeof(uint64_t *));
+    cbo->evtsel = (uint64_t **) libmsr_calloc(CBO_NUM_CTRS * cbo->nboxes * sockets, sizeof(uint64_t *));
+    cbo->ctr = (uint64_t **) libmsr_calloc(CBO_NUM_CTRS * cbo->nboxes * sockets, sizeof(uint64_t *));
+    allocate_batch(CBO_BOX_CTL, cbo->nboxes * sockets);
+    allocate_batch(CBO_EVTSEL, (CBO_NUM_CTRS + 1) * cbo->nboxes * sockets);
+    allocate_batch(CBO_COUNT, CBO_NUM_CTRS * cbo->nboxes * sockets);
+    for (box = 0; box < cbo->nboxes; box++)
+    {
+        base = box * CBO_MSR_STRIDE;
+        load_socket_batch(MSR_C0_PMON_BOX_CTL + base, &cbo->box_ctl[box * sockets], CBO_BOX_CTL);
+        load_socket_batch(MSR_C0_BOX_FILTER + base, &cbo->filter[box * sockets], CBO_EVTSEL);
+        for (ctr = 0; ctr < CBO_NUM_CTRS; ctr++)
+        {
+            load_socket_batch(MSR_C0_PMON_EVNTSEL0 + base + ctr, &cbo->evtsel[(ctr * cbo->nboxes + box) * sockets], CBO_EVTSEL);
+            load_socket_batch(MSR_C0_PMON_CTR0 + base + ctr, &cbo->ctr[(ctr * cbo->nboxes + box) * sockets], CBO_COUNT);
+        }
+    }
+#ifdef LIBMSR_DEBUG
+    fprintf(stderr, "%s %s::%d DEBUG: monitoring %d CBo boxes per socket\n", getenv("HOSTNAME"), __FILE__, __LINE__, cbo->nboxes);
+#endif
+}
+
+void cbo_counters_storage(struct cbo_counters **cbo)
+{
+    static struct cbo_counters cbo_data;
+    static int init = 0;
+    if (!init)
+    {
+        init = 1;
+        init_cbo_counters(&cbo_data);
+    }
+    if (cbo != NULL)
+    {
+        *cbo = &cbo_data;
+    }
+}
+
+int set_all_cbo_ctrl(uint64_t flags, uint64_t thresh, uint64_t umask, uint64_t eventsel, int ctrnum)
+{
+    static struct cbo_counters *cbo = NULL;
+    static int sockets = 0;
+    uint64_t val;
+    int i;
+
+    if (cbo == NULL)
+    {
+        sockets = num_sockets();
+        cbo_counters_storage(&cbo);
+    }
+    if (ctrnum < 0 || ctrnum >= CBO_NUM_CTRS)
+    {
+        libmsr_error_handler("set_all_cbo_ctrl(): Invalid CBo counter number", LIBMSR_ERROR_ARRAY_BOUNDS, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    /* Only edge, tid_en, invert and friends (bits 18-23) come from flags. */
+    val = CBO_EVTSEL_EN | ((flags & 0x3FUL) << 18) | ((thresh & 0xFFUL) << 24) | ((umask & 0xFFUL) << 8) | (eventsel & 0xFFUL);
+    for (i = 0; i < cbo->nboxes * sockets; i++)
+    {
+        *cbo->evtsel[ctrnum * cbo->nboxes * sockets + i] = val;
+    }
+    return 0;
+}
+
+void set_all_cbo_filter(uint64_t filter)
+{
+    static struct cbo_counters *cbo = NULL;
+    static int sockets = 0;
+    int i;
+
+    if (cbo == NULL)
+    {
+        sockets = num_sockets();
+        cbo_counters_storage(&cbo);
+    }
+    for (i = 0; i < cbo->nboxes * sockets; i++)
+    {
+        *cbo->filter[i] = filter;
+    }
+}
+
+int program_cbo(void)
+{
+    cbo_counters_storage(NULL);
+    return write_batch(CBO_EVTSEL);
+}
+
+/// @brief Write the same value to MSR_Cx_PMON_BOX_CTL on every box of every
+/// socket.
+///
+/// @param [in] val Raw value for MSR_Cx_PMON_BOX_CTL.
+///
+/// @return 0 if successful, else -1 if the batch write failed.
+static int write_cbo_box_ctl(uint64_t val)
+{
+    static struct cbo_counters *cbo = NULL;
+    static int sockets = 0;
+    int i;
+
+    if (cbo == NULL)
+    {
+        sockets = num_sockets();
+        cbo_counters_storage(&cbo);
+    }
+    for (i = 0; i < cbo->nboxes * sockets; i++)
+    {
+        *cbo->box_ctl[i] = val;
+    }
+    return write_batch(CBO_BOX_CTL);
+}
+
+int freeze_cbo(void)
+{
+    return write_cbo_box_ctl(CBO_BOX_CTL_FRZ);
+}
+
+int unfreeze_cbo(void)
+{
+    return write_cbo_box_ctl(CBO_BOX_CTL_FRZ & ~CBO_BOX_CTL_FRZ_BIT);
+}
+
+int reset_cbo(void)
+{
+    return write_cbo_box_ctl((CBO_BOX_CTL_FRZ & ~CBO_BOX_CTL_FRZ_BIT) | CBO_BOX_CTL_RST_CTRS);
+}
+
+int read_cbo_counters(void)
+{
+    cbo_counters_storage(NULL);
+    return read_batch(CBO_COUNT);
+}
+
+int sum_cbo_counters(int ctrnum, uint64_t *totals)
+{
+    static struct cbo_counters *cbo = NULL;
+    static int sockets = 0;
+    int box, s;
+
+    if (cbo == NULL)
+    {
+        sockets = num_sockets();
+        cbo_counters_storage(&cbo);
+    }
+    if (ctrnum < 0 || ctrnum >= CBO_NUM_CTRS)
+    {
+        libmsr_error_handler("sum_cbo_counters(): Invalid CBo counter number", LIBMSR_ERROR_ARRAY_BOUNDS, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    for (s = 0; s < sockets; s++)
+    {
+        totals[s] = 0;
+    }
+    for (box = 0; box < cbo->nboxes; box++)
+    {
+        for (s = 0; s < sockets; s++)
+        {
+            totals[s] += *cbo->ctr[(ctrnum * cbo->nboxes + box) * sockets + s];
+        }
+    }
+    return 0;
+}
+
+/// @brief Previous per-box LLC counter values and sample time, used to turn
+/// raw CBo counts into deltas.
+static uint64_t *cbo_llc_prev = NULL;
+static struct timespec cbo_llc_prev_time;
+
+int enable_cbo_llc(void)
+{
+#ifdef CBO_LLC_LOOKUP_EVENT
+    struct cbo_counters *cbo = NULL;
+    int sockets = num_sockets();
+
+    cbo_counters_storage(&cbo);
+    if (cbo_llc_prev == NULL)
+    {
+        cbo_llc_prev = (uint64_t *) libmsr_calloc(2 * cbo->nboxes * sockets, sizeof(uint64_t));
+    }
+    set_all_cbo_filter(CBO_FILTER_STATE_ALL);
+    set_all_cbo_ctrl(0, 0, CBO_LLC_LOOKUP_UMASK, CBO_LLC_LOOKUP_EVENT, 0);
+    set_all_cbo_ctrl(0, 0, CBO_LLC_MISS_UMASK, CBO_LLC_MISS_EVENT, 1);
+    if (freeze_cbo() || program_cbo() || reset_cbo())
+    {
+        return -1;
+    }
+    memset(cbo_llc_prev, 0, 2 * cbo->nboxes * sockets * sizeof(uint64_t));
+    clock_gettime(CLOCK_MONOTONIC, &cbo_llc_prev_time);
+    return 0;
+#else
+    libmsr_error_handler("enable_cbo_llc(): LLC events are not defined for this platform", LIBMSR_ERROR_PLATFORM_NOT_SUPPORTED, getenv("HOSTNAME"), __FILE__, __LINE__);
+    return -1;
+#endif
+}
+
+int get_cbo_llc_stats(struct cbo_llc_stats *stats)
+{
+    struct cbo_counters *cbo = NULL;
+    struct timespec now;
+    uint64_t mask = (1UL << CBO_CTR_WIDTH) - 1;
+    uint64_t cur;
+    double elapsed;
+    int sockets = num_sockets();
+    int box, s, i;
+
+    if (cbo_llc_prev == NULL)
+    {
+        libmsr_error_handler("get_cbo_llc_stats(): LLC counters are not enabled, call enable_cbo_llc() first", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    cbo_counters_storage(&cbo);
+    if (read_batch(CBO_COUNT))
+    {
+        return -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    elapsed = (now.tv_sec - cbo_llc_prev_time.tv_sec) + (now.tv_nsec - cbo_llc_prev_time.tv_nsec)/1000000000.0;
+    cbo_llc_prev_time = now;
+
+    for (s = 0; s < sockets; s++)
+    {
+        stats[s].lookups = 0;
+        stats[s].misses = 0;
+    }
+    for (box = 0; box < cbo->nboxes; box++)
+    {
+        for (s = 0; s < sockets; s++)
+        {
+            /* Counters 0 and 1 hold lookups and misses, respectively. */
+            i = box * sockets + s;
+            cur = *cbo->ctr[i] & mask;
+            stats[s].lookups += (cur - cbo_llc_prev[i]) & mask;
+            cbo_llc_prev[i] = cur;
+            i += cbo->nboxes * sockets;
+            cur = *cbo->ctr[i] & mask;
+            stats[s].misses += (cur - cbo_llc_prev[i]) & mask;
+            cbo_llc_prev[i] = cur;
+        }
+    }
+    for (s = 0; s < sockets; s++)
+    {
+        stats[s].lookup_rate = (elapsed > 0.0 ? stats[s].lookups / elapsed : 0.0);
+        stats[s].miss_rate = (elapsed > 0.0 ? stats[s].misses / elapsed : 0.0);
+        stats[s].miss_ratio = (stats[s].lookups ? (double)stats[s].misses / stats[s].lookups : 0.0);
+    }
+    return 0;
+}
+
+void dump_cbo_counter_data_label(FILE *writedest)
+{
+    fprintf(writedest, "socket c0\tc1\tc2\tc3\n");
+}
+
+void dump_cbo_counter_data(FILE *writedest)
+{
+    uint64_t *totals;
+    int sockets = num_sockets();
+    int ctr, s;
+
+    totals = (uint64_t *) libmsr_calloc(CBO_NUM_CTRS * sockets, sizeof(uint64_t));
+    read_cbo_counters();
+    for (ctr = 0; ctr < CBO_NUM_CTRS; ctr++)
+    {
+        sum_cbo_counters(ctr, &totals[ctr * sockets]);
+    }
+    for (s = 0; s < sockets; s++)
+    {
+        fprintf(writedest, "%d %lu\t%lu\t%lu\t%lu\n", s, totals[s], totals[sockets + s], totals[2 * sockets + s], totals[3 * sockets + s]);
+    }
+    libmsr_free(totals);
+}
+
 /*****************************************/
 /* Fixed Counters Performance Monitoring */
 /*****************************************/
@@ -877,19 +1104,18 @@ void dump_fixed_counter_data_terse_label(FILE *writedest)
 
 void dump_fixed_counter_data_readable(FILE *writedest)
 {
-    static uint64_t totalThreads = 0;
     struct fixed_counter *c0, *c1, *c2;
+    const uint64_t *devs;
+    uint64_t ndevs = cpu_subset_list(&devs);
+    uint64_t j;
     int i;
 
-    if (!totalThreads)
-    {
-        totalThreads = num_devs();
-    }
     fixed_counter_storage(&c0, &c1, &c2);
 
     read_batch(FIXED_COUNTERS_DATA);
-    for (i = 0; i < totalThreads; i++)
+    for (j = 0; j < ndevs; j++)
     {
+        i = devs[j];
         fprintf(writedest, "IR%02d: %lu UCC%02d:%lu URC%02d:%lu\n", i, *c0->value[i], i, *c1->value[i], i, *c2->value[i]);
     }
 }
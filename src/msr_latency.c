@@ -0,0 +1,276 @@
+/*
+ * Copyright (c) 2013-2017, Lawrence Livermore National Security, LLC.
+ *
+ * Produced at the Lawrence Livermore National Laboratory. Written by:
+ *     Barry Rountree <rountree@llnl.gov>,
+ *     Scott Walker <walker91@llnl.gov>, and
+ *     Kathleen Shoga <shoga1@llnl.gov>.
+ *
+ * LLNL-CODE-645430
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr. For details, see https://github.com/LLNL/libmsr.git.
+ *
+ * Please also read libmsr/LICENSE for our notice and the LGPL.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License (as published by the Free
+ * Software Foundation) version 2.1 dated February 1999.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the IMPLIED WARRANTY OF MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the terms and conditions of the GNU Lesser
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "msr_latency.h"
+
+/// @brief Structure holding one thread's statistics.
+///
+/// Blocks are allocated with plain calloc() rather than the libmsr memory
+/// handler, which is not thread safe and is torn down by finalize_msr().
+/// A block outlives its thread so its calls stay in the merged totals.
+struct lat_block
+{
+    /// @brief Statistics indexed as [type][batch id].
+    struct libmsr_lat_stats stats[LAT_NUM_OP_TYPES][LAT_MAX_BATCHES];
+    /// @brief Next registered block.
+    struct lat_block *next;
+};
+
+/// @brief Statistics block of the calling thread.
+static __thread struct lat_block *t_block = NULL;
+
+/// @brief List of every thread's block.
+static struct lat_block *g_blocks = NULL;
+
+/// @brief Lock guarding the block list.
+static volatile int g_blocks_lock = 0;
+
+/// @brief Acquire the block list lock.
+static void lat_lock(void)
+{
+    while (__sync_lock_test_and_set(&g_blocks_lock, 1))
+    {
+        while (g_blocks_lock)
+        {
+        }
+    }
+}
+
+/// @brief Release the block list lock.
+static void lat_unlock(void)
+{
+    __sync_lock_release(&g_blocks_lock);
+}
+
+/// @brief Get the calling thread's block, registering it on first use.
+///
+/// @return Pointer to the block, else NULL if allocation failed.
+static struct lat_block *lat_block_storage(void)
+{
+    if (t_block == NULL)
+    {
+        t_block = (struct lat_block *) calloc(1, sizeof(struct lat_block));
+        if (t_block == NULL)
+        {
+            return NULL;
+        }
+        lat_lock();
+        t_block->next = g_blocks;
+        g_blocks = t_block;
+        lat_unlock();
+    }
+    return t_block;
+}
+
+/// @brief Map a latency to its log2 bucket.
+///
+/// @param [in] ns Latency in nanoseconds.
+///
+/// @return Bucket index.
+static int lat_bucket(const uint64_t ns)
+{
+    int b = 63 - __builtin_clzll(ns | 1);
+
+    return (b < LAT_NUM_BUCKETS ? b : LAT_NUM_BUCKETS - 1);
+}
+
+/// @brief Add one set of statistics into another.
+///
+/// @param [in, out] dst Accumulated statistics.
+///
+/// @param [in] src Statistics to add.
+static void lat_merge(struct libmsr_lat_stats *dst, const struct libmsr_lat_stats *src)
+{
+    int i;
+
+    dst->calls += src->calls;
+    dst->ops += src->ops;
+    dst->errors += src->errors;
+    dst->total_ns += src->total_ns;
+    if (src->max_ns > dst->max_ns)
+    {
+        dst->max_ns = src->max_ns;
+    }
+    for (i = 0; i < LAT_NUM_BUCKETS; i++)
+    {
+        dst->buckets[i] += src->buckets[i];
+    }
+}
+
+uint64_t lat_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void lat_record(const int type, const int batchnum, const uint64_t start, const unsigned ops, const unsigned errors)
+{
+    lat_record_ns(type, batchnum, lat_now() - start, ops, errors);
+}
+
+void lat_record_ns(const int type, const int batchnum, const uint64_t ns, const unsigned ops, const unsigned errors)
+{
+    struct lat_block *blk;
+    struct libmsr_lat_stats *s;
+
+    if (type < 0 || type >= LAT_NUM_OP_TYPES)
+    {
+        return;
+    }
+    blk = lat_block_storage();
+    if (blk == NULL)
+    {
+        return;
+    }
+    s = &blk->stats[type][(batchnum < 0 ? 0 : (batchnum < LAT_MAX_BATCHES ? batchnum : LAT_MAX_BATCHES - 1))];
+    s->calls++;
+    s->ops += ops;
+    s->errors += errors;
+    s->total_ns += ns;
+    if (ns > s->max_ns)
+    {
+        s->max_ns = ns;
+    }
+    s->buckets[lat_bucket(ns)]++;
+}
+
+int get_lat_stats(const int type, const int batchnum, struct libmsr_lat_stats *stats)
+{
+    struct lat_block *blk;
+    int b;
+
+    if (type < 0 || type >= LAT_NUM_OP_TYPES)
+    {
+        return -1;
+    }
+    memset(stats, 0, sizeof(struct libmsr_lat_stats));
+    lat_lock();
+    for (blk = g_blocks; blk != NULL; blk = blk->next)
+    {
+        if (batchnum < 0)
+        {
+            for (b = 0; b < LAT_MAX_BATCHES; b++)
+            {
+                lat_merge(stats, &blk->stats[type][b]);
+            }
+        }
+        else
+        {
+            lat_merge(stats, &blk->stats[type][(batchnum < LAT_MAX_BATCHES ? batchnum : LAT_MAX_BATCHES - 1)]);
+        }
+    }
+    lat_unlock();
+    return 0;
+}
+
+uint64_t lat_percentile(const struct libmsr_lat_stats *stats, const double pct)
+{
+    uint64_t target;
+    uint64_t seen = 0;
+    int i;
+
+    if (stats->calls == 0)
+    {
+        return 0;
+    }
+    target = (uint64_t)(stats->calls * pct / 100.0);
+    if (target == 0)
+    {
+        target = 1;
+    }
+    for (i = 0; i < LAT_NUM_BUCKETS - 1; i++)
+    {
+        seen += stats->buckets[i];
+        if (seen >= target)
+        {
+            return (2ULL << i) < stats->max_ns ? (2ULL << i) : stats->max_ns;
+        }
+    }
+    return stats->max_ns;
+}
+
+void reset_lat_stats(void)
+{
+    struct lat_block *blk;
+
+    lat_lock();
+    for (blk = g_blocks; blk != NULL; blk = blk->next)
+    {
+        memset(blk->stats, 0, sizeof(blk->stats));
+    }
+    lat_unlock();
+}
+
+const char *lat_op_name(const int type)
+{
+    switch (type)
+    {
+        case LAT_MSR_BATCH:
+            return "msr_batch";
+        case LAT_MSR_COMPAT_BATCH:
+            return "msr_compat_batch";
+        case LAT_MSR_MERGED_BATCH:
+            return "msr_merged_batch";
+        case LAT_MSR_READ:
+            return "msr_read";
+        case LAT_MSR_WRITE:
+            return "msr_write";
+        case LAT_CSR_BATCH:
+            return "csr_batch";
+        default:
+            return "unknown";
+    }
+}
+
+void dump_lat_stats(FILE *writedest)
+{
+    struct libmsr_lat_stats s;
+    int type, b;
+
+    fprintf(writedest, "op               batch      calls        ops  errors    mean(us)     p50(us)     p99(us)     max(us)\n");
+    for (type = 0; type < LAT_NUM_OP_TYPES; type++)
+    {
+        for (b = 0; b < LAT_MAX_BATCHES; b++)
+        {
+            get_lat_stats(type, b, &s);
+            if (s.calls == 0)
+            {
+                continue;
+            }
+            fprintf(writedest, "%-16s %5d %10lu %10lu %7lu %11.3f %11.3f %11.3f %11.3f\n", lat_op_name(type), b, s.calls, s.ops, s.errors, s.total_ns / (double)s.calls / 1000.0, lat_percentile(&s, 50.0) / 1000.0, lat_percentile(&s, 99.0) / 1000.0, s.max_ns / 1000.0);
+        }
+    }
+}
@@ -90,7 +90,7 @@ void dump_misc_enable(struct misc_enable *s)
 void get_misc_enable(unsigned socket, struct misc_enable *s)
 {
     sockets_assert(&socket, __LINE__, __FILE__);
-    read_msr_by_coord(socket, 0, 0, IA32_MISC_ENABLE, &(s->raw));
+    read_msr_by_socket(socket, IA32_MISC_ENABLE, &(s->raw));
 
     s->fast_string_enable = MASK_VAL(s->raw, 0, 0);
     s->auto_TCC_enable = MASK_VAL(s->raw, 3, 3);
@@ -110,7 +110,7 @@ void set_misc_enable(unsigned socket, struct misc_enable *s)
 {
     uint64_t msrVal;
     sockets_assert(&socket, __LINE__, __FILE__);
-    read_msr_by_coord(socket, 0, 0, IA32_MISC_ENABLE, &msrVal);
+    read_msr_by_socket(socket, IA32_MISC_ENABLE, &msrVal);
 #if 0 /* For testing purposes. */
     assert(s->fast_string_enable == 0 || s->fast_string_enable == 1);
     assert(s->auto_TCC_enable == 0 || s->auto_TCC_enable == 1);
@@ -131,7 +131,7 @@ void set_misc_enable(unsigned socket, struct misc_enable *s)
     msrVal = (msrVal & (~((uint64_t)1<< (uint64_t)34))) | ((uint64_t)s->XD_bit_disable << (uint64_t)34);
     msrVal = (msrVal & (~((uint64_t)1<< (uint64_t)38))) | ((uint64_t)s->turbo_mode_disable << (uint64_t)38);
 
-    write_msr_by_coord(socket, 0, 0, IA32_MISC_ENABLE, msrVal);
+    write_msr_by_socket(socket, IA32_MISC_ENABLE, msrVal);
 }
 
 void pkg_cres_storage(struct pkg_cres **pcr)
@@ -206,3 +206,138 @@ void dump_core_cres(FILE *writedest)
         fprintf(writedest, "\n");
     }
 }
+
+/// @brief Raw batch pointers and previous sample for the C-state residency
+/// interval API.
+///
+/// Each core contributes C3, C6, C7 and TSC (in that order) and each package
+/// contributes C2, C3, C6, C7 and TSC.
+static struct
+{
+    uint64_t cores;
+    uint64_t sockets;
+    uint64_t **core_raw;
+    uint64_t **pkg_raw;
+    uint64_t *core_prev;
+    uint64_t *pkg_prev;
+    int have_baseline;
+} cres_state;
+
+void cres_interval_storage(struct cres_interval **ci)
+{
+    static struct cres_interval data;
+    static int init = 0;
+    const off_t core_msrs[CRES_NUM_CORE_STATES + 1] = {MSR_CORE_C3_RESIDENCY, MSR_CORE_C6_RESIDENCY, MSR_CORE_C7_RESIDENCY, IA32_TIME_STAMP_COUNTER};
+    const off_t pkg_msrs[CRES_NUM_PKG_STATES + 1] = {MSR_PKG_C2_RESIDENCY, MSR_PKG_C3_RESIDENCY, MSR_PKG_C6_RESIDENCY, MSR_PKG_C7_RESIDENCY, IA32_TIME_STAMP_COUNTER};
+    uint64_t cores, sockets;
+    int i;
+
+    if (!init)
+    {
+        cores = cres_state.cores = num_cores();
+        sockets = cres_state.sockets = num_sockets();
+        cres_state.core_raw = (uint64_t **) libmsr_calloc((CRES_NUM_CORE_STATES + 1) * cores, sizeof(uint64_t *));
+        cres_state.pkg_raw = (uint64_t **) libmsr_calloc((CRES_NUM_PKG_STATES + 1) * sockets, sizeof(uint64_t *));
+        cres_state.core_prev = (uint64_t *) libmsr_calloc((CRES_NUM_CORE_STATES + 1) * cores, sizeof(uint64_t));
+        cres_state.pkg_prev = (uint64_t *) libmsr_calloc((CRES_NUM_PKG_STATES + 1) * sockets, sizeof(uint64_t));
+        data.core_tsc = (uint64_t *) libmsr_calloc(cores, sizeof(uint64_t));
+        data.core = (double *) libmsr_calloc(CRES_NUM_CORE_STATES * cores, sizeof(double));
+        data.pkg_tsc = (uint64_t *) libmsr_calloc(sockets, sizeof(uint64_t));
+        data.pkg = (double *) libmsr_calloc(CRES_NUM_PKG_STATES * sockets, sizeof(double));
+        allocate_batch(CRES_INTERVAL, (CRES_NUM_CORE_STATES + 1) * cores + (CRES_NUM_PKG_STATES + 1) * sockets);
+        /* Stored as [msr][core] and [msr][socket]. */
+        for (i = 0; i <= CRES_NUM_CORE_STATES; i++)
+        {
+            load_core_batch(core_msrs[i], &cres_state.core_raw[i * cores], CRES_INTERVAL);
+        }
+        for (i = 0; i <= CRES_NUM_PKG_STATES; i++)
+        {
+            load_socket_batch(pkg_msrs[i], &cres_state.pkg_raw[i * sockets], CRES_INTERVAL);
+        }
+        init = 1;
+    }
+    if (ci != NULL)
+    {
+        *ci = &data;
+    }
+}
+
+/// @brief Compute residency fractions for one domain (cores or packages).
+///
+/// @param [in] raw Batch pointers, [msr][unit] with the TSC as the last msr.
+///
+/// @param [in,out] prev Previous raw values in the same layout, updated to
+///        the current sample.
+///
+/// @param [in] units Number of cores or packages.
+///
+/// @param [in] nstates Number of C-states per unit.
+///
+/// @param [in] baseline Non-zero if this is the first sample.
+///
+/// @param [out] tsc Elapsed TSC ticks per unit.
+///
+/// @param [out] frac Residency fractions, [unit * nstates + state].
+static void cres_fractions(uint64_t **raw, uint64_t *prev, uint64_t units, int nstates, int baseline, uint64_t *tsc, double *frac)
+{
+    uint64_t u, cur;
+    int st;
+
+    for (u = 0; u < units; u++)
+    {
+        cur = *raw[nstates * units + u];
+        tsc[u] = (baseline ? 0 : cur - prev[nstates * units + u]);
+        prev[nstates * units + u] = cur;
+    }
+    for (st = 0; st < nstates; st++)
+    {
+        for (u = 0; u < units; u++)
+        {
+            cur = *raw[st * units + u];
+            frac[u * nstates + st] = (tsc[u] ? (double)(cur - prev[st * units + u]) / tsc[u] : 0.0);
+            prev[st * units + u] = cur;
+        }
+    }
+}
+
+int read_cres_interval(struct cres_interval **ci)
+{
+    struct cres_interval *data = NULL;
+    int baseline;
+
+    cres_interval_storage(&data);
+    if (read_batch(CRES_INTERVAL))
+    {
+        return -1;
+    }
+    baseline = !cres_state.have_baseline;
+    cres_fractions(cres_state.core_raw, cres_state.core_prev, cres_state.cores, CRES_NUM_CORE_STATES, baseline, data->core_tsc, data->core);
+    cres_fractions(cres_state.pkg_raw, cres_state.pkg_prev, cres_state.sockets, CRES_NUM_PKG_STATES, baseline, data->pkg_tsc, data->pkg);
+    cres_state.have_baseline = 1;
+    if (ci != NULL)
+    {
+        *ci = data;
+    }
+    return 0;
+}
+
+void dump_cres_interval(FILE *writedest)
+{
+    struct cres_interval *ci = NULL;
+    uint64_t i;
+
+    if (read_cres_interval(&ci))
+    {
+        return;
+    }
+    fprintf(writedest, "PKG:c2\tc3\tc6\tc7\n");
+    for (i = 0; i < cres_state.sockets; i++)
+    {
+        fprintf(writedest, "%.4lf\t%.4lf\t%.4lf\t%.4lf\n", ci->pkg[i * CRES_NUM_PKG_STATES], ci->pkg[i * CRES_NUM_PKG_STATES + 1], ci->pkg[i * CRES_NUM_PKG_STATES + 2], ci->pkg[i * CRES_NUM_PKG_STATES + 3]);
+    }
+    fprintf(writedest, "CORE:c3\tc6\tc7\n");
+    for (i = 0; i < cres_state.cores; i++)
+    {
+        fprintf(writedest, "%.4lf\t%.4lf\t%.4lf\n", ci->core[i * CRES_NUM_CORE_STATES], ci->core[i * CRES_NUM_CORE_STATES + 1], ci->core[i * CRES_NUM_CORE_STATES + 2]);
+    }
+}
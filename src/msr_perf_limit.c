@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2013-2017, Lawrence Livermore National Security, LLC.
+ *
+ * Produced at the Lawrence Livermore National Laboratory. Written by:
+ *     Barry Rountree <rountree@llnl.gov>,
+ *     Scott Walker <walker91@llnl.gov>, and
+ *     Kathleen Shoga <shoga1@llnl.gov>.
+ *
+ * LLNL-CODE-645430
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr. For details, see https://github.com/LLNL/libmsr.git.
+ *
+ * Please also read libmsr/LICENSE for our notice and the LGPL.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License (as published by the Free
+ * Software Foundation) version 2.1 dated February 1999.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the IMPLIED WARRANTY OF MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the terms and conditions of the GNU Lesser
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "msr_core.h"
+#include "msr_perf_limit.h"
+#include "memhdlr.h"
+#include "libmsr_error.h"
+
+void perf_limit_storage(struct perf_limit_data **pl)
+{
+    static struct perf_limit_data d;
+    static int init = 0;
+    uint64_t sockets;
+
+    if (!init)
+    {
+        sockets = num_sockets();
+        d.raw = (uint64_t **) libmsr_calloc(sockets, sizeof(uint64_t *));
+        d.active = (uint64_t *) libmsr_calloc(sockets, sizeof(uint64_t));
+        d.log = (uint64_t *) libmsr_calloc(sockets, sizeof(uint64_t));
+        d.time_in_reason = (double *) libmsr_calloc(sockets * PERF_LIMIT_NUM_REASONS, sizeof(double));
+        d.time_limited = (double *) libmsr_calloc(sockets, sizeof(double));
+        d.dirty = (uint8_t *) libmsr_calloc(sockets, sizeof(uint8_t));
+#ifdef MSR_CORE_PERF_LIMIT_REASONS
+        allocate_batch(PERF_LIMIT, sockets);
+        load_socket_batch(MSR_CORE_PERF_LIMIT_REASONS, d.raw, PERF_LIMIT);
+#endif
+        init = 1;
+    }
+    if (pl != NULL)
+    {
+        *pl = &d;
+    }
+}
+
+int sample_perf_limit(void)
+{
+#ifdef MSR_CORE_PERF_LIMIT_REASONS
+    static struct perf_limit_data *pl = NULL;
+    static uint64_t sockets = 0;
+    struct timeval now;
+    double interval;
+    unsigned s;
+    int r;
+
+    if (pl == NULL)
+    {
+        sockets = num_sockets();
+        perf_limit_storage(&pl);
+    }
+    if (read_batch(PERF_LIMIT))
+    {
+        return -1;
+    }
+    gettimeofday(&now, NULL);
+    interval = (now.tv_sec - pl->last.tv_sec) + (now.tv_usec - pl->last.tv_usec) / 1000000.0;
+    for (s = 0; s < sockets; s++)
+    {
+        pl->active[s] = *pl->raw[s] & ((1UL << PERF_LIMIT_NUM_REASONS) - 1);
+        pl->log[s] = (*pl->raw[s] & PERF_LIMIT_LOG_MASK) >> PERF_LIMIT_LOG_SHIFT;
+        if (!pl->have_baseline || !pl->active[s])
+        {
+            continue;
+        }
+        pl->time_limited[s] += interval;
+        for (r = 0; r < PERF_LIMIT_NUM_REASONS; r++)
+        {
+            if (pl->active[s] & (1UL << r))
+            {
+                pl->time_in_reason[s * PERF_LIMIT_NUM_REASONS + r] += interval;
+            }
+        }
+    }
+    if (pl->have_baseline)
+    {
+        pl->elapsed += interval;
+    }
+    pl->last = now;
+    pl->have_baseline = 1;
+    return 0;
+#else
+    libmsr_error_handler("sample_perf_limit(): Perf limit reasons MSR not available on this platform", LIBMSR_ERROR_PLATFORM_NOT_SUPPORTED, getenv("HOSTNAME"), __FILE__, __LINE__);
+    return -1;
+#endif
+}
+
+int clear_perf_limit_log(void)
+{
+#ifdef MSR_CORE_PERF_LIMIT_REASONS
+    static struct perf_limit_data *pl = NULL;
+    static uint64_t sockets = 0;
+    unsigned s;
+    int ret;
+
+    if (pl == NULL)
+    {
+        sockets = num_sockets();
+        perf_limit_storage(&pl);
+    }
+    for (s = 0; s < sockets; s++)
+    {
+        /* Log bits are cleared by writing 0 and left alone by writing 1, so
+         * only the reasons seen in the last sample are cleared. Any latched
+         * since then are kept for the next poll. Status bits ignore writes. */
+        pl->dirty[s] = (pl->log[s] != 0);
+        *pl->raw[s] = (*pl->raw[s] & ~PERF_LIMIT_LOG_MASK) | (PERF_LIMIT_LOG_MASK & ~(pl->log[s] << PERF_LIMIT_LOG_SHIFT));
+    }
+    ret = write_batch_sparse(PERF_LIMIT, pl->dirty);
+    if (ret == 0)
+    {
+        memset(pl->log, 0, sockets * sizeof(uint64_t));
+    }
+    return ret;
+#else
+    libmsr_error_handler("clear_perf_limit_log(): Perf limit reasons MSR not available on this platform", LIBMSR_ERROR_PLATFORM_NOT_SUPPORTED, getenv("HOSTNAME"), __FILE__, __LINE__);
+    return -1;
+#endif
+}
+
+void reset_perf_limit_hist(void)
+{
+    static struct perf_limit_data *pl = NULL;
+    uint64_t sockets = num_sockets();
+
+    if (pl == NULL)
+    {
+        perf_limit_storage(&pl);
+    }
+    memset(pl->time_in_reason, 0, sockets * PERF_LIMIT_NUM_REASONS * sizeof(double));
+    memset(pl->time_limited, 0, sockets * sizeof(double));
+    pl->elapsed = 0.0;
+    pl->have_baseline = 0;
+}
+
+const char *perf_limit_reason_name(int reason)
+{
+    switch (reason)
+    {
+        case PERF_LIMIT_PROCHOT:
+            return "prochot";
+        case PERF_LIMIT_THERMAL:
+            return "thermal";
+        case PERF_LIMIT_RESIDENCY:
+            return "residency";
+        case PERF_LIMIT_RATL:
+            return "ratl";
+        case PERF_LIMIT_VR_THERM_ALERT:
+            return "vr_therm_alert";
+        case PERF_LIMIT_VR_TDC:
+            return "vr_tdc";
+        case PERF_LIMIT_OTHER:
+            return "other";
+        case PERF_LIMIT_PKG_PL1:
+            return "pkg_pl1";
+        case PERF_LIMIT_PKG_PL2:
+            return "pkg_pl2";
+        case PERF_LIMIT_MAX_TURBO:
+            return "max_turbo";
+        case PERF_LIMIT_TURBO_ATTEN:
+            return "turbo_atten";
+        default:
+            return "reserved";
+    }
+}
+
+void dump_perf_limit(FILE *writedest)
+{
+    static struct perf_limit_data *pl = NULL;
+    static uint64_t sockets = 0;
+    double t;
+    unsigned s;
+    int r;
+
+    if (pl == NULL)
+    {
+        sockets = num_sockets();
+        perf_limit_storage(&pl);
+    }
+    for (s = 0; s < sockets; s++)
+    {
+        fprintf(writedest, "Socket %u: active 0x%04lx, log 0x%04lx, limited %.3f of %.3f sec\n", s, pl->active[s], pl->log[s], pl->time_limited[s], pl->elapsed);
+        for (r = 0; r < PERF_LIMIT_NUM_REASONS; r++)
+        {
+            t = pl->time_in_reason[s * PERF_LIMIT_NUM_REASONS + r];
+            if (t > 0.0 || (pl->active[s] | pl->log[s]) & (1UL << r))
+            {
+                fprintf(writedest, "    %-14s %s%s %.3f sec\n", perf_limit_reason_name(r), pl->active[s] & (1UL << r) ? "A" : "-", pl->log[s] & (1UL << r) ? "L" : "-", t);
+            }
+        }
+    }
+}
@@ -44,6 +44,10 @@
 #include "libmsr_error.h"
 #include "libmsr_debug.h"
 
+/// @brief Non-zero once RAPL_DATA has been read and translated, so later
+/// reads have previous values to keep.
+static short rapl_data_init = 0;
+
 /// @brief Set the RAPL flags indicating available registers by looking up the
 /// model number of the CPU.
 ///
@@ -173,6 +177,10 @@ static int check_for_locks(void)
     /// @todo Should we flip bits for pkg_limit?
     for (i = 0; i < sockets; i++)
     {
+        if (!socket_in_subset(i))
+        {
+            continue;
+        }
         if (*rapl_flags & PKG_POWER_LIMIT)
         {
             get_pkg_rapl_limit(i, &rl1, &rl2);
@@ -766,7 +774,7 @@ int set_pkg_rapl_limit(const unsigned socket, struct rapl_limit *limit1, struct
 #ifdef LIBMSR_DEBUG
             fprintf(stderr, "%s %s::%d DEBUG: only one rapl limit, retrieving any existing power limits\n", getenv("HOSTNAME"), __FILE__, __LINE__);
 #endif
-            ret = read_msr_by_coord(socket, 0, 0, MSR_PKG_POWER_LIMIT, &currentval);
+            ret = read_msr_by_socket(socket, MSR_PKG_POWER_LIMIT, &currentval);
             /* We want to keep the lower limit so mask off all other bits. */
             pkg_limit |= currentval & 0x00000000FFFFFFFF;
         }
@@ -775,7 +783,7 @@ int set_pkg_rapl_limit(const unsigned socket, struct rapl_limit *limit1, struct
 #ifdef LIBMSR_DEBUG
             fprintf(stderr, "%s %s::%d DEBUG: only one rapl limit, retrieving any existing power limits\n", getenv("HOSTNAME"), __FILE__, __LINE__);
 #endif
-            ret = read_msr_by_coord(socket, 0, 0, MSR_PKG_POWER_LIMIT, &currentval);
+            ret = read_msr_by_socket(socket, MSR_PKG_POWER_LIMIT, &currentval);
             /* We want to keep the upper limit so mask off all other bits. */
             pkg_limit |= currentval & 0xFFFFFFFF00000000;
         }
@@ -794,7 +802,7 @@ int set_pkg_rapl_limit(const unsigned socket, struct rapl_limit *limit1, struct
         }
         if (limit1 != NULL || limit2 != NULL)
         {
-            ret += write_msr_by_coord(socket, 0, 0, MSR_PKG_POWER_LIMIT, pkg_limit);
+            ret += write_msr_by_socket(socket, MSR_PKG_POWER_LIMIT, pkg_limit);
         }
     }
     else
@@ -834,7 +842,7 @@ int set_dram_rapl_limit(const unsigned socket, struct rapl_limit *limit)
                 return -1;
             }
             dram_limit |= limit->bits | (1LL << 15);
-            write_msr_by_coord(socket, 0, 0, MSR_DRAM_POWER_LIMIT, dram_limit);
+            write_msr_by_socket(socket, MSR_DRAM_POWER_LIMIT, dram_limit);
         }
     }
     else
@@ -865,7 +873,7 @@ int get_rapl_power_info(const unsigned socket, struct rapl_power_info *info)
 #endif
     if (*rapl_flags & PKG_POWER_INFO)
     {
-        read_msr_by_coord(socket, 0, 0, MSR_PKG_POWER_INFO, &(info->msr_pkg_power_info));
+        read_msr_by_socket(socket, MSR_PKG_POWER_INFO, &(info->msr_pkg_power_info));
         val = MASK_VAL(info->msr_pkg_power_info, 54, 48);
         translate(socket, &val, &(info->pkg_max_window), BITS_TO_SECONDS_STD);
 
@@ -880,7 +888,7 @@ int get_rapl_power_info(const unsigned socket, struct rapl_power_info *info)
     }
     if (*rapl_flags & DRAM_POWER_INFO)
     {
-        read_msr_by_coord(socket, 0, 0, MSR_DRAM_POWER_INFO, &(info->msr_dram_power_info));
+        read_msr_by_socket(socket, MSR_DRAM_POWER_INFO, &(info->msr_dram_power_info));
 
         val = MASK_VAL(info->msr_dram_power_info, 54, 48);
         translate(socket, &val, &(info->dram_max_window), BITS_TO_SECONDS_STD);
@@ -915,11 +923,11 @@ int get_pkg_rapl_limit(const unsigned socket, struct rapl_limit *limit1, struct
     {
         if (limit1 != NULL)
         {
-            read_msr_by_coord(socket, 0, 0, MSR_PKG_POWER_LIMIT, &(limit1->bits));
+            read_msr_by_socket(socket, MSR_PKG_POWER_LIMIT, &(limit1->bits));
         }
         if (limit2 != NULL)
         {
-            read_msr_by_coord(socket, 0, 0, MSR_PKG_POWER_LIMIT, &(limit2->bits));
+            read_msr_by_socket(socket, MSR_PKG_POWER_LIMIT, &(limit2->bits));
         }
         calc_pkg_rapl_limit(socket, limit1, limit2);
     }
@@ -947,7 +955,7 @@ int get_dram_rapl_limit(const unsigned socket, struct rapl_limit *limit)
     /* Make sure the dram power limit register exists. */
     if ((limit != NULL) && (*rapl_flags & DRAM_POWER_LIMIT))
     {
-        read_msr_by_coord(socket, 0, 0, MSR_DRAM_POWER_LIMIT, &(limit->bits));
+        read_msr_by_socket(socket, MSR_DRAM_POWER_LIMIT, &(limit->bits));
         calc_std_rapl_limit(socket, limit);
     }
     else if (limit != NULL)
@@ -1088,6 +1096,10 @@ int dump_rapl_power_info(FILE *writedest)
     }
     for (socket = 0; socket < sockets; socket++)
     {
+        if (!socket_in_subset(socket))
+        {
+            continue;
+        }
         get_rapl_power_info(socket, &info);
         if (*rapl_flags & PKG_POWER_INFO)
         {
@@ -1156,7 +1168,11 @@ void get_rapl_power_unit(struct rapl_units *ru)
     uint64_t *tmp = (uint64_t *) libmsr_calloc(sockets, sizeof(uint64_t));
     for (i = 0; i < sockets; i++)
     {
-        read_msr_by_coord(i, 0, 0, MSR_RAPL_POWER_UNIT, tmp);
+        if (!socket_in_subset(i))
+        {
+            continue;
+        }
+        read_msr_by_socket(i, MSR_RAPL_POWER_UNIT, tmp);
         double energy = (double)(1 << (MASK_VAL(ru[i].msr_rapl_power_unit, 12, 8)));
         double seconds = (double)(1 << (MASK_VAL(ru[i].msr_rapl_power_unit, 19, 16)));
         double power = ((1.0)/((double)(1 << (MASK_VAL(ru[i].msr_rapl_power_unit, 3, 0)))));
@@ -1320,15 +1336,14 @@ int delta_rapl_data(void)
     return 0;
 }
 
-int read_rapl_data(void)
+int begin_rapl_data(void)
 {
     static struct rapl_data *rapl = NULL;
     static uint64_t *rapl_flags = NULL;
-    static short init = 0;
     static uint64_t sockets = 0;
     int s;
 
-    if (!init)
+    if (rapl == NULL)
     {
         sockets = num_sockets();
         if (rapl_storage(&rapl, &rapl_flags))
@@ -1358,7 +1373,7 @@ int read_rapl_data(void)
     rapl->old_now.tv_usec = rapl->now.tv_usec;
     /* Grab a timestamp. */
     gettimeofday(&(rapl->now), NULL);
-    if (init)
+    if (rapl_data_init)
     {
         rapl->elapsed = (rapl->now.tv_sec - rapl->old_now.tv_sec) +
                         (rapl->now.tv_usec - rapl->old_now.tv_usec)/1000000.0;
@@ -1400,7 +1415,24 @@ int read_rapl_data(void)
             }
         }
     }
-    read_batch(RAPL_DATA);
+    return 0;
+}
+
+int end_rapl_data(void)
+{
+    static struct rapl_data *rapl = NULL;
+    static uint64_t *rapl_flags = NULL;
+    static uint64_t sockets = 0;
+    int s;
+
+    if (rapl == NULL)
+    {
+        sockets = num_sockets();
+        if (rapl_storage(&rapl, &rapl_flags))
+        {
+            return -1;
+        }
+    }
     for (s = 0; s < sockets; s++)
     {
         if (*rapl_flags & DRAM_ENERGY_STATUS)
@@ -1426,6 +1458,16 @@ int read_rapl_data(void)
         fprintf(stderr, "DEBUG: delta_joules %lf\n", rapl->pkg_delta_joules[s]);
 #endif
     }
-    init = 1;
+    rapl_data_init = 1;
     return 0;
 }
+
+int read_rapl_data(void)
+{
+    if (begin_rapl_data())
+    {
+        return -1;
+    }
+    read_batch(RAPL_DATA);
+    return end_rapl_data();
+}
@@ -0,0 +1,306 @@
+/*
+ * Copyright (c) 2013-2017, Lawrence Livermore National Security, LLC.
+ *
+ * Produced at the Lawrence Livermore National Laboratory. Written by:
+ *     Barry Rountree <rountree@llnl.gov>,
+ *     Scott Walker <walker91@llnl.gov>, and
+ *     Kathleen Shoga <shoga1@llnl.gov>.
+ *
+ * LLNL-CODE-645430
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr. For details, see https://github.com/LLNL/libmsr.git.
+ *
+ * Please also read libmsr/LICENSE for our notice and the LGPL.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License (as published by the Free
+ * Software Foundation) version 2.1 dated February 1999.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the IMPLIED WARRANTY OF MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the terms and conditions of the GNU Lesser
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "msr_sampler.h"
+#include "libmsr_error.h"
+
+/// @brief Structure holding the state of a sampler.
+///
+/// Samplers are allocated with plain calloc() rather than the libmsr memory
+/// handler, which is not thread safe and is torn down by finalize_msr().
+struct msr_sampler
+{
+    /// @brief Copy of the configuration.
+    struct msr_sampler_config cfg;
+    /// @brief Statistics, updated atomically by the sampler thread.
+    struct msr_sampler_stats stats;
+    /// @brief Absolute CLOCK_MONOTONIC time of the first tick in ns.
+    uint64_t start_ns;
+    /// @brief Number of periods elapsed since start_ns.
+    uint64_t ticks;
+    /// @brief Periodic timerfd.
+    int timer_fd;
+    /// @brief Eventfd used to wake the thread for shutdown.
+    int stop_fd;
+    /// @brief Eventfd signalled after every tick, or -1.
+    int notify_fd;
+    /// @brief Sampler thread.
+    pthread_t thread;
+};
+
+/// @brief Get the CLOCK_MONOTONIC time in nanoseconds.
+static uint64_t sampler_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/// @brief Convert nanoseconds to a timespec.
+static void sampler_ts(const uint64_t ns, struct timespec *ts)
+{
+    ts->tv_sec = (time_t)(ns / 1000000000ULL);
+    ts->tv_nsec = (long)(ns % 1000000000ULL);
+}
+
+/// @brief Handle one timer expiration.
+///
+/// @param [in] s Sampler handle.
+///
+/// @param [in] expirations Number of periods elapsed since the last read of
+///        the timerfd.
+static void sampler_tick(struct msr_sampler *s, const uint64_t expirations)
+{
+    uint64_t now = sampler_now();
+    uint64_t deadline, jitter, one = 1;
+
+    s->ticks += expirations;
+    deadline = s->start_ns + s->ticks * s->cfg.period_ns;
+    jitter = (now > deadline ? now - deadline : 0);
+
+    __atomic_add_fetch(&s->stats.samples, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&s->stats.overruns, expirations - 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&s->stats.jitter_sum_ns, jitter, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->stats.jitter_last_ns, jitter, __ATOMIC_RELAXED);
+    if (jitter > __atomic_load_n(&s->stats.jitter_max_ns, __ATOMIC_RELAXED))
+    {
+        __atomic_store_n(&s->stats.jitter_max_ns, jitter, __ATOMIC_RELAXED);
+    }
+
+    if (s->cfg.callback != NULL)
+    {
+        s->cfg.callback(s->cfg.arg, now, expirations - 1);
+    }
+    if (s->notify_fd >= 0)
+    {
+        if (write(s->notify_fd, &one, sizeof(one)) != sizeof(one))
+        {
+            /* Counter saturated, the reader is far behind. */
+        }
+    }
+}
+
+/// @brief Body of the sampler thread.
+static void *sampler_thread(void *arg)
+{
+    struct msr_sampler *s = (struct msr_sampler *)arg;
+    struct pollfd fds[2];
+    uint64_t expirations;
+
+    fds[0].fd = s->timer_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = s->stop_fd;
+    fds[1].events = POLLIN;
+
+    while (1)
+    {
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        if (fds[1].revents)
+        {
+            break;
+        }
+        if (fds[0].revents & POLLIN)
+        {
+            if (read(s->timer_fd, &expirations, sizeof(expirations)) == sizeof(expirations) && expirations > 0)
+            {
+                sampler_tick(s, expirations);
+            }
+        }
+    }
+    return NULL;
+}
+
+/// @brief Report a failed system call while starting a sampler.
+///
+/// @param [in] what Description of the failed step.
+///
+/// @param [in] err errno value of the failure.
+///
+/// @param [in] line Line of the failure.
+static void sampler_error(const char *what, const int err, const int line)
+{
+    char msg[NAME_MAX];
+
+    snprintf(msg, NAME_MAX, "msr_sampler_start(): %s: %s", what, strerror(err));
+    libmsr_error_handler(msg, LIBMSR_ERROR_RUNTIME, getenv("HOSTNAME"), __FILE__, line);
+}
+
+/// @brief Close the descriptors of a sampler and free it.
+static void sampler_free(struct msr_sampler *s)
+{
+    if (s->timer_fd >= 0)
+    {
+        close(s->timer_fd);
+    }
+    if (s->stop_fd >= 0)
+    {
+        close(s->stop_fd);
+    }
+    if (s->notify_fd >= 0)
+    {
+        close(s->notify_fd);
+    }
+    free(s);
+}
+
+int msr_sampler_start(struct msr_sampler **s, const struct msr_sampler_config *cfg)
+{
+    struct msr_sampler *smp;
+    struct itimerspec its;
+    struct sched_param param;
+    pthread_attr_t attr;
+    cpu_set_t cpus;
+    int ret;
+
+    *s = NULL;
+    if (cfg->period_ns < MSR_SAMPLER_MIN_PERIOD_NS)
+    {
+        libmsr_error_handler("msr_sampler_start(): Period is shorter than 1 ms", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    smp = (struct msr_sampler *) calloc(1, sizeof(struct msr_sampler));
+    if (smp == NULL)
+    {
+        libmsr_error_handler("msr_sampler_start(): Could not allocate sampler", LIBMSR_ERROR_MEMORY_ALLOCATION, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    smp->cfg = *cfg;
+    smp->notify_fd = -1;
+    smp->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    smp->stop_fd = eventfd(0, EFD_CLOEXEC);
+    if (cfg->notify)
+    {
+        smp->notify_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    }
+    if (smp->timer_fd < 0 || smp->stop_fd < 0 || (cfg->notify && smp->notify_fd < 0))
+    {
+        sampler_error("Could not create timer", errno, __LINE__);
+        sampler_free(smp);
+        return -1;
+    }
+
+    /* Deadlines are absolute, a late tick does not push back later ones. */
+    smp->start_ns = sampler_now() + cfg->period_ns;
+    sampler_ts(smp->start_ns, &its.it_value);
+    sampler_ts(cfg->period_ns, &its.it_interval);
+    /* The first expiration is start_ns itself, count from one period
+     * earlier so ticks * period lands on each deadline. */
+    smp->start_ns -= cfg->period_ns;
+    if (timerfd_settime(smp->timer_fd, TFD_TIMER_ABSTIME, &its, NULL))
+    {
+        sampler_error("Could not arm timer", errno, __LINE__);
+        sampler_free(smp);
+        return -1;
+    }
+
+    pthread_attr_init(&attr);
+    if (cfg->cpu >= 0)
+    {
+        CPU_ZERO(&cpus);
+        CPU_SET(cfg->cpu, &cpus);
+        pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+    }
+    if (cfg->rt_priority > 0)
+    {
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = cfg->rt_priority;
+        pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+        pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+        pthread_attr_setschedparam(&attr, &param);
+    }
+    ret = pthread_create(&smp->thread, &attr, sampler_thread, smp);
+    pthread_attr_destroy(&attr);
+    if (ret)
+    {
+        /* EPERM without CAP_SYS_NICE, EINVAL for a CPU outside the mask. */
+        sampler_error("Could not start sampler thread", ret, __LINE__);
+        sampler_free(smp);
+        return -1;
+    }
+    *s = smp;
+    return 0;
+}
+
+int msr_sampler_eventfd(const struct msr_sampler *s)
+{
+    return s->notify_fd;
+}
+
+pthread_t msr_sampler_thread(const struct msr_sampler *s)
+{
+    return s->thread;
+}
+
+void msr_sampler_get_stats(const struct msr_sampler *s, struct msr_sampler_stats *stats)
+{
+    stats->samples = __atomic_load_n(&s->stats.samples, __ATOMIC_RELAXED);
+    stats->overruns = __atomic_load_n(&s->stats.overruns, __ATOMIC_RELAXED);
+    stats->jitter_last_ns = __atomic_load_n(&s->stats.jitter_last_ns, __ATOMIC_RELAXED);
+    stats->jitter_max_ns = __atomic_load_n(&s->stats.jitter_max_ns, __ATOMIC_RELAXED);
+    stats->jitter_sum_ns = __atomic_load_n(&s->stats.jitter_sum_ns, __ATOMIC_RELAXED);
+}
+
+void msr_sampler_stop(struct msr_sampler *s)
+{
+    uint64_t one = 1;
+
+    if (s == NULL)
+    {
+        return;
+    }
+    if (write(s->stop_fd, &one, sizeof(one)) != sizeof(one))
+    {
+        /* The stop eventfd is never read, a write cannot fail. */
+    }
+    pthread_join(s->thread, NULL);
+    sampler_free(s);
+}
@@ -0,0 +1,327 @@
+/*
+ * Copyright (c) 2013-2017, Lawrence Livermore National Security, LLC.
+ *
+ * Produced at the Lawrence Livermore National Laboratory. Written by:
+ *     Barry Rountree <rountree@llnl.gov>,
+ *     Scott Walker <walker91@llnl.gov>, and
+ *     Kathleen Shoga <shoga1@llnl.gov>.
+ *
+ * LLNL-CODE-645430
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr. For details, see https://github.com/LLNL/libmsr.git.
+ *
+ * Please also read libmsr/LICENSE for our notice and the LGPL.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License (as published by the Free
+ * Software Foundation) version 2.1 dated February 1999.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the IMPLIED WARRANTY OF MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the terms and conditions of the GNU Lesser
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "msr_sched.h"
+#include "msr_core.h"
+#include "csr_core.h"
+#include "msr_rapl.h"
+#include "msr_sampler.h"
+#include "libmsr_error.h"
+
+/// @brief Structure holding one registered source.
+struct sched_source
+{
+    /// @brief Batch to read.
+    int batchnum;
+    /// @brief 0 or MSR_SCHED_CSR.
+    int flags;
+    /// @brief Read period in nanoseconds, 0 to read once.
+    uint64_t period_ns;
+    /// @brief CLOCK_MONOTONIC time of the next read, 0 before the first.
+    uint64_t next_ns;
+    /// @brief Hook run before the read.
+    msr_sched_fn prepare;
+    /// @brief Hook run after the read.
+    msr_sched_fn decode;
+    /// @brief Argument of the hooks.
+    void *arg;
+    /// @brief Non-zero when due on the current tick.
+    int due;
+};
+
+/// @brief Registered sources.
+static struct sched_source g_sources[MSR_SCHED_MAX_SOURCES];
+
+/// @brief Number of registered sources.
+static int g_nsources = 0;
+
+/// @brief Tick period, the gcd of the source periods (0 if none has one).
+static uint64_t g_base_ns = 0;
+
+/// @brief Running sampler, NULL when stopped.
+static struct msr_sampler *g_sampler = NULL;
+
+/// @brief Counters, updated atomically.
+static struct msr_sched_stats g_stats;
+
+/// @brief User hook of the RAPL source.
+static msr_sched_fn g_rapl_decode = NULL;
+
+/// @brief Argument of the RAPL user hook.
+static void *g_rapl_arg = NULL;
+
+/// @brief Greatest common divisor of two periods.
+static uint64_t sched_gcd(uint64_t a, uint64_t b)
+{
+    uint64_t t;
+
+    while (b != 0)
+    {
+        t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/// @brief Prepare hook of the RAPL source.
+static void sched_rapl_prepare(void *arg)
+{
+    (void)arg;
+    begin_rapl_data();
+}
+
+/// @brief Decode hook of the RAPL source.
+static void sched_rapl_decode(void *arg)
+{
+    (void)arg;
+    end_rapl_data();
+    delta_rapl_data();
+    if (g_rapl_decode != NULL)
+    {
+        g_rapl_decode(g_rapl_arg);
+    }
+}
+
+/// @brief Sampler callback ticking the scheduler.
+static void sched_sample(void *arg, uint64_t now_ns, uint64_t missed)
+{
+    (void)arg;
+    (void)missed;
+    msr_sched_tick(now_ns);
+}
+
+int msr_sched_add(const int batchnum, const int flags, const uint64_t period_ns, msr_sched_fn prepare, msr_sched_fn decode, void *arg)
+{
+    struct sched_source *src;
+
+    if (g_sampler != NULL)
+    {
+        libmsr_error_handler("msr_sched_add(): Scheduler is running", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    if (g_nsources >= MSR_SCHED_MAX_SOURCES)
+    {
+        libmsr_error_handler("msr_sched_add(): Too many sources", LIBMSR_ERROR_ARRAY_BOUNDS, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    src = &g_sources[g_nsources];
+    memset(src, 0, sizeof(struct sched_source));
+    src->batchnum = batchnum;
+    src->flags = flags;
+    src->period_ns = period_ns;
+    src->prepare = prepare;
+    src->decode = decode;
+    src->arg = arg;
+    if (period_ns > 0)
+    {
+        g_base_ns = (g_base_ns == 0 ? period_ns : sched_gcd(g_base_ns, period_ns));
+    }
+    return g_nsources++;
+}
+
+int msr_sched_add_rapl(const uint64_t period_ns, msr_sched_fn decode, void *arg)
+{
+    struct rapl_data *rapl = NULL;
+    int i;
+
+    for (i = 0; i < g_nsources; i++)
+    {
+        if (g_sources[i].prepare == sched_rapl_prepare)
+        {
+            libmsr_error_handler("msr_sched_add_rapl(): RAPL_DATA is already scheduled", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+            return -1;
+        }
+    }
+    if (rapl_storage(&rapl, NULL) || rapl == NULL)
+    {
+        libmsr_error_handler("msr_sched_add_rapl(): RAPL init failed or has not yet been called", LIBMSR_ERROR_RAPL_INIT, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    g_rapl_decode = decode;
+    g_rapl_arg = arg;
+    return msr_sched_add(RAPL_DATA, 0, period_ns, sched_rapl_prepare, sched_rapl_decode, NULL);
+}
+
+int msr_sched_tick(const uint64_t now_ns)
+{
+    int batchnums[MSR_SCHED_MAX_SOURCES];
+    struct sched_source *src;
+    int nbatches = 0;
+    int ndue = 0;
+    int ret = 0;
+    int i;
+
+    /* Deadlines within half a tick count as due, so wakeup jitter does not
+     * push a source to the following tick. */
+    for (i = 0; i < g_nsources; i++)
+    {
+        src = &g_sources[i];
+        if (src->period_ns == 0)
+        {
+            src->due = (src->next_ns == 0);
+        }
+        else
+        {
+            src->due = (now_ns + g_base_ns / 2 >= src->next_ns);
+        }
+        if (!src->due)
+        {
+            continue;
+        }
+        ndue++;
+        if (src->prepare != NULL)
+        {
+            src->prepare(src->arg);
+        }
+        if (!(src->flags & MSR_SCHED_CSR))
+        {
+            batchnums[nbatches++] = src->batchnum;
+        }
+    }
+    if (ndue == 0)
+    {
+        return 0;
+    }
+
+    if (nbatches > 0)
+    {
+        ret |= read_batches(batchnums, nbatches);
+        __atomic_add_fetch(&g_stats.submissions, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&g_stats.batch_reads, nbatches, __ATOMIC_RELAXED);
+    }
+    for (i = 0; i < g_nsources; i++)
+    {
+        src = &g_sources[i];
+        if (src->due && (src->flags & MSR_SCHED_CSR))
+        {
+            ret |= (do_csr_batch_op(src->batchnum) < 0 ? -1 : 0);
+            __atomic_add_fetch(&g_stats.csr_reads, 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    for (i = 0; i < g_nsources; i++)
+    {
+        src = &g_sources[i];
+        if (!src->due)
+        {
+            continue;
+        }
+        if (src->decode != NULL)
+        {
+            src->decode(src->arg);
+        }
+        if (src->period_ns == 0)
+        {
+            src->next_ns = now_ns;
+            continue;
+        }
+        /* Keep the cadence, unless a whole period was missed. */
+        src->next_ns += src->period_ns;
+        if (src->next_ns + g_base_ns / 2 <= now_ns)
+        {
+            src->next_ns = now_ns + src->period_ns;
+        }
+    }
+    __atomic_add_fetch(&g_stats.ticks, 1, __ATOMIC_RELAXED);
+    return (ret ? -1 : ndue);
+}
+
+int msr_sched_start(const int cpu, const int rt_priority)
+{
+    struct msr_sampler_config cfg;
+    struct timespec ts;
+    pthread_t thread;
+
+    if (g_sampler != NULL)
+    {
+        libmsr_error_handler("msr_sched_start(): Scheduler is already running", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    if (g_base_ns == 0)
+    {
+        libmsr_error_handler("msr_sched_start(): No source has a period", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    /* Run the first tick here, it may allocate batch scratch space and the
+     * memory handler is not thread safe. */
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    msr_sched_tick((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec);
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.period_ns = (g_base_ns > MSR_SAMPLER_MIN_PERIOD_NS ? g_base_ns : MSR_SAMPLER_MIN_PERIOD_NS);
+    cfg.cpu = cpu;
+    cfg.rt_priority = rt_priority;
+    cfg.callback = sched_sample;
+    if (msr_sampler_start(&g_sampler, &cfg))
+    {
+        return -1;
+    }
+    /* Batches, scratch space and decode state are not locked, so only the
+     * sampler thread may touch them from now on. */
+    thread = msr_sampler_thread(g_sampler);
+    set_msr_owner(&thread);
+    return 0;
+}
+
+void msr_sched_stop(void)
+{
+    if (g_sampler == NULL)
+    {
+        return;
+    }
+    msr_sampler_stop(g_sampler);
+    g_sampler = NULL;
+    set_msr_owner(NULL);
+}
+
+void msr_sched_clear(void)
+{
+    msr_sched_stop();
+    g_nsources = 0;
+    g_base_ns = 0;
+    g_rapl_decode = NULL;
+    g_rapl_arg = NULL;
+    memset(&g_stats, 0, sizeof(g_stats));
+}
+
+void msr_sched_get_stats(struct msr_sched_stats *stats)
+{
+    stats->ticks = __atomic_load_n(&g_stats.ticks, __ATOMIC_RELAXED);
+    stats->submissions = __atomic_load_n(&g_stats.submissions, __ATOMIC_RELAXED);
+    stats->batch_reads = __atomic_load_n(&g_stats.batch_reads, __ATOMIC_RELAXED);
+    stats->csr_reads = __atomic_load_n(&g_stats.csr_reads, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,401 @@
+/*
+ * Copyright (c) 2013-2017, Lawrence Livermore National Security, LLC.
+ *
+ * Produced at the Lawrence Livermore National Laboratory. Written by:
+ *     Barry Rountree <rountree@llnl.gov>,
+ *     Scott Walker <walker91@llnl.gov>, and
+ *     Kathleen Shoga <shoga1@llnl.gov>.
+ *
+ * LLNL-CODE-645430
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr. For details, see https://github.com/LLNL/libmsr.git.
+ *
+ * Please also read libmsr/LICENSE for our notice and the LGPL.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License (as published by the Free
+ * Software Foundation) version 2.1 dated February 1999.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the IMPLIED WARRANTY OF MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the terms and conditions of the GNU Lesser
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "msr_shm.h"
+#include "msr_core.h"
+#include "msr_clocks.h"
+#include "msr_counters.h"
+#include "msr_rapl.h"
+#include "msr_thermal.h"
+#include "memhdlr.h"
+#include "libmsr_error.h"
+
+/// @brief Alignment of the record arrays in the segment.
+#define MSR_SHM_ALIGN 64
+
+/// @brief Structure holding the state of the publisher.
+struct msr_shm_pub
+{
+    /// @brief Segment name.
+    char name[FILENAME_SIZE];
+    /// @brief Writable mapping of the segment, NULL if not created.
+    struct msr_shm_header *hdr;
+    /// @brief RAPL data, if published.
+    struct rapl_data *rapl;
+    /// @brief RAPL feature flags.
+    uint64_t *rapl_flags;
+    /// @brief Clocks data, if published.
+    struct clocks_data *clocks;
+    /// @brief Fixed counter 0 data, if published.
+    struct fixed_counter *ctr0;
+    /// @brief Fixed counter 1 data, if published.
+    struct fixed_counter *ctr1;
+    /// @brief Fixed counter 2 data, if published.
+    struct fixed_counter *ctr2;
+    /// @brief Core temperatures of the current sample.
+    int *core_temp;
+    /// @brief Package temperatures of the current sample.
+    int *pkg_temp;
+    /// @brief Staged per-socket records.
+    struct msr_shm_socket *sock;
+    /// @brief Staged per-core records.
+    struct msr_shm_core *core;
+    /// @brief Staged per-thread records.
+    struct msr_shm_thread *thread;
+};
+
+static struct msr_shm_pub g_pub;
+
+static uint64_t shm_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t shm_align(const uint64_t off)
+{
+    return (off + MSR_SHM_ALIGN - 1) & ~((uint64_t)MSR_SHM_ALIGN - 1);
+}
+
+/// @brief Check whether an existing segment belongs to a running publisher.
+///
+/// @param [in] name Segment name.
+///
+/// @return 1 if a live publisher owns the segment, else 0.
+static int shm_owner_alive(const char *name)
+{
+    struct msr_shm_header hdr;
+    int fd;
+    int alive = 0;
+
+    fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+    {
+        return 0;
+    }
+    if (pread(fd, &hdr, sizeof(hdr), 0) == sizeof(hdr) && hdr.magic == MSR_SHM_MAGIC && hdr.pid > 0)
+    {
+        alive = (kill((pid_t)hdr.pid, 0) == 0 || errno == EPERM);
+    }
+    close(fd);
+    return alive;
+}
+
+/// @brief Set up every data source, recording the ones that work.
+///
+/// @return Bitmask of msr_shm_source_e sources.
+static uint64_t shm_init_sources(void)
+{
+    uint64_t sources = 0;
+
+    if (rapl_init(&g_pub.rapl, &g_pub.rapl_flags) >= 0 && (*g_pub.rapl_flags & PKG_ENERGY_STATUS) && poll_rapl_data() == 0)
+    {
+        sources |= MSR_SHM_RAPL;
+    }
+    clocks_storage(&g_pub.clocks);
+    if (read_batch(CLOCKS_DATA) == 0)
+    {
+        sources |= MSR_SHM_CLOCKS;
+    }
+    g_pub.core_temp = (int *) libmsr_calloc(num_cores(), sizeof(int));
+    g_pub.pkg_temp = (int *) libmsr_calloc(num_sockets(), sizeof(int));
+    if (read_core_temps(g_pub.core_temp, g_pub.pkg_temp) == 0)
+    {
+        sources |= MSR_SHM_THERM;
+    }
+    fixed_counter_storage(&g_pub.ctr0, &g_pub.ctr1, &g_pub.ctr2);
+    if (read_batch(FIXED_COUNTERS_DATA) == 0)
+    {
+        sources |= MSR_SHM_COUNTERS;
+    }
+    return sources;
+}
+
+int msr_shm_create(const char *name, const uint64_t interval_ns)
+{
+    struct msr_shm_header *hdr;
+    uint64_t nsockets = num_sockets();
+    uint64_t ncores = num_cores();
+    uint64_t nthreads = num_devs();
+    uint64_t socket_off, core_off, thread_off, size;
+    void *base;
+    int fd;
+
+    if (g_pub.hdr != NULL)
+    {
+        libmsr_error_handler("msr_shm_create(): Segment already created", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    snprintf(g_pub.name, FILENAME_SIZE, "%s", (name != NULL ? name : MSR_SHM_NAME));
+    if (shm_owner_alive(g_pub.name))
+    {
+        libmsr_error_handler("msr_shm_create(): Another publisher owns the segment", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    /* A segment left behind by a dead publisher is replaced, readers still
+     * mapping it see its age grow and attach again. */
+    shm_unlink(g_pub.name);
+
+    socket_off = shm_align(sizeof(struct msr_shm_header));
+    core_off = shm_align(socket_off + nsockets * sizeof(struct msr_shm_socket));
+    thread_off = shm_align(core_off + ncores * sizeof(struct msr_shm_core));
+    size = shm_align(thread_off + nthreads * sizeof(struct msr_shm_thread));
+
+    fd = shm_open(g_pub.name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0)
+    {
+        libmsr_error_handler("msr_shm_create(): Could not create segment", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    /* Readers need not share the publisher's credentials. */
+    if (fchmod(fd, 0644) || ftruncate(fd, size))
+    {
+        libmsr_error_handler("msr_shm_create(): Could not size segment", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        close(fd);
+        shm_unlink(g_pub.name);
+        return -1;
+    }
+    base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        libmsr_error_handler("msr_shm_create(): Could not map segment", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        shm_unlink(g_pub.name);
+        return -1;
+    }
+
+    g_pub.sock = (struct msr_shm_socket *) libmsr_calloc(nsockets, sizeof(struct msr_shm_socket));
+    g_pub.core = (struct msr_shm_core *) libmsr_calloc(ncores, sizeof(struct msr_shm_core));
+    g_pub.thread = (struct msr_shm_thread *) libmsr_calloc(nthreads, sizeof(struct msr_shm_thread));
+
+    hdr = (struct msr_shm_header *) base;
+    hdr->version = MSR_SHM_VERSION;
+    hdr->size = size;
+    hdr->nsockets = nsockets;
+    hdr->ncores = ncores;
+    hdr->nthreads = nthreads;
+    hdr->sources = shm_init_sources();
+    hdr->interval_ns = interval_ns;
+    hdr->pid = getpid();
+    hdr->socket_off = socket_off;
+    hdr->core_off = core_off;
+    hdr->thread_off = thread_off;
+    /* Readers validate the magic last. */
+    __atomic_store_n(&hdr->magic, MSR_SHM_MAGIC, __ATOMIC_RELEASE);
+    g_pub.hdr = hdr;
+    return 0;
+}
+
+int msr_shm_publish(void)
+{
+    struct msr_shm_header *hdr = g_pub.hdr;
+    uint64_t sources;
+    uint64_t seq;
+    uint64_t i;
+
+    if (hdr == NULL)
+    {
+        libmsr_error_handler("msr_shm_publish(): Segment has not been created", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    sources = hdr->sources;
+
+    /* Read everything first so the write side of the seqlock is short. */
+    if (sources & MSR_SHM_RAPL)
+    {
+        poll_rapl_data();
+        for (i = 0; i < hdr->nsockets; i++)
+        {
+            g_pub.sock[i].pkg_joules += g_pub.rapl->pkg_delta_joules[i];
+            g_pub.sock[i].pkg_watts = g_pub.rapl->pkg_watts[i];
+            if (*g_pub.rapl_flags & DRAM_ENERGY_STATUS)
+            {
+                g_pub.sock[i].dram_joules += g_pub.rapl->dram_delta_joules[i];
+                g_pub.sock[i].dram_watts = g_pub.rapl->dram_watts[i];
+            }
+        }
+    }
+    if (sources & MSR_SHM_THERM)
+    {
+        read_core_temps(g_pub.core_temp, g_pub.pkg_temp);
+        for (i = 0; i < hdr->ncores; i++)
+        {
+            g_pub.core[i].temp = g_pub.core_temp[i];
+        }
+        for (i = 0; i < hdr->nsockets; i++)
+        {
+            g_pub.sock[i].pkg_temp = g_pub.pkg_temp[i];
+        }
+    }
+    if (sources & MSR_SHM_CLOCKS)
+    {
+        read_batch(CLOCKS_DATA);
+        for (i = 0; i < hdr->nthreads; i++)
+        {
+            g_pub.thread[i].aperf = *g_pub.clocks->aperf[i];
+            g_pub.thread[i].mperf = *g_pub.clocks->mperf[i];
+            g_pub.thread[i].tsc = *g_pub.clocks->tsc[i];
+        }
+    }
+    if (sources & MSR_SHM_COUNTERS)
+    {
+        read_batch(FIXED_COUNTERS_DATA);
+        for (i = 0; i < hdr->nthreads; i++)
+        {
+            g_pub.thread[i].inst_retired = *g_pub.ctr0->value[i];
+            g_pub.thread[i].unhalted_core = *g_pub.ctr1->value[i];
+            g_pub.thread[i].unhalted_ref = *g_pub.ctr2->value[i];
+        }
+    }
+
+    seq = hdr->seq;
+    __atomic_store_n(&hdr->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy((char *)hdr + hdr->socket_off, g_pub.sock, hdr->nsockets * sizeof(struct msr_shm_socket));
+    memcpy((char *)hdr + hdr->core_off, g_pub.core, hdr->ncores * sizeof(struct msr_shm_core));
+    memcpy((char *)hdr + hdr->thread_off, g_pub.thread, hdr->nthreads * sizeof(struct msr_shm_thread));
+    hdr->elapsed = ((sources & MSR_SHM_RAPL) ? g_pub.rapl->elapsed : 0.0);
+    hdr->sample_ns = shm_now_ns();
+    hdr->nsamples++;
+    __atomic_store_n(&hdr->seq, seq + 2, __ATOMIC_RELEASE);
+    return 0;
+}
+
+void msr_shm_destroy(void)
+{
+    if (g_pub.hdr == NULL)
+    {
+        return;
+    }
+    __atomic_store_n(&g_pub.hdr->pid, 0, __ATOMIC_RELEASE);
+    munmap(g_pub.hdr, g_pub.hdr->size);
+    shm_unlink(g_pub.name);
+    g_pub.hdr = NULL;
+}
+
+int msr_shm_attach(const char *name, struct msr_shm_client *client)
+{
+    struct msr_shm_header hdr;
+    void *base;
+    int fd;
+
+    client->base = NULL;
+    client->size = 0;
+    fd = shm_open((name != NULL ? name : MSR_SHM_NAME), O_RDONLY, 0);
+    if (fd < 0)
+    {
+        libmsr_error_handler("msr_shm_attach(): Could not open segment, is the publisher running?", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    if (pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) || hdr.magic != MSR_SHM_MAGIC || hdr.version != MSR_SHM_VERSION)
+    {
+        libmsr_error_handler("msr_shm_attach(): Segment has an unexpected layout", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        close(fd);
+        return -1;
+    }
+    base = mmap(NULL, hdr.size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        libmsr_error_handler("msr_shm_attach(): Could not map segment", LIBMSR_ERROR_INVAL, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1;
+    }
+    client->base = base;
+    client->size = hdr.size;
+    return 0;
+}
+
+int msr_shm_read(const struct msr_shm_client *client, void *snap)
+{
+    const struct msr_shm_header *hdr = (const struct msr_shm_header *) client->base;
+    uint64_t s1, s2;
+    int tries;
+
+    for (tries = 0; tries < MSR_SHM_MAX_RETRIES; tries++)
+    {
+        s1 = __atomic_load_n(&hdr->seq, __ATOMIC_ACQUIRE);
+        if (s1 & 1)
+        {
+            continue;
+        }
+        memcpy(snap, client->base, client->size);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        s2 = __atomic_load_n(&hdr->seq, __ATOMIC_RELAXED);
+        if (s1 == s2)
+        {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+void msr_shm_detach(struct msr_shm_client *client)
+{
+    if (client->base != NULL)
+    {
+        munmap((void *)client->base, client->size);
+    }
+    client->base = NULL;
+    client->size = 0;
+}
+
+const struct msr_shm_socket *msr_shm_sockets(const void *snap)
+{
+    return (const struct msr_shm_socket *)((const char *)snap + ((const struct msr_shm_header *)snap)->socket_off);
+}
+
+const struct msr_shm_core *msr_shm_cores(const void *snap)
+{
+    return (const struct msr_shm_core *)((const char *)snap + ((const struct msr_shm_header *)snap)->core_off);
+}
+
+const struct msr_shm_thread *msr_shm_threads(const void *snap)
+{
+    return (const struct msr_shm_thread *)((const char *)snap + ((const struct msr_shm_header *)snap)->thread_off);
+}
+
+uint64_t msr_shm_age_ns(const void *snap)
+{
+    return shm_now_ns() - ((const struct msr_shm_header *)snap)->sample_ns;
+}
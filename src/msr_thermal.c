@@ -573,7 +573,11 @@ int get_pkg_therm2_ctl(void)
     therm2_ctl_storage(&thermctl);
     for (i = 0; i < sockets; i++)
     {
-        ret = read_msr_by_coord(i, 0, 0, MSR_THERM2_CTL, &thermctl[i]);
+        if (!socket_in_subset(i))
+        {
+            continue;
+        }
+        ret = read_msr_by_socket(i, MSR_THERM2_CTL, &thermctl[i]);
         if (ret)
         {
             return ret;
@@ -612,11 +616,11 @@ void set_therm_stat(struct therm_stat *s)
     for (i = 0; i < numCores; i++)
     {
         *s->raw[i] = (*s->raw[i] & (~(1<<1))) | (s->status_log[i] << 1);
-        *s->raw[i] = (*s->raw[i] & (~(1<<3))) | (s->PROCHOT_or_FORCEPR_log[i] << 1);
-        *s->raw[i] = (*s->raw[i] & (~(1<<5))) | (s->crit_temp_log[i] << 1);
-        *s->raw[i] = (*s->raw[i] & (~(1<<7))) | (s->therm_thresh1_log[i] << 1);
-        *s->raw[i] = (*s->raw[i] & (~(1<<9))) | (s->therm_thresh2_log[i] << 1);
-        *s->raw[i] = (*s->raw[i] & (~(1<<11))) | (s->power_notification_log[i] << 1);
+        *s->raw[i] = (*s->raw[i] & (~(1<<3))) | (s->PROCHOT_or_FORCEPR_log[i] << 3);
+        *s->raw[i] = (*s->raw[i] & (~(1<<5))) | (s->crit_temp_log[i] << 5);
+        *s->raw[i] = (*s->raw[i] & (~(1<<7))) | (s->therm_thresh1_log[i] << 7);
+        *s->raw[i] = (*s->raw[i] & (~(1<<9))) | (s->therm_thresh2_log[i] << 9);
+        *s->raw[i] = (*s->raw[i] & (~(1<<11))) | (s->power_notification_log[i] << 11);
     }
     write_batch(THERM_STAT);
     /* Not sure if I should update the struct here or not. */
@@ -950,3 +954,315 @@ void dump_therm_data_verbose(FILE *writedest)
         }
     }
 }
+
+/**********************/
+/* Temperature Stream */
+/**********************/
+
+int read_core_temps(int *core_temp, int *pkg_temp)
+{
+    static struct msr_temp_target *t_target = NULL;
+    static uint64_t **raw = NULL;
+    static int *core_target = NULL;
+    static uint64_t cores = 0;
+    static uint64_t sockets = 0;
+    uint64_t i, v;
+
+    if (raw == NULL)
+    {
+        cores = num_cores();
+        sockets = num_sockets();
+        raw = (uint64_t **) libmsr_calloc(cores + sockets, sizeof(uint64_t *));
+        allocate_batch(THERM_TEMP, cores + sockets);
+        load_core_batch(IA32_THERM_STATUS, raw, THERM_TEMP);
+        load_socket_batch(IA32_PACKAGE_THERM_STATUS, &raw[cores], THERM_TEMP);
+
+        /* TCC activation temperature does not change at runtime. */
+        is_init();
+        store_temp_target(&t_target);
+        core_target = (int *) libmsr_calloc(cores, sizeof(int));
+        for (i = 0; i < cores; i++)
+        {
+            core_target[i] = (int) t_target->temp_target[i / (cores / sockets)];
+        }
+    }
+    if (read_batch(THERM_TEMP))
+    {
+        return -1;
+    }
+    for (i = 0; i < cores; i++)
+    {
+        v = *raw[i];
+        core_temp[i] = (v & (1UL << 31)) ? core_target[i] - (int) MASK_VAL(v, 22, 16) : THERM_TEMP_INVALID;
+    }
+    if (pkg_temp != NULL)
+    {
+        for (i = 0; i < sockets; i++)
+        {
+            pkg_temp[i] = (int) t_target->temp_target[i] - (int) MASK_VAL(*raw[cores + i], 22, 16);
+        }
+    }
+    return 0;
+}
+
+void reduce_core_temps(const int *core_temp, int *max, double *mean, int *hotspot)
+{
+    static uint64_t sockets = 0;
+    static uint64_t coresPerSocket = 0;
+    const int *t;
+    uint64_t s, c;
+    int m, n, sum;
+
+    if (!sockets)
+    {
+        sockets = num_sockets();
+        coresPerSocket = cores_per_socket();
+    }
+    for (s = 0; s < sockets; s++)
+    {
+        t = &core_temp[s * coresPerSocket];
+        m = THERM_TEMP_INVALID;
+        n = 0;
+        sum = 0;
+        /* Branch-free reductions, simple enough to auto-vectorize. */
+        for (c = 0; c < coresPerSocket; c++)
+        {
+            m = (t[c] > m ? t[c] : m);
+            n += (t[c] != THERM_TEMP_INVALID);
+            sum += (t[c] != THERM_TEMP_INVALID ? t[c] : 0);
+        }
+        if (max != NULL)
+        {
+            max[s] = m;
+        }
+        if (mean != NULL)
+        {
+            mean[s] = (n ? (double) sum / n : 0.0);
+        }
+        if (hotspot != NULL)
+        {
+            hotspot[s] = -1;
+            for (c = 0; n && c < coresPerSocket; c++)
+            {
+                if (t[c] == m)
+                {
+                    hotspot[s] = (int) c;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+/*************************/
+/* Thermal Event Watcher */
+/*************************/
+
+/// @brief Structure holding the thermal watcher state.
+///
+/// Core entries come first, followed by one entry per socket, matching the
+/// order of the operations in the THERM_WATCH batch.
+struct therm_watch
+{
+    /// @brief Number of core entries.
+    uint64_t cores;
+    /// @brief Total number of entries (cores plus sockets).
+    uint64_t nentries;
+    /// @brief Pointers into the THERM_WATCH batch.
+    uint64_t **raw;
+    /// @brief Dense copy of the previous sample.
+    uint64_t *prev;
+    /// @brief Dense copy of the current sample.
+    uint64_t *cur;
+    /// @brief Newly set log bits per entry for the current sample.
+    uint64_t *edges;
+    /// @brief Entries selected for the next sparse write.
+    uint8_t *dirty;
+    /// @brief Ring buffer of undrained events.
+    struct therm_event *queue;
+    /// @brief Index of the oldest undrained event.
+    int head;
+    /// @brief Number of undrained events.
+    int count;
+    /// @brief Number of events dropped because the queue was full.
+    uint64_t dropped;
+    /// @brief Non-zero once a baseline sample has been taken.
+    int have_baseline;
+};
+
+/// @brief Initialize storage for the thermal event watcher.
+///
+/// @param [out] tw Pointer to thermal watcher state.
+static void therm_watch_storage(struct therm_watch **tw)
+{
+    static struct therm_watch w;
+    static int init = 0;
+
+    if (!init)
+    {
+        w.cores = num_cores();
+        w.nentries = w.cores + num_sockets();
+        w.raw = (uint64_t **) libmsr_calloc(w.nentries, sizeof(uint64_t *));
+        w.prev = (uint64_t *) libmsr_calloc(w.nentries, sizeof(uint64_t));
+        w.cur = (uint64_t *) libmsr_calloc(w.nentries, sizeof(uint64_t));
+        w.edges = (uint64_t *) libmsr_calloc(w.nentries, sizeof(uint64_t));
+        w.dirty = (uint8_t *) libmsr_calloc(w.nentries, sizeof(uint8_t));
+        w.queue = (struct therm_event *) libmsr_calloc(THERM_EVENT_QUEUE_SIZE, sizeof(struct therm_event));
+        allocate_batch(THERM_WATCH, w.nentries);
+        load_core_batch(IA32_THERM_STATUS, w.raw, THERM_WATCH);
+        load_socket_batch(IA32_PACKAGE_THERM_STATUS, &w.raw[w.cores], THERM_WATCH);
+        init = 1;
+    }
+    if (tw != NULL)
+    {
+        *tw = &w;
+    }
+}
+
+/// @brief Append an event to the watcher queue, dropping it if the queue is
+/// full.
+///
+/// @param [in] w Thermal watcher state.
+///
+/// @param [in] ev Event to append.
+///
+/// @return 1 if the event was queued, else 0.
+static int therm_watch_push(struct therm_watch *w, const struct therm_event *ev)
+{
+    if (w->count == THERM_EVENT_QUEUE_SIZE)
+    {
+        w->dropped++;
+        return 0;
+    }
+    w->queue[(w->head + w->count) % THERM_EVENT_QUEUE_SIZE] = *ev;
+    w->count++;
+    return 1;
+}
+
+int therm_watch_poll(void)
+{
+    static struct therm_watch *w = NULL;
+    struct therm_event ev;
+    struct timeval now;
+    uint64_t i, n;
+    uint64_t *tmp;
+    int bit;
+    int queued = 0;
+
+    if (w == NULL)
+    {
+        therm_watch_storage(&w);
+    }
+    if (read_batch(THERM_WATCH))
+    {
+        return -1;
+    }
+    gettimeofday(&now, NULL);
+    n = w->nentries;
+    for (i = 0; i < n; i++)
+    {
+        w->cur[i] = *w->raw[i];
+    }
+    if (!w->have_baseline)
+    {
+        w->have_baseline = 1;
+        tmp = w->prev;
+        w->prev = w->cur;
+        w->cur = tmp;
+        return 0;
+    }
+    /* Branch-free rising-edge detection, simple enough to auto-vectorize. */
+    for (i = 0; i < n; i++)
+    {
+        w->edges[i] = w->cur[i] & ~w->prev[i] & THERM_LOG_MASK;
+    }
+    ev.timestamp = (uint64_t)now.tv_sec * 1000000UL + now.tv_usec;
+    for (i = 0; i < n; i++)
+    {
+        if (!w->edges[i])
+        {
+            continue;
+        }
+        ev.pkg = (i >= w->cores);
+        ev.index = (uint16_t)(ev.pkg ? i - w->cores : i);
+        for (bit = 1; bit < 12; bit += 2)
+        {
+            if (w->edges[i] & (1UL << bit))
+            {
+                ev.bit = (uint8_t) bit;
+                queued += therm_watch_push(w, &ev);
+            }
+        }
+    }
+    tmp = w->prev;
+    w->prev = w->cur;
+    w->cur = tmp;
+    return queued;
+}
+
+int therm_watch_drain(struct therm_event *events, int max)
+{
+    static struct therm_watch *w = NULL;
+    int i;
+
+    if (w == NULL)
+    {
+        therm_watch_storage(&w);
+    }
+    for (i = 0; i < max && w->count > 0; i++)
+    {
+        events[i] = w->queue[w->head];
+        w->head = (w->head + 1) % THERM_EVENT_QUEUE_SIZE;
+        w->count--;
+    }
+    return i;
+}
+
+uint64_t therm_watch_dropped(void)
+{
+    struct therm_watch *w = NULL;
+
+    therm_watch_storage(&w);
+    return w->dropped;
+}
+
+int therm_watch_clear(void)
+{
+    static struct therm_watch *w = NULL;
+    static uint64_t keep_mask = THERM_LOG_MASK;
+    uint64_t i;
+    int ret;
+
+    if (w == NULL)
+    {
+        therm_watch_storage(&w);
+        /* Log bits of absent features are reserved and must be written 0. */
+        if (!cpuid_therm_status_enable_ThermalThresholds())
+        {
+            keep_mask &= ~0x280UL;
+        }
+        if (!cpuid_therm_interrupt_enable_PowerLimitNotify())
+        {
+            keep_mask &= ~0x800UL;
+        }
+    }
+    for (i = 0; i < w->nentries; i++)
+    {
+        /* Log bits are cleared by writing 0 and left alone by writing 1, so
+         * only the events seen in the last sample are cleared. Any latched
+         * since then are kept for the next poll. Read-only bits ignore
+         * writes. */
+        w->dirty[i] = ((w->prev[i] & THERM_LOG_MASK) != 0);
+        *w->raw[i] = (w->prev[i] & ~THERM_LOG_MASK) | (keep_mask & ~w->prev[i]);
+    }
+    ret = write_batch_sparse(THERM_WATCH, w->dirty);
+    if (ret == 0)
+    {
+        /* A bit that trips again after clearing shows up as a new edge. */
+        for (i = 0; i < w->nentries; i++)
+        {
+            w->prev[i] &= ~THERM_LOG_MASK;
+        }
+    }
+    return ret;
+}
@@ -54,7 +54,9 @@ void turbo_storage(uint64_t ***val)
     if (!init)
     {
         numDevs = num_devs();
-        perf_ctl = (uint64_t **) libmsr_malloc(numDevs * sizeof(uint64_t *));
+        perf_ctl = (uint64_t **) libmsr_calloc(numDevs, sizeof(uint64_t *));
+        allocate_batch(TURBO_CTL, numDevs);
+        load_thread_batch(IA32_PERF_CTL, perf_ctl, TURBO_CTL);
         init = 1;
     }
     if (val != NULL)
@@ -63,45 +65,44 @@ void turbo_storage(uint64_t ***val)
     }
 }
 
-void enable_turbo(void)
+/// @brief Set IDA/Turbo DISENGAGE (bit 32) of IA32_PERF_CTL on every logical
+/// processor with one batch read and one batch write.
+///
+/// @param [in] disengage 1 to disable turbo, 0 to enable it.
+///
+/// @return 0 if successful, else -1 if a batch operation failed.
+static int set_turbo_disengage(uint64_t disengage)
 {
-    int j;
     static uint64_t numDevs = 0;
-    static uint64_t **val =  NULL;
+    static uint64_t **val = NULL;
+    uint64_t j;
+
     if (!numDevs)
     {
         numDevs = num_devs();
-        val = (uint64_t **) libmsr_malloc(numDevs * sizeof(uint64_t *));
         turbo_storage(&val);
     }
-    /* Set bit 32 "IDA/Turbo DISENGAGE" of IA32_PERF_CTL to 1. */
-    read_batch(PERF_CTL);
+    if (read_batch(TURBO_CTL))
+    {
+        return -1;
+    }
     for (j = 0; j < numDevs; j++)
     {
-        *val[j] &= ~(((uint64_t)1) << 32);
-        fprintf(stderr, "0x%016lx\t", *val[j] & (((uint64_t)1)<<32));
+        *val[j] = (*val[j] & ~(((uint64_t)1) << 32)) | (disengage << 32);
     }
-    write_batch(PERF_CTL);
+    return write_batch(TURBO_CTL);
 }
 
-void disable_turbo(void)
+int enable_turbo(void)
 {
-    int j;
-    static uint64_t numDevs = 0;
-    static uint64_t **val = NULL;
-    if (!numDevs)
-    {
-        numDevs = num_devs();
-        val = (uint64_t **) libmsr_malloc(numDevs * sizeof(uint64_t *));
-        turbo_storage(&val);
-    }
     /* Set IDA/Turbo DISENGAGE (bit 32) of IA32_PERF_CTL to 0. */
-    read_batch(PERF_CTL);
-    for (j = 0; j < numDevs; j++)
-    {
-        *val[j] |= ((uint64_t)1) << 32;
-    }
-    write_batch(PERF_CTL);
+    return set_turbo_disengage(0);
+}
+
+int disable_turbo(void)
+{
+    /* Set IDA/Turbo DISENGAGE (bit 32) of IA32_PERF_CTL to 1. */
+    return set_turbo_disengage(1);
 }
 
 void dump_turbo(FILE *writedest)
@@ -153,7 +154,7 @@ int get_max_turbo_activation_ratio(const unsigned socket, struct turbo_activatio
     /* Check if MSR_TURBO_ACTIVATION_RATIO exists on this platform. */
     if (*rapl_flags & TURBO_ACTIVATION_RATIO)
     {
-        read_msr_by_coord(socket, 0, 0, MSR_TURBO_ACTIVATION_RATIO, &(info->bits));
+        read_msr_by_socket(socket, MSR_TURBO_ACTIVATION_RATIO, &(info->bits));
         calc_max_non_turbo(socket, info);
     }
     else
@@ -217,6 +218,7 @@ void calc_max_turbo_ratio(const unsigned socket, struct turbo_limit_data *info,
 int get_turbo_ratio_limit(const unsigned socket, struct turbo_limit_data *info, struct turbo_limit_data *info2)
 {
     static uint64_t *rapl_flags = NULL;
+    static struct turbo_bin_table *tb = NULL;
     sockets_assert(&socket, __LINE__, __FILE__);
     if (rapl_flags == NULL)
     {
@@ -225,11 +227,18 @@ int get_turbo_ratio_limit(const unsigned socket, struct turbo_limit_data *info,
             return -1;
         }
     }
+    if (tb == NULL)
+    {
+        if (turbo_bin_storage(&tb))
+        {
+            return -1;
+        }
+    }
 
     /* Check if MSR_TURBO_RATIO_LIMIT exists on this platform. */
     if (*rapl_flags & TURBO_RATIO_LIMIT)
     {
-        read_msr_by_coord(socket, 0, 0, MSR_TURBO_RATIO_LIMIT, &(info->bits));
+        info->bits = *tb->ratio_limit[socket];
         calc_max_turbo_ratio(socket, info, NULL);
     }
     else
@@ -241,7 +250,7 @@ int get_turbo_ratio_limit(const unsigned socket, struct turbo_limit_data *info,
     /* Check if MSR_TURBO_RATIO_LIMIT1 exists on this platform. */
     if (*rapl_flags & TURBO_RATIO_LIMIT1)
     {
-        read_msr_by_coord(socket, 0, 0, MSR_TURBO_RATIO_LIMIT1, &(info2->bits));
+        info2->bits = *tb->ratio_limit1[socket];
         calc_max_turbo_ratio(socket, NULL, info2);
     }
     else
@@ -251,4 +260,193 @@ int get_turbo_ratio_limit(const unsigned socket, struct turbo_limit_data *info,
     }
     return 0;
 }
+
+/// @brief Fill the turbo ratio table of one socket.
+///
+/// Platforms with ratio groups encode the active-core count of each group in
+/// MSR_TURBO_RATIO_LIMIT1, otherwise byte n of MSR_TURBO_RATIO_LIMIT (and
+/// MSR_TURBO_RATIO_LIMIT1, MSR_TURBO_RATIO_LIMIT2) holds the ratio for n+1
+/// (and n+9, n+17) active cores. Buckets without a ratio inherit the one below
+/// them.
+static void fill_turbo_bins(struct turbo_bin_table *tb, unsigned socket, uint64_t limit1_avail)
+{
+    double *bins = &tb->max_mhz[socket * tb->nbuckets];
+    uint64_t ratio = 0;
+    uint64_t n;
+#ifdef HAS_TURBO_RATIO_GROUPS
+    uint64_t group = 0;
+
+    for (n = 1; n <= tb->nbuckets; n++)
+    {
+        while (group < 7 && n > MASK_VAL(*tb->ratio_limit1[socket], group * 8 + 7, group * 8))
+        {
+            group++;
+        }
+        if (MASK_VAL(*tb->ratio_limit[socket], group * 8 + 7, group * 8))
+        {
+            ratio = MASK_VAL(*tb->ratio_limit[socket], group * 8 + 7, group * 8);
+        }
+        bins[n - 1] = ratio * 100.0;
+    }
+    (void) limit1_avail;
+#else
+    uint64_t raw;
+
+    for (n = 1; n <= tb->nbuckets; n++)
+    {
+        if (n <= 8)
+        {
+            raw = MASK_VAL(*tb->ratio_limit[socket], (n - 1) * 8 + 7, (n - 1) * 8);
+        }
+        else if (n <= 16 && limit1_avail)
+        {
+            raw = MASK_VAL(*tb->ratio_limit1[socket], (n - 9) * 8 + 7, (n - 9) * 8);
+        }
+#ifdef MSR_TURBO_RATIO_LIMIT2
+        /* Bit 63 is the semaphore bit, not part of a ratio. */
+        else if (n <= 23 && limit1_avail)
+        {
+            raw = MASK_VAL(*tb->ratio_limit2[socket], (n - 17) * 8 + 7, (n - 17) * 8);
+        }
+#endif
+        else
+        {
+            raw = 0;
+        }
+        if (raw)
+        {
+            ratio = raw;
+        }
+        bins[n - 1] = ratio * 100.0;
+    }
+#endif
+}
+
+int turbo_bin_storage(struct turbo_bin_table **tb)
+{
+    static struct turbo_bin_table t;
+    static int init = 0;
+    static int valid = 0;
+    static uint64_t *rapl_flags = NULL;
+    uint64_t sockets;
+    unsigned s;
+
+    if (!init)
+    {
+        if (rapl_storage(NULL, &rapl_flags))
+        {
+            return -1;
+        }
+        if (!(*rapl_flags & TURBO_RATIO_LIMIT))
+        {
+            libmsr_error_handler("turbo_bin_storage(): MSR_TURBO_RATIO_LIMIT not supported", LIBMSR_ERROR_PLATFORM_NOT_SUPPORTED, getenv("HOSTNAME"), __FILE__, __LINE__);
+            return -1;
+        }
+        sockets = num_sockets();
+        t.nbuckets = cores_per_socket();
+        t.ratio_limit = (uint64_t **) libmsr_calloc(sockets, sizeof(uint64_t *));
+        t.ratio_limit1 = (uint64_t **) libmsr_calloc(sockets, sizeof(uint64_t *));
+        t.ratio_limit2 = (uint64_t **) libmsr_calloc(sockets, sizeof(uint64_t *));
+        t.max_mhz = (double *) libmsr_calloc(sockets * t.nbuckets, sizeof(double));
+        allocate_batch(TURBO_RATIO, 3UL * sockets);
+        load_socket_batch(MSR_TURBO_RATIO_LIMIT, t.ratio_limit, TURBO_RATIO);
+        if (*rapl_flags & TURBO_RATIO_LIMIT1)
+        {
+            load_socket_batch(MSR_TURBO_RATIO_LIMIT1, t.ratio_limit1, TURBO_RATIO);
+#ifdef MSR_TURBO_RATIO_LIMIT2
+            if (t.nbuckets > 16)
+            {
+                load_socket_batch(MSR_TURBO_RATIO_LIMIT2, t.ratio_limit2, TURBO_RATIO);
+            }
+#endif
+        }
+        /* The batch is loaded once, a failed read is retried on the next call. */
+        init = 1;
+    }
+    if (!valid)
+    {
+        if (read_batch(TURBO_RATIO))
+        {
+            return -1;
+        }
+        for (s = 0; s < num_sockets(); s++)
+        {
+            fill_turbo_bins(&t, s, *rapl_flags & TURBO_RATIO_LIMIT1);
+        }
+        valid = 1;
+    }
+    if (tb != NULL)
+    {
+        *tb = &t;
+    }
+    return 0;
+}
+
+double predict_turbo_freq(const unsigned socket, unsigned active_cores)
+{
+    static struct turbo_bin_table *tb = NULL;
+
+    if (tb == NULL)
+    {
+        if (turbo_bin_storage(&tb))
+        {
+            return -1.0;
+        }
+    }
+    if (socket >= num_sockets())
+    {
+        libmsr_error_handler("predict_turbo_freq(): Invalid socket", LIBMSR_ERROR_ARRAY_BOUNDS, getenv("HOSTNAME"), __FILE__, __LINE__);
+        return -1.0;
+    }
+    if (active_cores < 1)
+    {
+        active_cores = 1;
+    }
+    if (active_cores > tb->nbuckets)
+    {
+        active_cores = tb->nbuckets;
+    }
+    return tb->max_mhz[socket * tb->nbuckets + active_cores - 1];
+}
+
+unsigned turbo_active_cores(const unsigned socket, const double *c0, double threshold)
+{
+    static uint64_t coresPerSocket = 0;
+    unsigned c;
+    unsigned active = 0;
+
+    if (coresPerSocket == 0)
+    {
+        coresPerSocket = cores_per_socket();
+    }
+    for (c = 0; c < coresPerSocket; c++)
+    {
+        active += (c0[socket * coresPerSocket + c] >= threshold);
+    }
+    return active;
+}
+
+void dump_turbo_bins(FILE *writedest)
+{
+    static struct turbo_bin_table *tb = NULL;
+    unsigned s;
+    uint64_t n;
+
+    if (tb == NULL)
+    {
+        if (turbo_bin_storage(&tb))
+        {
+            return;
+        }
+    }
+    for (s = 0; s < num_sockets(); s++)
+    {
+        fprintf(writedest, "Socket %u:", s);
+        for (n = 0; n < tb->nbuckets; n++)
+        {
+            fprintf(writedest, " %luC=%.0f", n + 1, tb->max_mhz[s * tb->nbuckets + n]);
+        }
+        fprintf(writedest, " MHz\n");
+    }
+}
 #endif
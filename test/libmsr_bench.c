@@ -0,0 +1,429 @@
+/*
+ * Copyright (c) 2013-2017, Lawrence Livermore National Security, LLC.
+ *
+ * Produced at the Lawrence Livermore National Laboratory. Written by:
+ *     Barry Rountree <rountree@llnl.gov>,
+ *     Scott Walker <walker91@llnl.gov>, and
+ *     Kathleen Shoga <shoga1@llnl.gov>.
+ *
+ * LLNL-CODE-645430
+ *
+ * All rights reserved.
+ *
+ * This file is part of libmsr. For details, see https://github.com/LLNL/libmsr.git.
+ *
+ * Please also read libmsr/LICENSE for our notice and the LGPL.
+ *
+ * libmsr is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License (as published by the Free
+ * Software Foundation) version 2.1 dated February 1999.
+ *
+ * libmsr is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the IMPLIED WARRANTY OF MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the terms and conditions of the GNU Lesser
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libmsr; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place, Suite 330, Boston, MA 02111-1307 USA.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "master.h"
+#include "memhdlr.h"
+#include "msr_core.h"
+#include "msr_counters.h"
+#include "msr_rapl.h"
+#include "msr_thermal.h"
+
+/// @brief Size of each fake per-CPU device file, covering every MSR address
+/// read by the benchmarks.
+#define FAKE_DEV_SIZE 0x1000
+
+/// @brief Default number of timed calls per benchmark.
+#define DEFAULT_ITERS 10000
+
+static unsigned g_iters = DEFAULT_ITERS;
+
+static const char *g_mode = "dev";
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/// @brief Print one CSV result row.
+///
+/// @param [in] name Benchmark name.
+///
+/// @param [in] calls Number of timed calls.
+///
+/// @param [in] ops Number of register operations (or allocations) per call.
+///
+/// @param [in] ns Total elapsed time in nanoseconds.
+static void report(const char *name, const uint64_t calls, const uint64_t ops, const uint64_t ns)
+{
+    double per_call = (double)ns / calls;
+
+    fprintf(stdout, "%s,%s,%lu,%lu,%.1f,%.1f,%.0f\n", g_mode, name, calls, ops, per_call, per_call / ops, (ns ? calls * ops * 1e9 / ns : 0.0));
+    fflush(stdout);
+}
+
+static void skip(const char *name, const char *why)
+{
+    fprintf(stderr, "libmsr-bench: %s: skipping %s: %s\n", g_mode, name, why);
+}
+
+static void bench_read_msr(void)
+{
+    uint64_t val;
+    uint64_t start;
+    unsigned i;
+
+    if (read_msr_by_idx(0, MSR_PKG_ENERGY_STATUS, &val))
+    {
+        skip("read_msr_by_idx", "read failed");
+        return;
+    }
+    start = now_ns();
+    for (i = 0; i < g_iters; i++)
+    {
+        read_msr_by_idx(0, MSR_PKG_ENERGY_STATUS, &val);
+    }
+    report("read_msr_by_idx", g_iters, 1, now_ns() - start);
+}
+
+/// @brief Time read_batch() on a batch built by one of the load_*_batch()
+/// helpers.
+///
+/// @param [in] name Benchmark name.
+///
+/// @param [in] load Batch loader to use.
+///
+/// @param [in] msr Register to read.
+///
+/// @param [in] n Number of entries the loader fills.
+///
+/// @param [in] batchnum User batch to build.
+static void bench_load_batch(const char *name, int (*load)(off_t, uint64_t **, const int), const off_t msr, const uint64_t n, const int batchnum)
+{
+    uint64_t **val;
+    uint64_t start;
+    unsigned i;
+
+    val = (uint64_t **) libmsr_calloc(n, sizeof(uint64_t *));
+    if (allocate_batch(batchnum, n) || load(msr, val, batchnum) || read_batch(batchnum))
+    {
+        skip(name, "batch read failed");
+        return;
+    }
+    start = now_ns();
+    for (i = 0; i < g_iters; i++)
+    {
+        read_batch(batchnum);
+    }
+    report(name, g_iters, n, now_ns() - start);
+}
+
+static void bench_rapl(void)
+{
+    struct rapl_data *rd = NULL;
+    uint64_t *rapl_flags = NULL;
+    uint64_t start;
+    unsigned i;
+
+    if (rapl_init(&rd, &rapl_flags) < 0 || read_rapl_data())
+    {
+        skip("read_rapl_data+delta_rapl_data", "RAPL init failed");
+        return;
+    }
+    start = now_ns();
+    for (i = 0; i < g_iters; i++)
+    {
+        read_rapl_data();
+        delta_rapl_data();
+    }
+    report("read_rapl_data+delta_rapl_data", g_iters, num_sockets(), now_ns() - start);
+}
+
+static void bench_therm(void)
+{
+    struct therm_stat *ts = NULL;
+    uint64_t start;
+    unsigned i;
+
+    store_therm_stat(&ts);
+    get_therm_stat(ts);
+    start = now_ns();
+    for (i = 0; i < g_iters; i++)
+    {
+        get_therm_stat(ts);
+    }
+    report("get_therm_stat", g_iters, num_cores(), now_ns() - start);
+}
+
+static void bench_counters(void)
+{
+    struct pmc_bank *bank = NULL;
+    uint64_t *out;
+    uint64_t mask;
+    uint64_t start;
+    unsigned i;
+
+    pmc_bank_storage(&bank);
+    if (bank->num_counters < 1)
+    {
+        skip("read_pmc_bank", "no counters");
+        return;
+    }
+    mask = (bank->num_counters >= 64 ? ~0UL : (1UL << bank->num_counters) - 1);
+    out = (uint64_t *) libmsr_calloc(bank->num_counters * bank->num_threads, sizeof(uint64_t));
+    if (read_pmc_bank(mask, out))
+    {
+        skip("read_pmc_bank", "batch read failed");
+        return;
+    }
+    start = now_ns();
+    for (i = 0; i < g_iters; i++)
+    {
+        read_pmc_bank(mask, out);
+    }
+    report("read_pmc_bank", g_iters, bank->num_counters * bank->num_threads, now_ns() - start);
+}
+
+/// @brief Time allocation and release through the memory handler while it
+/// already tracks the library's own allocations.
+static void bench_memhdlr(void)
+{
+    void *p[16];
+    uint64_t start;
+    unsigned i, j;
+
+    start = now_ns();
+    for (i = 0; i < g_iters; i++)
+    {
+        for (j = 0; j < 16; j++)
+        {
+            p[j] = libmsr_calloc(8, sizeof(uint64_t));
+        }
+        for (j = 0; j < 16; j++)
+        {
+            libmsr_free(p[j]);
+        }
+    }
+    report("memhdlr_calloc_free", g_iters, 16, now_ns() - start);
+}
+
+/// @brief Create a device file of FAKE_DEV_SIZE bytes with plausible RAPL
+/// units.
+///
+/// @param [in] path File to create.
+///
+/// @return 0 if successful, else -1.
+static int make_fake_dev(const char *path)
+{
+    uint64_t unit = 0xA0E03;
+    int fd;
+
+    fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    if (ftruncate(fd, FAKE_DEV_SIZE) || pwrite(fd, &unit, sizeof(unit), MSR_RAPL_POWER_UNIT) != sizeof(unit))
+    {
+        close(fd);
+        return -1;
+    }
+    close(fd);
+    return 0;
+}
+
+/// @brief Build a file-backed fake of the msr_safe device tree.
+///
+/// @param [in] root Directory to populate.
+///
+/// @param [in] ncpus Number of per-CPU device files to create.
+///
+/// @return 0 if successful, else -1.
+static int make_fake_tree(const char *root, const uint64_t ncpus)
+{
+    char path[FILENAME_SIZE];
+    uint64_t i;
+
+    snprintf(path, FILENAME_SIZE, "%s/msr_whitelist", root);
+    if (make_fake_dev(path))
+    {
+        return -1;
+    }
+    for (i = 0; i < ncpus; i++)
+    {
+        snprintf(path, FILENAME_SIZE, "%s/%lu", root, i);
+        if (mkdir(path, 0700) && errno != EEXIST)
+        {
+            return -1;
+        }
+        snprintf(path, FILENAME_SIZE, "%s/%lu/msr_safe", root, i);
+        if (make_fake_dev(path))
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void remove_fake_tree(const char *root, const uint64_t ncpus)
+{
+    char path[FILENAME_SIZE];
+    uint64_t i;
+
+    for (i = 0; i < ncpus; i++)
+    {
+        snprintf(path, FILENAME_SIZE, "%s/%lu/msr_safe", root, i);
+        unlink(path);
+        snprintf(path, FILENAME_SIZE, "%s/%lu", root, i);
+        rmdir(path);
+    }
+    snprintf(path, FILENAME_SIZE, "%s/msr_whitelist", root);
+    unlink(path);
+    rmdir(root);
+}
+
+/// @brief Run every benchmark against one backend.
+///
+/// @param [in] fake Non-zero to use a file-backed fake device tree.
+///
+/// @return 0 if successful, else -1 if libmsr could not be initialized.
+static int run_mode(const int fake)
+{
+    char root[] = "/tmp/libmsr-bench-XXXXXX";
+    uint64_t ncpus = 0;
+
+    g_mode = (fake ? "fake" : "dev");
+    if (fake)
+    {
+        if (mkdtemp(root) == NULL || make_fake_tree(root, 1))
+        {
+            fprintf(stderr, "libmsr-bench: could not create fake device tree\n");
+            return -1;
+        }
+        setenv("LIBMSR_DEV_DIR", root, 1);
+        /* Only CPU 0 is probed, the rest is created once the topology is
+         * known. */
+        set_msr_open_mode(MSR_OPEN_LAZY);
+    }
+    if (init_msr())
+    {
+        fprintf(stderr, "libmsr-bench: %s: unable to initialize msr\n", g_mode);
+        if (fake)
+        {
+            remove_fake_tree(root, 1);
+        }
+        return -1;
+    }
+    if (fake)
+    {
+        ncpus = num_devs();
+        if (make_fake_tree(root, ncpus))
+        {
+            fprintf(stderr, "libmsr-bench: could not create fake device tree\n");
+            remove_fake_tree(root, ncpus);
+            return -1;
+        }
+    }
+
+    bench_read_msr();
+    bench_load_batch("load_socket_batch", load_socket_batch, MSR_PKG_ENERGY_STATUS, num_sockets(), USR_BATCH0);
+    bench_load_batch("load_core_batch", load_core_batch, IA32_THERM_STATUS, num_cores(), USR_BATCH1);
+    bench_load_batch("load_thread_batch", load_thread_batch, IA32_TIME_STAMP_COUNTER, num_devs(), USR_BATCH2);
+    bench_rapl();
+    bench_therm();
+    bench_counters();
+    bench_memhdlr();
+
+    finalize_msr();
+    if (fake)
+    {
+        remove_fake_tree(root, ncpus);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *usage = "usage: %s [-m dev|fake|both] [-n iterations]\n";
+    const char *mode = "both";
+    int modes[2];
+    int nmodes = 0;
+    int status;
+    int ran = 0;
+    int opt;
+    int i;
+    pid_t pid;
+
+    while ((opt = getopt(argc, argv, "m:n:h")) != -1)
+    {
+        switch (opt)
+        {
+            case 'm':
+                mode = optarg;
+                break;
+            case 'n':
+                g_iters = strtoul(optarg, NULL, 10);
+                break;
+            default:
+                fprintf(stderr, usage, argv[0]);
+                return (opt == 'h' ? 0 : -1);
+        }
+    }
+    if (g_iters == 0)
+    {
+        fprintf(stderr, usage, argv[0]);
+        return -1;
+    }
+    if (strcmp(mode, "dev") == 0 || strcmp(mode, "both") == 0)
+    {
+        modes[nmodes++] = 0;
+    }
+    if (strcmp(mode, "fake") == 0 || strcmp(mode, "both") == 0)
+    {
+        modes[nmodes++] = 1;
+    }
+    if (nmodes == 0)
+    {
+        fprintf(stderr, usage, argv[0]);
+        return -1;
+    }
+
+    fprintf(stdout, "mode,bench,calls,ops_per_call,ns_per_call,ns_per_op,ops_per_sec\n");
+    fflush(stdout);
+    /* Library state is process wide, so each backend runs in its own
+     * process. */
+    for (i = 0; i < nmodes; i++)
+    {
+        pid = fork();
+        if (pid == 0)
+        {
+            return (run_mode(modes[i]) ? 1 : 0);
+        }
+        if (pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0)
+        {
+            ran++;
+        }
+    }
+    /* A missing backend is skipped, fail only if nothing could be measured. */
+    return (ran ? 0 : 1);
+}
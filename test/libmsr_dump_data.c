@@ -109,7 +109,7 @@ void clocks_test()
 {
     uint64_t sockets = 0;
     int i, j;
-    struct clock_mod t;
+    struct clock_mod *t;
     uint64_t coresPerSocket;
 
     sockets = num_sockets();
@@ -127,16 +127,18 @@ void clocks_test()
     dump_p_state(stdout);
 
     fprintf(stdout, "\n--- Reading IA32_CLOCK_MODULATION ---\n");
+    t = (struct clock_mod *) malloc(sockets * coresPerSocket * sizeof(struct clock_mod));
+    get_clock_mod_all(t);
     for (i = 0; i < sockets; i++)
     {
         for (j = 0; j < coresPerSocket; j++)
         {
-            get_clock_mod(i, j, &t);
             fprintf(stdout, "Socket %d, Core %2d\n", i, j);
-            dump_clock_mod(&t, stdout);
+            dump_clock_mod(&t[i * coresPerSocket + j], stdout);
             fprintf(stdout, "\n");
         }
     }
+    free(t);
 }
 
 void misc_test()